@@ -1,9 +1,12 @@
 package com.example.suota
 
 import android.bluetooth.BluetoothAdapter
+import android.bluetooth.BluetoothDevice
 import android.bluetooth.BluetoothManager
 import android.content.Context
-import android.util.Log
+import android.os.Handler
+import android.os.Looper
+import android.os.SystemClock
 import androidx.core.content.ContextCompat.getSystemService
 import androidx.fragment.app.FragmentActivity
 import androidx.fragment.app.FragmentManager
@@ -28,6 +31,14 @@ import io.flutter.plugin.common.MethodChannel.MethodCallHandler
 
 /** RenesasSuotaPlugin */
 class RenesasSuotaPlugin : FlutterPlugin, MethodCallHandler, ActivityAware {
+  companion object {
+    /// Minimum time in milliseconds between chunk telemetry events
+    private const val CHUNK_EVENT_INTERVAL = 100L
+
+    private var lastSessionId = 0
+    private var lastFirmwareHandle = 0
+  }
+
   /// The MethodChannel that will the communication between Flutter and native Android
   ///
   /// This local reference serves to register the plugin with the Flutter Engine and unregister it
@@ -38,7 +49,10 @@ class RenesasSuotaPlugin : FlutterPlugin, MethodCallHandler, ActivityAware {
   private lateinit var lifecycle: Lifecycle
 
   private var sink: EventChannel.EventSink? = null
-  private lateinit var suotaManager: SuotaManager
+  /// Running sessions, keyed by the upper case device address
+  private val sessions = HashMap<String, Session>()
+  private val firmwareImages = HashMap<Int, ByteArray>()
+  private val mainHandler = Handler(Looper.getMainLooper())
 
   override fun onAttachedToEngine(flutterPluginBinding: FlutterPlugin.FlutterPluginBinding) {
     channel = MethodChannel(flutterPluginBinding.binaryMessenger, "renesas_suota")
@@ -47,7 +61,6 @@ class RenesasSuotaPlugin : FlutterPlugin, MethodCallHandler, ActivityAware {
       object : EventChannel.StreamHandler {
         override fun onListen(arguments: Any?, events: EventChannel.EventSink?) {
           sink = events
-          events?.success(mapOf("event" to "listen"))
         }
 
         override fun onCancel(arguments: Any?) {
@@ -67,6 +80,19 @@ class RenesasSuotaPlugin : FlutterPlugin, MethodCallHandler, ActivityAware {
         "installUpdate" -> {
           installUpdate(call, result)
         }
+        "installUpdateFromBytes" -> {
+          installUpdateFromBytes(call, result)
+        }
+        "installUpdateFromHandle" -> {
+          installUpdateFromHandle(call, result)
+        }
+        "loadFirmware" -> {
+          loadFirmware(call, result)
+        }
+        "releaseFirmware" -> {
+          firmwareImages.remove(call.argument<Int>("handle"))
+          result.success(null)
+        }
         else -> {
           result.notImplemented()
         }
@@ -76,62 +102,200 @@ class RenesasSuotaPlugin : FlutterPlugin, MethodCallHandler, ActivityAware {
   private fun installUpdate(call: MethodCall, result: MethodChannel.Result) {
     val path = call.argument<String>("path")
     val fileName = call.argument<String>("fileName")
-    val remoteId = call.argument<String>("remoteId")
+    startUpdate(call.argument<String>("remoteId"), result) { SuotaFile(path, fileName) }
+  }
+
+  private fun installUpdateFromBytes(call: MethodCall, result: MethodChannel.Result) {
+    val firmware = firmwareFromBytes(call, result) ?: return
+    startUpdate(call.argument<String>("remoteId"), result) { SuotaFile(firmware) }
+  }
+
+  private fun installUpdateFromHandle(call: MethodCall, result: MethodChannel.Result) {
+    val firmware = firmwareImages[call.argument<Int>("handle")]
+    if (firmware == null) {
+      result.error("INVALID_FIRMWARE_HANDLE", "Firmware image not loaded", null)
+      return
+    }
+    startUpdate(call.argument<String>("remoteId"), result) { SuotaFile(firmware) }
+  }
+
+  private fun loadFirmware(call: MethodCall, result: MethodChannel.Result) {
+    val firmware = firmwareFromBytes(call, result) ?: return
+    val handle = ++lastFirmwareHandle
+    firmwareImages[handle] = firmware
+    result.success(handle)
+  }
+
+  private fun firmwareFromBytes(call: MethodCall, result: MethodChannel.Result): ByteArray? {
+    // The codec decodes a Uint8List to a ByteArray, which is used as is
+    val firmware = call.argument<ByteArray>("firmware")
+    if (firmware == null || firmware.isEmpty()) {
+      result.error("INVALID_FIRMWARE", "Firmware image is empty", null)
+      return null
+    }
+    return firmware
+  }
+
+  private fun startUpdate(remoteId: String?, result: MethodChannel.Result, createSuotaFile: () -> SuotaFile) {
     val bluetoothManager: BluetoothManager? =
       getSystemService(context, BluetoothManager::class.java)
     val bluetoothAdapter: BluetoothAdapter? = bluetoothManager?.adapter
     if (bluetoothAdapter == null) {
       result.error("Bluetooth not available", "Bluetooth not available", null)
+      return
     }
-    val remoteDevice = bluetoothAdapter?.getRemoteDevice(remoteId)
-    if (remoteDevice == null) {
+    if (remoteId == null || !BluetoothAdapter.checkBluetoothAddress(remoteId.uppercase())) {
       result.error("Remote device not found", "Remote device not found", null)
+      return
+    }
+    // Sessions are keyed by the upper case address, which is the form the adapter accepts
+    val address = remoteId.uppercase()
+    val active = sessions[address]
+    if (active != null) {
+      result.error("SESSION_ACTIVE", "The device is already being updated", active.sessionId)
+      return
     }
-    suotaManager = SuotaManager(context, remoteDevice, object : SuotaManagerCallback() {
+    val session = Session(++lastSessionId, address, createSuotaFile)
+    sessions[address] = session
+    // The session id reaches Dart before any event of the session
+    result.success(session.sessionId)
+    session.connect(bluetoothAdapter.getRemoteDevice(address))
+  }
 
-      override fun pendingRebootDialog(rebootDialog: SupportCustomDialogFragment?) {
-        if (lifecycle.currentState.isAtLeast(Lifecycle.State.STARTED)) {
-          rebootDialog?.showDialog((activity as FragmentActivity).supportFragmentManager)
-        } else {
-//                    suotaActivity.setPendingRebootDialog(rebootDialog);
-        }
-      }
+  private fun sendEvent(event: Any) {
+    // Event sinks must be used on the main thread
+    mainHandler.post { sink?.success(event) }
+  }
 
-      override fun onSuotaLog(state: SuotaProtocolState?, type: SuotaLogType?, log: String?) {
-      }
+  /** The update of a single device. Each session has its own SuotaManager and telemetry. */
+  private inner class Session(
+    val sessionId: Int,
+    val address: String,
+    private val createSuotaFile: () -> SuotaFile
+  ) : SuotaManagerCallback() {
+    private val telemetry = SuotaTelemetry(sessionId)
+    private val startTime = SystemClock.elapsedRealtime()
+    private var lastChunkEventTime = 0L
+    private var finished = false
+    private lateinit var suotaManager: SuotaManager
 
-      override fun onUploadProgress(percent: Float) {
-        Log.d("RenesasSuotaPlugin", "onUploadProgress: $percent")
-        sink?.success(mapOf("progress" to percent))
-      }
+    fun connect(device: BluetoothDevice) {
+      suotaManager = SuotaManager(context, device, this)
+      suotaManager.setUiContext(context)
+      suotaManager.connect()
+    }
 
-      override fun onSuccess(totalElapsedSeconds: Double, imageUploadElapsedSeconds: Double) {
-        result.success(true)
+    private fun finish(result: Map<String, Any?>) {
+      if (finished)
+        return
+      finished = true
+      sendEvent(result)
+      // The sessions are used on the main thread, like the method calls
+      mainHandler.post {
+        if (sessions[address] === this)
+          sessions.remove(address)
       }
+    }
 
-      override fun onFailure(errorCode: Int) {
-        val errorMsg = SuotaProfile.Errors.suotaErrorCodeList.get(errorCode)
-        result.error(errorCode.toString(), errorMsg, null)
-      }
+    private fun sendTelemetry(event: Int) {
+      if (!finished)
+        sendEvent(telemetry.encode(event))
+    }
 
-      override fun onDeviceReady() {
-        val suotaFile = SuotaFile(path, fileName)
-        suotaManager.suotaFile = suotaFile
-        suotaManager.initializeSuota(
-          SuotaLibConfig.Default.BLOCK_SIZE,
-          SuotaLibConfig.Default.MISO_GPIO,
-          SuotaLibConfig.Default.MOSI_GPIO,
-          SuotaLibConfig.Default.CS_GPIO,
-          SuotaLibConfig.Default.SCK_GPIO,
-          SuotaLibConfig.Default.IMAGE_BANK
-        )
-        suotaManager.startUpdate()
+    override fun pendingRebootDialog(rebootDialog: SupportCustomDialogFragment?) {
+      if (lifecycle.currentState.isAtLeast(Lifecycle.State.STARTED)) {
+        rebootDialog?.showDialog((activity as FragmentActivity).supportFragmentManager)
+      } else {
+//                  suotaActivity.setPendingRebootDialog(rebootDialog);
       }
+    }
+
+    override fun onSuotaLog(state: SuotaProtocolState?, type: SuotaLogType?, log: String?) {
+      if (state == null || telemetry.state == state.ordinal)
+        return
+      telemetry.state = state.ordinal
+      sendTelemetry(SuotaTelemetry.EVENT_STATE)
+    }
 
-    })
-    suotaManager.setUiContext(context)
-    suotaManager.connect()
+    override fun onChunkSend(chunkCount: Int, totalChunks: Int, chunk: Int, block: Int, blockChunks: Int, totalBlocks: Int) {
+      val suotaFile = suotaManager.suotaFile
+      telemetry.block = block
+      telemetry.totalBlocks = totalBlocks
+      telemetry.chunkCount = chunkCount
+      telemetry.totalChunks = totalChunks
+      val blockBytes = minOf(chunk * suotaFile.chunkSize, suotaFile.blockSize)
+      telemetry.bytesSent = minOf((block - 1) * suotaFile.blockSize + blockBytes, suotaFile.uploadSize)
+      // The library reports every chunk, so the chunk events are rate limited here
+      val now = SystemClock.elapsedRealtime()
+      if (now - lastChunkEventTime < CHUNK_EVENT_INTERVAL)
+        return
+      lastChunkEventTime = now
+      sendTelemetry(SuotaTelemetry.EVENT_CHUNK)
+    }
+
+    override fun onBlockSent(block: Int, totalBlocks: Int) {
+      val suotaFile = suotaManager.suotaFile
+      telemetry.block = block
+      telemetry.totalBlocks = totalBlocks
+      telemetry.bytesSent = minOf(block * suotaFile.blockSize, suotaFile.uploadSize)
+      sendTelemetry(SuotaTelemetry.EVENT_BLOCK)
+    }
 
+    override fun updateSpeedStatistics(current: Double, max: Double, min: Double, avg: Double) {
+      telemetry.currentSpeed = current
+      telemetry.avgSpeed = avg
+      sendTelemetry(SuotaTelemetry.EVENT_SPEED)
+    }
+
+    override fun updateCurrentSpeed(currentSpeed: Double) {
+      telemetry.currentSpeed = currentSpeed
+      sendTelemetry(SuotaTelemetry.EVENT_SPEED)
+    }
+
+    override fun onUploadProgress(percent: Float) {
+      telemetry.percent = percent
+      sendTelemetry(SuotaTelemetry.EVENT_PROGRESS)
+    }
+
+    override fun onSuccess(totalElapsedSeconds: Double, imageUploadElapsedSeconds: Double) {
+      finish(mapOf(
+        "sessionId" to sessionId,
+        "event" to "success",
+        "totalElapsedSeconds" to totalElapsedSeconds,
+        "imageUploadElapsedSeconds" to imageUploadElapsedSeconds
+      ))
+    }
+
+    override fun onFailure(errorCode: Int) {
+      finish(mapOf(
+        "sessionId" to sessionId,
+        "event" to "failure",
+        "errorCode" to errorCode,
+        "message" to SuotaProfile.Errors.suotaErrorCodeList.get(errorCode)
+      ))
+    }
+
+    override fun onDeviceReady() {
+      if (finished)
+        return
+      // The device is created from its address, so there is no scan to measure
+      sendEvent(mapOf(
+        "sessionId" to sessionId,
+        "event" to "metrics",
+        "connectLatency" to (SystemClock.elapsedRealtime() - startTime) / 1000.0,
+        "peripheralSource" to "address"
+      ))
+      suotaManager.suotaFile = createSuotaFile()
+      suotaManager.initializeSuota(
+        SuotaLibConfig.Default.BLOCK_SIZE,
+        SuotaLibConfig.Default.MISO_GPIO,
+        SuotaLibConfig.Default.MOSI_GPIO,
+        SuotaLibConfig.Default.CS_GPIO,
+        SuotaLibConfig.Default.SCK_GPIO,
+        SuotaLibConfig.Default.IMAGE_BANK
+      )
+      suotaManager.startUpdate()
+    }
   }
 
   override fun onDetachedFromEngine(binding: FlutterPlugin.FlutterPluginBinding) {
@@ -0,0 +1,72 @@
+package com.example.suota
+
+import android.os.SystemClock
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * Keeps the latest upload state of a session, and encodes it as a fixed size little endian
+ * record, which is sent on the event channel. The layout must match the Dart decoder:
+ *
+ * ```
+ *  0 uint32  session id
+ *  4 uint8   event
+ *  5 uint8   SUOTA protocol state, or NO_STATE
+ *  6 uint8   record version
+ *  7 uint8   reserved
+ *  8 uint32  block
+ * 12 uint32  total blocks
+ * 16 uint32  chunk count
+ * 20 uint32  total chunks
+ * 24 uint32  bytes sent
+ * 28 float32 upload progress percent
+ * 32 float64 current speed in Bps
+ * 40 float64 average speed in Bps
+ * 48 float64 seconds since the session started
+ * ```
+ */
+class SuotaTelemetry(val sessionId: Int) {
+  companion object {
+    const val EVENT_STATE = 1
+    const val EVENT_CHUNK = 2
+    const val EVENT_BLOCK = 3
+    const val EVENT_PROGRESS = 4
+    const val EVENT_SPEED = 5
+
+    const val VERSION = 1
+    const val NO_STATE = 0xFF
+    const val RECORD_SIZE = 56
+  }
+
+  var state = NO_STATE
+  var block = 0
+  var totalBlocks = 0
+  var chunkCount = 0
+  var totalChunks = 0
+  var bytesSent = 0
+  var percent = 0f
+  var currentSpeed = 0.0
+  var avgSpeed = 0.0
+
+  private val startTime = SystemClock.elapsedRealtimeNanos()
+
+  fun encode(event: Int): ByteArray {
+    val elapsed = (SystemClock.elapsedRealtimeNanos() - startTime) / 1e9
+    return ByteBuffer.allocate(RECORD_SIZE).order(ByteOrder.LITTLE_ENDIAN)
+      .putInt(sessionId)
+      .put(event.toByte())
+      .put(state.toByte())
+      .put(VERSION.toByte())
+      .put(0)
+      .putInt(block)
+      .putInt(totalBlocks)
+      .putInt(chunkCount)
+      .putInt(totalChunks)
+      .putInt(bytesSent)
+      .putFloat(percent)
+      .putDouble(currentSpeed)
+      .putDouble(avgSpeed)
+      .putDouble(elapsed)
+      .array()
+  }
+}
@@ -1,6 +1,8 @@
 #import <Flutter/Flutter.h>
 #import <UIKit/UIKit.h>
 #import <XCTest/XCTest.h>
+#import <QuartzCore/QuartzCore.h>
+#import <libkern/OSByteOrder.h>
 
 @import suota;
 
@@ -12,8 +14,328 @@
 
 @end
 
+// Fake fleet transport. Each session reports upload progress in steps on the main queue, then
+// fails with the next scripted error of its device, or succeeds when there are none left.
+@interface FakeFleetTransport : NSObject <SuotaFleetTransport>
+
+@property NSMutableDictionary<NSUUID *, NSMutableArray<NSNumber *> *> *errors;
+@property int activeSessions;
+@property int maxActiveSessions;
+@property int sessionsCreated;
+
+@end
+
+@interface FakeFleetSession : NSObject <SuotaFleetSession>
+
+@property NSUUID *identifier;
+@property(weak) id<SuotaFleetSessionDelegate> delegate;
+@property(weak) FakeFleetTransport *transport;
+@property int error;
+@property BOOL cancelled;
+
+@end
+
+@implementation FakeFleetSession
+
+- (void)start {
+  self.transport.activeSessions++;
+  self.transport.maxActiveSessions =
+      MAX(self.transport.maxActiveSessions, self.transport.activeSessions);
+  [self step:0];
+}
+
+- (void)step:(int)percent {
+  dispatch_after(dispatch_time(DISPATCH_TIME_NOW, 2 * NSEC_PER_MSEC), dispatch_get_main_queue(), ^{
+    if (self.cancelled)
+      return;
+    if (self.error && percent == 50) {
+      self.transport.activeSessions--;
+      [self.delegate onSessionFailure:self error:self.error];
+      return;
+    }
+    [self.delegate onSessionProgress:self percent:percent];
+    if (percent < 100) {
+      [self step:percent + 25];
+      return;
+    }
+    self.transport.activeSessions--;
+    [self.delegate onSessionSuccess:self];
+  });
+}
+
+- (void)cancel {
+  self.cancelled = true;
+  self.transport.activeSessions--;
+}
+
+@end
+
+@implementation FakeFleetTransport
+
+- (id<SuotaFleetSession>)createSession:(NSUUID *)identifier
+                             suotaFile:(SuotaFile *)suotaFile
+                              delegate:(id<SuotaFleetSessionDelegate>)delegate {
+  FakeFleetSession *session = [[FakeFleetSession alloc] init];
+  session.identifier = identifier;
+  session.delegate = delegate;
+  session.transport = self;
+  NSMutableArray<NSNumber *> *errors = self.errors[identifier];
+  if (errors.count) {
+    session.error = errors.firstObject.intValue;
+    [errors removeObjectAtIndex:0];
+  }
+  self.sessionsCreated++;
+  return session;
+}
+
+@end
+
+@interface FleetUpdateObserver : NSObject <SuotaFleetUpdateDelegate>
+
+@property XCTestExpectation *finished;
+@property SuotaFleetProgress *finalProgress;
+@property int progressReports;
+
+@end
+
+@implementation FleetUpdateObserver
+
+- (void)onFleetDeviceStateChange:(SuotaFleetDevice *)device {
+}
+
+- (void)onFleetProgress:(SuotaFleetProgress *)progress {
+  self.progressReports++;
+}
+
+- (void)onFleetFinished:(SuotaFleetProgress *)progress {
+  self.finalProgress = progress;
+  [self.finished fulfill];
+}
+
+@end
+
+// Counts the notifications delivered by a notification coalescer.
+@interface NotificationCounter : NSObject
+
+@property int chunkEvents;
+@property int blockEvents;
+@property int progressEvents;
+@property int lastChunkCount;
+@property int lastBlock;
+@property float lastPercent;
+@property NSMutableArray<NSString *> *events;
+@property XCTestExpectation *completed;
+
+@end
+
+@implementation NotificationCounter
+
+- (void)onChunkSend:(int)chunkCount
+        totalChunks:(int)totalChunks
+              chunk:(int)chunk
+              block:(int)block
+        blockChunks:(int)blockChunks
+        totalBlocks:(int)totalBlocks {
+  self.chunkEvents++;
+  self.lastChunkCount = chunkCount;
+  [self.events addObject:@"chunk"];
+}
+
+- (void)onBlockSent:(int)block totalBlocks:(int)totalBlocks {
+  self.blockEvents++;
+  self.lastBlock = block;
+  [self.events addObject:@"block"];
+}
+
+- (void)onUploadProgress:(float)percent {
+  self.progressEvents++;
+  self.lastPercent = percent;
+  [self.events addObject:@"progress"];
+  if (percent >= 100)
+    [self.completed fulfill];
+}
+
+@end
+
+// Records the operations sent by a GATT scheduler.
+@interface FakeGattExecutor : NSObject <SuotaGattSchedulerDelegate>
+
+@property NSMutableArray<GattOperation *> *executed;
+@property NSMutableArray<GattOperation *> *timedOut;
+@property XCTestExpectation *timeout;
+
+@end
+
+@implementation FakeGattExecutor
+
+- (instancetype)init {
+  self = [super init];
+  self.executed = [NSMutableArray array];
+  self.timedOut = [NSMutableArray array];
+  return self;
+}
+
+- (BOOL)executeScheduledOperation:(GattOperation *)operation {
+  [self.executed addObject:operation];
+  return true;
+}
+
+- (void)onScheduledOperationTimeout:(GattOperation *)operation {
+  [self.timedOut addObject:operation];
+  [self.timeout fulfill];
+}
+
+@end
+
+// Records the result callbacks of a SUOTA manager. The dispatcher forwards only the implemented
+// delegate methods.
+@interface ManagerEventRecorder : NSObject
+
+@property NSMutableArray<NSNumber *> *failures;
+@property int successes;
+@property int lastBlock;
+@property BOOL calledOffMainThread;
+@property XCTestExpectation *failed;
+@property XCTestExpectation *blockSent;
+
+@end
+
+@implementation ManagerEventRecorder
+
+- (instancetype)init {
+  self = [super init];
+  self.failures = [NSMutableArray array];
+  return self;
+}
+
+- (void)checkMainThread {
+  if (!NSThread.isMainThread)
+    self.calledOffMainThread = true;
+}
+
+- (void)onBlockSent:(int)block totalBlocks:(int)totalBlocks {
+  [self checkMainThread];
+  self.lastBlock = block;
+  [self.blockSent fulfill];
+}
+
+- (void)onUploadProgress:(float)percent {
+  [self checkMainThread];
+}
+
+- (void)onSuccess:(double)totalElapsedSeconds imageUploadElapsedSeconds:(double)imageUploadElapsedSeconds {
+  [self checkMainThread];
+  self.successes++;
+}
+
+- (void)onFailure:(int)errorCode {
+  [self checkMainThread];
+  [self.failures addObject:@(errorCode)];
+  [self.failed fulfill];
+}
+
+@end
+
+// Peripheral that accepts a scripted number of writes without response before it reports that its
+// buffers are full, and records the written values.
+@interface FakeChunkPeripheral : NSObject
+
+@property int credits;
+@property NSMutableArray<NSData *> *writes;
+
+@end
+
+@implementation FakeChunkPeripheral
+
+- (instancetype)init {
+  self = [super init];
+  self.writes = [NSMutableArray array];
+  return self;
+}
+
+- (BOOL)canSendWriteWithoutResponse {
+  @synchronized(self) {
+    return self.credits > 0;
+  }
+}
+
+- (void)writeValue:(NSData *)data
+    forCharacteristic:(CBCharacteristic *)characteristic
+                 type:(CBCharacteristicWriteType)type {
+  @synchronized(self) {
+    [self.writes addObject:[data copy]];
+    self.credits--;
+  }
+}
+
+@end
+
+// Builds a firmware image with a header of the given layout, and the payload at offset 64. The
+// payload size, CRC, version and timestamp follow each other from sizeOffset. If pointerOffset is
+// set, it points to the payload.
+static NSData *FirmwareImage(uint16_t signature, int sizeOffset, int pointerOffset,
+                             NSString *version, uint32_t timestamp, NSData *payload) {
+  const int payloadOffset = 64;
+  NSMutableData *image = [NSMutableData dataWithLength:payloadOffset];
+  uint8_t *bytes = image.mutableBytes;
+  bytes[0] = signature >> 8;
+  bytes[1] = signature & 0xff;
+  OSWriteLittleInt32(bytes, sizeOffset, (uint32_t)payload.length);
+  OSWriteLittleInt32(bytes, sizeOffset + 4,
+                     [SuotaChecksum crc32:0 bytes:payload.bytes length:payload.length]);
+  NSData *versionData = [version dataUsingEncoding:NSASCIIStringEncoding];
+  memcpy(bytes + sizeOffset + 8, versionData.bytes, MIN(versionData.length, 16));
+  OSWriteLittleInt32(bytes, sizeOffset + 24, timestamp);
+  if (pointerOffset)
+    OSWriteLittleInt32(bytes, pointerOffset, payloadOffset);
+  [image appendData:payload];
+  return image;
+}
+
+static NSData *RandomData(NSUInteger length) {
+  NSMutableData *data = [NSMutableData dataWithLength:length];
+  arc4random_buf(data.mutableBytes, length);
+  return data;
+}
+
+// The byte at a time XOR loop that SuotaFile used before the checksum kernels.
+static uint8_t ByteLoopXorChecksum(const uint8_t *bytes, NSUInteger length) {
+  uint8_t crc = 0;
+  for (NSUInteger i = 0; i < length; i++)
+    crc ^= bytes[i];
+  return crc;
+}
+
+// Random images of 64 KB, 256 KB, 1 MB and 4 MB, the range of firmware image sizes.
+static NSArray<NSData *> *ChecksumImages(void) {
+  NSMutableArray<NSData *> *images = [NSMutableArray array];
+  for (NSUInteger size = 64 * 1024; size <= 4 * 1024 * 1024; size *= 4)
+    [images addObject:RandomData(size)];
+  return images;
+}
+
 @implementation RunnerTests
 
+// Runs the block on the protocol queue of the manager, which is the main queue unless
+// SUOTA_LIB_CONFIG_PROTOCOL_QUEUE is set.
+- (void)runOnProtocolQueue:(SuotaManager *)manager block:(dispatch_block_t)block {
+  if (manager.protocolQueue == dispatch_get_main_queue())
+    block();
+  else
+    dispatch_sync(manager.protocolQueue, block);
+}
+
+// Waits until the chunks queued so far are written, and the protocol has handled their writes.
+- (void)waitForProtocolQueue:(SuotaManager *)manager {
+  dispatch_sync(manager.bluetoothManager.bleQueue, ^{
+  });
+  XCTestExpectation *idle = [self expectationWithDescription:@"protocol queue idle"];
+  dispatch_async(manager.protocolQueue, ^{
+    [idle fulfill];
+  });
+  [self waitForExpectationsWithTimeout:2 handler:nil];
+}
+
 - (void)testExample {
   SuotaPlugin *plugin = [[SuotaPlugin alloc] init];
 
@@ -30,4 +352,1161 @@
   [self waitForExpectationsWithTimeout:1 handler:nil];
 }
 
+// The telemetry record layout must match the Dart decoder.
+- (void)testTelemetryRecordLayout {
+  SuotaTelemetry *telemetry = [[SuotaTelemetry alloc] initWithSessionId:7];
+  telemetry.state = SEND_BLOCK;
+  telemetry.block = 12;
+  telemetry.totalBlocks = 300;
+  telemetry.chunkCount = 190;
+  telemetry.totalChunks = 4800;
+  telemetry.bytesSent = 45600;
+  telemetry.percent = 4;
+  telemetry.currentSpeed = 21500.5;
+  telemetry.avgSpeed = 19875.25;
+
+  NSData *record = [telemetry encode:TELEMETRY_CHUNK];
+  XCTAssertEqual(record.length, SUOTA_TELEMETRY_RECORD_SIZE);
+  const uint8_t *bytes = record.bytes;
+  uint32_t u32;
+  float f32;
+  double f64;
+  memcpy(&u32, bytes, 4);
+  XCTAssertEqual(u32, 7);
+  XCTAssertEqual(bytes[4], TELEMETRY_CHUNK);
+  XCTAssertEqual(bytes[5], SEND_BLOCK);
+  XCTAssertEqual(bytes[6], SUOTA_TELEMETRY_VERSION);
+  memcpy(&u32, bytes + 8, 4);
+  XCTAssertEqual(u32, 12);
+  memcpy(&u32, bytes + 20, 4);
+  XCTAssertEqual(u32, 4800);
+  memcpy(&u32, bytes + 24, 4);
+  XCTAssertEqual(u32, 45600);
+  memcpy(&f32, bytes + 28, 4);
+  XCTAssertEqual(f32, 4);
+  memcpy(&f64, bytes + 32, 8);
+  XCTAssertEqual(f64, 21500.5);
+  memcpy(&f64, bytes + 40, 8);
+  XCTAssertEqual(f64, 19875.25);
+  memcpy(&f64, bytes + 48, 8);
+  XCTAssertGreaterThanOrEqual(f64, 0);
+}
+
+// Lazily sliced blocks and chunks must match the chunks of the image with the CRC byte appended,
+// sliced eagerly, including a last chunk that holds only the CRC byte.
+- (void)testSuotaFileChunksMatchEagerSlicing {
+  NSArray<NSArray<NSNumber *> *> *geometries =
+      @[ @[ @240, @20 ], @[ @64, @20 ], @[ @100, @33 ], @[ @244, @244 ] ];
+  for (NSNumber *size in @[ @19, @239, @500, @4096, @4099 ]) {
+    NSData *image = RandomData(size.unsignedIntegerValue);
+    uint8_t crc = [SuotaChecksum xorChecksumReference:image.bytes length:image.length];
+    NSMutableData *upload = [image mutableCopy];
+    [upload appendBytes:&crc length:1];
+
+    for (NSArray<NSNumber *> *geometry in geometries) {
+      SuotaFile *file = [[SuotaFile alloc] initWithFirmwareBuffer:image];
+      [file initBlocks:geometry[0].intValue chunkSize:geometry[1].intValue];
+      XCTAssertEqual(file.crc, crc);
+      XCTAssertEqual(file.uploadSize, (int)upload.length);
+
+      NSMutableArray<NSArray<NSData *> *> *blocks = [NSMutableArray array];
+      for (NSUInteger offset = 0; offset < upload.length; offset += file.blockSize) {
+        NSUInteger blockSize = MIN((NSUInteger)file.blockSize, upload.length - offset);
+        NSMutableArray<NSData *> *block = [NSMutableArray array];
+        for (NSUInteger chunk = 0; chunk < blockSize; chunk += file.chunkSize) {
+          NSRange range =
+              NSMakeRange(offset + chunk, MIN((NSUInteger)file.chunkSize, blockSize - chunk));
+          [block addObject:[upload subdataWithRange:range]];
+        }
+        [blocks addObject:block];
+      }
+
+      XCTAssertEqual(file.totalBlocks, (int)blocks.count);
+      int index = 0;
+      for (int block = 0; block < file.totalBlocks; block++) {
+        XCTAssertEqualObjects([file getBlock:block], blocks[block]);
+        XCTAssertEqual([file getBlockChunks:block], (int)blocks[block].count);
+        for (int chunk = 0; chunk < [file getBlockChunks:block]; chunk++, index++) {
+          XCTAssertEqualObjects([file getChunk:index], blocks[block][chunk]);
+          XCTAssertEqual([file isLastChunk:index], chunk == (int)blocks[block].count - 1);
+        }
+      }
+      XCTAssertEqual(file.totalChunks, index);
+      NSData *lastChunk = [file getChunk:index - 1];
+      XCTAssertEqual(((const uint8_t *)lastChunk.bytes)[lastChunk.length - 1], crc);
+    }
+  }
+}
+
+// Headers read from the first bytes of a file must match the headers parsed from the whole image,
+// for each header type. Files shorter than their header, or with an unknown signature, have none.
+- (void)testHeaderInfoBuilderReadsOnlyTheHeader {
+  NSString *directory =
+      [NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString];
+  [NSFileManager.defaultManager createDirectoryAtPath:directory
+                          withIntermediateDirectories:true
+                                           attributes:nil
+                                                error:nil];
+  NSData *payload = RandomData(100 * 1024);
+  NSArray<NSData *> *images = @[
+    FirmwareImage(HeaderInfo58x.SIGNATURE, 4, 0, @"5.0.4.1", 1500000000, payload),
+    FirmwareImage(HeaderInfo68x.SIGNATURE, 4, 32, @"6.0.14.1114", 1600000000, payload),
+    FirmwareImage(HeaderInfo69x.SIGNATURE, 2, 30, @"10.0.10.118", 1700000000, payload),
+  ];
+  NSArray<NSString *> *types = @[ HeaderInfo58x.TYPE, HeaderInfo68x.TYPE, HeaderInfo69x.TYPE ];
+
+  for (NSUInteger i = 0; i < images.count; i++) {
+    NSString *path = [directory stringByAppendingPathComponent:types[i]];
+    [images[i] writeToFile:path atomically:true];
+    HeaderInfo *expected = [HeaderInfoBuilder headerWithRawBuffer:images[i]];
+    HeaderInfo *header = [HeaderInfoBuilder headerWithFilePath:path];
+    XCTAssertEqualObjects(header.type, types[i]);
+    XCTAssertEqualObjects(header.header, expected.header);
+    XCTAssertEqualObjects(header.version, expected.version);
+    XCTAssertEqual(header.timestamp, expected.timestamp);
+    XCTAssertEqual(header.payloadOffset, 64);
+    XCTAssertEqual(header.payloadSize, payload.length);
+    XCTAssertEqual(header.payloadCrc, expected.payloadCrc);
+    XCTAssertEqual(header.totalBytes, images[i].length);
+
+    NSString *link = [path stringByAppendingString:@".link"];
+    [NSFileManager.defaultManager createSymbolicLinkAtPath:link withDestinationPath:path error:nil];
+    XCTAssertEqual([HeaderInfoBuilder headerWithFilePath:link].totalBytes, images[i].length);
+
+    NSString *truncated = [path stringByAppendingString:@".truncated"];
+    [[images[i] subdataWithRange:NSMakeRange(0, header.headerSize - 1)] writeToFile:truncated
+                                                                        atomically:true];
+    XCTAssertNil([HeaderInfoBuilder headerWithFilePath:truncated]);
+  }
+
+  NSString *unknown = [directory stringByAppendingPathComponent:@"unknown"];
+  [payload writeToFile:unknown atomically:true];
+  XCTAssertNil([HeaderInfoBuilder headerWithFilePath:unknown]);
+  NSString *empty = [directory stringByAppendingPathComponent:@"empty"];
+  [[NSData data] writeToFile:empty atomically:true];
+  XCTAssertNil([HeaderInfoBuilder headerWithFilePath:empty]);
+  [NSFileManager.defaultManager removeItemAtPath:directory error:nil];
+}
+
+// A loaded image without header info has its header parsed during the load, so that the payload CRC
+// is calculated in the same pass as the firmware CRC.
+- (void)testLoadedFirmwareChecksPayloadCrc {
+  NSData *payload = RandomData(200 * 1024);
+  NSData *image = FirmwareImage(HeaderInfo69x.SIGNATURE, 2, 30, @"1.0", 1, payload);
+  SuotaFile *suotaFile = [[SuotaFile alloc] initWithFirmwareBuffer:image];
+  XCTAssertTrue(suotaFile.hasHeaderInfo);
+  XCTAssertTrue(suotaFile.payloadCrcCalculated);
+  XCTAssertEqual(suotaFile.calculatedPayloadCrc,
+                 [SuotaChecksum crc32:0 bytes:payload.bytes length:payload.length]);
+  XCTAssertTrue(suotaFile.isHeaderCrcValid);
+
+  NSMutableData *corrupted = [image mutableCopy];
+  ((uint8_t *)corrupted.mutableBytes)[corrupted.length - 1] ^= 0xff;
+  suotaFile = [[SuotaFile alloc] initWithFirmwareBuffer:corrupted];
+  XCTAssertTrue(suotaFile.payloadCrcCalculated);
+  XCTAssertFalse(suotaFile.isHeaderCrcValid);
+
+  // The size field is read as a signed int, so this size wraps around the payload offset unless
+  // the range check avoids the addition
+  NSMutableData *oversized = [image mutableCopy];
+  OSWriteLittleInt32(oversized.mutableBytes, 2, UINT32_MAX);
+  suotaFile = [[SuotaFile alloc] initWithFirmwareBuffer:oversized];
+  XCTAssertTrue(suotaFile.hasHeaderInfo);
+  XCTAssertFalse(suotaFile.payloadCrcCalculated);
+  XCTAssertFalse(suotaFile.isHeaderCrcValid);
+
+  suotaFile = [[SuotaFile alloc] initWithFirmwareBuffer:[NSMutableData dataWithLength:1024]];
+  XCTAssertFalse(suotaFile.hasHeaderInfo);
+  XCTAssertFalse(suotaFile.payloadCrcCalculated);
+}
+
+// A cataloged file must not be parsed again while its size and modification date are unchanged,
+// also after a reload from disk, and must be parsed again when either changes.
+- (void)testFileCatalogInvalidatesChangedFiles {
+  NSString *directory =
+      [NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString];
+  [NSFileManager.defaultManager createDirectoryAtPath:directory
+                          withIntermediateDirectories:true
+                                           attributes:nil
+                                                error:nil];
+  NSString *catalogPath = [directory stringByAppendingPathComponent:@"catalog.plist"];
+  NSString *path = [directory stringByAppendingPathComponent:@"image.img"];
+  NSDate *modificationDate = [NSDate dateWithTimeIntervalSince1970:1600000000];
+  NSData *payload = RandomData(4096);
+  void (^writeImage)(NSData *, NSDate *) = ^(NSData *image, NSDate *date) {
+    [image writeToFile:path atomically:false];
+    [NSFileManager.defaultManager setAttributes:@{NSFileModificationDate : date}
+                                   ofItemAtPath:path
+                                          error:nil];
+  };
+
+  writeImage(FirmwareImage(HeaderInfo69x.SIGNATURE, 2, 30, @"1.0", 1, payload), modificationDate);
+  SuotaFileCatalog *catalog = [[SuotaFileCatalog alloc] initWithCatalogPath:catalogPath];
+  XCTAssertEqualObjects([catalog entryForFile:path].version, @"1.0");
+  [catalog save];
+
+  // Same size and date: the cached header is used, even after a reload
+  NSData *image = FirmwareImage(HeaderInfo69x.SIGNATURE, 2, 30, @"2.0", 2, payload);
+  writeImage(image, modificationDate);
+  catalog = [[SuotaFileCatalog alloc] initWithCatalogPath:catalogPath];
+  SuotaFileCatalogEntry *entry = [catalog entryForFile:path];
+  XCTAssertEqualObjects(entry.version, @"1.0");
+  XCTAssertEqual(entry.timestamp, 1);
+
+  // Modification date changed
+  writeImage(image, [modificationDate dateByAddingTimeInterval:1]);
+  entry = [catalog entryForFile:path];
+  XCTAssertEqualObjects(entry.version, @"2.0");
+  XCTAssertEqual(entry.crc, [SuotaChecksum xorChecksumReference:image.bytes length:image.length]);
+  XCTAssertEqualObjects(entry.headerInfo.version, @"2.0");
+
+  // Size changed
+  image = FirmwareImage(HeaderInfo69x.SIGNATURE, 2, 30, @"3.0", 3, RandomData(1024));
+  writeImage(image, [modificationDate dateByAddingTimeInterval:1]);
+  entry = [catalog entryForFile:path];
+  XCTAssertEqualObjects(entry.version, @"3.0");
+  XCTAssertEqual(entry.size, image.length);
+  XCTAssertEqual(entry.payloadSize, 1024);
+
+  // A symbolic link uses the cached entry of the file it points to
+  NSString *link = [directory stringByAppendingPathComponent:@"link.img"];
+  [NSFileManager.defaultManager createSymbolicLinkAtPath:link withDestinationPath:path error:nil];
+  XCTAssertEqual([catalog entryForFile:link], entry);
+  [NSFileManager.defaultManager removeItemAtPath:directory error:nil];
+}
+
+// Cached values must survive a reload from disk, and invalidating the revision must keep the static
+// device info values only.
+- (void)testDeviceInfoCacheInvalidatesRevision {
+  NSString *path = [NSTemporaryDirectory()
+      stringByAppendingPathComponent:[NSUUID.UUID.UUIDString stringByAppendingString:@".plist"]];
+  NSUUID *peripheral = [NSUUID UUID];
+  NSData *model = [@"DA14585" dataUsingEncoding:NSUTF8StringEncoding];
+  NSData *firmware = [@"6.0.14" dataUsingEncoding:NSUTF8StringEncoding];
+  uint32_t patchDataSize = 244;
+
+  SuotaDeviceInfoCache *cache = [[SuotaDeviceInfoCache alloc] initWithCachePath:path];
+  [cache storeValue:model
+      characteristic:SuotaProfile.CHARACTERISTIC_MODEL_NUMBER_STRING
+          peripheral:peripheral];
+  [cache storeValue:firmware
+      characteristic:SuotaProfile.CHARACTERISTIC_FIRMWARE_REVISION_STRING
+          peripheral:peripheral];
+  [cache storeValue:[NSData dataWithBytes:&patchDataSize length:sizeof(patchDataSize)]
+      characteristic:SuotaProfile.SUOTA_PATCH_DATA_CHAR_SIZE_UUID
+          peripheral:peripheral];
+  [cache save];
+
+  NSDictionary<CBUUID *, NSData *> *values =
+      [[[SuotaDeviceInfoCache alloc] initWithCachePath:path] valuesForPeripheral:peripheral];
+  XCTAssertEqual(values.count, 3);
+  XCTAssertEqualObjects(values[SuotaProfile.CHARACTERISTIC_FIRMWARE_REVISION_STRING], firmware);
+  XCTAssertEqual([cache valuesForPeripheral:[NSUUID UUID]].count, 0);
+
+  [cache invalidateRevisionForPeripheral:peripheral];
+  [cache save];
+  values = [[[SuotaDeviceInfoCache alloc] initWithCachePath:path] valuesForPeripheral:peripheral];
+  XCTAssertEqualObjects(values, @{SuotaProfile.CHARACTERISTIC_MODEL_NUMBER_STRING : model});
+  [NSFileManager.defaultManager removeItemAtPath:path error:nil];
+}
+
+// Checkpoints must survive a reload from disk, and must match only an upload of the same image,
+// identified by its hash, with the same settings.
+- (void)testUploadJournalCheckpoints {
+  NSString *path = [NSTemporaryDirectory()
+      stringByAppendingPathComponent:[NSUUID.UUID.UUIDString stringByAppendingString:@".plist"]];
+  NSUUID *peripheral = [NSUUID UUID];
+  NSMutableData *image = [NSMutableData dataWithLength:4096];
+  NSData *imageHash = [SuotaChecksum sha256:image];
+  SuotaUploadCheckpoint *checkpoint = [[SuotaUploadCheckpoint alloc] initWithPeripheral:peripheral
+                                                                              imageHash:imageHash
+                                                                                   size:4097
+                                                                              blockSize:240
+                                                                           memoryDevice:0x13000000
+                                                                                gpioMap:0
+                                                                       firmwareRevision:@"6.0.14"];
+  checkpoint.lastBlock = 7;
+
+  SuotaUploadJournal *journal = [[SuotaUploadJournal alloc] initWithJournalPath:path];
+  [journal updateCheckpoint:checkpoint];
+  [journal save];
+  SuotaUploadCheckpoint *stored =
+      [[[SuotaUploadJournal alloc] initWithJournalPath:path] checkpointForPeripheral:peripheral];
+  XCTAssertNotNil(stored);
+  XCTAssertEqualObjects(stored.imageHash, imageHash);
+  XCTAssertEqual(stored.lastBlock, 7);
+  XCTAssertTrue([stored isSameUpload:checkpoint]);
+
+  // Images with the same XOR CRC and size must not match
+  ((uint8_t *)image.mutableBytes)[0] = 0x5a;
+  ((uint8_t *)image.mutableBytes)[1] = 0x5a;
+  SuotaUploadCheckpoint *other = [[SuotaUploadCheckpoint alloc] initWithPeripheral:peripheral
+                                                                         imageHash:[SuotaChecksum sha256:image]
+                                                                              size:4097
+                                                                         blockSize:240
+                                                                      memoryDevice:0x13000000
+                                                                           gpioMap:0
+                                                                  firmwareRevision:@"6.0.14"];
+  XCTAssertFalse([stored isSameUpload:other]);
+  other = [[SuotaUploadCheckpoint alloc] initWithPeripheral:peripheral
+                                                  imageHash:imageHash
+                                                       size:4097
+                                                  blockSize:240
+                                               memoryDevice:0x13000000
+                                                    gpioMap:0
+                                           firmwareRevision:@"6.0.16"];
+  XCTAssertFalse([stored isSameUpload:other]);
+
+  [journal removeCheckpointForPeripheral:peripheral];
+  [journal save];
+  XCTAssertNil([[[SuotaUploadJournal alloc] initWithJournalPath:path] checkpointForPeripheral:peripheral]);
+
+  // Journals of the previous version identified the image by its CRC only
+  NSDictionary *legacy = @{
+    @"version" : @1,
+    @"checkpoints" : @{
+      peripheral.UUIDString : @{@"crc" : @0x12, @"size" : @4097, @"blockSize" : @240, @"memoryDevice" : @0, @"gpioMap" : @0, @"lastBlock" : @7}
+    }
+  };
+  [[NSPropertyListSerialization dataWithPropertyList:legacy
+                                              format:NSPropertyListBinaryFormat_v1_0
+                                             options:0
+                                               error:nil] writeToFile:path
+                                                           atomically:true];
+  XCTAssertNil([[[SuotaUploadJournal alloc] initWithJournalPath:path] checkpointForPeripheral:peripheral]);
+  [NSFileManager.defaultManager removeItemAtPath:path error:nil];
+}
+
+// A checkpoint must be resumed only if the device reports exactly the bytes of the acknowledged
+// blocks. Stock firmware resets its write offset on the memory device command and reports 0.
+- (void)testResumeRequiresDeviceReportedOffset {
+  SuotaManager *manager = [[SuotaManager alloc] init];
+  manager.suotaFile = [[SuotaFile alloc] initWithFirmwareBuffer:[NSMutableData dataWithLength:4096]];
+  int blockSize = manager.suotaFile.blockSize;
+
+  for (NSNumber *reported in @[ @0, @(3 * blockSize) ]) {
+    SuotaProtocol *protocol = [[SuotaProtocol alloc] initWithManager:manager];
+    dispatch_block_t resume = ^{
+      protocol.suotaRunning = true;
+      protocol.state = SET_GPIO_MAP;
+      protocol.resumeBlock = 3;
+      protocol.checkpoint = [[SuotaUploadCheckpoint alloc] initWithPeripheral:[NSUUID UUID]
+                                                                    imageHash:[SuotaChecksum sha256:manager.suotaFile.data]
+                                                                         size:manager.suotaFile.uploadSize
+                                                                    blockSize:blockSize
+                                                                 memoryDevice:0
+                                                                      gpioMap:0
+                                                             firmwareRevision:nil];
+      uint32_t value = reported.unsignedIntValue;
+      [protocol onMemoryInfoRead:[NSData dataWithBytes:&value length:sizeof(value)]];
+
+      BOOL resumed = reported.intValue > 0;
+      XCTAssertEqual(protocol.state, SEND_BLOCK);
+      XCTAssertEqual(protocol.resumeBlock, 0);
+      XCTAssertEqual(protocol.firstBlock, resumed ? 3 : 0);
+      XCTAssertEqual(protocol.currentBlock, resumed ? 3 : 0);
+      if (resumed)
+        XCTAssertEqual(protocol.checkpoint.lastBlock, 2);
+      [protocol destroy];
+    };
+    [self runOnProtocolQueue:manager block:resume];
+  }
+}
+
+// A GATT operation timeout during the update must stop the protocol, so that a late response can't
+// continue it, and must be reported once.
+- (void)testGattTimeoutStopsProtocol {
+  ManagerEventRecorder *recorder = [[ManagerEventRecorder alloc] init];
+  recorder.failed = [self expectationWithDescription:@"failure reported"];
+  SuotaManager *manager = [[SuotaManager alloc] init];
+  manager.suotaManagerDelegate = (id<SuotaManagerDelegate>)recorder;
+  manager.suotaFile = [[SuotaFile alloc] initWithFirmwareBuffer:[NSMutableData dataWithLength:4096]];
+  SuotaProtocol *protocol = [[SuotaProtocol alloc] initWithManager:manager];
+  manager.suotaProtocol = protocol;
+
+  dispatch_block_t timeout = ^{
+    protocol.suotaRunning = true;
+    protocol.state = SEND_BLOCK;
+    [(id<SuotaGattSchedulerDelegate>)manager onScheduledOperationTimeout:[[GattOperation alloc] init]];
+    XCTAssertFalse(protocol.isRunning);
+    XCTAssertEqual(protocol.state, ERROR);
+    XCTAssertNil(manager.suotaProtocol);
+  };
+  [self runOnProtocolQueue:manager block:timeout];
+
+  [self waitForExpectationsWithTimeout:1 handler:nil];
+  XCTAssertEqualObjects(recorder.failures, @[ @(GATT_OPERATION_TIMEOUT) ]);
+  XCTAssertEqual(recorder.successes, 0);
+}
+
+// With a window of one, a control write queued after a read group must be sent before the remaining
+// reads. The group completes with its last read, and an operation without a response times out.
+- (void)testGattSchedulerPriorityAndDeadline {
+  CBCharacteristic *(^characteristic)(NSString *) = ^(NSString *uuid) {
+    return (CBCharacteristic *)[[CBMutableCharacteristic alloc]
+        initWithType:[CBUUID UUIDWithString:uuid]
+          properties:CBCharacteristicPropertyRead | CBCharacteristicPropertyWrite
+               value:nil
+         permissions:CBAttributePermissionsReadable];
+  };
+  CBCharacteristic *model = characteristic(@"2A24");
+  CBCharacteristic *firmware = characteristic(@"2A26");
+  CBCharacteristic *patchLength = characteristic(@"2A00");
+  FakeGattExecutor *executor = [[FakeGattExecutor alloc] init];
+  SuotaGattScheduler *scheduler =
+      [[SuotaGattScheduler alloc] initWithDelegate:executor
+                                             queue:dispatch_get_main_queue()
+                                            window:1
+                                           timeout:0.2];
+
+  __block BOOL groupCompleted = false;
+  GattOperation *readModel = [[GattOperation alloc] initWithCharacteristic:model];
+  GattOperation *readFirmware = [[GattOperation alloc] initWithCharacteristic:firmware];
+  GattOperation *write = [[GattOperation alloc] initWithCharacteristic:patchLength value:240];
+  [scheduler enqueueGroup:@[ readModel, readFirmware ]
+                     name:@"info"
+               completion:^{
+                 groupCompleted = true;
+               }];
+  [scheduler enqueue:write];
+  XCTAssertEqualObjects(executor.executed, @[ readModel ]);
+  XCTAssertEqual(scheduler.queueDepth, 2);
+  XCTAssertTrue([scheduler isGroupPending:@"info"]);
+
+  XCTAssertTrue([scheduler completeOperation:READ characteristic:model error:nil]);
+  XCTAssertTrue([scheduler completeOperation:WRITE characteristic:patchLength error:nil]);
+  XCTAssertFalse(groupCompleted);
+  XCTAssertTrue([scheduler completeOperation:READ characteristic:firmware error:nil]);
+  XCTAssertEqualObjects(executor.executed, (@[ readModel, write, readFirmware ]));
+  XCTAssertTrue(groupCompleted);
+  XCTAssertFalse([scheduler isGroupPending:@"info"]);
+  XCTAssertFalse([scheduler completeOperation:READ characteristic:model error:nil]);
+  XCTAssertEqual(scheduler.completed, 3);
+  XCTAssertEqual(scheduler.maxQueueDepth, 2);
+
+  executor.timeout = [self expectationWithDescription:@"The write must time out"];
+  [scheduler enqueue:[[GattOperation alloc] initWithCharacteristic:patchLength value:240]];
+  [self waitForExpectationsWithTimeout:2 handler:nil];
+  XCTAssertEqual(scheduler.timedOut, 1);
+  XCTAssertEqual(scheduler.inFlight, 0);
+}
+
+// Each comparator must skip the image only if the selected device revision matches the image
+// header, or is newer when that is allowed.
+- (void)testVersionPolicyComparators {
+  HeaderInfo *header = [[HeaderInfo alloc] init];
+  header.version = @"6.0.14.1114";
+  header.timestamp = 1600000000;
+
+  // Only the selected revision is compared, the software revision by default
+  SuotaVersionPolicy *exact = SuotaVersionPolicy.exactVersionPolicy;
+  XCTAssertTrue([exact isFirmwareCurrent:header firmwareRevision:nil softwareRevision:@"6.0.14.1114\n"]);
+  XCTAssertFalse([exact isFirmwareCurrent:header firmwareRevision:@"6.0.14.1114" softwareRevision:@"1.2"]);
+  SuotaVersionPolicy *exactFirmware = [[SuotaVersionPolicy alloc] initWithComparison:VERSION_EXACT
+                                                                                field:REVISION_FIRMWARE
+                                                                           allowNewer:false];
+  XCTAssertTrue([exactFirmware isFirmwareCurrent:header firmwareRevision:@"6.0.14.1114" softwareRevision:nil]);
+  XCTAssertFalse([exactFirmware isFirmwareCurrent:header firmwareRevision:@"v_6.0.14.1115" softwareRevision:nil]);
+
+  // A newer version is current only if explicitly allowed
+  SuotaVersionPolicy *semantic = SuotaVersionPolicy.semanticVersionPolicy;
+  XCTAssertEqualObjects([SuotaVersionPolicy parseSemanticVersion:@"DA14585 v_6.0.14.1114"],
+                        (@[ @6, @0, @14, @1114 ]));
+  XCTAssertTrue([semantic isFirmwareCurrent:header firmwareRevision:nil softwareRevision:@"v_6.0.14.1114"]);
+  XCTAssertFalse([semantic isFirmwareCurrent:header firmwareRevision:nil softwareRevision:@"6.1"]);
+  XCTAssertFalse([semantic isFirmwareCurrent:header firmwareRevision:nil softwareRevision:@"6.0.14"]);
+  XCTAssertFalse([semantic isFirmwareCurrent:header firmwareRevision:nil softwareRevision:@"unknown"]);
+  SuotaVersionPolicy *semanticNewer = [[SuotaVersionPolicy alloc] initWithComparison:VERSION_SEMANTIC
+                                                                                field:REVISION_SOFTWARE
+                                                                           allowNewer:true];
+  XCTAssertTrue([semanticNewer isFirmwareCurrent:header firmwareRevision:nil softwareRevision:@"6.1"]);
+  XCTAssertFalse([semanticNewer isFirmwareCurrent:header firmwareRevision:@"6.1" softwareRevision:@"6.0.14"]);
+
+  SuotaVersionPolicy *timestamp = SuotaVersionPolicy.timestampPolicy;
+  XCTAssertEqual([SuotaVersionPolicy parseTimestamp:@"build 1600000001"], 1600000001);
+  XCTAssertTrue([timestamp isFirmwareCurrent:header firmwareRevision:nil softwareRevision:@"build 1600000000"]);
+  XCTAssertFalse([timestamp isFirmwareCurrent:header firmwareRevision:nil softwareRevision:@"build 1600000001"]);
+  XCTAssertFalse([timestamp isFirmwareCurrent:header firmwareRevision:nil softwareRevision:@"build 1599999999"]);
+  XCTAssertFalse([timestamp isFirmwareCurrent:header firmwareRevision:@"build 1600000000" softwareRevision:nil]);
+  SuotaVersionPolicy *timestampNewer = [[SuotaVersionPolicy alloc] initWithComparison:VERSION_TIMESTAMP
+                                                                                 field:REVISION_SOFTWARE
+                                                                            allowNewer:true];
+  XCTAssertTrue([timestampNewer isFirmwareCurrent:header firmwareRevision:nil softwareRevision:@"build 1600000001"]);
+}
+
+// Percentiles must stay within the bucket precision, and a merged histogram must match one that
+// recorded all values, also after encoding.
+- (void)testHistogramPercentilesAndMerge {
+  SuotaHistogram *first = [[SuotaHistogram alloc] init];
+  SuotaHistogram *second = [[SuotaHistogram alloc] init];
+  SuotaHistogram *all = [[SuotaHistogram alloc] init];
+  for (uint64_t value = 1; value <= 10000; value++) {
+    [(value % 2 ? first : second) recordValue:value * 100];
+    [all recordValue:value * 100];
+  }
+  XCTAssertEqual(all.min, 100);
+  XCTAssertEqual([all valueAtPercentile:100], 1000000);
+  for (NSNumber *percentile in @[ @50, @90, @99 ]) {
+    double expected = percentile.doubleValue * 10000;
+    XCTAssertEqualWithAccuracy([all valueAtPercentile:percentile.doubleValue], expected,
+                               expected / 32);
+  }
+
+  SuotaHistogram *merged = [SuotaHistogram histogramWithData:first.data];
+  [merged merge:[SuotaHistogram histogramWithData:second.data]];
+  XCTAssertEqualObjects(merged.data, all.data);
+  XCTAssertEqual(merged.count, 10000);
+  XCTAssertEqual(merged.mean, 500050);
+  XCTAssertNil([SuotaHistogram histogramWithData:[all.data subdataWithRange:NSMakeRange(0, 20)]]);
+
+  [merged reset];
+  XCTAssertEqual([merged valueAtPercentile:50], 0);
+}
+
+// The checksum kernels must match the byte at a time XOR and zlib CRC32 for every length and
+// alignment, and a CRC32 computed in parts must match the whole.
+- (void)testChecksumKernels {
+  NSMutableData *image = [NSMutableData dataWithLength:64 * 1024 + 64];
+  arc4random_buf(image.mutableBytes, image.length);
+  const uint8_t *bytes = image.bytes;
+
+  for (NSUInteger offset = 0; offset < 16; offset++) {
+    for (NSUInteger length = 0; length <= 300; length++) {
+      XCTAssertEqual([SuotaChecksum xorChecksum:bytes + offset length:length],
+                     ByteLoopXorChecksum(bytes + offset, length));
+      XCTAssertEqual([SuotaChecksum crc32:0 bytes:bytes + offset length:length],
+                     [SuotaChecksum crc32Reference:0 bytes:bytes + offset length:length]);
+    }
+  }
+
+  NSUInteger size = 64 * 1024 + 7;
+  uint32_t crc = [SuotaChecksum crc32Reference:0 bytes:bytes length:size];
+  XCTAssertEqual([SuotaChecksum xorChecksum:bytes length:size], ByteLoopXorChecksum(bytes, size));
+  XCTAssertEqual([SuotaChecksum crc32:0 bytes:bytes length:size], crc);
+  for (NSUInteger split = 1; split < size; split += 4099) {
+    uint32_t part = [SuotaChecksum crc32:0 bytes:bytes length:split];
+    XCTAssertEqual([SuotaChecksum crc32:part bytes:bytes + split length:size - split], crc);
+  }
+}
+
+// Image sized buffers whose length is not a multiple of the widest kernel stride (64 bytes for
+// AVX2 and NEON), at an unaligned start, must leave no tail byte out of either kernel.
+- (void)testChecksumKernelsOnUnevenImageLengths {
+  for (NSData *image in ChecksumImages()) {
+    const uint8_t *bytes = image.bytes;
+    for (NSUInteger trim = 1; trim < 64; trim += 9) {
+      NSUInteger length = image.length - trim;
+      XCTAssertEqual([SuotaChecksum xorChecksum:bytes + 1 length:length - 1],
+                     ByteLoopXorChecksum(bytes + 1, length - 1));
+      XCTAssertEqual([SuotaChecksum xorChecksum:bytes length:length],
+                     ByteLoopXorChecksum(bytes, length));
+    }
+    NSUInteger length = image.length - 33;
+    XCTAssertEqual([SuotaChecksum crc32:0 bytes:bytes + 1 length:length],
+                   [SuotaChecksum crc32Reference:0 bytes:bytes + 1 length:length]);
+  }
+}
+
+// The four measurements below time the same 64 KB - 4 MB images, so that the kernel baselines can
+// be compared with the byte loop and zlib baselines they replace.
+- (void)testXorChecksumByteLoopPerformance {
+  NSArray<NSData *> *images = ChecksumImages();
+  __block uint8_t checksum;
+  [self measureBlock:^{
+    // Kept in a result, so that the inlined loop is not optimized out
+    checksum = 0;
+    for (NSData *image in images)
+      checksum ^= ByteLoopXorChecksum(image.bytes, image.length);
+  }];
+  uint8_t expected = 0;
+  for (NSData *image in images)
+    expected ^= [SuotaChecksum xorChecksum:image.bytes length:image.length];
+  XCTAssertEqual(checksum, expected);
+}
+
+- (void)testXorChecksumKernelPerformance {
+  NSArray<NSData *> *images = ChecksumImages();
+  [self measureBlock:^{
+    for (NSData *image in images)
+      [SuotaChecksum xorChecksum:image.bytes length:image.length];
+  }];
+}
+
+- (void)testCrc32ZlibPerformance {
+  NSArray<NSData *> *images = ChecksumImages();
+  [self measureBlock:^{
+    for (NSData *image in images)
+      [SuotaChecksum crc32Reference:0 bytes:image.bytes length:image.length];
+  }];
+}
+
+- (void)testCrc32KernelPerformance {
+  NSArray<NSData *> *images = ChecksumImages();
+  [self measureBlock:^{
+    for (NSData *image in images)
+      [SuotaChecksum crc32:0 bytes:image.bytes length:image.length];
+  }];
+}
+
+// A consumer thread must receive every object pushed by a producer thread, once and in order,
+// while the queue keeps filling up and draining.
+- (void)testRingBufferAcrossThreads {
+  const NSUInteger total = 200000;
+  SuotaRingBuffer<NSNumber *> *ring = [[SuotaRingBuffer alloc] initWithCapacity:50];
+  XCTAssertEqual(ring.capacity, 64);
+
+  dispatch_semaphore_t produced = dispatch_semaphore_create(0);
+  dispatch_async(dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+    for (NSUInteger i = 0; i < total; i++) {
+      while (![ring push:@(i)])
+        ;
+    }
+    dispatch_semaphore_signal(produced);
+  });
+
+  NSUInteger expected = 0;
+  BOOL ordered = true;
+  while (expected < total) {
+    NSNumber *object = [ring pop];
+    if (!object)
+      continue;
+    if (object.unsignedIntegerValue != expected)
+      ordered = false;
+    expected++;
+  }
+  XCTAssertTrue(ordered);
+  XCTAssertEqual(dispatch_semaphore_wait(produced, dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC)), 0);
+  XCTAssertNil([ring pop]);
+  XCTAssertTrue(ring.isEmpty);
+
+  // The queue holds exactly its capacity, and removeAllObjects releases the rest
+  for (NSUInteger i = 0; i < ring.capacity; i++)
+    XCTAssertTrue([ring push:@(i)]);
+  XCTAssertFalse([ring push:@(ring.capacity)]);
+  XCTAssertEqual(ring.count, ring.capacity);
+  [ring removeAllObjects];
+  XCTAssertTrue(ring.isEmpty);
+}
+
+// Chunk sized buffers for one block, queued and sent 5000 times by the two queue benchmarks below.
+static NSArray<NSData *> *BlockChunks(void) {
+  NSMutableArray<NSData *> *chunks = [NSMutableArray array];
+  for (int i = 0; i < 64; i++)
+    [chunks addObject:RandomData(244)];
+  return chunks;
+}
+
+// Measures the per chunk enqueue and dequeue cost of the send chunk ring buffer. Compare with
+// testSendChunkLockedArrayPerformance.
+- (void)testSendChunkRingBufferPerformance {
+  NSArray<NSData *> *chunks = BlockChunks();
+  SuotaRingBuffer<NSData *> *ring = [[SuotaRingBuffer alloc] initWithCapacity:chunks.count];
+  __block NSUInteger sent = 0;
+  [self measureBlock:^{
+    for (int block = 0; block < 5000; block++) {
+      for (NSData *chunk in chunks)
+        [ring push:chunk];
+      while ([ring pop])
+        sent++;
+    }
+  }];
+  XCTAssertEqual(sent % (chunks.count * 5000), 0);
+}
+
+// Measures the same chunks through the locked NSMutableArray queue that the ring buffer replaced.
+- (void)testSendChunkLockedArrayPerformance {
+  NSArray<NSData *> *chunks = BlockChunks();
+  NSMutableArray<NSData *> *queue = [NSMutableArray array];
+  __block NSUInteger sent = 0;
+  [self measureBlock:^{
+    for (int block = 0; block < 5000; block++) {
+      for (NSData *chunk in chunks) {
+        @synchronized(queue) {
+          [queue addObject:chunk];
+        }
+      }
+      while (true) {
+        @synchronized(queue) {
+          if (!queue.count)
+            break;
+          [queue removeObjectAtIndex:0];
+        }
+        sent++;
+      }
+    }
+  }];
+  XCTAssertEqual(sent % (chunks.count * 5000), 0);
+}
+
+// Runs a fleet update against the fake transport: the concurrency cap must hold, a transient error
+// must be retried and an image error must not.
+- (void)testFleetUpdateWithFakeTransport {
+  NSMutableData *image = [NSMutableData dataWithLength:64 * 1024];
+  arc4random_buf(image.mutableBytes, image.length);
+  SuotaFile *firmware = [[SuotaFile alloc] initWithFirmwareBuffer:image];
+
+  NSMutableArray<NSUUID *> *identifiers = [NSMutableArray array];
+  for (int i = 0; i < 10; i++)
+    [identifiers addObject:[NSUUID UUID]];
+  FakeFleetTransport *transport = [[FakeFleetTransport alloc] init];
+  transport.errors = [NSMutableDictionary dictionary];
+  transport.errors[identifiers[2]] = [@[ @(UPLOAD_TIMEOUT) ] mutableCopy];
+  transport.errors[identifiers[5]] = [@[ @(SAME_IMAGE_ERROR) ] mutableCopy];
+
+  FleetUpdateObserver *observer = [[FleetUpdateObserver alloc] init];
+  observer.finished = [self expectationWithDescription:@"fleet update must finish"];
+  SuotaFleetUpdate *fleet = [[SuotaFleetUpdate alloc] initWithIdentifiers:identifiers
+                                                                 suotaFile:firmware
+                                                                 transport:transport
+                                                                  delegate:observer];
+  fleet.maxConcurrentSessions = 3;
+  fleet.maxRetries = 1;
+  fleet.retryDelay = 0;
+  [fleet start];
+  [self waitForExpectationsWithTimeout:5 handler:nil];
+
+  XCTAssertEqual(transport.maxActiveSessions, 3);
+  XCTAssertEqual(transport.sessionsCreated, 11);
+  XCTAssertEqual(observer.finalProgress.succeeded, 9);
+  XCTAssertEqual(observer.finalProgress.failed, 1);
+  XCTAssertEqualWithAccuracy(observer.finalProgress.percent, 100, 0.01);
+  XCTAssertGreaterThan(observer.progressReports, 0);
+  XCTAssertEqual(fleet.devices[2].state, FLEET_DEVICE_SUCCEEDED);
+  XCTAssertEqual(fleet.devices[2].attempts, 2);
+  XCTAssertEqual(fleet.devices[5].state, FLEET_DEVICE_FAILED);
+  XCTAssertEqual(fleet.devices[5].lastError, SAME_IMAGE_ERROR);
+  XCTAssertFalse(fleet.running);
+}
+
+// Protocol events must be handled on the protocol queue, which is private if
+// SUOTA_LIB_CONFIG_PROTOCOL_QUEUE is set, and the delegate must be called on the main queue.
+- (void)testProtocolEventsReachDelegateOnMainQueue {
+  ManagerEventRecorder *recorder = [[ManagerEventRecorder alloc] init];
+  recorder.blockSent = [self expectationWithDescription:@"block sent reported"];
+  SuotaManager *manager = [[SuotaManager alloc] init];
+  manager.suotaManagerDelegate = (id<SuotaManagerDelegate>)recorder;
+  manager.suotaFile = [[SuotaFile alloc] initWithFirmwareBuffer:[NSMutableData dataWithLength:4096]];
+  SuotaProtocol *protocol = [[SuotaProtocol alloc] initWithManager:manager];
+  manager.suotaProtocol = protocol;
+
+  __block BOOL onProtocolQueue = false;
+  __block BOOL onMainThread = true;
+  dispatch_async(manager.protocolQueue, ^{
+    onProtocolQueue = manager.isOnProtocolQueue;
+    onMainThread = NSThread.isMainThread;
+    protocol.suotaRunning = true;
+    protocol.state = SEND_BLOCK;
+    protocol.currentBlock = 0;
+    int chunks = [manager.suotaFile getBlockChunks:0];
+    protocol.lastChunk = [[SendChunkOperation alloc] initWithSuotaProtocol:protocol
+                                                            characteristic:nil
+                                                                 valueData:[NSData data]
+                                                                chunkCount:chunks
+                                                                     chunk:chunks - 1
+                                                                     block:0
+                                                               isLastChunk:true];
+    [protocol onCharacteristicChanged:SERVICE_STATUS_OK];
+  });
+  [self waitForExpectationsWithTimeout:2 handler:nil];
+
+  XCTAssertTrue(onProtocolQueue);
+  XCTAssertEqual(onMainThread, !SuotaLibConfig.PROTOCOL_QUEUE);
+  XCTAssertEqual(recorder.lastBlock, 1);
+  XCTAssertFalse(recorder.calledOffMainThread);
+  XCTAssertEqual(recorder.failures.count, 0);
+  [manager destroy];
+}
+
+// Each write readiness callback must write chunks while the peripheral accepts them, and account
+// for every written chunk and for the chunks written per callback.
+- (void)testBatchedWritesAccounting {
+  const int totalChunks = 8;
+  const int credits = 3;
+  SuotaManager *manager = [[SuotaManager alloc] init];
+  manager.suotaFile = [[SuotaFile alloc] initWithFirmwareBuffer:[NSMutableData dataWithLength:4096]];
+  FakeChunkPeripheral *peripheral = [[FakeChunkPeripheral alloc] init];
+  manager.peripheral = (CBPeripheral *)peripheral;
+  manager.patchDataCharacteristic = [[CBMutableCharacteristic alloc]
+      initWithType:SuotaProfile.SUOTA_PATCH_DATA_UUID
+        properties:CBCharacteristicPropertyWriteWithoutResponse
+             value:nil
+       permissions:CBAttributePermissionsWriteable];
+  SuotaProtocol *protocol = [[SuotaProtocol alloc] initWithManager:manager];
+  manager.suotaProtocol = protocol;
+  [self runOnProtocolQueue:manager
+                     block:^{
+                       protocol.suotaRunning = true;
+                       protocol.state = SEND_BLOCK;
+                     }];
+
+  NSMutableArray<SendChunkOperation *> *chunks = [NSMutableArray array];
+  for (int chunk = 0; chunk < totalChunks; chunk++) {
+    [chunks addObject:[[SendChunkOperation alloc] initWithSuotaProtocol:protocol
+                                                         characteristic:manager.patchDataCharacteristic
+                                                              valueData:[NSData dataWithBytes:&chunk length:1]
+                                                             chunkCount:chunk + 1
+                                                                  chunk:chunk
+                                                                  block:0
+                                                            isLastChunk:false]];
+  }
+  // Queued together, as the protocol does, before the writer runs
+  dispatch_sync(manager.bluetoothManager.bleQueue, ^{
+    peripheral.credits = credits;
+    for (SendChunkOperation *chunk in chunks)
+      [manager enqueueSendChunkOperation:chunk];
+  });
+  int callbacks = 1;
+  while (true) {
+    __block NSUInteger written;
+    dispatch_sync(manager.bluetoothManager.bleQueue, ^{
+      written = peripheral.writes.count;
+    });
+    if (written == totalChunks)
+      break;
+    dispatch_sync(manager.bluetoothManager.bleQueue, ^{
+      peripheral.credits = credits;
+      [manager peripheralIsReadyToSendWriteWithoutResponse:(CBPeripheral *)peripheral];
+    });
+    callbacks++;
+  }
+  [self waitForProtocolQueue:manager];
+
+  int batch = SuotaLibConfig.BATCH_WRITES ? credits : 1;
+  XCTAssertEqual(callbacks, (totalChunks + batch - 1) / batch);
+  XCTAssertEqual(protocol.statistics.writeCallbacks, callbacks);
+  XCTAssertEqual(protocol.statistics.batchedChunks, totalChunks);
+  XCTAssertEqual(protocol.statistics.maxChunksPerCallback, batch);
+  XCTAssertEqualWithAccuracy(protocol.statistics.chunksPerCallback, (double)totalChunks / callbacks, 0.001);
+  XCTAssertEqual(protocol.lastChunk, chunks.lastObject);
+  for (int chunk = 0; chunk < totalChunks; chunk++)
+    XCTAssertEqual(((const uint8_t *)peripheral.writes[chunk].bytes)[0], chunk);
+
+  [protocol destroy];
+  manager.peripheral = nil;
+  [manager destroy];
+}
+
+// With pipelining, the next block must be queued on the status notification of the current one, and
+// the chunks must reach the peripheral in image order. A shorter last block is prepared as a patch
+// length write instead.
+- (void)testPipelinedBlocksKeepImageOrder {
+  SuotaManager *manager = [[SuotaManager alloc] init];
+  manager.suotaFile = [[SuotaFile alloc] initWithFirmwareBuffer:RandomData(4096)];
+  [manager.suotaFile initBlocks:240 chunkSize:20];
+  FakeChunkPeripheral *peripheral = [[FakeChunkPeripheral alloc] init];
+  peripheral.credits = INT_MAX;
+  manager.peripheral = (CBPeripheral *)peripheral;
+  CBCharacteristic *patchLength = [[CBMutableCharacteristic alloc]
+      initWithType:SuotaProfile.SUOTA_PATCH_LEN_UUID
+        properties:CBCharacteristicPropertyWrite
+             value:nil
+       permissions:CBAttributePermissionsWriteable];
+  SuotaProtocol *protocol = [[SuotaProtocol alloc] initWithManager:manager];
+  manager.suotaProtocol = protocol;
+  SuotaFile *file = manager.suotaFile;
+  const int blocks = 3;
+
+  [self runOnProtocolQueue:manager
+                     block:^{
+                       protocol.suotaRunning = true;
+                       protocol.state = SEND_BLOCK;
+                       protocol.currentBlock = 0;
+                       // Sends the current block after the patch length write
+                       [protocol onCharacteristicWrite:patchLength];
+                       XCTAssertEqual(protocol.preparedChunks != nil, SuotaLibConfig.PIPELINE_BLOCKS);
+                       if (protocol.preparedChunks)
+                         XCTAssertEqual(protocol.preparedChunks.firstObject.block, 1);
+                     }];
+  for (int block = 1; block < blocks; block++) {
+    [self waitForProtocolQueue:manager];
+    [self runOnProtocolQueue:manager
+                       block:^{
+                         XCTAssertTrue(protocol.lastChunk.isLastChunk);
+                         [protocol onCharacteristicChanged:SERVICE_STATUS_OK];
+                         XCTAssertEqual(protocol.state, SEND_BLOCK);
+                         XCTAssertEqual(protocol.currentBlock, block);
+                       }];
+  }
+  [self waitForProtocolQueue:manager];
+
+  NSMutableArray<NSData *> *expected = [NSMutableArray array];
+  for (int block = 0; block < blocks; block++)
+    [expected addObjectsFromArray:[file getBlock:block]];
+  XCTAssertEqualObjects(peripheral.writes, expected);
+
+  if (SuotaLibConfig.PIPELINE_BLOCKS && file.isLastBlockShorter) {
+    [self runOnProtocolQueue:manager
+                       block:^{
+                         protocol.currentBlock = file.totalBlocks - 2;
+                         [protocol onCharacteristicWrite:patchLength];
+                         XCTAssertNil(protocol.preparedChunks);
+                         XCTAssertNotNil(protocol.preparedPatchLength);
+                       }];
+    [self waitForProtocolQueue:manager];
+  }
+
+  [protocol destroy];
+  manager.peripheral = nil;
+  [manager destroy];
+}
+
+// The chunk size must be derived from the MTU only if the caller didn't set one.
+- (void)testExplicitChunkSizeOverridesMtu {
+  for (NSNumber *explicitChunkSize in @[ @0, @20 ]) {
+    SuotaManager *manager = [[SuotaManager alloc] init];
+    manager.suotaFile = [[SuotaFile alloc] initWithFirmwareBuffer:[NSMutableData dataWithLength:4096]];
+    manager.mtu = 247;
+    manager.patchDataSize = 244;
+    if (explicitChunkSize.intValue)
+      manager.chunkSize = explicitChunkSize.intValue;
+    [self runOnProtocolQueue:manager
+                       block:^{
+                         [manager initializeSuota];
+                       }];
+
+    int blockSize = SuotaLibConfig.DEFAULT_BLOCK_SIZE;
+    int chunkSize = SuotaLibConfig.AUTO_CHUNK_SIZE ? MIN(244, blockSize) : SuotaLibConfig.DEFAULT_CHUNK_SIZE;
+    if (explicitChunkSize.intValue)
+      chunkSize = explicitChunkSize.intValue;
+    XCTAssertEqual(manager.suotaFile.chunkSize, chunkSize);
+    XCTAssertEqual(manager.suotaFile.blockSize, SuotaLibConfig.AUTO_CHUNK_SIZE && !explicitChunkSize.intValue
+                                                    ? blockSize / chunkSize * chunkSize
+                                                    : blockSize);
+    [manager destroy];
+  }
+}
+
+// Armed and cancelled timers must leave the wheel empty, and the timers left armed must all fire,
+// never before their interval.
+- (void)testTimerWheelFiresOnTime {
+  const int sessions = 128;
+  SuotaTimerWheel *wheel = [[SuotaTimerWheel alloc] initWithTickInterval:0.01 slots:16];
+  NSMutableArray<dispatch_queue_t> *queues = [NSMutableArray arrayWithCapacity:sessions];
+  for (int i = 0; i < sessions; i++)
+    [queues addObject:dispatch_queue_create("Session", DISPATCH_QUEUE_SERIAL)];
+
+  // A block timeout per block, as the protocol does
+  for (int block = 0; block < 100; block++) {
+    for (int session = 0; session < sessions; session++) {
+      SuotaTimer *timeout = [wheel scheduleTimerWithInterval:30
+                                                       queue:queues[session]
+                                                     repeats:false
+                                                       block:^(SuotaTimer *timer) {
+                                                         XCTFail(@"cancelled timer fired");
+                                                       }];
+      [timeout invalidate];
+      XCTAssertFalse(timeout.isValid);
+    }
+  }
+  XCTAssertEqual(wheel.count, 0);
+
+  XCTestExpectation *fired = [self expectationWithDescription:@"all timers must fire"];
+  fired.expectedFulfillmentCount = sessions;
+  __block double earliest = DBL_MAX;
+  for (int session = 0; session < sessions; session++) {
+    // Longer than one revolution for some timers
+    double interval = 0.02 + 0.3 * session / sessions;
+    CFTimeInterval armed = CACurrentMediaTime();
+    [wheel scheduleTimerWithInterval:interval
+                               queue:queues[session]
+                             repeats:false
+                               block:^(SuotaTimer *timer) {
+                                 @synchronized(fired) {
+                                   earliest = MIN(earliest, CACurrentMediaTime() - armed - interval);
+                                 }
+                                 [fired fulfill];
+                               }];
+  }
+  XCTAssertEqual(wheel.count, sessions);
+  [self waitForExpectationsWithTimeout:5 handler:nil];
+  XCTAssertGreaterThanOrEqual(earliest, -wheel.tickInterval);
+  XCTAssertEqual(wheel.count, 0);
+}
+
+// Arms and cancels a block timeout per block for 128 sessions, as the protocol does, with a speed
+// sampling timer armed per session. Compare with testDispatchSourceTimeoutPerformance.
+- (void)testTimerWheelTimeoutPerformance {
+  const int sessions = 128;
+  SuotaTimerWheel *wheel = [[SuotaTimerWheel alloc] initWithTickInterval:0.01 slots:512];
+  NSMutableArray<dispatch_queue_t> *queues = [NSMutableArray arrayWithCapacity:sessions];
+  NSMutableArray<SuotaTimer *> *samplers = [NSMutableArray arrayWithCapacity:sessions];
+  for (int i = 0; i < sessions; i++) {
+    [queues addObject:dispatch_queue_create("Session", DISPATCH_QUEUE_SERIAL)];
+    [samplers addObject:[wheel scheduleTimerWithInterval:1
+                                                    queue:queues[i]
+                                                  repeats:true
+                                                    block:^(SuotaTimer *timer){
+                                                    }]];
+  }
+
+  [self measureBlock:^{
+    for (int block = 0; block < 200; block++) {
+      for (int session = 0; session < sessions; session++) {
+        SuotaTimer *timeout = [wheel scheduleTimerWithInterval:30
+                                                         queue:queues[session]
+                                                       repeats:false
+                                                         block:^(SuotaTimer *timer){
+                                                         }];
+        [timeout invalidate];
+      }
+    }
+  }];
+  XCTAssertEqual(wheel.count, sessions);
+  for (SuotaTimer *sampler in samplers)
+    [sampler invalidate];
+  XCTAssertEqual(wheel.count, 0);
+}
+
+// Measures the same block timeouts and speed sampling with a dispatch timer source per timer,
+// instead of one wheel for all the sessions.
+- (void)testDispatchSourceTimeoutPerformance {
+  const int sessions = 128;
+  NSMutableArray<dispatch_queue_t> *queues = [NSMutableArray arrayWithCapacity:sessions];
+  NSMutableArray<dispatch_source_t> *samplers = [NSMutableArray arrayWithCapacity:sessions];
+  for (int i = 0; i < sessions; i++) {
+    [queues addObject:dispatch_queue_create("Session", DISPATCH_QUEUE_SERIAL)];
+    dispatch_source_t sampler =
+        dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queues[i]);
+    dispatch_source_set_timer(sampler, dispatch_time(DISPATCH_TIME_NOW, NSEC_PER_SEC),
+                              NSEC_PER_SEC, NSEC_PER_SEC / 100);
+    dispatch_source_set_event_handler(sampler, ^{
+    });
+    dispatch_resume(sampler);
+    [samplers addObject:sampler];
+  }
+
+  [self measureBlock:^{
+    for (int block = 0; block < 200; block++) {
+      for (int session = 0; session < sessions; session++) {
+        dispatch_source_t timeout =
+            dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queues[session]);
+        dispatch_source_set_timer(timeout, dispatch_time(DISPATCH_TIME_NOW, 30 * NSEC_PER_SEC),
+                                  DISPATCH_TIME_FOREVER, NSEC_PER_SEC / 100);
+        dispatch_source_set_event_handler(timeout, ^{
+        });
+        dispatch_resume(timeout);
+        dispatch_source_cancel(timeout);
+      }
+    }
+  }];
+  for (dispatch_source_t sampler in samplers)
+    dispatch_source_cancel(sampler);
+}
+
+// A timer invalidated after it fired, while its block is still queued, must not call the block.
+- (void)testTimerWheelCancelWhileFirePending {
+  SuotaTimerWheel *wheel = [[SuotaTimerWheel alloc] initWithTickInterval:0.01 slots:16];
+  dispatch_queue_t queue = dispatch_queue_create("Session", DISPATCH_QUEUE_SERIAL);
+  dispatch_semaphore_t busy = dispatch_semaphore_create(0);
+  dispatch_async(queue, ^{
+    dispatch_semaphore_wait(busy, DISPATCH_TIME_FOREVER);
+  });
+
+  __block BOOL called = false;
+  SuotaTimer *timer = [wheel scheduleTimerWithInterval:0.01
+                                                 queue:queue
+                                               repeats:false
+                                                 block:^(SuotaTimer *timer) {
+                                                   called = true;
+                                                 }];
+  // Fired: unlinked from the wheel, but still valid until the block runs
+  CFTimeInterval deadline = CACurrentMediaTime() + 2;
+  while (wheel.count && CACurrentMediaTime() < deadline)
+    usleep(1000);
+  XCTAssertEqual(wheel.count, 0);
+  XCTAssertTrue(timer.isValid);
+
+  [timer invalidate];
+  XCTAssertFalse(timer.isValid);
+  dispatch_semaphore_signal(busy);
+  dispatch_sync(queue, ^{
+  });
+  XCTAssertFalse(called);
+}
+
+// Deliveries must carry the latest values in chunk, block, progress order. A flush must deliver the
+// pending snapshot once, and a 100% progress must be delivered immediately, after the pending chunk
+// and block.
+- (void)testNotificationCoalescerFlushOrder {
+  NotificationCounter *counter = [[NotificationCounter alloc] init];
+  counter.events = [NSMutableArray array];
+  SuotaNotificationCoalescer *coalescer =
+      [[SuotaNotificationCoalescer alloc] initWithDelegate:(id<SuotaManagerDelegate>)counter
+                                                     queue:dispatch_get_main_queue()
+                                                      rate:10];
+
+  for (int chunk = 1; chunk <= 3; chunk++)
+    [coalescer onChunkSend:chunk totalChunks:6 chunk:chunk block:1 blockChunks:3 totalBlocks:2];
+  [coalescer onBlockSent:1 totalBlocks:2];
+  [coalescer onUploadProgress:50];
+  [coalescer onChunkSend:4 totalChunks:6 chunk:1 block:2 blockChunks:3 totalBlocks:2];
+  XCTAssertEqual(counter.events.count, 0);
+
+  [coalescer flush];
+  XCTAssertEqualObjects(counter.events, (@[ @"chunk", @"block", @"progress" ]));
+  XCTAssertEqual(counter.lastChunkCount, 4);
+  XCTAssertEqual(counter.lastBlock, 1);
+  XCTAssertEqualWithAccuracy(counter.lastPercent, 50, 0.001);
+  XCTAssertEqual(coalescer.updates, 6);
+  XCTAssertEqual(coalescer.deliveries, 1);
+
+  [coalescer flush];
+  XCTAssertEqual(coalescer.deliveries, 1);
+
+  [counter.events removeAllObjects];
+  [coalescer onChunkSend:6 totalChunks:6 chunk:3 block:2 blockChunks:3 totalBlocks:2];
+  [coalescer onBlockSent:2 totalBlocks:2];
+  [coalescer onUploadProgress:100];
+  XCTAssertEqualObjects(counter.events, (@[ @"chunk", @"block", @"progress" ]));
+  XCTAssertEqual(counter.lastChunkCount, 6);
+  XCTAssertEqual(counter.lastBlock, 2);
+  XCTAssertEqualWithAccuracy(counter.lastPercent, 100, 0.001);
+  XCTAssertEqual(coalescer.deliveries, 2);
+
+  // No scheduled delivery is left to repeat an older snapshot
+  [[NSRunLoop mainRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.3]];
+  XCTAssertEqual(coalescer.deliveries, 2);
+  XCTAssertEqual(counter.events.count, 3);
+}
+
+// Chunk, block and progress notifications of a 512 block upload, paced over about half a second,
+// must be delivered through a 10 Hz coalescer as a few snapshots, and the last one must carry the
+// final chunk, block and 100% progress.
+- (void)testNotificationCoalescerRate {
+  const int totalBlocks = 512;
+  const int blockChunks = 16;
+  NotificationCounter *counter = [[NotificationCounter alloc] init];
+  counter.completed = [self expectationWithDescription:@"100% progress must be delivered"];
+  SuotaNotificationCoalescer *coalescer =
+      [[SuotaNotificationCoalescer alloc] initWithDelegate:(id<SuotaManagerDelegate>)counter
+                                                     queue:dispatch_get_main_queue()
+                                                      rate:10];
+
+  CFTimeInterval start = CACurrentMediaTime();
+  dispatch_async(dispatch_queue_create("ChunkWriter", DISPATCH_QUEUE_SERIAL), ^{
+    int chunkCount = 0;
+    for (int block = 1; block <= totalBlocks; block++) {
+      for (int chunk = 1; chunk <= blockChunks; chunk++) {
+        [coalescer onChunkSend:++chunkCount
+                   totalChunks:totalBlocks * blockChunks
+                         chunk:chunk
+                         block:block
+                   blockChunks:blockChunks
+                   totalBlocks:totalBlocks];
+      }
+      [coalescer onBlockSent:block totalBlocks:totalBlocks];
+      [coalescer onUploadProgress:(float)block / totalBlocks * 100];
+      usleep(1000);
+    }
+  });
+  [self waitForExpectationsWithTimeout:10 handler:nil];
+  CFTimeInterval elapsed = CACurrentMediaTime() - start;
+
+  XCTAssertEqual(coalescer.updates, totalBlocks * (blockChunks + 2));
+  XCTAssertLessThanOrEqual(coalescer.deliveries, (int)(elapsed * 10) + 2);
+  XCTAssertEqual(counter.lastChunkCount, totalBlocks * blockChunks);
+  XCTAssertEqual(counter.lastBlock, totalBlocks);
+  XCTAssertEqualWithAccuracy(counter.lastPercent, 100, 0.001);
+}
+
 @end
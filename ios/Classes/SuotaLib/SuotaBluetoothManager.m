@@ -9,6 +9,7 @@
  */
 
 #import "SuotaBluetoothManager.h"
+#import "SuotaLibConfig.h"
 #import "SuotaLibLog.h"
 #import "SuotaManager.h"
 #import "SuotaUtils.h"
@@ -114,29 +115,34 @@ NSString* const SuotaBluetoothManagerDeviceDisconnected = @"SuotaBluetoothManage
 }
 
 - (void) centralManager:(CBCentralManager*)central didConnectPeripheral:(CBPeripheral*)peripheral {
-    dispatch_async(dispatch_get_main_queue(), ^{
-        SuotaLog(TAG, @"Device connected: %@", peripheral.name);
-        NSDictionary* info = @{@"peripheral" : peripheral};
-        [NSNotificationCenter.defaultCenter postNotificationName:SuotaBluetoothManagerDeviceConnected object:self userInfo:info];
-    });
+    SuotaLog(TAG, @"Device connected: %@", peripheral.name);
+    NSDictionary* info = @{@"peripheral" : peripheral};
+    [self postConnectionNotification:SuotaBluetoothManagerDeviceConnected userInfo:info];
 }
 
 - (void) centralManager:(CBCentralManager*)central didFailToConnectPeripheral:(CBPeripheral*)peripheral error:(NSError*)error {
-    dispatch_async(dispatch_get_main_queue(), ^{
-        SuotaLog(TAG, @"Device connection error: %@ %@", peripheral.name, error);
-        NSDictionary* info = @{@"peripheral" : peripheral, @"error" : error};
-        [NSNotificationCenter.defaultCenter postNotificationName:SuotaBluetoothManagerConnectionFailed object:self userInfo:info];
-    });
+    SuotaLog(TAG, @"Device connection error: %@ %@", peripheral.name, error);
+    NSDictionary* info = @{@"peripheral" : peripheral, @"error" : error};
+    [self postConnectionNotification:SuotaBluetoothManagerConnectionFailed userInfo:info];
 }
 
 - (void) centralManager:(CBCentralManager*)central didDisconnectPeripheral:(CBPeripheral*)peripheral error:(NSError*)error {
+    if (error)
+        SuotaLog(TAG, @"Device disconnected: %@, error: %@", peripheral.name, error);
+    else
+        SuotaLog(TAG, @"Device disconnected: %@", peripheral.name);
+    NSDictionary* info = !error ? @{@"peripheral" : peripheral} : @{@"peripheral" : peripheral, @"error" : error};
+    [self postConnectionNotification:SuotaBluetoothManagerDeviceDisconnected userInfo:info];
+}
+
+// If the SUOTA managers run on their own queues, connection notifications are posted on the Bluetooth queue, so that they don't wait for the main thread.
+- (void) postConnectionNotification:(NSString*)name userInfo:(NSDictionary*)info {
+    if (SuotaLibConfig.PROTOCOL_QUEUE) {
+        [NSNotificationCenter.defaultCenter postNotificationName:name object:self userInfo:info];
+        return;
+    }
     dispatch_async(dispatch_get_main_queue(), ^{
-        if (error)
-            SuotaLog(TAG, @"Device disconnected: %@, error: %@", peripheral.name, error);
-        else
-            SuotaLog(TAG, @"Device disconnected: %@", peripheral.name);
-        NSDictionary* info = !error ? @{@"peripheral" : peripheral} : @{@"peripheral" : peripheral, @"error" : error};
-        [NSNotificationCenter.defaultCenter postNotificationName:SuotaBluetoothManagerDeviceDisconnected object:self userInfo:info];
+        [NSNotificationCenter.defaultCenter postNotificationName:name object:self userInfo:info];
     });
 }
 
@@ -14,12 +14,14 @@
 #import "SuotaProfile.h"
 #import "SuotaScanner.h"
 #import "AutoSuota.h"
+#import "SuotaFleetUpdate.h"
 #import "HeaderInfo.h"
 #import "HeaderInfo58x.h"
 #import "HeaderInfo68x.h"
 #import "HeaderInfo69x.h"
 #import "SuotaManager.h"
 #import "SuotaFile.h"
+#import "SuotaVersionPolicy.h"
 
 @interface SuotaLib : NSObject
 
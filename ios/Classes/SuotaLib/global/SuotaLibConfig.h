@@ -42,6 +42,96 @@
  */
 #define SUOTA_LIB_CONFIG_CHECK_HEADER_CRC true
 
+/*!
+ * @defined SUOTA_LIB_CONFIG_MEMORY_MAP_FIRMWARE
+ *
+ * @abstract Indicates if the library should memory-map the firmware file instead of reading it into memory.
+ *
+ * @discussion If <code>true</code>, the firmware file is mapped read-only, when the file system allows it, and the image pages are loaded on demand during the upload.
+ *
+ */
+#define SUOTA_LIB_CONFIG_MEMORY_MAP_FIRMWARE true
+
+/*!
+ * @defined SUOTA_LIB_CONFIG_FILE_CATALOG
+ *
+ * @abstract Indicates if the firmware file list methods should use the persistent firmware catalog.
+ *
+ * @discussion If <code>true</code>, the header info and CRC of each firmware file are stored in the catalog at {@link FIRMWARE_CATALOG_PATH}. A file is parsed again only if its size or modification date changes.
+ *
+ */
+#define SUOTA_LIB_CONFIG_FILE_CATALOG true
+
+/*!
+ * @defined SUOTA_LIB_CONFIG_AUTO_CHUNK_SIZE
+ *
+ * @abstract Indicates if the library should select the upload chunk and block size automatically.
+ *
+ * @discussion If <code>true</code>, the chunk size is set to the minimum of the negotiated ATT MTU - 3 and the device patch data size, and the block size is rounded down to a multiple of the chunk size. The configured block size is used as the device limit. A chunk size set on the manager is used as is.
+ *
+ */
+#define SUOTA_LIB_CONFIG_AUTO_CHUNK_SIZE true
+
+/*!
+ * @defined SUOTA_LIB_CONFIG_L2CAP_TRANSPORT
+ *
+ * @abstract Indicates if the library should send the image data over an L2CAP connection oriented channel.
+ *
+ * @discussion If <code>true</code> and the device reports a non-zero L2CAP PSM, the image data are streamed over the L2CAP channel instead of writing the patch data characteristic. The status notifications still control the block transfer. If the channel fails, the library falls back to GATT writes.
+ *
+ */
+#define SUOTA_LIB_CONFIG_L2CAP_TRANSPORT true
+
+/*!
+ * @defined SUOTA_LIB_CONFIG_L2CAP_OPEN_TIMEOUT
+ *
+ * @abstract L2CAP channel open timeout milli seconds. On timeout, the library falls back to GATT writes.
+ *
+ */
+#define SUOTA_LIB_CONFIG_L2CAP_OPEN_TIMEOUT 5000 //ms
+
+/*!
+ * @defined SUOTA_LIB_CONFIG_BATCH_WRITES
+ *
+ * @abstract Indicates if the library should write several chunks on each write readiness callback.
+ *
+ * @discussion If <code>true</code>, chunks are written while the peripheral <code>canSendWriteWithoutResponse</code> is <code>true</code>, so that several chunks can be sent in the same connection event. If <code>false</code>, one chunk is written on each <code>peripheralIsReadyToSendWriteWithoutResponse:</code> callback.
+ *
+ */
+#define SUOTA_LIB_CONFIG_BATCH_WRITES true
+
+/*!
+ * @defined SUOTA_LIB_CONFIG_PIPELINE_BLOCKS
+ *
+ * @abstract Indicates if the library should prepare the next block while waiting for the current block status notification.
+ *
+ * @discussion If <code>true</code>, the chunk operations of the next block, or its patch length write, are prepared as soon as the current block is queued. The next block is sent on the same run loop turn as the <code>SERVICE_STATUS_OK</code> notification, before the block sent notifications and statistics are processed.
+ *
+ */
+#define SUOTA_LIB_CONFIG_PIPELINE_BLOCKS true
+
+/*!
+ * @defined SUOTA_LIB_CONFIG_RESUME_UPLOADS
+ *
+ * @abstract Indicates if an interrupted upload should resume from the last block acknowledged by the device.
+ *
+ * @discussion If <code>true</code>, the last acknowledged block of each upload is recorded in the journal at {@link UPLOAD_JOURNAL_PATH}. When the same image, identified by its SHA-256 digest, is uploaded again to the same peripheral, with the same block size and memory settings, and the device firmware revision did not change, the memory info characteristic is read after the memory device is set. The upload continues after the recorded block only if the device reports that it has received exactly the bytes of the acknowledged blocks. Otherwise, it starts from the first block. If the device rejects the resumed upload, it is restarted from the first block.
+ *
+ * Stock SUOTA firmware resets the image write offset when the memory device is set, so it never resumes. Enable this only for firmware that keeps the received image and reports its size in the memory info characteristic.
+ *
+ */
+#define SUOTA_LIB_CONFIG_RESUME_UPLOADS false
+
+/*!
+ * @defined SUOTA_LIB_CONFIG_PROTOCOL_QUEUE
+ *
+ * @abstract Indicates if each {@link SuotaManager} should run on a private serial queue instead of the main thread.
+ *
+ * @discussion If <code>true</code>, the peripheral callbacks, the SUOTA protocol state machine and its timers run on a serial queue owned by the manager, so that the upload is not delayed by work on the main thread. Only the {@link SuotaManagerDelegate} methods are called on the manager <code>delegateQueue</code>, which is the main queue by default. If <code>false</code>, everything runs on the main thread.
+ *
+ */
+#define SUOTA_LIB_CONFIG_PROTOCOL_QUEUE false
+
 // SUOTA Manager and Protocol Config
 /*!
  * @defined SUOTA_LIB_CONFIG_CALCULATE_STATISTICS
@@ -61,6 +151,36 @@
  */
 #define SUOTA_LIB_CONFIG_UPLOAD_TIMEOUT 30000 //ms
 
+/*!
+ * @defined SUOTA_LIB_CONFIG_GATT_WINDOW
+ *
+ * @abstract Maximum number of GATT operations in flight per peripheral.
+ *
+ * @discussion Operations that expect a response are sent by the {@link SuotaGattScheduler} of the {@link SuotaManager}, control writes before info reads before data writes. A window of 2 keeps the next operation queued in CoreBluetooth while the current one completes, so the link is not idle between operations, and leaves the rest in priority order.
+ *
+ */
+#define SUOTA_LIB_CONFIG_GATT_WINDOW 2
+
+/*!
+ * @defined SUOTA_LIB_CONFIG_GATT_OPERATION_TIMEOUT
+ *
+ * @abstract Time a GATT operation may wait for its response, in milli seconds.
+ *
+ * @discussion If the response does not arrive in time, the update fails with <code>GATT_OPERATION_TIMEOUT</code>, instead of waiting for the protocol timeout. Set to 0 to disable.
+ *
+ */
+#define SUOTA_LIB_CONFIG_GATT_OPERATION_TIMEOUT 5000 //ms
+
+/*!
+ * @defined SUOTA_LIB_CONFIG_TIMER_WHEEL_TICK
+ *
+ * @abstract Resolution milli seconds of the shared timer wheel.
+ *
+ * @discussion The library timeouts and the speed sampling of all sessions use one timer wheel, driven by a single dispatch source. The tick is the resolution of the wheel: the source is programmed for the next due tick, not woken up at every tick, and timers fire up to one tick late.
+ *
+ */
+#define SUOTA_LIB_CONFIG_TIMER_WHEEL_TICK 10 //ms
+
 /*!
  * @defined SUOTA_LIB_CONFIG_AUTO_REBOOT
  *
@@ -109,6 +229,26 @@
  */
 #define SUOTA_LIB_CONFIG_READ_ALL_DEVICE_INFO false
 
+/*!
+ * @defined SUOTA_LIB_CONFIG_DEVICE_INFO_CACHE
+ *
+ * @abstract Indicates whether the device info and SUOTA info values should be cached per peripheral.
+ *
+ * @discussion If <code>true</code>, the values read from each peripheral are stored in the cache at {@link DEVICE_INFO_CACHE_PATH}, and cached values are used instead of reading the characteristics again on the next connection. The {@link onCharacteristicRead:characteristic:} method is not called for cached values. The revision and SUOTA info values are invalidated when an update succeeds or a reboot command is sent, so they are read again after the device runs the new firmware.
+ *
+ */
+#define SUOTA_LIB_CONFIG_DEVICE_INFO_CACHE true
+
+/*!
+ * @defined SUOTA_LIB_CONFIG_TARGETED_DISCOVERY
+ *
+ * @abstract Indicates whether only the services and characteristics used by the library should be discovered after the connection with the device.
+ *
+ * @discussion If <code>true</code>, only the {@link discoveryServiceUuids} services are discovered, and only the {@link suotaCharacteristicUuids} and {@link deviceInfoUuids} characteristics in them. Other services of the device are not discovered, so they are not available to the app through the {@link SuotaManager} peripheral. If <code>false</code>, all services and characteristics are discovered.
+ *
+ */
+#define SUOTA_LIB_CONFIG_TARGETED_DISCOVERY true
+
 /*!
  * @defined SUOTA_LIB_CONFIG_NOTIFY_DEVICE_INFO_READ
  *
@@ -173,6 +313,16 @@
  */
 #define SUOTA_LIB_CONFIG_NOTIFY_UPLOAD_PROGRESS true
 
+/*!
+ * @defined SUOTA_LIB_CONFIG_NOTIFICATION_RATE
+ *
+ * @abstract Maximum number of chunk, block and progress notifications per second. Set to 0 to deliver every notification.
+ *
+ * @discussion If greater than 0, the {@link onChunkSend:totalChunks:chunk:block:blockChunks:totalBlocks:}, {@link onBlockSent:totalBlocks:} and {@link onUploadProgress:} notifications are collapsed, and only the latest value of each is delivered, at most at this rate. The 100% progress notification is delivered immediately, and pending notifications are always delivered before the success, failure and disconnection notifications.
+ *
+ */
+#define SUOTA_LIB_CONFIG_NOTIFICATION_RATE 10 //Hz
+
 /*!
  * @defined SUOTA_LIB_CONFIG_PROTOCOL_DEBUG
  *
@@ -199,6 +349,46 @@
  */
 #define SUOTA_LIB_DEFAULT_FILE_LIST_HEADER_INFO false
 
+/*!
+ * @defined SUOTA_LIB_DEFAULT_FILE_LIST_CONCURRENCY
+ *
+ * @abstract Maximum number of concurrent workers used by the concurrent firmware file list.
+ *
+ */
+#define SUOTA_LIB_DEFAULT_FILE_LIST_CONCURRENCY 4
+
+/*!
+ * @defined SUOTA_LIB_DEFAULT_FLEET_CONCURRENCY
+ *
+ * @abstract Maximum number of concurrent update sessions of a fleet update.
+ *
+ */
+#define SUOTA_LIB_DEFAULT_FLEET_CONCURRENCY 4
+
+/*!
+ * @defined SUOTA_LIB_DEFAULT_FLEET_MAX_RETRIES
+ *
+ * @abstract Number of times a failed device update is retried by a fleet update.
+ *
+ */
+#define SUOTA_LIB_DEFAULT_FLEET_MAX_RETRIES 2
+
+/*!
+ * @defined SUOTA_LIB_DEFAULT_FLEET_RETRY_DELAY
+ *
+ * @abstract Time in milli seconds before a failed device update is queued again.
+ *
+ */
+#define SUOTA_LIB_DEFAULT_FLEET_RETRY_DELAY 2000 // ms
+
+/*!
+ * @defined SUOTA_LIB_DEFAULT_FLEET_CONNECTION_TIMEOUT
+ *
+ * @abstract Time in milli seconds to wait for a device to connect and become ready, during a fleet update.
+ *
+ */
+#define SUOTA_LIB_DEFAULT_FLEET_CONNECTION_TIMEOUT 15000 // ms
+
 /*!
  * @defined SUOTA_LIB_DEFAULT_BLOCK_SIZE
  *
@@ -304,18 +494,90 @@
  * @discussion Property containing the {@link SUOTA_LIB_CONFIG_CHECK_HEADER_CRC} value.
  */
 @property (class, readonly) BOOL CHECK_HEADER_CRC;
+/*!
+ * @property MEMORY_MAP_FIRMWARE
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_MEMORY_MAP_FIRMWARE} value.
+ */
+@property (class, readonly) BOOL MEMORY_MAP_FIRMWARE;
+/*!
+ * @property FILE_CATALOG
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_FILE_CATALOG} value.
+ */
+@property (class, readonly) BOOL FILE_CATALOG;
 /*!
  * @property CALCULATE_STATISTICS
  *
  * @discussion Property containing the {@link SUOTA_LIB_CONFIG_CALCULATE_STATISTICS} value.
  */
 @property (class, readonly) BOOL CALCULATE_STATISTICS;
+/*!
+ * @property AUTO_CHUNK_SIZE
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_AUTO_CHUNK_SIZE} value.
+ */
+@property (class, readonly) BOOL AUTO_CHUNK_SIZE;
+/*!
+ * @property L2CAP_TRANSPORT
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_L2CAP_TRANSPORT} value.
+ */
+@property (class, readonly) BOOL L2CAP_TRANSPORT;
+/*!
+ * @property BATCH_WRITES
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_BATCH_WRITES} value.
+ */
+@property (class, readonly) BOOL BATCH_WRITES;
+/*!
+ * @property PIPELINE_BLOCKS
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_PIPELINE_BLOCKS} value.
+ */
+@property (class, readonly) BOOL PIPELINE_BLOCKS;
+/*!
+ * @property RESUME_UPLOADS
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_RESUME_UPLOADS} value.
+ */
+@property (class, readonly) BOOL RESUME_UPLOADS;
+/*!
+ * @property PROTOCOL_QUEUE
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_PROTOCOL_QUEUE} value.
+ */
+@property (class, readonly) BOOL PROTOCOL_QUEUE;
+/*!
+ * @property L2CAP_OPEN_TIMEOUT
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_L2CAP_OPEN_TIMEOUT} value.
+ */
+@property (class, readonly) int L2CAP_OPEN_TIMEOUT;
 /*!
  * @property UPLOAD_TIMEOUT
  *
  * @discussion Property containing the {@link SUOTA_LIB_CONFIG_UPLOAD_TIMEOUT} value.
  */
 @property (class, readonly) int UPLOAD_TIMEOUT;
+/*!
+ * @property GATT_WINDOW
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_GATT_WINDOW} value.
+ */
+@property (class, readonly) int GATT_WINDOW;
+/*!
+ * @property GATT_OPERATION_TIMEOUT
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_GATT_OPERATION_TIMEOUT} value.
+ */
+@property (class, readonly) int GATT_OPERATION_TIMEOUT;
+/*!
+ * @property TIMER_WHEEL_TICK
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_TIMER_WHEEL_TICK} value.
+ */
+@property (class, readonly) int TIMER_WHEEL_TICK;
 /*!
  * @property AUTO_REBOOT
  *
@@ -346,6 +608,18 @@
  * @discussion Property containing the {@link SUOTA_LIB_CONFIG_READ_ALL_DEVICE_INFO} value.
  */
 @property (class, readonly) BOOL READ_ALL_DEVICE_INFO;
+/*!
+ * @property DEVICE_INFO_CACHE
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_DEVICE_INFO_CACHE} value.
+ */
+@property (class, readonly) BOOL DEVICE_INFO_CACHE;
+/*!
+ * @property TARGETED_DISCOVERY
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_TARGETED_DISCOVERY} value.
+ */
+@property (class, readonly) BOOL TARGETED_DISCOVERY;
 /*!
  * @property NOTIFY_DEVICE_INFO_READ
  *
@@ -394,6 +668,12 @@
  * @discussion Property containing the {@link SUOTA_LIB_CONFIG_NOTIFY_UPLOAD_PROGRESS} value.
  */
 @property (class, readonly) BOOL NOTIFY_UPLOAD_PROGRESS;
+/*!
+ * @property NOTIFICATION_RATE
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_CONFIG_NOTIFICATION_RATE} value.
+ */
+@property (class, readonly) int NOTIFICATION_RATE;
 /*!
  * @property PROTOCOL_DEBUG
  *
@@ -421,6 +701,27 @@
  */
 @property (class, readonly) NSString* DEFAULT_FIRMWARE_PATH;
 
+/*!
+ * @property FIRMWARE_CATALOG_PATH
+ *
+ * @discussion Property containing the path of the firmware catalog file. The catalog is stored in the app Library/Caches directory, next to the Documents directory.
+ */
+@property (class, readonly) NSString* FIRMWARE_CATALOG_PATH;
+
+/*!
+ * @property UPLOAD_JOURNAL_PATH
+ *
+ * @discussion Property containing the path of the upload journal file, used to resume interrupted uploads. The journal is stored in the app Library/Caches directory.
+ */
+@property (class, readonly) NSString* UPLOAD_JOURNAL_PATH;
+
+/*!
+ * @property DEVICE_INFO_CACHE_PATH
+ *
+ * @discussion Property containing the path of the device info cache file. The cache is stored in the app Library/Caches directory.
+ */
+@property (class, readonly) NSString* DEVICE_INFO_CACHE_PATH;
+
 /*!
  * @property FILE_LIST_HEADER_INFO
  *
@@ -428,6 +729,41 @@
  */
 @property (class, readonly) BOOL FILE_LIST_HEADER_INFO;
 
+/*!
+ * @property FILE_LIST_CONCURRENCY
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_DEFAULT_FILE_LIST_CONCURRENCY} value.
+ */
+@property (class, readonly) int FILE_LIST_CONCURRENCY;
+
+/*!
+ * @property FLEET_CONCURRENCY
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_DEFAULT_FLEET_CONCURRENCY} value.
+ */
+@property (class, readonly) int FLEET_CONCURRENCY;
+
+/*!
+ * @property FLEET_MAX_RETRIES
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_DEFAULT_FLEET_MAX_RETRIES} value.
+ */
+@property (class, readonly) int FLEET_MAX_RETRIES;
+
+/*!
+ * @property FLEET_RETRY_DELAY
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_DEFAULT_FLEET_RETRY_DELAY} value.
+ */
+@property (class, readonly) int FLEET_RETRY_DELAY;
+
+/*!
+ * @property FLEET_CONNECTION_TIMEOUT
+ *
+ * @discussion Property containing the {@link SUOTA_LIB_DEFAULT_FLEET_CONNECTION_TIMEOUT} value.
+ */
+@property (class, readonly) int FLEET_CONNECTION_TIMEOUT;
+
 /*!
  * @property DEFAULT_BLOCK_SIZE
  *
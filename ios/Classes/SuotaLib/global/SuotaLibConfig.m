@@ -13,6 +13,9 @@
 
 static NSArray<CBUUID*>* DEVICE_INFO_TO_READ;
 static NSString* DEFAULT_FIRMWARE_PATH;
+static NSString* FIRMWARE_CATALOG_PATH;
+static NSString* UPLOAD_JOURNAL_PATH;
+static NSString* DEVICE_INFO_CACHE_PATH;
 
 @implementation SuotaLibConfig
 
@@ -28,6 +31,9 @@ static NSString* DEFAULT_FIRMWARE_PATH;
                             ];
     
     DEFAULT_FIRMWARE_PATH = NSSearchPathForDirectoriesInDomains(NSDocumentDirectory, NSUserDomainMask, YES)[0];
+    FIRMWARE_CATALOG_PATH = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES)[0] stringByAppendingPathComponent:@"SuotaFirmwareCatalog.plist"];
+    UPLOAD_JOURNAL_PATH = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES)[0] stringByAppendingPathComponent:@"SuotaUploadJournal.plist"];
+    DEVICE_INFO_CACHE_PATH = [NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES)[0] stringByAppendingPathComponent:@"SuotaDeviceInfoCache.plist"];
 }
 
 + (BOOL) ALLOW_DIALOG_DISPLAY {
@@ -38,14 +44,62 @@ static NSString* DEFAULT_FIRMWARE_PATH;
     return SUOTA_LIB_CONFIG_CHECK_HEADER_CRC;
 }
 
++ (BOOL) MEMORY_MAP_FIRMWARE {
+    return SUOTA_LIB_CONFIG_MEMORY_MAP_FIRMWARE;
+}
+
++ (BOOL) FILE_CATALOG {
+    return SUOTA_LIB_CONFIG_FILE_CATALOG;
+}
+
 + (BOOL) CALCULATE_STATISTICS {
     return SUOTA_LIB_CONFIG_CALCULATE_STATISTICS;
 }
 
++ (BOOL) AUTO_CHUNK_SIZE {
+    return SUOTA_LIB_CONFIG_AUTO_CHUNK_SIZE;
+}
+
++ (BOOL) L2CAP_TRANSPORT {
+    return SUOTA_LIB_CONFIG_L2CAP_TRANSPORT;
+}
+
++ (BOOL) BATCH_WRITES {
+    return SUOTA_LIB_CONFIG_BATCH_WRITES;
+}
+
++ (BOOL) PIPELINE_BLOCKS {
+    return SUOTA_LIB_CONFIG_PIPELINE_BLOCKS;
+}
+
++ (BOOL) RESUME_UPLOADS {
+    return SUOTA_LIB_CONFIG_RESUME_UPLOADS;
+}
+
++ (BOOL) PROTOCOL_QUEUE {
+    return SUOTA_LIB_CONFIG_PROTOCOL_QUEUE;
+}
+
++ (int) L2CAP_OPEN_TIMEOUT {
+    return SUOTA_LIB_CONFIG_L2CAP_OPEN_TIMEOUT;
+}
+
 + (int) UPLOAD_TIMEOUT {
     return SUOTA_LIB_CONFIG_UPLOAD_TIMEOUT;
 }
 
++ (int) GATT_WINDOW {
+    return SUOTA_LIB_CONFIG_GATT_WINDOW;
+}
+
++ (int) GATT_OPERATION_TIMEOUT {
+    return SUOTA_LIB_CONFIG_GATT_OPERATION_TIMEOUT;
+}
+
++ (int) TIMER_WHEEL_TICK {
+    return SUOTA_LIB_CONFIG_TIMER_WHEEL_TICK;
+}
+
 + (BOOL) AUTO_REBOOT {
     return SUOTA_LIB_CONFIG_AUTO_REBOOT;
 }
@@ -66,6 +120,14 @@ static NSString* DEFAULT_FIRMWARE_PATH;
     return SUOTA_LIB_CONFIG_READ_ALL_DEVICE_INFO;
 }
 
++ (BOOL) DEVICE_INFO_CACHE {
+    return SUOTA_LIB_CONFIG_DEVICE_INFO_CACHE;
+}
+
++ (BOOL) TARGETED_DISCOVERY {
+    return SUOTA_LIB_CONFIG_TARGETED_DISCOVERY;
+}
+
 + (BOOL) NOTIFY_DEVICE_INFO_READ {
     return SUOTA_LIB_CONFIG_NOTIFY_DEVICE_INFO_READ;
 }
@@ -98,6 +160,10 @@ static NSString* DEFAULT_FIRMWARE_PATH;
     return SUOTA_LIB_CONFIG_NOTIFY_UPLOAD_PROGRESS;
 }
 
++ (int) NOTIFICATION_RATE {
+    return SUOTA_LIB_CONFIG_NOTIFICATION_RATE;
+}
+
 + (BOOL) PROTOCOL_DEBUG {
     return SUOTA_LIB_CONFIG_PROTOCOL_DEBUG;
 }
@@ -114,10 +180,42 @@ static NSString* DEFAULT_FIRMWARE_PATH;
     return DEFAULT_FIRMWARE_PATH;
 }
 
++ (NSString*) FIRMWARE_CATALOG_PATH {
+    return FIRMWARE_CATALOG_PATH;
+}
+
++ (NSString*) UPLOAD_JOURNAL_PATH {
+    return UPLOAD_JOURNAL_PATH;
+}
+
++ (NSString*) DEVICE_INFO_CACHE_PATH {
+    return DEVICE_INFO_CACHE_PATH;
+}
+
 + (BOOL) FILE_LIST_HEADER_INFO {
     return SUOTA_LIB_DEFAULT_FILE_LIST_HEADER_INFO;
 }
 
++ (int) FILE_LIST_CONCURRENCY {
+    return SUOTA_LIB_DEFAULT_FILE_LIST_CONCURRENCY;
+}
+
++ (int) FLEET_CONCURRENCY {
+    return SUOTA_LIB_DEFAULT_FLEET_CONCURRENCY;
+}
+
++ (int) FLEET_MAX_RETRIES {
+    return SUOTA_LIB_DEFAULT_FLEET_MAX_RETRIES;
+}
+
++ (int) FLEET_RETRY_DELAY {
+    return SUOTA_LIB_DEFAULT_FLEET_RETRY_DELAY;
+}
+
++ (int) FLEET_CONNECTION_TIMEOUT {
+    return SUOTA_LIB_DEFAULT_FLEET_CONNECTION_TIMEOUT;
+}
+
 + (int) DEFAULT_BLOCK_SIZE {
     return SUOTA_LIB_DEFAULT_BLOCK_SIZE;
 }
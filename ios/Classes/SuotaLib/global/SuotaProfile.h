@@ -184,6 +184,7 @@ enum SuotaErrors {
  * @constant UPLOAD_TIMEOUT, File upload timeout.
  * @constant PROTOCOL_ERROR, Unexpected protocol behavior.
  * @constant NOT_CONNECTED, Isn't connected to a BLE device to perform SUOTA.
+ * @constant GATT_OPERATION_TIMEOUT, A GATT operation did not complete in time.
  *
  */
 enum ApplicationErrors {
@@ -196,6 +197,7 @@ enum ApplicationErrors {
     UPLOAD_TIMEOUT = 0xfff9,
     PROTOCOL_ERROR = 0xfff8,
     NOT_CONNECTED = 0xfff7,
+    GATT_OPERATION_TIMEOUT = 0xfff6,
 };
 
 @interface SuotaProfile : NSObject
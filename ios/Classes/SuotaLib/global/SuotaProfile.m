@@ -92,6 +92,7 @@ static NSMutableDictionary<NSNumber*, NSString*>* notificationValueDescriptionLi
     suotaErrorCodeList[@(UPLOAD_TIMEOUT)] = @"File upload timeout.";
     suotaErrorCodeList[@(PROTOCOL_ERROR)] = @"Unexpected behavior while running SUOTA protocol.";
     suotaErrorCodeList[@(NOT_CONNECTED)] = @"Device not connected.";
+    suotaErrorCodeList[@(GATT_OPERATION_TIMEOUT)] = @"GATT operation timeout.";
 
     suotaProtocolStateArray = @[ @(ENABLE_NOTIFICATIONS), @(SET_MEMORY_DEVICE), @(SET_GPIO_MAP), @(SEND_BLOCK), @(END_SIGNAL), @(ERROR) ];
     
@@ -22,11 +22,22 @@ enum OperationType {
     REBOOT_COMMAND
 };
 
+// Scheduling order of queued operations, highest first
+enum GattOperationPriority {
+    PRIORITY_CONTROL,
+    PRIORITY_INFO,
+    PRIORITY_DATA
+};
+
 @property CBCharacteristic* characteristic;
 @property CBDescriptor* descriptor;
 @property enum OperationType const type;
 @property NSData* value;
 @property BOOL notificationStatus;
+// Reads are info operations, writes without response are data and everything else is control
+@property (readonly) enum GattOperationPriority priority;
+// Writes without response complete when they are sent
+@property (readonly) BOOL expectsResponse;
 
 - (instancetype) initWithCharacteristic:(CBCharacteristic*)characteristic;
 - (instancetype) initWithType:(enum OperationType)type characteristic:(CBCharacteristic*)characteristic valueData:(NSData*)value;
@@ -73,6 +73,21 @@ static NSString* const TAG = @"GattOperation";
     return self;
 }
 
+- (enum GattOperationPriority) priority {
+    switch (self.type) {
+        case READ:
+            return PRIORITY_INFO;
+        case WRITE_WITHOUT_RESPONSE:
+            return PRIORITY_DATA;
+        default:
+            return PRIORITY_CONTROL;
+    }
+}
+
+- (BOOL) expectsResponse {
+    return self.type != WRITE_WITHOUT_RESPONSE;
+}
+
 - (void) execute:(CBPeripheral*)peripheral {
     if (self.type == WRITE || self.type == WRITE_WITHOUT_RESPONSE || self.type == REBOOT_COMMAND) {
         [self executeWriteCharacteristic:peripheral];
@@ -16,5 +16,7 @@
 
 + (HeaderInfo*) headerWithRawBuffer:(NSData*)rawBuffer;
 + (HeaderInfo*) headerWithFilePath:(NSString*)filePath;
++ (HeaderInfo*) headerWithHeader:(NSData*)header totalBytes:(uint64_t)totalBytes;
++ (int) maxHeaderSize;
 
 @end
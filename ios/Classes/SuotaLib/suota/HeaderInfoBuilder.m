@@ -34,36 +34,52 @@ static NSString* const TAG = @"HeaderInfoBuilder";
     }
 }
 
++ (int) maxHeaderSize {
+    return MAX(HeaderInfo58x.HEADER_SIZE, MAX(HeaderInfo68x.HEADER_SIZE, HeaderInfo69x.HEADER_SIZE));
+}
+
 + (HeaderInfo*) headerWithFilePath:(NSString*)filePath {
     NSFileHandle* file = [NSFileHandle fileHandleForReadingAtPath:filePath];
     if (!file) {
-        SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Failed to read firmware header: %@", file);
+        SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Failed to read firmware header: %@", filePath);
         return nil;
     }
-    NSData* fileData = [file readDataToEndOfFile];
+    // The size is taken from the opened file, so that symbolic links report the size of the firmware
+    uint64_t totalBytes = [file seekToEndOfFile];
+    if (totalBytes < HeaderInfo.SIGNATURE_LENGTH) {
+        [file closeFile];
+        return nil;
+    }
+    [file seekToFileOffset:0];
+    // Only the signature and the largest supported header are needed
+    NSData* fileData = [file readDataOfLength:HeaderInfo.SIGNATURE_LENGTH + self.maxHeaderSize];
     [file closeFile];
-    NSUInteger totalBytes = fileData.length;
 
-    if (totalBytes < HeaderInfo.SIGNATURE_LENGTH)
-        return nil;
-    uint8_t headerSignature[HeaderInfo.SIGNATURE_LENGTH];
-    [fileData getBytes:&headerSignature length:HeaderInfo.SIGNATURE_LENGTH];
-    int signature = headerSignature[0] << 8 | headerSignature[1];
+    return [self headerWithHeader:fileData totalBytes:totalBytes];
+}
 
-    int headerSize;
++ (int) headerSizeForSignature:(int)signature {
     if (signature == HeaderInfo58x.SIGNATURE) {
-        headerSize = HeaderInfo58x.HEADER_SIZE;
+        return HeaderInfo58x.HEADER_SIZE;
     } else if (signature == HeaderInfo68x.SIGNATURE) {
-        headerSize = HeaderInfo68x.HEADER_SIZE;
+        return HeaderInfo68x.HEADER_SIZE;
     } else if (signature == HeaderInfo69x.SIGNATURE) {
-        headerSize = HeaderInfo69x.HEADER_SIZE;
+        return HeaderInfo69x.HEADER_SIZE;
     } else {
-        return nil;
+        return 0;
     }
+}
 
-    if (totalBytes < headerSize)
++ (HeaderInfo*) headerWithHeader:(NSData*)header totalBytes:(uint64_t)totalBytes {
+    if (header.length < HeaderInfo.SIGNATURE_LENGTH)
+        return nil;
+    const uint8_t* headerBytes = header.bytes;
+    int signature = headerBytes[0] << 8 | headerBytes[1];
+    int headerSize = [self headerSizeForSignature:signature];
+    if (!headerSize || header.length < headerSize)
         return nil;
-    NSData* header = [fileData subdataWithRange:NSMakeRange(0, headerSize)];
+    if (header.length > headerSize)
+        header = [header subdataWithRange:NSMakeRange(0, headerSize)];
 
     if (signature == HeaderInfo58x.SIGNATURE) {
         return [[HeaderInfo58x alloc] initWithHeader:header totalBytes:totalBytes];
@@ -21,6 +21,17 @@
 @property int block;
 @property BOOL isLastChunk;
 @property uint64_t sendStartTime;
+// System uptime when the chunk was written, or 0 if it was not written yet
+@property NSTimeInterval writeTime;
+
+/*!
+ * @method write:
+ *
+ * @param peripheral The peripheral.
+ *
+ * @discussion Writes the chunk without notifying the protocol. Used by the chunk writer, which reports the written chunks on the protocol queue.
+ */
+- (void) write:(CBPeripheral*)peripheral;
 
 - (instancetype) initWithSuotaProtocol:(SuotaProtocol*)suotaProtocol characteristic:(CBCharacteristic*)characteristic valueData:(NSData*)valueData chunkCount:(int)chunkCount chunk:(int)chunk block:(int)block isLastChunk:(BOOL)isLastChunk;
 
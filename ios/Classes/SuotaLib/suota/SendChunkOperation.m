@@ -28,8 +28,14 @@
 
 - (void) execute:(CBPeripheral*)peripheral {
     [self.suotaProtocol notifyForSendingChunk:self];
-    if (SuotaLibConfig.CALCULATE_STATISTICS)
+    [self write:peripheral];
+}
+
+- (void) write:(CBPeripheral*)peripheral {
+    if (SuotaLibConfig.CALCULATE_STATISTICS) {
         self.sendStartTime = [[NSDate date] timeIntervalSince1970] * 1000;
+        self.writeTime = NSProcessInfo.processInfo.systemUptime;
+    }
     [self executeWriteCharacteristic:peripheral];
 }
 
@@ -0,0 +1,111 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+/*!
+ @header SuotaDeviceInfoCache.h
+ @brief Header file for the SuotaDeviceInfoCache class.
+
+ This header file contains method and property declaration for the SuotaDeviceInfoCache class.
+
+ @copyright 2019 Dialog Semiconductor
+ */
+
+#import <Foundation/Foundation.h>
+#import <CoreBluetooth/CoreBluetooth.h>
+
+/*!
+ * @class SuotaDeviceInfoCache
+ *
+ * @discussion Persistent record of the device information and SUOTA information values of each peripheral, keyed by the peripheral identifier. Cached values are used instead of reading the characteristics again on the next connection.
+ *
+ * The revision values, which change when the device firmware is updated, are kept separately from the static values and can be invalidated on their own. The SUOTA information values belong to the running firmware, so they are invalidated together with the revision values.
+ *
+ * The cache is thread safe. Updates are written to disk asynchronously.
+ *
+ */
+@interface SuotaDeviceInfoCache : NSObject
+
+/*!
+ * @property defaultCache
+ *
+ * @discussion The cache stored at {@link DEVICE_INFO_CACHE_PATH}.
+ */
+@property (class, readonly) SuotaDeviceInfoCache* defaultCache;
+
+/*!
+ * @property revisionUuids
+ *
+ * @discussion The characteristics that are invalidated by {@link invalidateRevisionForPeripheral:}: the hardware, firmware and software revision and the SUOTA information characteristics.
+ */
+@property (class, readonly) NSArray<CBUUID*>* revisionUuids;
+
+/*!
+ * @property cachePath
+ *
+ * @discussion The cache file path.
+ */
+@property (readonly) NSString* cachePath;
+
+/*!
+ * @method initWithCachePath:
+ *
+ * @param cachePath The cache file path.
+ *
+ * @discussion Creates a new {@link SuotaDeviceInfoCache} instance and loads the stored values.
+ *
+ */
+- (instancetype) initWithCachePath:(NSString*)cachePath;
+
+/*!
+ * @method valuesForPeripheral:
+ *
+ * @param peripheral The peripheral identifier.
+ *
+ * @return The cached characteristic values of the peripheral. The dictionary is empty if nothing is cached.
+ */
+- (NSDictionary<CBUUID*, NSData*>*) valuesForPeripheral:(NSUUID*)peripheral;
+
+/*!
+ * @method storeValue:characteristic:peripheral:
+ *
+ * @param value The characteristic value.
+ * @param uuid The characteristic UUID.
+ * @param peripheral The peripheral identifier.
+ *
+ * @discussion Stores a value read from the peripheral, replacing any previous value of the same characteristic.
+ */
+- (void) storeValue:(NSData*)value characteristic:(CBUUID*)uuid peripheral:(NSUUID*)peripheral;
+
+/*!
+ * @method invalidateRevisionForPeripheral:
+ *
+ * @param peripheral The peripheral identifier.
+ *
+ * @discussion Removes the cached values of the {@link revisionUuids} characteristics, so that they are read again on the next connection. It is called when the device firmware may have changed.
+ */
+- (void) invalidateRevisionForPeripheral:(NSUUID*)peripheral;
+
+/*!
+ * @method removePeripheral:
+ *
+ * @param peripheral The peripheral identifier.
+ *
+ * @discussion Removes all cached values of the peripheral.
+ */
+- (void) removePeripheral:(NSUUID*)peripheral;
+
+/*!
+ * @method save
+ *
+ * @discussion Writes the cache to disk, if it was modified.
+ */
+- (void) save;
+
+@end
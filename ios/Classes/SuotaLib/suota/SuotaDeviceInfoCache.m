@@ -0,0 +1,163 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+#import "SuotaDeviceInfoCache.h"
+#import "SuotaLibConfig.h"
+#import "SuotaLibLog.h"
+#import "SuotaProfile.h"
+#import "SuotaPropertyListWriter.h"
+
+static NSString* const TAG = @"SuotaDeviceInfoCache";
+
+static int const CACHE_VERSION = 1;
+static NSString* const KEY_VERSION = @"version";
+static NSString* const KEY_PERIPHERALS = @"peripherals";
+
+static NSArray<CBUUID*>* revisionUuids;
+
+@interface SuotaDeviceInfoCache ()
+
+@property NSString* cachePath;
+// Peripheral UUID string to characteristic UUID string to value
+@property NSMutableDictionary<NSString*, NSMutableDictionary<NSString*, NSData*>*>* peripherals;
+@property SuotaPropertyListWriter* writer;
+
+@end
+
+@implementation SuotaDeviceInfoCache
+
++ (void) initialize {
+    if (self != SuotaDeviceInfoCache.class)
+        return;
+
+    revisionUuids = @[
+            SuotaProfile.CHARACTERISTIC_HARDWARE_REVISION_STRING,
+            SuotaProfile.CHARACTERISTIC_FIRMWARE_REVISION_STRING,
+            SuotaProfile.CHARACTERISTIC_SOFTWARE_REVISION_STRING,
+            SuotaProfile.SUOTA_VERSION_UUID,
+            SuotaProfile.SUOTA_PATCH_DATA_CHAR_SIZE_UUID,
+            SuotaProfile.SUOTA_MTU_UUID,
+            SuotaProfile.SUOTA_L2CAP_PSM_UUID
+    ];
+}
+
++ (SuotaDeviceInfoCache*) defaultCache {
+    static SuotaDeviceInfoCache* defaultCache;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        defaultCache = [[SuotaDeviceInfoCache alloc] initWithCachePath:SuotaLibConfig.DEVICE_INFO_CACHE_PATH];
+    });
+    return defaultCache;
+}
+
++ (NSArray<CBUUID*>*) revisionUuids {
+    return revisionUuids;
+}
+
+- (instancetype) initWithCachePath:(NSString*)cachePath {
+    self = [super init];
+    if (!self)
+        return nil;
+    self.cachePath = cachePath;
+    self.peripherals = [NSMutableDictionary dictionary];
+    __weak SuotaDeviceInfoCache* weakSelf = self;
+    self.writer = [[SuotaPropertyListWriter alloc] initWithPath:cachePath name:@"SuotaDeviceInfoCache" snapshot:^NSDictionary* {
+        return [weakSelf propertyList];
+    }];
+    [self load];
+    return self;
+}
+
+- (void) load {
+    NSData* data = [NSData dataWithContentsOfFile:self.cachePath];
+    if (!data)
+        return;
+    NSError* error;
+    NSDictionary* cache = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:nil error:&error];
+    if (![cache isKindOfClass:NSDictionary.class] || [cache[KEY_VERSION] intValue] != CACHE_VERSION) {
+        SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Ignoring invalid cache: %@ %@", self.cachePath, error ? error.localizedDescription : @"");
+        return;
+    }
+    NSDictionary* peripherals = cache[KEY_PERIPHERALS];
+    if (![peripherals isKindOfClass:NSDictionary.class])
+        return;
+    for (NSString* key in peripherals) {
+        NSDictionary* values = peripherals[key];
+        if (![values isKindOfClass:NSDictionary.class])
+            continue;
+        NSMutableDictionary<NSString*, NSData*>* entry = [NSMutableDictionary dictionary];
+        for (NSString* uuid in values) {
+            if ([uuid isKindOfClass:NSString.class] && [values[uuid] isKindOfClass:NSData.class])
+                entry[uuid] = values[uuid];
+        }
+        self.peripherals[key] = entry;
+    }
+}
+
+- (NSDictionary<CBUUID*, NSData*>*) valuesForPeripheral:(NSUUID*)peripheral {
+    @synchronized (self) {
+        NSDictionary<NSString*, NSData*>* entry = self.peripherals[peripheral.UUIDString];
+        NSMutableDictionary<CBUUID*, NSData*>* values = [NSMutableDictionary dictionaryWithCapacity:entry.count];
+        for (NSString* uuid in entry)
+            values[[CBUUID UUIDWithString:uuid]] = entry[uuid];
+        return values;
+    }
+}
+
+- (void) storeValue:(NSData*)value characteristic:(CBUUID*)uuid peripheral:(NSUUID*)peripheral {
+    if (!value)
+        return;
+    @synchronized (self) {
+        NSMutableDictionary<NSString*, NSData*>* entry = self.peripherals[peripheral.UUIDString];
+        if (!entry)
+            entry = self.peripherals[peripheral.UUIDString] = [NSMutableDictionary dictionary];
+        if ([entry[uuid.UUIDString] isEqualToData:value])
+            return;
+        entry[uuid.UUIDString] = [value copy];
+        [self.writer saveLater];
+    }
+}
+
+- (void) invalidateRevisionForPeripheral:(NSUUID*)peripheral {
+    @synchronized (self) {
+        NSMutableDictionary<NSString*, NSData*>* entry = self.peripherals[peripheral.UUIDString];
+        NSUInteger count = entry.count;
+        for (CBUUID* uuid in revisionUuids)
+            [entry removeObjectForKey:uuid.UUIDString];
+        if (entry.count == count)
+            return;
+        SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Invalidated revision of %@", peripheral.UUIDString);
+        [self.writer saveLater];
+    }
+}
+
+- (void) removePeripheral:(NSUUID*)peripheral {
+    @synchronized (self) {
+        if (!self.peripherals[peripheral.UUIDString])
+            return;
+        [self.peripherals removeObjectForKey:peripheral.UUIDString];
+        [self.writer saveLater];
+    }
+}
+
+- (void) save {
+    [self.writer save];
+}
+
+- (NSDictionary*) propertyList {
+    @synchronized (self) {
+        NSMutableDictionary* peripherals = [NSMutableDictionary dictionaryWithCapacity:self.peripherals.count];
+        for (NSString* key in self.peripherals)
+            peripherals[key] = [self.peripherals[key] copy];
+        return @{ KEY_VERSION : @(CACHE_VERSION), KEY_PERIPHERALS : peripherals };
+    }
+}
+
+@end
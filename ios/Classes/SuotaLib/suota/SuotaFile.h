@@ -20,14 +20,24 @@
 #import <Foundation/Foundation.h>
 
 @class HeaderInfo;
+@class SuotaFile;
+
+/*!
+ * @typedef SuotaFileListHandler
+ *
+ * @discussion Block that receives a sorted list of {@link SuotaFile} objects.
+ */
+typedef void (^SuotaFileListHandler)(NSArray<SuotaFile*>* files);
 
 /*!
  * @class SuotaFile
  *
  * @discussion Representation of a firmware file.
  *
+ * A copy shares the loaded firmware buffer and checksums with the original, but has its own block and chunk settings. Use a copy for each device when the same firmware is uploaded to several devices concurrently.
+ *
  */
-@interface SuotaFile : NSObject
+@interface SuotaFile : NSObject <NSCopying>
 
 /*!
  * @property file
@@ -101,10 +111,29 @@
 @property int chunksPerBlock;
 
 @property int lastBlockSize;
-@property NSMutableData* data;
-@property NSMutableArray<NSMutableArray<NSData*>*>* blocks;
+
+/*!
+ * @property data
+ *
+ * @discussion The firmware image. The buffer is never modified. The CRC byte is sent after the image as a virtual final byte.
+ */
+@property NSData* data;
 @property uint8_t crc;
 
+/*!
+ * @property payloadCrcCalculated
+ *
+ * @discussion Indicates if the header payload CRC has been calculated during the firmware load.
+ */
+@property BOOL payloadCrcCalculated;
+
+/*!
+ * @property calculatedPayloadCrc
+ *
+ * @discussion The header payload CRC32 value, calculated over the firmware payload.
+ */
+@property uint64_t calculatedPayloadCrc;
+
 /*!
  * @method initWithAbsoluteFilePath:
  *
@@ -171,6 +200,21 @@
  */
 + (NSArray<SuotaFile*>*) listFilesInPathList:(NSArray<NSString*>*)pathList extension:(NSString*)extension searchSubFolders:(BOOL)searchSubFolders withHeaderInfo:(BOOL)withHeaderInfo;
 
+/*!
+ * @method listFilesInPathList:extension:searchSubFolders:withHeaderInfo:progress:completion:
+ *
+ * @param pathList Search path list.
+ * @param extension File extension. If nil, all files are included in the returned list.
+ * @param searchSubFolders Indicates if the method shall search for files in each path sub-folder. If <code>false</code>, the path sub-folders are ignored.
+ * @param withHeaderInfo Indicates if the method shall initialize the header info of each {@link SuotaFile} object. If <code>false</code>, {@link SuotaFile} header info initialization is ignored.
+ * @param progress Called with the files found so far, sorted by filename. Reports are coalesced while the main queue is busy. May be nil.
+ * @param completion Called with the complete list of files, sorted by filename.
+ *
+ * @discussion Concurrent version of {@link listFilesInPathList:extension:searchSubFolders:withHeaderInfo:}. Directory traversal and header parsing are distributed to a pool of {@link FILE_LIST_CONCURRENCY} workers. The method returns immediately. Both blocks are called on the main queue.
+ *
+ */
++ (void) listFilesInPathList:(NSArray<NSString*>*)pathList extension:(NSString*)extension searchSubFolders:(BOOL)searchSubFolders withHeaderInfo:(BOOL)withHeaderInfo progress:(SuotaFileListHandler)progress completion:(SuotaFileListHandler)completion;
+
 /*!
  * @method listFilesInPathList:
  *
@@ -277,15 +321,38 @@
 - (NSString*) fileName;
 
 - (BOOL) hasHeaderInfo;
+
+/*!
+ * @method uploadSize
+ *
+ * @discussion Returns the number of bytes sent to the device, which is the firmware size plus the trailing CRC byte.
+ *
+ * @return The upload size.
+ */
 - (int) uploadSize;
 - (BOOL) isLastBlockShorter;
+/*!
+ * @method getBlock:
+ *
+ * @param index The block index.
+ *
+ * @discussion Returns the chunks of the specified block. Each chunk is a {@link SuotaDataSlice} that references the loaded firmware buffer, so no firmware bytes are copied.
+ *
+ * @return List of chunk data objects.
+ */
 - (NSArray<NSData*>*) getBlock:(int)index;
 - (NSData*) getChunk:(int)index;
+- (NSData*) getChunk:(int)block chunk:(int)chunk;
 - (int) getBlockSize:(int)blockCount;
 - (int) getBlockChunks:(int)index;
 - (BOOL) isLastBlock:(int)index;
 - (BOOL) isLastChunk:(int)index;
 - (BOOL) isLastChunk:(int)block chunk:(int)chunk;
+/*!
+ * @method load
+ *
+ * @discussion Loads the firmware file. If {@link MEMORY_MAP_FIRMWARE} is <code>true</code>, the file is memory-mapped. The firmware CRC and, if {@link CHECK_HEADER_CRC} is <code>true</code>, the header payload CRC are calculated in a single pass over the image. In that case, if the file has no header info, the header is parsed from the loaded image first.
+ */
 - (void) load;
 - (BOOL) isLoaded;
 /*!
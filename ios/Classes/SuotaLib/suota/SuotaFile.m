@@ -9,15 +9,36 @@
  */
 
 #import "SuotaFile.h"
-#import <zlib.h>
 #import "HeaderInfo.h"
 #import "HeaderInfoBuilder.h"
+#import "SuotaChecksum.h"
+#import "SuotaFileCatalog.h"
 #import "SuotaLibConfig.h"
 #import "SuotaLibLog.h"
+#import "SuotaUtils.h"
+
+@interface SuotaFileListContext : NSObject
+
+@property NSString* extension;
+@property BOOL searchSubFolders;
+@property BOOL withHeaderInfo;
+@property SuotaFileCatalog* catalog;
+@property (copy) SuotaFileListHandler progress;
+@property NSOperationQueue* workers;
+@property dispatch_group_t group;
+@property NSMutableArray<SuotaFile*>* files;
+@property BOOL progressPending;
+
+@end
+
+@implementation SuotaFileListContext
+@end
+
 
 @implementation SuotaFile
 
 static NSString* const TAG = @"SuotaFile";
+static NSUInteger const CHECKSUM_WINDOW = 64 * 1024;
 
 - (instancetype) init {
     self = [super init];
@@ -73,52 +94,193 @@ static NSString* const TAG = @"SuotaFile";
     self = [self init];
     if (!self)
         return nil;
-    self.firmwareSize = (int) firmware.length;
-    self.data = [NSMutableData data];
-    [self.data appendData:firmware];
-    self.crc = [self calculateCrc];
-    const uint8_t crc = self.crc;
-    [self.data appendBytes:&crc length:1];
+    [self loadFirmware:[firmware copy]];
     return self;
 }
 
+- (id) copyWithZone:(NSZone*)zone {
+    SuotaFile* copy = [[SuotaFile allocWithZone:zone] init];
+    copy.file = self.file;
+    copy.url = self.url;
+    copy.filename = self.filename;
+    copy.headerInfo = self.headerInfo;
+    copy.firmwareSize = self.firmwareSize;
+    copy.data = self.data;
+    copy.crc = self.crc;
+    copy.payloadCrcCalculated = self.payloadCrcCalculated;
+    copy.calculatedPayloadCrc = self.calculatedPayloadCrc;
+    copy.blockSize = self.blockSize;
+    copy.chunkSize = self.chunkSize;
+    if (copy.data)
+        [copy initBlocks];
+    return copy;
+}
+
 + (NSArray<SuotaFile*>*) listFilesInPathList:(NSArray<NSString*>*)pathList extension:(NSString*)extension searchSubFolders:(BOOL)searchSubFolders withHeaderInfo:(BOOL)withHeaderInfo {
     SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"List files%@: %@ %@", (extension && extension.length != 0  ? [NSString stringWithFormat:@" (*%@)", extension] : @""), pathList, searchSubFolders ? @" (recursive)" : @"");
-    NSFileManager* fileManager = [NSFileManager defaultManager];
+    SuotaFileCatalog* catalog = withHeaderInfo && SuotaLibConfig.FILE_CATALOG ? SuotaFileCatalog.defaultCatalog : nil;
     NSMutableArray<SuotaFile*>* files = [NSMutableArray array];
-    BOOL isDirectory;
+    NSMutableArray<NSString*>* directories = [NSMutableArray array];
     for (NSString* path in pathList) {
-        if (![fileManager fileExistsAtPath:path isDirectory:&isDirectory] || !isDirectory) {
-            SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Can't find directory: %@", path);
-            continue;
+        if ([self isDirectory:path])
+            [directories addObject:path];
+    }
+    while (directories.count > 0) {
+        NSString* directory = directories.lastObject;
+        [directories removeLastObject];
+        NSMutableArray<NSURL*>* fileURLs = [NSMutableArray array];
+        [self listDirectory:directory extension:extension subFolders:searchSubFolders ? directories : nil files:fileURLs];
+        for (NSURL* url in fileURLs)
+            [files addObject:[self suotaFileWithURL:url withHeaderInfo:withHeaderInfo catalog:catalog]];
+    }
+    [catalog save];
+    SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Found %lu files", (unsigned long)files.count);
+    return [self sortedFiles:files];
+}
+
++ (void) listFilesInPathList:(NSArray<NSString*>*)pathList extension:(NSString*)extension searchSubFolders:(BOOL)searchSubFolders withHeaderInfo:(BOOL)withHeaderInfo progress:(SuotaFileListHandler)progress completion:(SuotaFileListHandler)completion {
+    SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"List files concurrently%@: %@ %@", (extension && extension.length != 0  ? [NSString stringWithFormat:@" (*%@)", extension] : @""), pathList, searchSubFolders ? @" (recursive)" : @"");
+    SuotaFileListContext* context = [[SuotaFileListContext alloc] init];
+    context.extension = extension;
+    context.searchSubFolders = searchSubFolders;
+    context.withHeaderInfo = withHeaderInfo;
+    context.catalog = withHeaderInfo && SuotaLibConfig.FILE_CATALOG ? SuotaFileCatalog.defaultCatalog : nil;
+    context.progress = progress;
+    context.workers = [[NSOperationQueue alloc] init];
+    context.workers.name = @"SuotaFile.list";
+    context.workers.maxConcurrentOperationCount = SuotaLibConfig.FILE_LIST_CONCURRENCY;
+    context.workers.qualityOfService = NSQualityOfServiceUserInitiated;
+    context.group = dispatch_group_create();
+    context.files = [NSMutableArray array];
+
+    for (NSString* path in pathList) {
+        [self enqueueDirectory:path context:context];
+    }
+    dispatch_group_notify(context.group, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+        [context.catalog save];
+        NSArray<SuotaFile*>* files;
+        @synchronized (context) {
+            files = [self sortedFiles:context.files];
+        }
+        SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Found %lu files", (unsigned long)files.count);
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (completion)
+                completion(files);
+        });
+    });
+}
+
++ (void) enqueueDirectory:(NSString*)path context:(SuotaFileListContext*)context {
+    dispatch_group_enter(context.group);
+    [context.workers addOperationWithBlock:^{
+        if ([self isDirectory:path]) {
+            NSMutableArray<NSString*>* subFolders = context.searchSubFolders ? [NSMutableArray array] : nil;
+            NSMutableArray<NSURL*>* fileURLs = [NSMutableArray array];
+            [self listDirectory:path extension:context.extension subFolders:subFolders files:fileURLs];
+            for (NSString* subFolder in subFolders)
+                [self enqueueDirectory:subFolder context:context];
+            // Header parsing may read the whole file, so each file is a separate work item
+            if (context.withHeaderInfo) {
+                for (NSURL* url in fileURLs)
+                    [self enqueueFile:url context:context];
+            } else if (fileURLs.count > 0) {
+                NSMutableArray<SuotaFile*>* files = [NSMutableArray arrayWithCapacity:fileURLs.count];
+                for (NSURL* url in fileURLs)
+                    [files addObject:[self suotaFileWithURL:url withHeaderInfo:false catalog:nil]];
+                [self addFiles:files context:context];
+            }
         }
+        dispatch_group_leave(context.group);
+    }];
+}
 
-        NSError *error;
-        NSArray<NSString*>* currentDirFiles = [fileManager contentsOfDirectoryAtPath:path error:&error];
-        if (!currentDirFiles) {
-            SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Error reading contents of directory: %@ %@", path, error.localizedDescription);
-            continue;
++ (void) enqueueFile:(NSURL*)url context:(SuotaFileListContext*)context {
+    dispatch_group_enter(context.group);
+    [context.workers addOperationWithBlock:^{
+        [self addFiles:@[[self suotaFileWithURL:url withHeaderInfo:true catalog:context.catalog]] context:context];
+        dispatch_group_leave(context.group);
+    }];
+}
+
+// Partial results are coalesced, so that at most one progress report is pending on the main queue
++ (void) addFiles:(NSArray<SuotaFile*>*)files context:(SuotaFileListContext*)context {
+    @synchronized (context) {
+        [context.files addObjectsFromArray:files];
+        if (!context.progress || context.progressPending)
+            return;
+        context.progressPending = true;
+    }
+    dispatch_async(dispatch_get_main_queue(), ^{
+        NSArray<SuotaFile*>* files;
+        @synchronized (context) {
+            context.progressPending = false;
+            files = [self sortedFiles:context.files];
         }
-        if (currentDirFiles.count == 0)
-            continue;
+        context.progress(files);
+    });
+}
+
++ (BOOL) isDirectory:(NSString*)path {
+    BOOL isDirectory;
+    if (![NSFileManager.defaultManager fileExistsAtPath:path isDirectory:&isDirectory] || !isDirectory) {
+        SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Can't find directory: %@", path);
+        return false;
+    }
+    return true;
+}
 
-        for (NSString* currentFile in currentDirFiles) {
-            NSString* fullFilePath = [NSString pathWithComponents:@[path, currentFile]];
-            if (![fileManager fileExistsAtPath:fullFilePath isDirectory:&isDirectory]) {
-                SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Unexpected error. Can' find file: %@", fullFilePath);
+// Lists the directory contents with a single call, prefetching the attributes needed by the file list
++ (void) listDirectory:(NSString*)path extension:(NSString*)extension subFolders:(NSMutableArray<NSString*>*)subFolders files:(NSMutableArray<NSURL*>*)files {
+    NSArray<NSURLResourceKey>* keys = @[NSURLIsDirectoryKey, NSURLIsSymbolicLinkKey, NSURLFileSizeKey, NSURLContentModificationDateKey];
+    NSError *error;
+    NSArray<NSURL*>* currentDirFiles = [NSFileManager.defaultManager contentsOfDirectoryAtURL:[NSURL fileURLWithPath:path isDirectory:true] includingPropertiesForKeys:keys options:0 error:&error];
+    if (!currentDirFiles) {
+        SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Error reading contents of directory: %@ %@", path, error.localizedDescription);
+        return;
+    }
+
+    for (NSURL* url in currentDirFiles) {
+        NSDictionary<NSURLResourceKey, id>* values = [url resourceValuesForKeys:keys error:&error];
+        if (!values) {
+            SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Unexpected error. Can' find file: %@", url.path);
+            continue;
+        }
+        BOOL isDirectory = [values[NSURLIsDirectoryKey] boolValue];
+        if ([values[NSURLIsSymbolicLinkKey] boolValue]) {
+            // Follow symbolic links, like fileExistsAtPath:isDirectory: does
+            if (![NSFileManager.defaultManager fileExistsAtPath:url.path isDirectory:&isDirectory]) {
+                SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Unexpected error. Can' find file: %@", url.path);
                 continue;
             }
-            if (isDirectory && searchSubFolders) {
-                [files addObjectsFromArray:[self listFilesInPath:fullFilePath extension:extension searchSubFolders:true withHeaderInfo:withHeaderInfo]];
-            } else if (!isDirectory && ((!extension || extension.length == 0) || [currentFile hasSuffix:[extension lowercaseString]])) {
-                SuotaFile* suotaFile = [[SuotaFile alloc] initWithAbsoluteFilePath:fullFilePath];
-                if (withHeaderInfo)
-                    suotaFile.headerInfo = [HeaderInfoBuilder headerWithFilePath:fullFilePath];
-                [files addObject:suotaFile];
-            }
+        }
+        if (isDirectory && subFolders) {
+            [subFolders addObject:url.path];
+        } else if (!isDirectory && ((!extension || extension.length == 0) || [url.lastPathComponent hasSuffix:[extension lowercaseString]])) {
+            [files addObject:url];
         }
     }
-    SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Found %lu files", (unsigned long)files.count);
+}
+
++ (SuotaFile*) suotaFileWithURL:(NSURL*)url withHeaderInfo:(BOOL)withHeaderInfo catalog:(SuotaFileCatalog*)catalog {
+    SuotaFile* suotaFile = [[SuotaFile alloc] init];
+    suotaFile.file = url.path;
+    suotaFile.filename = url.lastPathComponent;
+    if (catalog) {
+        NSDictionary<NSURLResourceKey, id>* values = [url resourceValuesForKeys:@[NSURLIsSymbolicLinkKey, NSURLFileSizeKey, NSURLContentModificationDateKey] error:nil];
+        NSNumber* size = values[NSURLFileSizeKey];
+        NSDate* modificationDate = values[NSURLContentModificationDateKey];
+        SuotaFileCatalogEntry* entry = size && modificationDate && ![values[NSURLIsSymbolicLinkKey] boolValue]
+                ? [catalog entryForFile:suotaFile.file size:size.unsignedLongLongValue modificationDate:modificationDate]
+                : [catalog entryForFile:suotaFile.file];
+        suotaFile.headerInfo = entry.headerInfo;
+        suotaFile.crc = entry.crc;
+    } else if (withHeaderInfo) {
+        suotaFile.headerInfo = [HeaderInfoBuilder headerWithFilePath:suotaFile.file];
+    }
+    return suotaFile;
+}
+
++ (NSArray<SuotaFile*>*) sortedFiles:(NSArray<SuotaFile*>*)files {
     return [files sortedArrayUsingDescriptors:@[[NSSortDescriptor sortDescriptorWithKey:@"filename" ascending:true selector:@selector(localizedCaseInsensitiveCompare:)]]];
 }
 
@@ -163,7 +325,7 @@ static NSString* const TAG = @"SuotaFile";
 }
 
 - (int) uploadSize {
-    return (int)self.data.length;
+    return self.data ? self.firmwareSize + 1 : 0;
 }
 
 - (BOOL) isLastBlockShorter {
@@ -171,13 +333,33 @@ static NSString* const TAG = @"SuotaFile";
 }
 
 - (NSArray<NSData*>*) getBlock:(int)index {
-    return self.blocks[index];
+    int chunksInBlock = [self getBlockChunks:index];
+    NSMutableArray<NSData*>* block = [NSMutableArray arrayWithCapacity:chunksInBlock];
+    for (int chunk = 0; chunk < chunksInBlock; chunk++)
+        [block addObject:[self getChunk:index chunk:chunk]];
+    return block;
 }
 
 - (NSData*) getChunk:(int)index {
     int block = index / self.chunksPerBlock;
     int chunk = index % self.chunksPerBlock;
-    return self.blocks[block][chunk];
+    return [self getChunk:block chunk:chunk];
+}
+
+- (NSData*) getChunk:(int)block chunk:(int)chunk {
+    int blockSize = [self getBlockSize:block];
+    int chunkOffset = chunk * self.chunkSize;
+    int chunkSize = MIN(self.chunkSize, blockSize - chunkOffset);
+    NSRange range = NSMakeRange(block * self.blockSize + chunkOffset, chunkSize);
+    if (NSMaxRange(range) <= self.data.length)
+        return [SuotaDataSlice sliceWithData:self.data range:range];
+
+    // Last chunk, which contains the virtual CRC byte
+    NSMutableData* lastChunk = [NSMutableData dataWithCapacity:chunkSize];
+    [lastChunk appendBytes:(const uint8_t*)self.data.bytes + range.location length:chunkSize - 1];
+    const uint8_t crc = self.crc;
+    [lastChunk appendBytes:&crc length:1];
+    return lastChunk;
 }
 
 - (int) getBlockSize:(int)index {
@@ -185,7 +367,8 @@ static NSString* const TAG = @"SuotaFile";
 }
 
 - (int) getBlockChunks:(int)index {
-    return (int)self.blocks[index].count;
+    int blockSize = [self getBlockSize:index];
+    return blockSize / self.chunkSize + (blockSize % self.chunkSize != 0 ? 1 : 0);
 }
 
 - (BOOL) isLastBlock:(int)index {
@@ -193,51 +376,82 @@ static NSString* const TAG = @"SuotaFile";
 }
 
 - (BOOL) isLastChunk:(int)index {
-    return index % self.chunksPerBlock == self.blocks[index / self.chunksPerBlock].count - 1;
+    return [self isLastChunk:index / self.chunksPerBlock chunk:index % self.chunksPerBlock];
 }
 
 - (BOOL) isLastChunk:(int)block chunk:(int)chunk {
-    return chunk == self.blocks[block].count - 1;
+    return chunk == [self getBlockChunks:block] - 1;
 }
 
 - (void) load {
-    NSFileHandle* file = self.file ? [NSFileHandle fileHandleForReadingAtPath:self.file] : [NSFileHandle fileHandleForReadingFromURL:self.url error:nil];
-    if (!file) {
-        SuotaLog(TAG, @"Failed to load firmware: %@", self.file);
+    // Firmware buffers have no source to reload from
+    if (!self.file && !self.url)
+        return;
+    NSError* error;
+    NSDataReadingOptions options = SuotaLibConfig.MEMORY_MAP_FIRMWARE ? NSDataReadingMappedIfSafe : 0;
+    NSData* firmware = self.file ? [NSData dataWithContentsOfFile:self.file options:options error:&error] : [NSData dataWithContentsOfURL:self.url options:options error:&error];
+    if (!firmware) {
+        SuotaLog(TAG, @"Failed to load firmware: %@ %@", self.file ? self.file : self.url, error.localizedDescription);
         self.data = nil;
         return;
     }
-    self.data = [NSMutableData dataWithData:[file readDataToEndOfFile]];
-    [file closeFile];
-    self.firmwareSize = (int)self.data.length;
-    self.crc = [self calculateCrc];
-    const uint8_t crc = self.crc;
-    [self.data appendBytes:&crc length:1];
+    [self loadFirmware:firmware];
+}
+
+- (void) loadFirmware:(NSData*)firmware {
+    self.data = firmware;
+    self.firmwareSize = (int)firmware.length;
+    // The header is parsed first, so that the payload CRC is always calculated in the same pass as the firmware CRC
+    if (SuotaLibConfig.CHECK_HEADER_CRC && !self.hasHeaderInfo) {
+        NSUInteger headerLength = MIN(firmware.length, (NSUInteger)(HeaderInfo.SIGNATURE_LENGTH + HeaderInfoBuilder.maxHeaderSize));
+        self.headerInfo = [HeaderInfoBuilder headerWithHeader:[firmware subdataWithRange:NSMakeRange(0, headerLength)] totalBytes:firmware.length];
+    }
+    [self calculateChecksums:SuotaLibConfig.CHECK_HEADER_CRC];
 }
 
 - (BOOL) isLoaded {
     return self.data != nil;
 }
 
-- (uint8_t) calculateCrc {
+// Compared without adding the header values, so that a crafted payload size can't overflow the check
+- (BOOL) isPayloadInRange {
+    uint64_t firmwareSize = (uint64_t)MAX(self.firmwareSize, 0);
+    uint64_t payloadOffset = self.headerInfo.payloadOffset;
+    return payloadOffset <= firmwareSize && self.headerInfo.payloadSize <= firmwareSize - payloadOffset;
+}
+
+// Calculates the firmware XOR CRC and the header payload CRC32 in a single pass over the image
+- (void) calculateChecksums:(BOOL)withPayloadCrc {
+    withPayloadCrc = withPayloadCrc && self.hasHeaderInfo && self.isPayloadInRange;
+    NSUInteger payloadStart = withPayloadCrc ? (NSUInteger)self.headerInfo.payloadOffset : 0;
+    NSUInteger payloadEnd = withPayloadCrc ? payloadStart + (NSUInteger)self.headerInfo.payloadSize : 0;
+    NSUInteger size = self.firmwareSize;
+
     uint8_t crc_code = 0;
+    uint32_t payloadCrc = 0;
     const uint8_t* bytes = self.data.bytes;
-    for (int i = 0; i < self.firmwareSize; i++) {
-        crc_code ^= bytes[i];
+    for (NSUInteger offset = 0; offset < size; offset += CHECKSUM_WINDOW) {
+        NSUInteger end = MIN(offset + CHECKSUM_WINDOW, size);
+        crc_code ^= [SuotaChecksum xorChecksum:bytes + offset length:end - offset];
+        // The window is still in cache, update the payload CRC with the part that overlaps the payload
+        NSUInteger payloadWindowStart = MAX(offset, payloadStart);
+        NSUInteger payloadWindowEnd = MIN(end, payloadEnd);
+        if (payloadWindowStart < payloadWindowEnd)
+            payloadCrc = [SuotaChecksum crc32:payloadCrc bytes:bytes + payloadWindowStart length:payloadWindowEnd - payloadWindowStart];
     }
-    crc_code &= 0xff;
-    return crc_code;
-}
 
-- (uint64_t) calculatePayloadCrc {
-    uint8_t headerBytes[self.headerInfo.payloadSize];
-    [self.data getBytes:&headerBytes range:NSMakeRange(self.headerInfo.payloadOffset, self.headerInfo.payloadSize)];
-    unsigned long crc = crc32(0L, Z_NULL, 0);
-    return crc32(crc, headerBytes, (int)self.headerInfo.payloadSize);
+    self.crc = crc_code;
+    self.payloadCrcCalculated = withPayloadCrc;
+    self.calculatedPayloadCrc = withPayloadCrc ? payloadCrc : 0;
 }
 
 - (BOOL) isHeaderCrcValid {
-    return self.firmwareSize - self.headerInfo.payloadOffset >= self.headerInfo.payloadSize && self.headerInfo.payloadCrc == [self calculatePayloadCrc];
+    if (!self.isPayloadInRange)
+        return false;
+    // Only if the header was set after the load, or the CRC check was disabled during the load
+    if (!self.payloadCrcCalculated)
+        [self calculateChecksums:true];
+    return self.headerInfo.payloadCrc == self.calculatedPayloadCrc;
 }
 
 - (void) initBlocks:(int)blockSize chunkSize:(int)chunkSize {
@@ -249,43 +463,18 @@ static NSString* const TAG = @"SuotaFile";
 - (void) initBlocks {
     if (self.blockSize < self.chunkSize)
         self.blockSize = self.chunkSize;
-    if (self.blockSize > self.data.length) {
-        self.blockSize = (int)self.data.length;
+    if (self.blockSize > self.uploadSize) {
+        self.blockSize = self.uploadSize;
         if (self.chunkSize > self.blockSize)
             self.chunkSize = self.blockSize;
     }
     
-    self.totalBlocks = ((int)self.data.length) / self.blockSize + ((int)self.data.length % self.blockSize != 0 ? 1 : 0);
+    self.totalBlocks = self.uploadSize / self.blockSize + (self.uploadSize % self.blockSize != 0 ? 1 : 0);
     self.chunksPerBlock = self.blockSize / self.chunkSize + (self.blockSize % self.chunkSize != 0 ? 1 : 0);
-    self.lastBlockSize = self.data.length % self.blockSize;
-    self.totalChunks = 0;
-    
-    // Loop through all the bytes and split them into pieces of the default chunk size
-    self.blocks = [NSMutableArray arrayWithCapacity:self.totalBlocks];
-    int offset = 0;
-    for (int i = 0; i < self.totalBlocks; i++) {
-        int currBlockSize = self.blockSize;
-        int chunksInBlock = self.chunksPerBlock;
-        // Check if the last block needs to be smaller
-        if (offset + self.blockSize > self.data.length) {
-            currBlockSize = self.data.length % self.blockSize;
-            chunksInBlock = currBlockSize / self.chunkSize + (currBlockSize % self.chunkSize != 0 ? 1 : 0);
-        }
-        self.blocks[i] = [NSMutableArray arrayWithCapacity:chunksInBlock];
-        for (int j = 0; j < chunksInBlock; j++) {
-            // Default chunk size
-            int currChunkSize = self.chunkSize;
-            // Check if last chunk in block needs to be smaller
-            if ((j + 1) * self.chunkSize > currBlockSize) {
-                currChunkSize = currBlockSize % self.chunkSize;
-            }
-            uint8_t chunk[currChunkSize];
-            [self.data getBytes:&chunk range:NSMakeRange(offset, currChunkSize)];
-            self.blocks[i][j] = [NSData dataWithBytes:chunk length:currChunkSize];
-            offset += currChunkSize;
-            self.totalChunks++;
-        }
-    }
+    self.lastBlockSize = self.uploadSize % self.blockSize;
+
+    // Chunks are not materialized here. They are sliced from the loaded buffer on demand.
+    self.totalChunks = (self.totalBlocks - 1) * self.chunksPerBlock + [self getBlockChunks:self.totalBlocks - 1];
 }
 
 @end
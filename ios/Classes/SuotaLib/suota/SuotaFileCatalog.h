@@ -0,0 +1,127 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+/*!
+ @header SuotaFileCatalog.h
+ @brief Header file for the SuotaFileCatalog class.
+
+ This header file contains method and property declaration for the SuotaFileCatalog class.
+
+ @copyright 2019 Dialog Semiconductor
+ */
+
+#import <Foundation/Foundation.h>
+
+@class HeaderInfo;
+
+/*!
+ * @class SuotaFileCatalogEntry
+ *
+ * @discussion Cached information about a firmware file.
+ *
+ */
+@interface SuotaFileCatalogEntry : NSObject
+
+@property (readonly) NSString* path;
+@property (readonly) uint64_t size;
+@property (readonly) NSDate* modificationDate;
+/*!
+ * @property header
+ *
+ * @discussion The raw firmware header, or <code>nil</code> if the file has no valid header.
+ */
+@property (readonly) NSData* header;
+@property (readonly) NSString* type;
+@property (readonly) NSString* version;
+@property (readonly) uint64_t timestamp;
+@property (readonly) uint64_t payloadSize;
+@property (readonly) uint64_t payloadCrc;
+/*!
+ * @property crc
+ *
+ * @discussion The SUOTA image CRC, which is the XOR of all the firmware bytes.
+ */
+@property (readonly) uint8_t crc;
+
+/*!
+ * @method headerInfo
+ *
+ * @discussion Creates the {@link HeaderInfo} object from the cached header, without accessing the file.
+ *
+ * @return The header info, or <code>nil</code> if the file has no valid header.
+ */
+- (HeaderInfo*) headerInfo;
+
+@end
+
+/*!
+ * @class SuotaFileCatalog
+ *
+ * @discussion Persistent index of the firmware files found by the {@link SuotaFile} list methods. Each entry is keyed by the file path and is valid as long as the file size and modification date do not change. Only new or modified files are opened and parsed.
+ *
+ * The catalog is thread safe.
+ *
+ */
+@interface SuotaFileCatalog : NSObject
+
+/*!
+ * @property defaultCatalog
+ *
+ * @discussion The catalog stored at {@link FIRMWARE_CATALOG_PATH}.
+ */
+@property (class, readonly) SuotaFileCatalog* defaultCatalog;
+
+/*!
+ * @property catalogPath
+ *
+ * @discussion The catalog file path.
+ */
+@property (readonly) NSString* catalogPath;
+
+/*!
+ * @method initWithCatalogPath:
+ *
+ * @param catalogPath The catalog file path. The file is created on the first {@link save} call.
+ *
+ * @discussion Creates a new {@link SuotaFileCatalog} instance and loads the stored entries.
+ *
+ */
+- (instancetype) initWithCatalogPath:(NSString*)catalogPath;
+
+/*!
+ * @method entryForFile:size:modificationDate:
+ *
+ * @param path The firmware file path.
+ * @param size The current file size.
+ * @param modificationDate The current file modification date.
+ *
+ * @discussion Returns the catalog entry of the file. If the file is not in the catalog, or its size or modification date changed, the file is parsed and the entry is updated.
+ *
+ * @return The catalog entry, or <code>nil</code> if the file can't be read.
+ */
+- (SuotaFileCatalogEntry*) entryForFile:(NSString*)path size:(uint64_t)size modificationDate:(NSDate*)modificationDate;
+
+/*!
+ * @method entryForFile:
+ *
+ * @param path The firmware file path.
+ *
+ * @discussion Resolves symbolic links in the path, reads the file attributes and calls {@link entryForFile:size:modificationDate:}, so that the entry of a linked file is stored for the file it points to.
+ */
+- (SuotaFileCatalogEntry*) entryForFile:(NSString*)path;
+
+/*!
+ * @method save
+ *
+ * @discussion Writes the catalog to disk, if it was modified. Entries of files that no longer exist are removed.
+ */
+- (void) save;
+
+@end
@@ -0,0 +1,269 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+#import "SuotaFileCatalog.h"
+#import "HeaderInfo.h"
+#import "HeaderInfoBuilder.h"
+#import "SuotaChecksum.h"
+#import "SuotaLibConfig.h"
+#import "SuotaLibLog.h"
+
+static NSString* const TAG = @"SuotaFileCatalog";
+
+static int const CATALOG_VERSION = 1;
+static NSString* const KEY_VERSION = @"version";
+static NSString* const KEY_ENTRIES = @"entries";
+static NSString* const KEY_SIZE = @"size";
+static NSString* const KEY_MODIFICATION_DATE = @"mtime";
+static NSString* const KEY_HEADER = @"header";
+static NSString* const KEY_TYPE = @"type";
+static NSString* const KEY_FIRMWARE_VERSION = @"firmwareVersion";
+static NSString* const KEY_TIMESTAMP = @"timestamp";
+static NSString* const KEY_PAYLOAD_SIZE = @"payloadSize";
+static NSString* const KEY_PAYLOAD_CRC = @"payloadCrc";
+static NSString* const KEY_CRC = @"crc";
+
+@interface SuotaFileCatalogEntry ()
+
+@property NSString* path;
+@property uint64_t size;
+@property NSDate* modificationDate;
+@property NSData* header;
+@property NSString* type;
+@property NSString* version;
+@property uint64_t timestamp;
+@property uint64_t payloadSize;
+@property uint64_t payloadCrc;
+@property uint8_t crc;
+
+- (instancetype) initWithPath:(NSString*)path dictionary:(NSDictionary*)dictionary;
+- (instancetype) initWithPath:(NSString*)path size:(uint64_t)size modificationDate:(NSDate*)modificationDate;
+- (NSDictionary*) dictionary;
+- (BOOL) matchesSize:(uint64_t)size modificationDate:(NSDate*)modificationDate;
+
+@end
+
+@implementation SuotaFileCatalogEntry
+
+- (instancetype) initWithPath:(NSString*)path dictionary:(NSDictionary*)dictionary {
+    self = [super init];
+    if (!self)
+        return nil;
+    NSNumber* size = dictionary[KEY_SIZE];
+    NSDate* modificationDate = dictionary[KEY_MODIFICATION_DATE];
+    NSNumber* crc = dictionary[KEY_CRC];
+    if (![size isKindOfClass:NSNumber.class] || ![modificationDate isKindOfClass:NSDate.class] || ![crc isKindOfClass:NSNumber.class])
+        return nil;
+    self.path = path;
+    self.size = size.unsignedLongLongValue;
+    self.modificationDate = modificationDate;
+    self.crc = crc.unsignedCharValue;
+
+    NSData* header = dictionary[KEY_HEADER];
+    if ([header isKindOfClass:NSData.class]) {
+        self.header = header;
+        self.type = dictionary[KEY_TYPE];
+        self.version = dictionary[KEY_FIRMWARE_VERSION];
+        self.timestamp = [dictionary[KEY_TIMESTAMP] unsignedLongLongValue];
+        self.payloadSize = [dictionary[KEY_PAYLOAD_SIZE] unsignedLongLongValue];
+        self.payloadCrc = [dictionary[KEY_PAYLOAD_CRC] unsignedLongLongValue];
+    }
+    return self;
+}
+
+- (instancetype) initWithPath:(NSString*)path size:(uint64_t)size modificationDate:(NSDate*)modificationDate {
+    self = [super init];
+    if (!self)
+        return nil;
+    self.path = path;
+    self.modificationDate = modificationDate;
+
+    NSError* error;
+    NSData* firmware = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:&error];
+    if (!firmware) {
+        SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Failed to read firmware: %@ %@", path, error.localizedDescription);
+        return nil;
+    }
+    // Use the actual length, in case the file changed after the attributes were read
+    self.size = firmware.length;
+    self.crc = [SuotaChecksum xorChecksum:firmware.bytes length:firmware.length];
+
+    NSUInteger headerLength = MIN(firmware.length, (NSUInteger)(HeaderInfo.SIGNATURE_LENGTH + HeaderInfoBuilder.maxHeaderSize));
+    HeaderInfo* headerInfo = [HeaderInfoBuilder headerWithHeader:[firmware subdataWithRange:NSMakeRange(0, headerLength)] totalBytes:firmware.length];
+    if (headerInfo) {
+        self.header = headerInfo.header;
+        self.type = headerInfo.type;
+        self.version = headerInfo.version;
+        self.timestamp = headerInfo.timestamp;
+        self.payloadSize = headerInfo.payloadSize;
+        self.payloadCrc = headerInfo.payloadCrc;
+    }
+    return self;
+}
+
+- (NSDictionary*) dictionary {
+    NSMutableDictionary* dictionary = [NSMutableDictionary dictionary];
+    dictionary[KEY_SIZE] = @(self.size);
+    dictionary[KEY_MODIFICATION_DATE] = self.modificationDate;
+    dictionary[KEY_CRC] = @(self.crc);
+    if (self.header) {
+        dictionary[KEY_HEADER] = self.header;
+        if (self.type)
+            dictionary[KEY_TYPE] = self.type;
+        if (self.version)
+            dictionary[KEY_FIRMWARE_VERSION] = self.version;
+        dictionary[KEY_TIMESTAMP] = @(self.timestamp);
+        dictionary[KEY_PAYLOAD_SIZE] = @(self.payloadSize);
+        dictionary[KEY_PAYLOAD_CRC] = @(self.payloadCrc);
+    }
+    return dictionary;
+}
+
+- (BOOL) matchesSize:(uint64_t)size modificationDate:(NSDate*)modificationDate {
+    return self.size == size && [self.modificationDate isEqualToDate:modificationDate];
+}
+
+- (HeaderInfo*) headerInfo {
+    return self.header ? [HeaderInfoBuilder headerWithHeader:self.header totalBytes:self.size] : nil;
+}
+
+@end
+
+
+@interface SuotaFileCatalog ()
+
+@property NSString* catalogPath;
+@property NSMutableDictionary<NSString*, SuotaFileCatalogEntry*>* entries;
+@property NSMutableSet<NSString*>* checkedPaths;
+@property BOOL modified;
+
+@end
+
+@implementation SuotaFileCatalog
+
++ (SuotaFileCatalog*) defaultCatalog {
+    static SuotaFileCatalog* defaultCatalog;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        defaultCatalog = [[SuotaFileCatalog alloc] initWithCatalogPath:SuotaLibConfig.FIRMWARE_CATALOG_PATH];
+    });
+    return defaultCatalog;
+}
+
+- (instancetype) initWithCatalogPath:(NSString*)catalogPath {
+    self = [super init];
+    if (!self)
+        return nil;
+    self.catalogPath = catalogPath;
+    self.entries = [NSMutableDictionary dictionary];
+    self.checkedPaths = [NSMutableSet set];
+    [self load];
+    return self;
+}
+
+// The app container path changes when the app is reinstalled, so paths are stored relative to the home directory.
+- (NSString*) keyForPath:(NSString*)path {
+    return path.stringByStandardizingPath.stringByAbbreviatingWithTildeInPath;
+}
+
+- (void) load {
+    NSData* data = [NSData dataWithContentsOfFile:self.catalogPath];
+    if (!data)
+        return;
+    NSError* error;
+    NSDictionary* catalog = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:nil error:&error];
+    if (![catalog isKindOfClass:NSDictionary.class] || [catalog[KEY_VERSION] intValue] != CATALOG_VERSION) {
+        SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Ignoring invalid catalog: %@ %@", self.catalogPath, error ? error.localizedDescription : @"");
+        return;
+    }
+    NSDictionary* entries = catalog[KEY_ENTRIES];
+    if (![entries isKindOfClass:NSDictionary.class])
+        return;
+    for (NSString* key in entries) {
+        NSDictionary* dictionary = entries[key];
+        if (![dictionary isKindOfClass:NSDictionary.class])
+            continue;
+        SuotaFileCatalogEntry* entry = [[SuotaFileCatalogEntry alloc] initWithPath:key.stringByExpandingTildeInPath dictionary:dictionary];
+        if (entry)
+            self.entries[key] = entry;
+    }
+    SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Loaded %lu catalog entries", (unsigned long)self.entries.count);
+}
+
+- (SuotaFileCatalogEntry*) entryForFile:(NSString*)path size:(uint64_t)size modificationDate:(NSDate*)modificationDate {
+    NSString* key = [self keyForPath:path];
+    @synchronized (self) {
+        [self.checkedPaths addObject:key];
+        SuotaFileCatalogEntry* entry = self.entries[key];
+        if (entry && [entry matchesSize:size modificationDate:modificationDate])
+            return entry;
+    }
+
+    // Parse outside the lock, so that files can be processed concurrently
+    SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Parse firmware: %@", path);
+    SuotaFileCatalogEntry* entry = [[SuotaFileCatalogEntry alloc] initWithPath:path size:size modificationDate:modificationDate];
+    @synchronized (self) {
+        if (entry) {
+            self.entries[key] = entry;
+        } else {
+            [self.entries removeObjectForKey:key];
+        }
+        self.modified = true;
+    }
+    return entry;
+}
+
+- (SuotaFileCatalogEntry*) entryForFile:(NSString*)path {
+    // The attributes of a symbolic link are those of the link, so the entry is kept for the firmware it points to
+    path = path.stringByResolvingSymlinksInPath;
+    NSError* error;
+    NSDictionary<NSFileAttributeKey, id>* attributes = [NSFileManager.defaultManager attributesOfItemAtPath:path error:&error];
+    if (!attributes) {
+        SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Failed to read firmware attributes: %@ %@", path, error.localizedDescription);
+        return nil;
+    }
+    return [self entryForFile:path size:attributes.fileSize modificationDate:attributes.fileModificationDate];
+}
+
+- (void) save {
+    NSData* data;
+    @synchronized (self) {
+        // Remove entries of deleted files. Files checked since the last save are known to exist.
+        NSFileManager* fileManager = [NSFileManager defaultManager];
+        for (NSString* key in self.entries.allKeys) {
+            if (![self.checkedPaths containsObject:key] && ![fileManager fileExistsAtPath:key.stringByExpandingTildeInPath]) {
+                [self.entries removeObjectForKey:key];
+                self.modified = true;
+            }
+        }
+        [self.checkedPaths removeAllObjects];
+        if (!self.modified)
+            return;
+
+        NSMutableDictionary* entries = [NSMutableDictionary dictionaryWithCapacity:self.entries.count];
+        for (NSString* key in self.entries)
+            entries[key] = self.entries[key].dictionary;
+        NSError* error;
+        data = [NSPropertyListSerialization dataWithPropertyList:@{ KEY_VERSION : @(CATALOG_VERSION), KEY_ENTRIES : entries } format:NSPropertyListBinaryFormat_v1_0 options:0 error:&error];
+        if (!data) {
+            SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Failed to serialize catalog: %@", error.localizedDescription);
+            return;
+        }
+        self.modified = false;
+    }
+
+    NSError* error;
+    [NSFileManager.defaultManager createDirectoryAtPath:self.catalogPath.stringByDeletingLastPathComponent withIntermediateDirectories:true attributes:nil error:nil];
+    if (![data writeToFile:self.catalogPath options:NSDataWritingAtomic error:&error]) {
+        SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Failed to save catalog: %@ %@", self.catalogPath, error.localizedDescription);
+    }
+}
+
+@end
@@ -0,0 +1,384 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+/*!
+ @header SuotaFleetUpdate.h
+ @brief Header file for the SuotaFleetUpdate class.
+
+ This header file contains method and property declaration for the SuotaFleetUpdate class and the session transport protocols it uses.
+
+ @copyright 2019 Dialog Semiconductor
+ */
+
+#import <Foundation/Foundation.h>
+#import <CoreBluetooth/CoreBluetooth.h>
+
+@class SpeedStatistics;
+@class SuotaFile;
+@class SuotaHistogram;
+@protocol SuotaFleetSession;
+@protocol SuotaUpdatePolicy;
+
+/*!
+ * @enum SuotaFleetDeviceState
+ *
+ * @constant FLEET_DEVICE_QUEUED, The device is waiting for a free session slot.
+ * @constant FLEET_DEVICE_RUNNING, The device is being updated.
+ * @constant FLEET_DEVICE_RETRY_PENDING, The update failed and will be queued again after the retry delay.
+ * @constant FLEET_DEVICE_SUCCEEDED, The device was updated.
+ * @constant FLEET_DEVICE_FAILED, The update failed and no retries are left.
+ * @constant FLEET_DEVICE_CANCELLED, The fleet update was cancelled before the device finished.
+ */
+enum SuotaFleetDeviceState {
+    FLEET_DEVICE_QUEUED,
+    FLEET_DEVICE_RUNNING,
+    FLEET_DEVICE_RETRY_PENDING,
+    FLEET_DEVICE_SUCCEEDED,
+    FLEET_DEVICE_FAILED,
+    FLEET_DEVICE_CANCELLED,
+};
+
+/*!
+ * @protocol SuotaFleetSessionDelegate
+ *
+ * @discussion Receives the events of a {@link SuotaFleetSession}. All methods must be called on the main thread. No method is called after the session finishes or is cancelled.
+ *
+ */
+@protocol SuotaFleetSessionDelegate <NSObject>
+
+/*!
+ * @method onSessionProgress:percent:
+ *
+ * @param session The session.
+ * @param percent The image upload progress, from 0 to 100.
+ */
+- (void) onSessionProgress:(id<SuotaFleetSession>)session percent:(float)percent;
+
+/*!
+ * @method onSessionSuccess:
+ *
+ * @param session The session.
+ *
+ * @discussion Called when the device was updated. The session is finished.
+ */
+- (void) onSessionSuccess:(id<SuotaFleetSession>)session;
+
+/*!
+ * @method onSessionFailure:error:
+ *
+ * @param session The session.
+ * @param error The error code. Error codes can be found at {@link SuotaErrors} and {@link ApplicationErrors}.
+ *
+ * @discussion Called when the update failed. The session is finished.
+ */
+- (void) onSessionFailure:(id<SuotaFleetSession>)session error:(int)error;
+
+@end
+
+/*!
+ * @protocol SuotaFleetSession
+ *
+ * @discussion A single device update, from connection to completion.
+ *
+ */
+@protocol SuotaFleetSession <NSObject>
+
+@property (readonly) NSUUID* identifier;
+
+/*!
+ * @method start
+ *
+ * @discussion Connects to the device and starts the update.
+ */
+- (void) start;
+
+/*!
+ * @method cancel
+ *
+ * @discussion Stops the update and disconnects. The delegate is not called afterwards.
+ */
+- (void) cancel;
+
+@optional
+
+/*!
+ * @method speedStatistics
+ *
+ * @discussion Called when the session ends. The upload statistics are added to the fleet statistics.
+ *
+ * @return The upload statistics of the session, or <code>nil</code> if none were collected.
+ */
+- (SpeedStatistics*) speedStatistics;
+
+@end
+
+/*!
+ * @protocol SuotaFleetTransport
+ *
+ * @discussion Creates the device sessions of a {@link SuotaFleetUpdate}. A test transport can provide sessions that don't use Bluetooth.
+ *
+ */
+@protocol SuotaFleetTransport <NSObject>
+
+/*!
+ * @method createSession:suotaFile:delegate:
+ *
+ * @param identifier The peripheral identifier.
+ * @param suotaFile The firmware to upload. Each session gets its own copy.
+ * @param delegate The session delegate.
+ *
+ * @return A new session, not started yet.
+ */
+- (id<SuotaFleetSession>) createSession:(NSUUID*)identifier suotaFile:(SuotaFile*)suotaFile delegate:(id<SuotaFleetSessionDelegate>)delegate;
+
+@end
+
+/*!
+ * @class SuotaManagerFleetTransport
+ *
+ * @discussion The default transport. Each session uses a {@link SuotaManager} with the library configuration. Sessions never display dialogs.
+ *
+ */
+@interface SuotaManagerFleetTransport : NSObject <SuotaFleetTransport>
+
+/*!
+ * @property connectionTimeout
+ *
+ * @discussion Time in milli seconds to wait for the device to connect and become ready. Default is {@link FLEET_CONNECTION_TIMEOUT}.
+ */
+@property int connectionTimeout;
+/*!
+ * @property updatePolicy
+ *
+ * @discussion The {@link SuotaManager} update policy of each session. Devices that already run the firmware are disconnected without uploading it, and count as succeeded. Default is <code>nil</code>.
+ */
+@property id<SuotaUpdatePolicy> updatePolicy;
+
+@end
+
+/*!
+ * @class SuotaFleetDevice
+ *
+ * @discussion The update status of a device in a fleet update.
+ *
+ */
+@interface SuotaFleetDevice : NSObject
+
+@property (readonly) NSUUID* identifier;
+@property (readonly) enum SuotaFleetDeviceState state;
+/*!
+ * @property attempts
+ *
+ * @discussion Number of sessions started for the device.
+ */
+@property (readonly) int attempts;
+/*!
+ * @property lastError
+ *
+ * @discussion The error of the last failed session, or 0.
+ */
+@property (readonly) int lastError;
+/*!
+ * @property progress
+ *
+ * @discussion The image upload progress of the current session, from 0 to 100.
+ */
+@property (readonly) float progress;
+/*!
+ * @property elapsedTime
+ *
+ * @discussion Time in seconds from the start of the last session to its completion.
+ */
+@property (readonly) double elapsedTime;
+
+@end
+
+/*!
+ * @class SuotaFleetProgress
+ *
+ * @discussion A snapshot of the aggregate progress of a fleet update.
+ *
+ */
+@interface SuotaFleetProgress : NSObject
+
+@property (readonly) int total;
+@property (readonly) int queued;
+@property (readonly) int running;
+@property (readonly) int succeeded;
+@property (readonly) int failed;
+/*!
+ * @property percent
+ *
+ * @discussion The overall progress, from 0 to 100. Finished devices count as complete.
+ */
+@property (readonly) float percent;
+/*!
+ * @property bytesSent
+ *
+ * @discussion Image bytes uploaded by all sessions, including failed attempts.
+ */
+@property (readonly) uint64_t bytesSent;
+/*!
+ * @property elapsedTime
+ *
+ * @discussion Time in seconds since the fleet update started.
+ */
+@property (readonly) double elapsedTime;
+/*!
+ * @property throughput
+ *
+ * @discussion The aggregate upload speed, in bytes per second.
+ */
+@property (readonly) double throughput;
+
+@end
+
+/*!
+ * @protocol SuotaFleetUpdateDelegate
+ *
+ * @discussion Receives the events of a {@link SuotaFleetUpdate}. All methods are called on the main thread.
+ *
+ */
+@protocol SuotaFleetUpdateDelegate <NSObject>
+
+/*!
+ * @method onFleetDeviceStateChange:
+ *
+ * @param device The device whose state changed.
+ */
+- (void) onFleetDeviceStateChange:(SuotaFleetDevice*)device;
+
+/*!
+ * @method onFleetProgress:
+ *
+ * @param progress The aggregate progress.
+ *
+ * @discussion Called when a device state changes, and at most every {@link progressInterval} milli seconds while uploads are in progress.
+ */
+- (void) onFleetProgress:(SuotaFleetProgress*)progress;
+
+/*!
+ * @method onFleetFinished:
+ *
+ * @param progress The final aggregate progress.
+ *
+ * @discussion Called when all devices have finished, or after the fleet update is cancelled.
+ */
+- (void) onFleetFinished:(SuotaFleetProgress*)progress;
+
+@end
+
+/*!
+ * @class SuotaFleetUpdate
+ *
+ * @brief Updates several devices with the same firmware.
+ *
+ * @discussion Runs up to {@link maxConcurrentSessions} device sessions at a time. The rest of the devices are queued in the order given. A failed device is queued again, after {@link retryDelay}, until it has been tried {@link maxRetries} more times, unless the error can't be fixed by retrying. Aggregate progress and throughput are reported to the delegate.
+ *
+ * The object must be used on the main thread.
+ *
+ */
+@interface SuotaFleetUpdate : NSObject <SuotaFleetSessionDelegate>
+
+@property (weak) id<SuotaFleetUpdateDelegate> delegate;
+@property (readonly) SuotaFile* suotaFile;
+@property (readonly) id<SuotaFleetTransport> transport;
+@property (readonly) NSArray<SuotaFleetDevice*>* devices;
+@property (readonly) BOOL running;
+/*!
+ * @property throughputHistogram
+ *
+ * @discussion The block upload speeds of all sessions that ended, including failed attempts, in bytes per second.
+ */
+@property (readonly) SuotaHistogram* throughputHistogram;
+/*!
+ * @property chunkLatencyHistogram
+ *
+ * @discussion The chunk write latencies of all sessions that ended, in micro seconds.
+ */
+@property (readonly) SuotaHistogram* chunkLatencyHistogram;
+
+/*!
+ * @property maxConcurrentSessions
+ *
+ * @discussion Maximum number of concurrent sessions. Default is {@link FLEET_CONCURRENCY}.
+ */
+@property int maxConcurrentSessions;
+/*!
+ * @property maxRetries
+ *
+ * @discussion Number of times a failed device is retried. Default is {@link FLEET_MAX_RETRIES}.
+ */
+@property int maxRetries;
+/*!
+ * @property retryDelay
+ *
+ * @discussion Time in milli seconds before a failed device is queued again. Default is {@link FLEET_RETRY_DELAY}.
+ */
+@property int retryDelay;
+/*!
+ * @property progressInterval
+ *
+ * @discussion Minimum time in milli seconds between upload progress reports. Default is 500.
+ */
+@property int progressInterval;
+
+/*!
+ * @method initWithPeripherals:suotaFile:delegate:
+ *
+ * @param peripherals The devices to update.
+ * @param suotaFile The firmware to upload.
+ * @param delegate The delegate.
+ *
+ * @discussion Creates a fleet update that uses {@link SuotaManagerFleetTransport}.
+ */
+- (instancetype) initWithPeripherals:(NSArray<CBPeripheral*>*)peripherals suotaFile:(SuotaFile*)suotaFile delegate:(id<SuotaFleetUpdateDelegate>)delegate;
+
+/*!
+ * @method initWithIdentifiers:suotaFile:transport:delegate:
+ *
+ * @param identifiers The peripheral identifiers of the devices to update. Duplicates are ignored.
+ * @param suotaFile The firmware to upload.
+ * @param transport The session transport.
+ * @param delegate The delegate.
+ */
+- (instancetype) initWithIdentifiers:(NSArray<NSUUID*>*)identifiers suotaFile:(SuotaFile*)suotaFile transport:(id<SuotaFleetTransport>)transport delegate:(id<SuotaFleetUpdateDelegate>)delegate;
+
+/*!
+ * @method start
+ *
+ * @discussion Starts the first sessions. Does nothing if the update is running or has finished.
+ */
+- (void) start;
+
+/*!
+ * @method cancel
+ *
+ * @discussion Cancels the running sessions and the queued devices, then reports {@link onFleetFinished:}.
+ */
+- (void) cancel;
+
+/*!
+ * @method progress
+ *
+ * @return The current aggregate progress.
+ */
+- (SuotaFleetProgress*) progress;
+
+/*!
+ * @method isRetryableError:
+ *
+ * @param error The error code.
+ *
+ * @discussion Checks if a failed update may succeed when retried. Errors about the firmware image, or a device that doesn't support SUOTA, are not retried.
+ */
++ (BOOL) isRetryableError:(int)error;
+
+@end
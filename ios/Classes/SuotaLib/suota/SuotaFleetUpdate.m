@@ -0,0 +1,499 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+#import "SuotaFleetUpdate.h"
+#import "SuotaBluetoothManager.h"
+#import "SuotaFile.h"
+#import "SuotaHistogram.h"
+#import "SuotaLibConfig.h"
+#import "SuotaLibLog.h"
+#import "SuotaManager.h"
+#import "SuotaProfile.h"
+#import "SuotaProtocol.h"
+#import "SuotaTimer.h"
+
+static NSString* const TAG = @"SuotaFleetUpdate";
+
+static int const PROGRESS_INTERVAL_MILLIS = 500;
+
+#pragma mark - SuotaManagerFleetSession
+
+/*!
+ * @class SuotaManagerFleetSession
+ *
+ * @discussion Runs a device update with a {@link SuotaManager}. The update is started when the device is ready, and finishes when the reboot command is sent, or after disconnection if {@link AUTO_REBOOT} is disabled.
+ *
+ */
+@interface SuotaManagerFleetSession : NSObject <SuotaFleetSession, SuotaManagerDelegate>
+
+@property NSUUID* identifier;
+@property SuotaFile* suotaFile;
+@property (weak) id<SuotaFleetSessionDelegate> delegate;
+@property int connectionTimeout;
+@property id<SuotaUpdatePolicy> updatePolicy;
+@property SuotaManager* suotaManager;
+@property SuotaTimer* connectionTimer;
+@property SpeedStatistics* speedStatistics;
+@property BOOL updateSucceeded;
+@property BOOL finished;
+
+@end
+
+@implementation SuotaManagerFleetSession
+
+- (void) start {
+    CBPeripheral* peripheral = [SuotaBluetoothManager.instance retrievePeripheralWithIdentifier:self.identifier];
+    if (!peripheral) {
+        SuotaLog(TAG, @"Unknown peripheral: %@", self.identifier.UUIDString);
+        [self finish:NOT_CONNECTED];
+        return;
+    }
+    self.suotaManager = [[SuotaManager alloc] initWithPeripheral:peripheral suotaManagerDelegate:self];
+    self.suotaManager.suotaFile = self.suotaFile;
+    self.suotaManager.updatePolicy = self.updatePolicy;
+    if (!self.suotaFile.isLoaded) {
+        [self finish:FIRMWARE_LOAD_FAILED];
+        return;
+    }
+    if (self.connectionTimeout > 0) {
+        __weak SuotaManagerFleetSession* weakSelf = self;
+        self.connectionTimer = [SuotaTimer scheduledTimerWithInterval:self.connectionTimeout / 1000. queue:dispatch_get_main_queue() repeats:false block:^(SuotaTimer* timer) {
+            [weakSelf onConnectionTimeout];
+        }];
+    }
+    [self.suotaManager connect];
+}
+
+- (void) cancel {
+    self.finished = true;
+    [self.connectionTimer invalidate];
+    self.speedStatistics = self.suotaManager.suotaProtocol.statistics;
+    [self.suotaManager destroy];
+}
+
+- (void) onConnectionTimeout {
+    SuotaLog(TAG, @"Connection timeout: %@", self.identifier.UUIDString);
+    [self.suotaManager destroy];
+    [self finish:NOT_CONNECTED];
+}
+
+// Error 0 means success. The delegate is called asynchronously, so that it can release the session from within the callback.
+- (void) finish:(int)error {
+    if (self.finished)
+        return;
+    self.finished = true;
+    [self.connectionTimer invalidate];
+    self.speedStatistics = self.suotaManager.suotaProtocol.statistics;
+    dispatch_async(dispatch_get_main_queue(), ^{
+        if (!error)
+            [self.delegate onSessionSuccess:self];
+        else
+            [self.delegate onSessionFailure:self error:error];
+    });
+}
+
+#pragma mark - SuotaManagerDelegate
+
+- (void) onConnectionStateChange:(enum SuotaManagerStatus)newStatus {
+    if (newStatus == DISCONNECTED)
+        [self finish:self.updateSucceeded ? 0 : NOT_CONNECTED];
+}
+
+- (void) onServicesDiscovered {
+}
+
+- (void) onCharacteristicRead:(enum CharacteristicGroup)characteristicGroup characteristic:(CBCharacteristic*)characteristic {
+}
+
+- (void) onDeviceInfoReadCompleted:(enum DeviceInfoReadStatus)status {
+}
+
+- (void) onDeviceReady {
+    if (self.finished)
+        return;
+    [self.connectionTimer invalidate];
+    [self.suotaManager startUpdate];
+}
+
+- (void) onSuotaLog:(enum SuotaProtocolState)state type:(enum SuotaLogType)type log:(NSString*)log {
+}
+
+- (void) onChunkSend:(int)chunkCount totalChunks:(int)totalChunks chunk:(int)chunk block:(int)block blockChunks:(int)blockChunks totalBlocks:(int)totalBlocks {
+}
+
+- (void) onBlockSent:(int)block totalBlocks:(int)totalBlocks {
+}
+
+- (void) updateSpeedStatistics:(double)current max:(double)max min:(double)min avg:(double)avg {
+}
+
+- (void) updateCurrentSpeed:(double)currentSpeed {
+}
+
+- (void) onUploadProgress:(float)percent {
+    if (!self.finished)
+        [self.delegate onSessionProgress:self percent:percent];
+}
+
+- (void) onSuccess:(double)totalElapsedSeconds imageUploadElapsedSeconds:(double)imageUploadElapsedSeconds {
+    self.updateSucceeded = true;
+    // Without auto reboot, the session ends on disconnection
+    if (!SuotaLibConfig.AUTO_REBOOT)
+        [self.suotaManager disconnect];
+}
+
+- (void) onFailure:(int)errorCode {
+    // Failures reported before the update starts, like GATT errors, leave the device connected
+    [self.suotaManager destroy];
+    [self finish:errorCode];
+}
+
+- (void) onRebootSent {
+    [self finish:0];
+}
+
+- (void) onFirmwareCurrent:(SuotaFile*)suotaFile {
+    self.updateSucceeded = true;
+    [self.suotaManager disconnect];
+}
+
+@end
+
+#pragma mark - SuotaManagerFleetTransport
+
+@implementation SuotaManagerFleetTransport
+
+- (instancetype) init {
+    self = [super init];
+    if (!self)
+        return nil;
+    self.connectionTimeout = SuotaLibConfig.FLEET_CONNECTION_TIMEOUT;
+    return self;
+}
+
+- (id<SuotaFleetSession>) createSession:(NSUUID*)identifier suotaFile:(SuotaFile*)suotaFile delegate:(id<SuotaFleetSessionDelegate>)delegate {
+    SuotaManagerFleetSession* session = [[SuotaManagerFleetSession alloc] init];
+    session.identifier = identifier;
+    session.suotaFile = suotaFile;
+    session.delegate = delegate;
+    session.connectionTimeout = self.connectionTimeout;
+    session.updatePolicy = self.updatePolicy;
+    return session;
+}
+
+@end
+
+#pragma mark - SuotaFleetDevice
+
+@interface SuotaFleetDevice ()
+
+@property NSUUID* identifier;
+@property enum SuotaFleetDeviceState state;
+@property int attempts;
+@property int lastError;
+@property float progress;
+@property double elapsedTime;
+@property uint64_t startTime;
+@property id<SuotaFleetSession> session;
+
+- (BOOL) isFinished;
+
+@end
+
+@implementation SuotaFleetDevice
+
+- (BOOL) isFinished {
+    return self.state == FLEET_DEVICE_SUCCEEDED || self.state == FLEET_DEVICE_FAILED || self.state == FLEET_DEVICE_CANCELLED;
+}
+
+@end
+
+#pragma mark - SuotaFleetProgress
+
+@interface SuotaFleetProgress ()
+
+@property int total;
+@property int queued;
+@property int running;
+@property int succeeded;
+@property int failed;
+@property float percent;
+@property uint64_t bytesSent;
+@property double elapsedTime;
+@property double throughput;
+
+@end
+
+@implementation SuotaFleetProgress
+@end
+
+#pragma mark - SuotaFleetUpdate
+
+@interface SuotaFleetUpdate ()
+
+@property SuotaFile* suotaFile;
+@property id<SuotaFleetTransport> transport;
+@property NSArray<SuotaFleetDevice*>* devices;
+@property BOOL running;
+@property BOOL started;
+@property NSMutableArray<SuotaFleetDevice*>* queue;
+@property int activeSessions;
+@property uint64_t startTime;
+@property uint64_t finishedBytes;
+@property SuotaHistogram* throughputHistogram;
+@property SuotaHistogram* chunkLatencyHistogram;
+@property BOOL progressPending;
+
+@end
+
+@implementation SuotaFleetUpdate
+
+- (instancetype) initWithPeripherals:(NSArray<CBPeripheral*>*)peripherals suotaFile:(SuotaFile*)suotaFile delegate:(id<SuotaFleetUpdateDelegate>)delegate {
+    NSMutableArray<NSUUID*>* identifiers = [NSMutableArray arrayWithCapacity:peripherals.count];
+    for (CBPeripheral* peripheral in peripherals)
+        [identifiers addObject:peripheral.identifier];
+    return [self initWithIdentifiers:identifiers suotaFile:suotaFile transport:[[SuotaManagerFleetTransport alloc] init] delegate:delegate];
+}
+
+- (instancetype) initWithIdentifiers:(NSArray<NSUUID*>*)identifiers suotaFile:(SuotaFile*)suotaFile transport:(id<SuotaFleetTransport>)transport delegate:(id<SuotaFleetUpdateDelegate>)delegate {
+    self = [super init];
+    if (!self)
+        return nil;
+    self.suotaFile = suotaFile;
+    self.transport = transport;
+    self.delegate = delegate;
+    self.maxConcurrentSessions = SuotaLibConfig.FLEET_CONCURRENCY;
+    self.maxRetries = SuotaLibConfig.FLEET_MAX_RETRIES;
+    self.retryDelay = SuotaLibConfig.FLEET_RETRY_DELAY;
+    self.progressInterval = PROGRESS_INTERVAL_MILLIS;
+    self.throughputHistogram = [[SuotaHistogram alloc] init];
+    self.chunkLatencyHistogram = [[SuotaHistogram alloc] init];
+
+    NSMutableArray<SuotaFleetDevice*>* devices = [NSMutableArray arrayWithCapacity:identifiers.count];
+    NSMutableSet<NSUUID*>* added = [NSMutableSet setWithCapacity:identifiers.count];
+    for (NSUUID* identifier in identifiers) {
+        if ([added containsObject:identifier])
+            continue;
+        [added addObject:identifier];
+        SuotaFleetDevice* device = [[SuotaFleetDevice alloc] init];
+        device.identifier = identifier;
+        device.state = FLEET_DEVICE_QUEUED;
+        [devices addObject:device];
+    }
+    self.devices = devices;
+    self.queue = [devices mutableCopy];
+    return self;
+}
+
++ (BOOL) isRetryableError:(int)error {
+    switch (error) {
+        case INVALID_MEMORY_TYPE:
+        case INVALID_IMAGE_BANK:
+        case INVALID_IMAGE_HEADER:
+        case INVALID_IMAGE_SIZE:
+        case INVALID_PRODUCT_HEADER:
+        case SAME_IMAGE_ERROR:
+        case SUOTA_NOT_SUPPORTED:
+        case FIRMWARE_LOAD_FAILED:
+        case INVALID_FIRMWARE_CRC:
+            return false;
+        default:
+            return true;
+    }
+}
+
+- (void) start {
+    if (self.started)
+        return;
+    self.started = true;
+    self.running = true;
+    self.startTime = [[NSDate date] timeIntervalSince1970] * 1000;
+    SuotaLog(TAG, @"Start fleet update: %lu devices, %d concurrent sessions", (unsigned long)self.devices.count, self.maxConcurrentSessions);
+    [self startSessions];
+    [self checkFinished];
+}
+
+- (void) cancel {
+    if (!self.running)
+        return;
+    SuotaLog(TAG, @"Cancel fleet update");
+    self.running = false;
+    [self.queue removeAllObjects];
+    for (SuotaFleetDevice* device in self.devices) {
+        if (device.isFinished)
+            continue;
+        [device.session cancel];
+        [self endSession:device];
+        [self setState:FLEET_DEVICE_CANCELLED device:device];
+    }
+    [self.delegate onFleetFinished:self.progress];
+}
+
+- (SuotaFleetProgress*) progress {
+    SuotaFleetProgress* progress = [[SuotaFleetProgress alloc] init];
+    progress.total = (int) self.devices.count;
+    float percent = 0;
+    uint64_t bytesSent = self.finishedBytes;
+    int uploadSize = self.suotaFile.uploadSize;
+    for (SuotaFleetDevice* device in self.devices) {
+        switch (device.state) {
+            case FLEET_DEVICE_QUEUED:
+            case FLEET_DEVICE_RETRY_PENDING:
+                progress.queued++;
+                break;
+            case FLEET_DEVICE_RUNNING:
+                progress.running++;
+                percent += device.progress;
+                bytesSent += (uint64_t)(device.progress / 100 * uploadSize);
+                break;
+            case FLEET_DEVICE_SUCCEEDED:
+                progress.succeeded++;
+                percent += 100;
+                break;
+            case FLEET_DEVICE_FAILED:
+            case FLEET_DEVICE_CANCELLED:
+                progress.failed++;
+                percent += 100;
+                break;
+        }
+    }
+    progress.percent = progress.total ? percent / progress.total : 100;
+    progress.bytesSent = bytesSent;
+    progress.elapsedTime = self.startTime ? ([[NSDate date] timeIntervalSince1970] * 1000 - self.startTime) / 1000. : 0;
+    progress.throughput = progress.elapsedTime > 0 ? bytesSent / progress.elapsedTime : 0;
+    return progress;
+}
+
+- (void) startSessions {
+    while (self.running && self.activeSessions < MAX(self.maxConcurrentSessions, 1) && self.queue.count) {
+        SuotaFleetDevice* device = self.queue.firstObject;
+        [self.queue removeObjectAtIndex:0];
+        [self startSession:device];
+    }
+}
+
+- (void) startSession:(SuotaFleetDevice*)device {
+    device.attempts++;
+    device.progress = 0;
+    device.startTime = [[NSDate date] timeIntervalSince1970] * 1000;
+    // Each session sets its own block and chunk size, so the sessions can't share the file object
+    device.session = [self.transport createSession:device.identifier suotaFile:[self.suotaFile copy] delegate:self];
+    self.activeSessions++;
+    SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Start session %d for %@", device.attempts, device.identifier.UUIDString);
+    [self setState:FLEET_DEVICE_RUNNING device:device];
+    [device.session start];
+}
+
+- (void) endSession:(SuotaFleetDevice*)device {
+    if (!device.session)
+        return;
+    if ([device.session respondsToSelector:@selector(speedStatistics)]) {
+        SpeedStatistics* statistics = device.session.speedStatistics;
+        [self.throughputHistogram merge:statistics.throughputHistogram];
+        [self.chunkLatencyHistogram merge:statistics.chunkLatencyHistogram];
+    }
+    device.session = nil;
+    device.elapsedTime = ([[NSDate date] timeIntervalSince1970] * 1000 - device.startTime) / 1000.;
+    self.finishedBytes += (uint64_t)(device.progress / 100 * self.suotaFile.uploadSize);
+    self.activeSessions--;
+}
+
+- (SuotaFleetDevice*) deviceForSession:(id<SuotaFleetSession>)session {
+    for (SuotaFleetDevice* device in self.devices) {
+        if (device.session == session)
+            return device;
+    }
+    return nil;
+}
+
+- (void) setState:(enum SuotaFleetDeviceState)state device:(SuotaFleetDevice*)device {
+    device.state = state;
+    [self.delegate onFleetDeviceStateChange:device];
+    if (self.running)
+        [self.delegate onFleetProgress:self.progress];
+}
+
+- (void) checkFinished {
+    if (!self.running || self.activeSessions)
+        return;
+    for (SuotaFleetDevice* device in self.devices) {
+        if (!device.isFinished)
+            return;
+    }
+    self.running = false;
+    SuotaFleetProgress* progress = self.progress;
+    SuotaLog(TAG, @"Fleet update finished: %d succeeded, %d failed, %.3f seconds, %d B/s", progress.succeeded, progress.failed, progress.elapsedTime, (int) progress.throughput);
+    SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Block speed (B/s): %@", self.throughputHistogram);
+    SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Chunk write latency (us): %@", self.chunkLatencyHistogram);
+    [self.delegate onFleetFinished:progress];
+}
+
+// Upload progress is reported at most once per interval
+- (void) scheduleProgress {
+    if (self.progressPending)
+        return;
+    self.progressPending = true;
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)self.progressInterval * NSEC_PER_MSEC), dispatch_get_main_queue(), ^{
+        self.progressPending = false;
+        if (self.running)
+            [self.delegate onFleetProgress:self.progress];
+    });
+}
+
+#pragma mark - SuotaFleetSessionDelegate
+
+- (void) onSessionProgress:(id<SuotaFleetSession>)session percent:(float)percent {
+    SuotaFleetDevice* device = [self deviceForSession:session];
+    if (!device)
+        return;
+    device.progress = percent;
+    [self scheduleProgress];
+}
+
+- (void) onSessionSuccess:(id<SuotaFleetSession>)session {
+    SuotaFleetDevice* device = [self deviceForSession:session];
+    if (!device)
+        return;
+    device.progress = 100;
+    device.lastError = 0;
+    [self endSession:device];
+    SuotaLog(TAG, @"Device updated: %@ (%.3f seconds)", device.identifier.UUIDString, device.elapsedTime);
+    [self setState:FLEET_DEVICE_SUCCEEDED device:device];
+    [self startSessions];
+    [self checkFinished];
+}
+
+- (void) onSessionFailure:(id<SuotaFleetSession>)session error:(int)error {
+    SuotaFleetDevice* device = [self deviceForSession:session];
+    if (!device)
+        return;
+    device.lastError = error;
+    [self endSession:device];
+    BOOL retry = device.attempts <= self.maxRetries && [SuotaFleetUpdate isRetryableError:error];
+    SuotaLog(TAG, @"Device update failed: %@, error %#x, attempt %d%@", device.identifier.UUIDString, error, device.attempts, retry ? @", retry" : @"");
+    if (!retry) {
+        [self setState:FLEET_DEVICE_FAILED device:device];
+        [self startSessions];
+        [self checkFinished];
+        return;
+    }
+
+    [self setState:FLEET_DEVICE_RETRY_PENDING device:device];
+    [self startSessions];
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)MAX(self.retryDelay, 0) * NSEC_PER_MSEC), dispatch_get_main_queue(), ^{
+        if (!self.running || device.state != FLEET_DEVICE_RETRY_PENDING)
+            return;
+        [self.queue addObject:device];
+        [self setState:FLEET_DEVICE_QUEUED device:device];
+        [self startSessions];
+    });
+}
+
+@end
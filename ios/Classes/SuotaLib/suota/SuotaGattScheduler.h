@@ -0,0 +1,164 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+/*!
+ @header SuotaGattScheduler.h
+ @brief Header file for the SuotaGattScheduler class.
+
+ This header file contains method and property declaration for the SuotaGattScheduler class.
+
+ @copyright 2019 Dialog Semiconductor
+ */
+
+#import <Foundation/Foundation.h>
+#import <CoreBluetooth/CoreBluetooth.h>
+#import "GattOperation.h"
+
+/*!
+ * @protocol SuotaGattSchedulerDelegate
+ *
+ * @discussion Executes the operations of a {@link SuotaGattScheduler}. All methods are called on the scheduler queue.
+ */
+@protocol SuotaGattSchedulerDelegate <NSObject>
+
+/*!
+ * @method executeScheduledOperation:
+ *
+ * @param operation The operation to send to the peripheral.
+ *
+ * @return <code>true</code> if the operation was sent, <code>false</code> if it was dropped.
+ */
+- (BOOL) executeScheduledOperation:(GattOperation*)operation;
+
+/*!
+ * @method onScheduledOperationTimeout:
+ *
+ * @param operation The operation that did not complete before its deadline.
+ */
+- (void) onScheduledOperationTimeout:(GattOperation*)operation;
+
+@end
+
+/*!
+ * @class SuotaGattScheduler
+ *
+ * @discussion Queues the GATT operations of a peripheral by priority: control writes first, then info reads, then data writes. Operations of the same priority are sent in order.
+ *
+ * At most {@link window} operations that expect a response are in flight at the same time. Each of them must complete before its deadline, otherwise the delegate is notified and its slot is released. Operations can be queued as a group, with a completion block that runs when all of them complete successfully.
+ *
+ * The scheduler is not thread safe. All methods must be called on the scheduler queue.
+ *
+ */
+@interface SuotaGattScheduler : NSObject
+
+/*!
+ * @property window
+ *
+ * @discussion Maximum number of operations in flight.
+ */
+@property (readonly) int window;
+/*!
+ * @property timeout
+ *
+ * @discussion Time in seconds an operation may stay in flight, or 0 for no deadline.
+ */
+@property (readonly) double timeout;
+/*!
+ * @property queueDepth
+ *
+ * @discussion Number of operations waiting to be sent.
+ */
+@property (readonly) int queueDepth;
+/*!
+ * @property maxQueueDepth
+ *
+ * @discussion Highest {@link queueDepth} since the last {@link reset}.
+ */
+@property (readonly) int maxQueueDepth;
+/*!
+ * @property inFlight
+ *
+ * @discussion Number of operations sent and waiting for their response.
+ */
+@property (readonly) int inFlight;
+@property (readonly) int enqueued;
+@property (readonly) int completed;
+@property (readonly) int timedOut;
+/*!
+ * @property totalWaitTime
+ *
+ * @discussion Total time in seconds operations spent in the queue before they were sent.
+ */
+@property (readonly) double totalWaitTime;
+@property (readonly) double maxWaitTime;
+
+/*!
+ * @method initWithDelegate:queue:window:timeout:
+ *
+ * @param delegate The delegate that executes the operations. It is not retained.
+ * @param queue The queue on which the scheduler is used and its deadlines run.
+ * @param window Maximum number of operations in flight, at least 1.
+ * @param timeout Time in seconds an operation may stay in flight, or 0 for no deadline.
+ *
+ * @discussion Creates a new {@link SuotaGattScheduler} instance.
+ *
+ */
+- (instancetype) initWithDelegate:(id<SuotaGattSchedulerDelegate>)delegate queue:(dispatch_queue_t)queue window:(int)window timeout:(double)timeout;
+
+/*!
+ * @method enqueue:
+ *
+ * @param operation The operation to send.
+ *
+ * @discussion Queues the operation by its priority and sends it as soon as the window allows.
+ */
+- (void) enqueue:(GattOperation*)operation;
+
+/*!
+ * @method enqueueGroup:name:completion:
+ *
+ * @param operations The operations to send.
+ * @param name The group name.
+ * @param completion Called when all operations complete successfully. It is not called if any of them fails or times out.
+ *
+ * @discussion Queues a group of operations. The group is pending until it completes, fails or the scheduler is reset.
+ */
+- (void) enqueueGroup:(NSArray<GattOperation*>*)operations name:(NSString*)name completion:(dispatch_block_t)completion;
+
+/*!
+ * @method isGroupPending:
+ *
+ * @param name The group name.
+ *
+ * @return <code>true</code> if a group with the name was queued and has not finished yet.
+ */
+- (BOOL) isGroupPending:(NSString*)name;
+
+/*!
+ * @method completeOperation:characteristic:error:
+ *
+ * @param type The completed operation type. {@link WRITE} also completes a {@link REBOOT_COMMAND}.
+ * @param characteristic The characteristic of the completed operation, or of the completed descriptor.
+ * @param error The operation error, or <code>nil</code> on success.
+ *
+ * @discussion Completes the oldest matching operation in flight, and sends the next queued operations. Completions without a matching operation are ignored.
+ *
+ * @return <code>true</code> if a matching operation was found.
+ */
+- (BOOL) completeOperation:(enum OperationType)type characteristic:(CBCharacteristic*)characteristic error:(NSError*)error;
+
+/*!
+ * @method reset
+ *
+ * @discussion Drops the queued and in flight operations and the pending groups, and clears the counters.
+ */
+- (void) reset;
+
+@end
@@ -0,0 +1,241 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+#import "SuotaGattScheduler.h"
+#import "SuotaLibLog.h"
+#import "SuotaTimer.h"
+
+static NSString* const TAG = @"SuotaGattScheduler";
+
+static int const PRIORITY_COUNT = PRIORITY_DATA + 1;
+
+@interface SuotaScheduledOperation : NSObject
+
+@property GattOperation* operation;
+@property NSString* group;
+@property NSTimeInterval enqueueTime;
+@property SuotaTimer* deadline;
+
+@end
+
+@implementation SuotaScheduledOperation
+@end
+
+
+@interface SuotaGattScheduler ()
+
+@property (weak) id<SuotaGattSchedulerDelegate> delegate;
+@property dispatch_queue_t queue;
+@property int window;
+@property double timeout;
+@property int queueDepth;
+@property int maxQueueDepth;
+@property int enqueued;
+@property int completed;
+@property int timedOut;
+@property double totalWaitTime;
+@property double maxWaitTime;
+
+@end
+
+@implementation SuotaGattScheduler {
+    // One FIFO per priority
+    NSMutableArray<SuotaScheduledOperation*>* queues[PRIORITY_COUNT];
+    NSMutableArray<SuotaScheduledOperation*>* inFlightOperations;
+    // Group name to group completion and number of operations not completed yet
+    NSMutableDictionary<NSString*, dispatch_block_t>* groupCompletions;
+    NSMutableDictionary<NSString*, NSNumber*>* groupRemaining;
+    BOOL sending;
+}
+
+- (instancetype) initWithDelegate:(id<SuotaGattSchedulerDelegate>)delegate queue:(dispatch_queue_t)queue window:(int)window timeout:(double)timeout {
+    self = [super init];
+    if (!self)
+        return nil;
+    self.delegate = delegate;
+    self.queue = queue;
+    self.window = MAX(window, 1);
+    self.timeout = MAX(timeout, 0);
+    for (int i = 0; i < PRIORITY_COUNT; i++)
+        queues[i] = [NSMutableArray array];
+    inFlightOperations = [NSMutableArray array];
+    groupCompletions = [NSMutableDictionary dictionary];
+    groupRemaining = [NSMutableDictionary dictionary];
+    return self;
+}
+
+- (int) inFlight {
+    return (int)inFlightOperations.count;
+}
+
+- (void) enqueue:(GattOperation*)operation {
+    [self schedule:operation group:nil];
+    [self sendQueued];
+}
+
+- (void) enqueueGroup:(NSArray<GattOperation*>*)operations name:(NSString*)name completion:(dispatch_block_t)completion {
+    if (!operations.count) {
+        if (completion)
+            completion();
+        return;
+    }
+    groupCompletions[name] = completion ? completion : ^{};
+    groupRemaining[name] = @(operations.count);
+    for (GattOperation* operation in operations)
+        [self schedule:operation group:name];
+    [self sendQueued];
+}
+
+- (BOOL) isGroupPending:(NSString*)name {
+    return groupRemaining[name] != nil;
+}
+
+- (void) schedule:(GattOperation*)operation group:(NSString*)group {
+    SuotaScheduledOperation* scheduled = [[SuotaScheduledOperation alloc] init];
+    scheduled.operation = operation;
+    scheduled.group = group;
+    scheduled.enqueueTime = NSProcessInfo.processInfo.systemUptime;
+    [queues[operation.priority] addObject:scheduled];
+    self.enqueued++;
+    self.queueDepth++;
+    self.maxQueueDepth = MAX(self.maxQueueDepth, self.queueDepth);
+}
+
+- (SuotaScheduledOperation*) dequeue {
+    for (int i = 0; i < PRIORITY_COUNT; i++) {
+        SuotaScheduledOperation* scheduled = queues[i].firstObject;
+        if (scheduled) {
+            [queues[i] removeObjectAtIndex:0];
+            self.queueDepth--;
+            return scheduled;
+        }
+    }
+    return nil;
+}
+
+// Sending an operation may queue new ones, which are sent by the outer call
+- (void) sendQueued {
+    if (sending)
+        return;
+    sending = true;
+    while (inFlightOperations.count < self.window) {
+        SuotaScheduledOperation* scheduled = [self dequeue];
+        if (!scheduled)
+            break;
+        double wait = NSProcessInfo.processInfo.systemUptime - scheduled.enqueueTime;
+        self.totalWaitTime += wait;
+        self.maxWaitTime = MAX(self.maxWaitTime, wait);
+
+        GattOperation* operation = scheduled.operation;
+        if (operation.expectsResponse)
+            [inFlightOperations addObject:scheduled];
+        if (![self.delegate executeScheduledOperation:operation]) {
+            [inFlightOperations removeObjectIdenticalTo:scheduled];
+            [self failGroup:scheduled.group];
+            continue;
+        }
+        if (!operation.expectsResponse) {
+            [self finish:scheduled];
+        } else if (self.timeout > 0 && [inFlightOperations indexOfObjectIdenticalTo:scheduled] != NSNotFound) {
+            __weak SuotaGattScheduler* weakSelf = self;
+            __weak SuotaScheduledOperation* weakScheduled = scheduled;
+            scheduled.deadline = [SuotaTimer scheduledTimerWithInterval:self.timeout queue:self.queue repeats:false block:^(SuotaTimer* timer) {
+                [weakSelf onDeadline:weakScheduled];
+            }];
+        }
+    }
+    sending = false;
+}
+
+- (BOOL) completeOperation:(enum OperationType)type characteristic:(CBCharacteristic*)characteristic error:(NSError*)error {
+    NSUInteger index = [inFlightOperations indexOfObjectPassingTest:^BOOL (SuotaScheduledOperation* scheduled, NSUInteger index, BOOL* stop) {
+        return *stop = [self operation:scheduled.operation matchesType:type characteristic:characteristic];
+    }];
+    if (index == NSNotFound)
+        return false;
+
+    SuotaScheduledOperation* scheduled = inFlightOperations[index];
+    [inFlightOperations removeObjectAtIndex:index];
+    [scheduled.deadline invalidate];
+    if (error) {
+        [self failGroup:scheduled.group];
+    } else {
+        [self finish:scheduled];
+    }
+    [self sendQueued];
+    return true;
+}
+
+- (BOOL) operation:(GattOperation*)operation matchesType:(enum OperationType)type characteristic:(CBCharacteristic*)characteristic {
+    enum OperationType operationType = operation.type == REBOOT_COMMAND ? WRITE : operation.type;
+    if (operationType != type)
+        return false;
+    CBCharacteristic* operationCharacteristic = operation.type == WRITE_DESCRIPTOR ? operation.descriptor.characteristic : operation.characteristic;
+    return operationCharacteristic == characteristic || [operationCharacteristic.UUID isEqual:characteristic.UUID];
+}
+
+- (void) finish:(SuotaScheduledOperation*)scheduled {
+    self.completed++;
+    NSString* group = scheduled.group;
+    if (!group || !groupRemaining[group])
+        return;
+    int remaining = groupRemaining[group].intValue - 1;
+    if (remaining > 0) {
+        groupRemaining[group] = @(remaining);
+        return;
+    }
+    dispatch_block_t completion = groupCompletions[group];
+    [groupRemaining removeObjectForKey:group];
+    [groupCompletions removeObjectForKey:group];
+    completion();
+}
+
+- (void) failGroup:(NSString*)group {
+    if (!group || !groupRemaining[group])
+        return;
+    SuotaLogOpt(SuotaLibLog.GATT_OPERATION, TAG, @"Group failed: %@", group);
+    [groupRemaining removeObjectForKey:group];
+    [groupCompletions removeObjectForKey:group];
+}
+
+- (void) onDeadline:(SuotaScheduledOperation*)scheduled {
+    if (!scheduled || [inFlightOperations indexOfObjectIdenticalTo:scheduled] == NSNotFound)
+        return;
+    GattOperation* operation = scheduled.operation;
+    SuotaLog(TAG, @"Operation timeout: %d %@", operation.type, operation.characteristic.UUID.UUIDString);
+    [inFlightOperations removeObjectIdenticalTo:scheduled];
+    self.timedOut++;
+    [self failGroup:scheduled.group];
+    [self.delegate onScheduledOperationTimeout:operation];
+    [self sendQueued];
+}
+
+- (void) reset {
+    for (SuotaScheduledOperation* scheduled in inFlightOperations)
+        [scheduled.deadline invalidate];
+    [inFlightOperations removeAllObjects];
+    for (int i = 0; i < PRIORITY_COUNT; i++)
+        [queues[i] removeAllObjects];
+    [groupCompletions removeAllObjects];
+    [groupRemaining removeAllObjects];
+    self.queueDepth = 0;
+    self.maxQueueDepth = 0;
+    self.enqueued = 0;
+    self.completed = 0;
+    self.timedOut = 0;
+    self.totalWaitTime = 0;
+    self.maxWaitTime = 0;
+}
+
+- (NSString*) description {
+    return [NSString stringWithFormat:@"queued %d (max %d), in flight %d, enqueued %d, completed %d, timed out %d, wait %.1f ms (max %.1f ms)", self.queueDepth, self.maxQueueDepth, self.inFlight, self.enqueued, self.completed, self.timedOut, self.totalWaitTime * 1000, self.maxWaitTime * 1000];
+}
+
+@end
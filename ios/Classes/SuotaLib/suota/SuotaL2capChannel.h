@@ -0,0 +1,115 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+/*!
+ @header SuotaL2capChannel.h
+ @brief Header file for the SuotaL2capChannel class.
+
+ This header file contains method and property declaration for the SuotaL2capChannel class.
+
+ @copyright 2019 Dialog Semiconductor
+ */
+
+#import <CoreBluetooth/CoreBluetooth.h>
+#import <Foundation/Foundation.h>
+
+@class SendChunkOperation;
+@class SuotaL2capChannel;
+
+/*!
+ * @protocol SuotaL2capChannelDelegate
+ *
+ * @discussion Receives the L2CAP channel events. All methods are called on the main thread.
+ *
+ */
+@protocol SuotaL2capChannelDelegate <NSObject>
+
+/*!
+ * @method onL2capChannelOpen:
+ *
+ * @discussion Called when the channel is open and ready to send data.
+ */
+- (void) onL2capChannelOpen:(SuotaL2capChannel*)channel;
+
+/*!
+ * @method onL2capChannelFailure:pendingChunks:
+ *
+ * @param channel The channel.
+ * @param pendingChunks Chunks queued for sending, including a partially written one. Empty if the channel failed before opening. Chunks already written to the channel may not have reached the device, so the block they belong to must be sent again.
+ *
+ * @discussion Called when the channel failed to open, or was closed or failed while open. The channel is closed when this method is called.
+ */
+- (void) onL2capChannelFailure:(SuotaL2capChannel*)channel pendingChunks:(NSArray<SendChunkOperation*>*)pendingChunks;
+
+/*!
+ * @method onL2capChannel:chunkSent:
+ *
+ * @discussion Called when all the bytes of a chunk have been written to the channel.
+ */
+- (void) onL2capChannel:(SuotaL2capChannel*)channel chunkSent:(SendChunkOperation*)chunk;
+
+@end
+
+/*!
+ * @class SuotaL2capChannel
+ *
+ * @discussion L2CAP connection oriented channel used to stream the SUOTA image data, instead of writing to the patch data characteristic. The channel streams, the open timeout and the delegate calls run on the channel queue, which must be serial.
+ *
+ */
+@interface SuotaL2capChannel : NSObject <NSStreamDelegate>
+
+@property (readonly) CBPeripheral* peripheral;
+@property (readonly) CBL2CAPPSM psm;
+@property (weak) id<SuotaL2capChannelDelegate> delegate;
+/*!
+ * @property queue
+ *
+ * @discussion The queue on which the channel runs.
+ */
+@property (readonly) dispatch_queue_t queue;
+
+/*!
+ * @property isOpen
+ *
+ * @discussion Indicates if the channel is open and can send data.
+ */
+@property (readonly) BOOL isOpen;
+
+- (instancetype) initWithPeripheral:(CBPeripheral*)peripheral psm:(CBL2CAPPSM)psm queue:(dispatch_queue_t)queue delegate:(id<SuotaL2capChannelDelegate>)delegate;
+
+/*!
+ * @method open
+ *
+ * @discussion Requests the channel from the peripheral. The delegate is notified when the channel opens, or if it fails to open within {@link L2CAP_OPEN_TIMEOUT}.
+ */
+- (void) open;
+
+/*!
+ * @method onChannelOpened:error:
+ *
+ * @discussion Must be called by the peripheral delegate on the <code>peripheral:didOpenL2CAPChannel:error:</code> callback.
+ */
+- (void) onChannelOpened:(CBL2CAPChannel*)channel error:(NSError*)error;
+
+/*!
+ * @method sendChunk:
+ *
+ * @discussion Queues the chunk value for sending over the channel.
+ */
+- (void) sendChunk:(SendChunkOperation*)chunk;
+
+/*!
+ * @method close
+ *
+ * @discussion Closes the channel and discards any queued chunks. The delegate is not notified.
+ */
+- (void) close;
+
+@end
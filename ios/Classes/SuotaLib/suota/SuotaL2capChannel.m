@@ -0,0 +1,174 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+#import "SuotaL2capChannel.h"
+#import "SendChunkOperation.h"
+#import "SuotaLibConfig.h"
+#import "SuotaLibLog.h"
+#import "SuotaProtocol.h"
+#import "SuotaTimer.h"
+
+@interface SuotaL2capChannel ()
+
+@property CBPeripheral* peripheral;
+@property CBL2CAPPSM psm;
+@property dispatch_queue_t queue;
+@property CBL2CAPChannel* channel;
+@property BOOL isOpen;
+@property BOOL opening;
+@property SuotaTimer* openTimer;
+@property NSMutableArray<SendChunkOperation*>* pendingChunks;
+@property NSUInteger pendingOffset;
+
+@end
+
+@implementation SuotaL2capChannel
+
+static NSString* const TAG = @"SuotaL2capChannel";
+
+- (instancetype) initWithPeripheral:(CBPeripheral*)peripheral psm:(CBL2CAPPSM)psm queue:(dispatch_queue_t)queue delegate:(id<SuotaL2capChannelDelegate>)delegate {
+    self = [super init];
+    if (!self)
+        return nil;
+    self.peripheral = peripheral;
+    self.psm = psm;
+    self.queue = queue;
+    self.delegate = delegate;
+    self.pendingChunks = [NSMutableArray array];
+    return self;
+}
+
+- (void) open {
+    if (self.isOpen || self.opening)
+        return;
+    SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Open L2CAP channel, PSM %d", self.psm);
+    self.opening = true;
+    if (SuotaLibConfig.L2CAP_OPEN_TIMEOUT > 0) {
+        __weak SuotaL2capChannel* weakSelf = self;
+        self.openTimer = [SuotaTimer scheduledTimerWithInterval:(double)SuotaLibConfig.L2CAP_OPEN_TIMEOUT / 1000.0 queue:self.queue repeats:false block:^(SuotaTimer* timer) {
+            [weakSelf openTimeout];
+        }];
+    }
+    [self.peripheral openL2CAPChannel:self.psm];
+}
+
+- (void) openTimeout {
+    if (!self.opening)
+        return;
+    SuotaLog(TAG, @"L2CAP channel open timeout");
+    [self fail];
+}
+
+- (void) onChannelOpened:(CBL2CAPChannel*)channel error:(NSError*)error {
+    if (!self.opening || channel.PSM != self.psm)
+        return;
+    [self.openTimer invalidate];
+    self.opening = false;
+    if (error || !channel) {
+        SuotaLog(TAG, @"Failed to open L2CAP channel: %@", error);
+        [self fail];
+        return;
+    }
+
+    self.channel = channel;
+    for (NSStream* stream in @[channel.inputStream, channel.outputStream]) {
+        stream.delegate = self;
+    }
+    CFReadStreamSetDispatchQueue((__bridge CFReadStreamRef)channel.inputStream, self.queue);
+    CFWriteStreamSetDispatchQueue((__bridge CFWriteStreamRef)channel.outputStream, self.queue);
+    [channel.inputStream open];
+    [channel.outputStream open];
+}
+
+- (void) sendChunk:(SendChunkOperation*)chunk {
+    [self.pendingChunks addObject:chunk];
+    if (self.isOpen && self.channel.outputStream.hasSpaceAvailable)
+        [self write];
+}
+
+- (void) write {
+    NSOutputStream* outputStream = self.channel.outputStream;
+    while (self.pendingChunks.count && outputStream.hasSpaceAvailable) {
+        SendChunkOperation* chunk = self.pendingChunks[0];
+        if (!self.pendingOffset)
+            [chunk.suotaProtocol notifyForSendingChunk:chunk];
+
+        NSData* value = chunk.value;
+        NSInteger written = [outputStream write:(const uint8_t*)value.bytes + self.pendingOffset maxLength:value.length - self.pendingOffset];
+        if (written < 0) {
+            SuotaLog(TAG, @"L2CAP channel write error: %@", outputStream.streamError);
+            [self fail];
+            return;
+        }
+        self.pendingOffset += written;
+        if (self.pendingOffset < value.length)
+            return;
+
+        self.pendingOffset = 0;
+        [self.pendingChunks removeObjectAtIndex:0];
+        [self.delegate onL2capChannel:self chunkSent:chunk];
+    }
+}
+
+- (void) stream:(NSStream*)stream handleEvent:(NSStreamEvent)eventCode {
+    switch (eventCode) {
+        case NSStreamEventOpenCompleted:
+            if (stream == self.channel.outputStream && !self.isOpen) {
+                SuotaLog(TAG, @"L2CAP channel open, PSM %d", self.psm);
+                self.isOpen = true;
+                [self.delegate onL2capChannelOpen:self];
+            }
+            break;
+        case NSStreamEventHasSpaceAvailable:
+            [self write];
+            break;
+        case NSStreamEventHasBytesAvailable: {
+            // The device does not send data over the channel. Status is reported with notifications.
+            uint8_t buffer[64];
+            while (self.channel.inputStream.hasBytesAvailable && [self.channel.inputStream read:buffer maxLength:sizeof(buffer)] > 0);
+            break;
+        }
+        case NSStreamEventErrorOccurred:
+            SuotaLog(TAG, @"L2CAP channel error: %@", stream.streamError);
+            [self fail];
+            break;
+        case NSStreamEventEndEncountered:
+            SuotaLog(TAG, @"L2CAP channel closed");
+            [self fail];
+            break;
+        default:
+            break;
+    }
+}
+
+- (void) fail {
+    NSArray<SendChunkOperation*>* pendingChunks = [self.pendingChunks copy];
+    [self close];
+    [self.delegate onL2capChannelFailure:self pendingChunks:pendingChunks];
+}
+
+- (void) close {
+    [self.openTimer invalidate];
+    self.opening = false;
+    self.isOpen = false;
+    if (self.channel) {
+        for (NSStream* stream in @[self.channel.inputStream, self.channel.outputStream]) {
+            stream.delegate = nil;
+            [stream close];
+        }
+        CFReadStreamSetDispatchQueue((__bridge CFReadStreamRef)self.channel.inputStream, NULL);
+        CFWriteStreamSetDispatchQueue((__bridge CFWriteStreamRef)self.channel.outputStream, NULL);
+    }
+    self.channel = nil;
+    [self.pendingChunks removeAllObjects];
+    self.pendingOffset = 0;
+}
+
+@end
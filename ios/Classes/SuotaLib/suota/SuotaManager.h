@@ -27,8 +27,13 @@
 @class SendChunkOperation;
 @class SuotaBluetoothManager;
 @class SuotaFile;
+@class SuotaGattScheduler;
 @class SuotaInfo;
+@class SuotaL2capChannel;
+@class SuotaNotificationCoalescer;
 @class SuotaProtocol;
+@class SuotaRingBuffer<ObjectType>;
+@protocol SuotaUpdatePolicy;
 
 enum SuotaLogType {
     INFO,
@@ -206,6 +211,17 @@ enum SuotaLogType {
  */
 - (void) onRebootSent;
 
+@optional
+
+/*!
+ * @method onFirmwareCurrent:
+ *
+ * @param suotaFile The selected firmware file.
+ *
+ * @discussion Triggered instead of starting the SUOTA protocol, if the {@link updatePolicy} reports that the device already runs the firmware of the selected file. The device is not rebooted and stays connected.
+ */
+- (void) onFirmwareCurrent:(SuotaFile*)suotaFile;
+
 @end
 
 /*!
@@ -224,13 +240,61 @@ enum ManagerState {
 
 @property CBPeripheral* peripheral;
 @property (weak) id<SuotaManagerDelegate> suotaManagerDelegate;
+/*!
+ *  @property delegateQueue
+ *
+ *  @discussion The queue on which the {@link SuotaManagerDelegate} methods are called. Default is the main queue.
+ *
+ */
+@property dispatch_queue_t delegateQueue;
+/*!
+ *  @property delegateDispatcher
+ *
+ *  @discussion Forwards the {@link SuotaManagerDelegate} methods to the delegate on the {@link delegateQueue}. The library notifies the delegate through this object.
+ *
+ */
+@property (readonly) id<SuotaManagerDelegate> delegateDispatcher;
+/*!
+ *  @property protocolQueue
+ *
+ *  @discussion The serial queue on which the manager and the SUOTA protocol run. It is a private queue if {@link PROTOCOL_QUEUE} is enabled, otherwise the main queue.
+ *  Calls to {@link connect}, {@link startUpdate}, {@link disconnect} and {@link destroy} from other queues are dispatched to this queue.
+ *
+ */
+@property (readonly) dispatch_queue_t protocolQueue;
+/*!
+ *  @property notificationCoalescer
+ *
+ *  @discussion Collapses the chunk, block and progress notifications, if {@link NOTIFICATION_RATE} is greater than 0. Otherwise <code>nil</code>.
+ *
+ */
+@property (readonly) SuotaNotificationCoalescer* notificationCoalescer;
+/*!
+ *  @property gattScheduler
+ *
+ *  @discussion Sends the GATT operations of {@link executeOperation:} by priority, with at most {@link GATT_WINDOW} in flight. The chunks of the image use the {@link sendChunkQueue} instead. Its counters report the queue depth and wait time of the current connection.
+ *
+ */
+@property (readonly) SuotaGattScheduler* gattScheduler;
 @property SuotaBluetoothManager* bluetoothManager;
 @property enum ManagerState state;
 @property SuotaProtocol* suotaProtocol;
 @property (weak) UIViewController* suotaViewController;
-@property NSMutableArray<SendChunkOperation*>* sendChunkOperationArray;
-@property BOOL sendChunkOperationPending;
+/*!
+ *  @property sendChunkQueue
+ *
+ *  @discussion Queue of the chunks waiting to be written. It holds one block and is filled by the protocol and drained by the chunk writer.
+ *
+ */
+@property SuotaRingBuffer<SendChunkOperation*>* sendChunkQueue;
 @property BOOL rebootSent;
+/*!
+ *  @property discoveryTime
+ *
+ *  @discussion Time in seconds from the start of service discovery until the service status descriptor was discovered, or 0 before that.
+ *
+ */
+@property (readonly) NSTimeInterval discoveryTime;
 
 // SUOTA configuration
 /*!
@@ -240,8 +304,21 @@ enum ManagerState {
  *
  */
 @property (nonatomic) SuotaFile* suotaFile;
+/*!
+ *  @property updatePolicy
+ *
+ *  @discussion Checked by {@link startUpdate} before the SUOTA protocol starts, with the firmware and software revisions read from the device, never from the device info cache. If it reports that the device firmware is current, {@link onFirmwareCurrent:} is called instead of uploading the image. Default is <code>nil</code>, which always uploads.
+ *
+ */
+@property id<SuotaUpdatePolicy> updatePolicy;
 @property int blockSize;
-@property int chunkSize;
+/*!
+ *  @property chunkSize
+ *
+ *  @discussion The upload chunk size. If it is set, it is used as is. Otherwise it is derived from the MTU and the device patch data size.
+ *
+ */
+@property (nonatomic) int chunkSize;
 @property uint8_t imageBank;
 @property uint8_t memoryType;
 // SPI
@@ -334,6 +411,14 @@ enum ManagerState {
  */
 @property BOOL l2capPsmRead;
 
+/*!
+ *  @property l2capChannel
+ *
+ *  @discussion L2CAP channel used to send the image data. Has a nil value if the image data are sent with GATT writes.
+ *
+ */
+@property SuotaL2capChannel* l2capChannel;
+
 // Device Info
 @property CBService* deviceInfoService;
 @property CBCharacteristic* manufacturerNameCharacteristic;
@@ -433,12 +518,22 @@ enum ManagerState {
  *
  */
 @property NSMutableDictionary<CBUUID*, CBCharacteristic*>* deviceInfoMap;
-@property BOOL isSuotaInfoReadGroupPending;
-@property BOOL isDeviceInfoReadGroupPending;
-@property int totalSuotaInfo;
-@property int totalDeviceInfo;
 @property (class, readonly) NSArray<CBUUID*>* suotaInfoUuids;
 @property (class, readonly) NSArray<CBUUID*>* deviceInfoUuids;
+/*!
+ *  @property suotaCharacteristicUuids
+ *
+ *  @discussion The SUOTA control characteristics followed by the {@link suotaInfoUuids}. Only these are discovered in the SUOTA service if {@link SUOTA_LIB_CONFIG_TARGETED_DISCOVERY} is <code>true</code>.
+ *
+ */
+@property (class, readonly) NSArray<CBUUID*>* suotaCharacteristicUuids;
+/*!
+ *  @property discoveryServiceUuids
+ *
+ *  @discussion The SUOTA and device information services. Only these are discovered if {@link SUOTA_LIB_CONFIG_TARGETED_DISCOVERY} is <code>true</code>.
+ *
+ */
+@property (class, readonly) NSArray<CBUUID*>* discoveryServiceUuids;
 
 /*!
  * @method initWithPeripheral:suotaManagerDelegate:
@@ -672,7 +767,7 @@ enum ManagerState {
 /*!
  * @method initializeSuota
  *
- * @discussion Initializes the SUOTA protocol settings using default values. If a SUOTA process is already running this method does nothing.
+ * @discussion Initializes the SUOTA protocol settings using default values. If a SUOTA process is already running this method does nothing. If {@link AUTO_CHUNK_SIZE} is <code>true</code> and {@link chunkSize} wasn't set, the chunk size is selected from the negotiated MTU and the device patch data size, and the block size is rounded down to a multiple of the chunk size.
  *
  * @see initializeSuota:misoGpio:mosiGpio:csGpio:sckGpio:imageBank:
  * @see initializeSuota:i2cAddress:sclGpio:sdaGpio:imageBank:
@@ -759,7 +854,7 @@ enum ManagerState {
 /*!
  * @method startUpdate
  *
- * @discussion This method actually starts SuotaProtocol.
+ * @discussion This method actually starts SuotaProtocol, unless the {@link updatePolicy} reports that the device firmware is current.
  * Make sure to call this only if you have successfully connected a BLE device first.
  * Otherwise this method does nothing.
  */
@@ -778,12 +873,29 @@ enum ManagerState {
  * @discussion Cleans up everything needed.
  */
 - (void) destroy;
+
+/*!
+ * @method isOnProtocolQueue
+ *
+ * @discussion Checks if the caller runs on the {@link protocolQueue}.
+ */
+- (BOOL) isOnProtocolQueue;
+
+/*!
+ * @method runOnProtocolQueue:
+ *
+ * @param block The block to run.
+ *
+ * @discussion Runs the block immediately if called on the {@link protocolQueue}, otherwise dispatches it asynchronously to the queue.
+ */
+- (void) runOnProtocolQueue:(dispatch_block_t)block;
 - (int) memoryDevice;
 - (int) gpioMap;
 - (int) spiGpioMap;
 - (int) i2cGpioMap;
 - (void) close;
 - (void) enqueueSendChunkOperation:(SendChunkOperation*)sendChunkOperation;
+- (void) clearSendChunkQueue;
 - (void) executeOperation:(GattOperation*)gattOperation;
 - (void) executeOperationArray:(NSArray<GattOperation*>*)gattOperationArray;
 
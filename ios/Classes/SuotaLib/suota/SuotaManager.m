@@ -10,27 +10,68 @@
 
 #import "SuotaManager.h"
 #import "GattOperation.h"
+#import "HeaderInfo.h"
+#import "HeaderInfoBuilder.h"
 #import "SendChunkOperation.h"
 #import "SuotaBluetoothManager.h"
+#import "SuotaDelegateDispatcher.h"
+#import "SuotaDeviceInfoCache.h"
 #import "SuotaFile.h"
+#import "SuotaGattScheduler.h"
+#import "SuotaL2capChannel.h"
+#import "SuotaNotificationCoalescer.h"
 #import "SuotaProfile.h"
 #import "SuotaProtocol.h"
+#import "SuotaRingBuffer.h"
 #import "SuotaLibConfig.h"
 #import "SuotaLibLog.h"
 #import "SuotaUtils.h"
+#import "SuotaVersionPolicy.h"
+#import <stdatomic.h>
+
+@interface SuotaManager () <SuotaL2capChannelDelegate, SuotaGattSchedulerDelegate>
+
+@property dispatch_queue_t protocolQueue;
+@property SuotaNotificationCoalescer* notificationCoalescer;
+@property SuotaGattScheduler* gattScheduler;
+@property NSTimeInterval discoveryTime;
+@property NSTimeInterval discoveryStartTime;
+
+@end
 
 @implementation SuotaManager {
     BOOL pendingConnection;
+    BOOL pendingStart;
+    BOOL l2capChannelFailed;
+    // Set when the revisions were read from the device for the pending update start
+    BOOL revisionsRead;
+    // Set when the chunk size was set by the caller, so that it is not derived from the MTU
+    BOOL chunkSizeSet;
+    SuotaDelegateDispatcher* dispatcher;
+    // Set while a chunk writer owns the send queue. Only the owner dequeues, so the queue has a single consumer.
+    atomic_bool sendChunkOperationPending;
+    // Set when the owner waits for peripheralIsReadyToSendWriteWithoutResponse: to continue
+    atomic_bool awaitingWriteReady;
 }
 
 static NSString* const TAG = @"SuotaManager";
+static NSString* const SUOTA_INFO_READ_GROUP = @"SuotaInfo";
+static NSString* const DEVICE_INFO_READ_GROUP = @"DeviceInfo";
+static NSString* const REVISION_READ_GROUP = @"Revision";
 static NSArray<CBUUID*>* suotaInfoUuids;
 static NSArray<CBUUID*>* deviceInfoUuids;
+static NSArray<CBUUID*>* suotaCharacteristicUuids;
+static NSArray<CBUUID*>* discoveryServiceUuids;
+static BOOL writeWithoutResponseFlowControl;
+// Queue specific key, set on the private protocol queue of each manager
+static char protocolQueueKey;
 
 + (void) initialize {
     if (self != SuotaManager.class)
         return;
 
+    writeWithoutResponseFlowControl = UIDevice.currentDevice.systemVersion.floatValue >= 11.0;
+
     suotaInfoUuids = @[
             SuotaProfile.SUOTA_VERSION_UUID,
             SuotaProfile.SUOTA_PATCH_DATA_CHAR_SIZE_UUID,
@@ -49,6 +90,20 @@ static NSArray<CBUUID*>* deviceInfoUuids;
             SuotaProfile.CHARACTERISTIC_IEEE_11073,
             SuotaProfile.CHARACTERISTIC_PNP_ID
     ];
+
+    suotaCharacteristicUuids = [@[
+            SuotaProfile.SUOTA_MEM_DEV_UUID,
+            SuotaProfile.SUOTA_GPIO_MAP_UUID,
+            SuotaProfile.SUOTA_MEM_INFO_UUID,
+            SuotaProfile.SUOTA_PATCH_LEN_UUID,
+            SuotaProfile.SUOTA_PATCH_DATA_UUID,
+            SuotaProfile.SUOTA_SERV_STATUS_UUID
+    ] arrayByAddingObjectsFromArray:suotaInfoUuids];
+
+    discoveryServiceUuids = @[
+            SuotaProfile.SUOTA_SERVICE_UUID,
+            SuotaProfile.SERVICE_DEVICE_INFORMATION
+    ];
 }
 
 + (NSArray<CBUUID*>*) suotaInfoUuids {
@@ -59,6 +114,14 @@ static NSArray<CBUUID*>* deviceInfoUuids;
     return deviceInfoUuids;
 }
 
++ (NSArray<CBUUID*>*) suotaCharacteristicUuids {
+    return suotaCharacteristicUuids;
+}
+
++ (NSArray<CBUUID*>*) discoveryServiceUuids {
+    return discoveryServiceUuids;
+}
+
 - (instancetype) init {
     self = [super init];
     if (!self)
@@ -66,10 +129,20 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 
     self.state = DEVICE_DISCONNECTED;
     self.bluetoothManager = SuotaBluetoothManager.instance;
+    dispatcher = [[SuotaDelegateDispatcher alloc] initWithProtocol:@protocol(SuotaManagerDelegate) target:nil queue:dispatch_get_main_queue()];
+    if (SuotaLibConfig.PROTOCOL_QUEUE) {
+        self.protocolQueue = dispatch_queue_create("SuotaManager", DISPATCH_QUEUE_SERIAL);
+        dispatch_queue_set_specific(self.protocolQueue, &protocolQueueKey, (__bridge void*)self.protocolQueue, NULL);
+    } else {
+        self.protocolQueue = dispatch_get_main_queue();
+    }
+    if (SuotaLibConfig.NOTIFICATION_RATE > 0)
+        self.notificationCoalescer = [[SuotaNotificationCoalescer alloc] initWithDelegate:self.delegateDispatcher queue:self.protocolQueue rate:SuotaLibConfig.NOTIFICATION_RATE];
+    self.gattScheduler = [[SuotaGattScheduler alloc] initWithDelegate:self queue:self.protocolQueue window:SuotaLibConfig.GATT_WINDOW timeout:SuotaLibConfig.GATT_OPERATION_TIMEOUT / 1000.];
     
     // SUOTA configuration
     self.blockSize = SuotaLibConfig.DEFAULT_BLOCK_SIZE;
-    self.chunkSize = SuotaLibConfig.DEFAULT_CHUNK_SIZE;
+    _chunkSize = SuotaLibConfig.DEFAULT_CHUNK_SIZE;
     self.imageBank = SuotaLibConfig.DEFAULT_IMAGE_BANK;
     self.memoryType = SuotaLibConfig.DEFAULT_MEMORY_TYPE;
     // SPI
@@ -88,7 +161,9 @@ static NSArray<CBUUID*>* deviceInfoUuids;
     self.suotaInfoMap = [NSMutableDictionary dictionary];
     self.deviceInfoMap = [NSMutableDictionary dictionary];
     
-    self.sendChunkOperationArray = [NSMutableArray array];
+    self.sendChunkQueue = [[SuotaRingBuffer alloc] initWithCapacity:self.blockSize / self.chunkSize];
+    atomic_init(&sendChunkOperationPending, false);
+    atomic_init(&awaitingWriteReady, false);
     
     [NSNotificationCenter.defaultCenter addObserver:self selector:@selector(onBluetoothUpdatedState:) name:SuotaBluetoothManagerUpdatedState object:self.bluetoothManager];
     [NSNotificationCenter.defaultCenter addObserver:self selector:@selector(onDeviceDisconnection:) name:SuotaBluetoothManagerConnectionFailed object:self.bluetoothManager];
@@ -109,6 +184,39 @@ static NSArray<CBUUID*>* deviceInfoUuids;
     return self;
 }
 
+- (id<SuotaManagerDelegate>) suotaManagerDelegate {
+    return dispatcher.target;
+}
+
+- (void) setSuotaManagerDelegate:(id<SuotaManagerDelegate>)suotaManagerDelegate {
+    dispatcher.target = suotaManagerDelegate;
+}
+
+- (dispatch_queue_t) delegateQueue {
+    return dispatcher.queue;
+}
+
+- (void) setDelegateQueue:(dispatch_queue_t)delegateQueue {
+    dispatcher.queue = delegateQueue ? delegateQueue : dispatch_get_main_queue();
+}
+
+- (id<SuotaManagerDelegate>) delegateDispatcher {
+    return (id<SuotaManagerDelegate>)dispatcher;
+}
+
+- (BOOL) isOnProtocolQueue {
+    if (self.protocolQueue == dispatch_get_main_queue())
+        return NSThread.isMainThread;
+    return dispatch_get_specific(&protocolQueueKey) == (__bridge void*)self.protocolQueue;
+}
+
+- (void) runOnProtocolQueue:(dispatch_block_t)block {
+    if (self.isOnProtocolQueue)
+        block();
+    else
+        dispatch_async(self.protocolQueue, block);
+}
+
 - (void) setSuotaFile:(SuotaFile*)suotaFile {
     _suotaFile = suotaFile;
     suotaFile.blockSize = self.blockSize;
@@ -274,6 +382,12 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 }
 
 - (void) readDeviceInfo {
+    if (!self.isOnProtocolQueue) {
+        dispatch_async(self.protocolQueue, ^{
+            [self readDeviceInfo];
+        });
+        return;
+    }
     if (!self.peripheral || self.state != DEVICE_CONNECTED) {
         [self notifyFailure:NOT_CONNECTED];
         return;
@@ -283,6 +397,12 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 }
 
 - (void) connect {
+    if (!self.isOnProtocolQueue) {
+        dispatch_async(self.protocolQueue, ^{
+            [self connect];
+        });
+        return;
+    }
     if (!self.peripheral) {
         SuotaLog(TAG, @"There isn't a CBPeripheral object to connect to");
         return;
@@ -310,7 +430,7 @@ static NSArray<CBUUID*>* deviceInfoUuids;
         return;
 
     self.suotaProtocol = [[SuotaProtocol alloc] initWithManager:self];
-    [self.suotaFile initBlocks:self.blockSize chunkSize:self.chunkSize];
+    [self initBlocks];
 }
 
 - (void) initializeSuota:(int)blockSize misoGpio:(int)misoGpio mosiGpio:(int)mosiGpio csGpio:(int)csGpio sckGpio:(int)sckGpio imageBank:(int)imageBank {
@@ -319,7 +439,7 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 
     self.suotaProtocol = [[SuotaProtocol alloc] initWithManager:self];
     self.blockSize = blockSize;
-    [self.suotaFile initBlocks:blockSize chunkSize:self.chunkSize];
+    [self initBlocks];
     self.memoryType = MEMORY_TYPE_EXTERNAL_SPI;
     self.misoGpio = misoGpio;
     self.mosiGpio = mosiGpio;
@@ -334,7 +454,7 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 
     self.suotaProtocol = [[SuotaProtocol alloc] initWithManager:self];
     self.blockSize = blockSize;
-    [self.suotaFile initBlocks:blockSize chunkSize:self.chunkSize];
+    [self initBlocks];
     self.memoryType = MEMORY_TYPE_EXTERNAL_I2C;
     self.i2cDeviceAddress = i2cAddress;
     self.sclGpio = sclGpio;
@@ -353,6 +473,12 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 }
 
 - (void) startUpdate {
+    if (!self.isOnProtocolQueue) {
+        dispatch_async(self.protocolQueue, ^{
+            [self startUpdate];
+        });
+        return;
+    }
     if (!self.peripheral || self.state != DEVICE_CONNECTED) {
         SuotaLog(TAG, @"Make sure to connect before trying to start update");
         [self notifyFailure:NOT_CONNECTED];
@@ -361,21 +487,106 @@ static NSArray<CBUUID*>* deviceInfoUuids;
     
     if (!self.suotaProtocol)
         [self initializeSuota];
-    if (self.suotaProtocol.isRunning) {
+    if (self.suotaProtocol.isRunning || pendingStart) {
         SuotaLog(TAG, @"Previous SUOTA is still running");
         return;
     }
-    
+
+    if ([self readRevisionsBeforeUpdate])
+        return;
+    revisionsRead = false;
+    if ([self isFirmwareCurrent]) {
+        SuotaLog(TAG, @"Device firmware is current, skipping update");
+        [self.delegateDispatcher onFirmwareCurrent:self.suotaFile];
+        return;
+    }
+
+    // The protocol is started when the L2CAP channel opens, or fails to open
+    if (self.shouldUseL2capChannel && !self.l2capChannel.isOpen) {
+        pendingStart = true;
+        if (!self.l2capChannel)
+            self.l2capChannel = [[SuotaL2capChannel alloc] initWithPeripheral:self.peripheral psm:(CBL2CAPPSM)self.l2capPsm queue:self.protocolQueue delegate:self];
+        [self.l2capChannel open];
+        return;
+    }
+
+    SuotaLog(TAG, @"Image data transport: %@", self.l2capChannel.isOpen ? @"L2CAP" : @"GATT");
     [self.suotaProtocol start];
 }
 
+// The policy is ignored if the delegate can not receive the result
+- (BOOL) shouldCheckFirmwareCurrent {
+    return self.updatePolicy && self.suotaFile && [self.suotaManagerDelegate respondsToSelector:@selector(onFirmwareCurrent:)];
+}
+
+// The cached revisions may be older than the running firmware, for example if it was updated by another app,
+// so they are read from the device before each update that checks them. The update starts after the reads.
+- (BOOL) readRevisionsBeforeUpdate {
+    if (revisionsRead || !self.shouldCheckFirmwareCurrent)
+        return false;
+    if ([self.gattScheduler isGroupPending:REVISION_READ_GROUP])
+        return true;
+
+    NSMutableArray<GattOperation*>* gattOperations = [NSMutableArray array];
+    if (self.firmwareRevisionCharacteristic)
+        [gattOperations addObject:[[GattOperation alloc] initWithCharacteristic:self.firmwareRevisionCharacteristic]];
+    if (self.softwareRevisionCharacteristic)
+        [gattOperations addObject:[[GattOperation alloc] initWithCharacteristic:self.softwareRevisionCharacteristic]];
+    // Cleared, so that cached values are never compared. If a read fails, the update is not started.
+    self.firmwareRevision = nil;
+    self.softwareRevision = nil;
+    if (!gattOperations.count)
+        return false;
+
+    SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Read revisions before update");
+    __weak SuotaManager* weakSelf = self;
+    [self.gattScheduler enqueueGroup:gattOperations name:REVISION_READ_GROUP completion:^{
+        SuotaManager* manager = weakSelf;
+        if (!manager || manager.state != DEVICE_CONNECTED)
+            return;
+        manager->revisionsRead = true;
+        [manager startUpdate];
+    }];
+    return true;
+}
+
+- (BOOL) isFirmwareCurrent {
+    if (!self.shouldCheckFirmwareCurrent)
+        return false;
+    // If the header can't be parsed, for example from an image shorter than its header, the device is not current
+    if (!self.suotaFile.hasHeaderInfo && self.suotaFile.isLoaded) {
+        NSData* firmware = self.suotaFile.data;
+        NSUInteger headerLength = MIN(firmware.length, (NSUInteger)(HeaderInfo.SIGNATURE_LENGTH + HeaderInfoBuilder.maxHeaderSize));
+        self.suotaFile.headerInfo = [HeaderInfoBuilder headerWithHeader:[firmware subdataWithRange:NSMakeRange(0, headerLength)] totalBytes:firmware.length];
+    }
+    return [self.updatePolicy isFirmwareCurrent:self.suotaFile.headerInfo firmwareRevision:self.firmwareRevision softwareRevision:self.softwareRevision];
+}
+
+- (BOOL) shouldUseL2capChannel {
+    return SuotaLibConfig.L2CAP_TRANSPORT && self.l2capPsm > 0 && !l2capChannelFailed;
+}
+
+- (void) closeL2capChannel {
+    pendingStart = false;
+    if (self.l2capChannel) {
+        [self.l2capChannel close];
+        self.l2capChannel = nil;
+    }
+}
+
 - (void) disconnect {
+    if (!self.isOnProtocolQueue) {
+        dispatch_async(self.protocolQueue, ^{
+            [self disconnect];
+        });
+        return;
+    }
     @synchronized (self) {
         if (!self.peripheral || self.state == DEVICE_DISCONNECTED)
             return;
 
-        self.sendChunkOperationPending = false;
-        [self.sendChunkOperationArray removeAllObjects];
+        [self clearSendChunkQueue];
+        [self closeL2capChannel];
         SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Disconnecting from device");
         [self.bluetoothManager disconnectPeripheral:self.peripheral];
         if (self.suotaProtocol)
@@ -384,14 +595,21 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 }
 
 - (void) destroy {
+    if (!self.isOnProtocolQueue) {
+        dispatch_async(self.protocolQueue, ^{
+            [self destroy];
+        });
+        return;
+    }
     @synchronized (self) {
         SuotaLog(TAG, @"Destroy");
         if (self.state != DEVICE_DISCONNECTED) {
             [self disconnect];
         }
 
-        self.sendChunkOperationPending = false;
-        [self.sendChunkOperationArray removeAllObjects];
+        [self clearSendChunkQueue];
+        [self closeL2capChannel];
+        [self.gattScheduler reset];
         self.suotaProtocol = nil;
     }
 }
@@ -421,6 +639,8 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 
 - (void) close {
     SuotaLog(TAG, @"Close");
+    [self closeL2capChannel];
+    [self.gattScheduler reset];
     if (self.suotaProtocol) {
         [self.suotaProtocol destroy];
         self.suotaProtocol = nil;
@@ -429,40 +649,95 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 }
 
 - (void) enqueueSendChunkOperation:(SendChunkOperation*)sendChunkOperation {
-    @synchronized (self) {
-        [self.sendChunkOperationArray addObject:sendChunkOperation];
-        if (!self.sendChunkOperationPending)
+    if (self.l2capChannel.isOpen) {
+        [self.l2capChannel sendChunk:sendChunkOperation];
+        return;
+    }
+    if (![self.sendChunkQueue push:sendChunkOperation]) {
+        SuotaLog(TAG, @"Send chunk queue is full");
+        [self.suotaProtocol suotaProtocolError];
+        return;
+    }
+    if (!atomic_exchange(&sendChunkOperationPending, true)) {
+        dispatch_async(self.bluetoothManager.bleQueue, ^{
             [self dequeueSendChunkOperation];
+        });
     }
 }
 
+// Runs on the Bluetooth queue, called by the owner of the send queue. On iOS 11 and later, if the controller
+// buffers are full, ownership is kept and passed to the peripheralIsReadyToSendWriteWithoutResponse: callback.
+// If batching is enabled, chunks are written while canSendWriteWithoutResponse is true, so that several chunks
+// are sent in the same connection event. Only the writes happen here, the protocol is notified on its own queue.
 - (void) dequeueSendChunkOperation {
-    @synchronized (self) {
-        self.sendChunkOperationPending = false;
-        if (self.sendChunkOperationArray.count) {
-            self.sendChunkOperationPending = true;
-            [self executeOperation:self.sendChunkOperationArray[0]];
-            [self.sendChunkOperationArray removeObjectAtIndex:0];
-            if (UIDevice.currentDevice.systemVersion.floatValue < 11.0) {
-                if (SuotaLibConfig.NOTIFY_CHUNK_SEND)
-                    [self.suotaProtocol notifyChunkSend];
-                [self dequeueSendChunkOperation];
+    NSMutableArray<SendChunkOperation*>* written = [NSMutableArray array];
+    while (true) {
+        SendChunkOperation* sendChunkOperation = [self.sendChunkQueue pop];
+        if (sendChunkOperation) {
+            [sendChunkOperation write:self.peripheral];
+            [written addObject:sendChunkOperation];
+            if (writeWithoutResponseFlowControl && !(SuotaLibConfig.BATCH_WRITES && self.peripheral.canSendWriteWithoutResponse)) {
+                [self onChunksWritten:written awaitingWriteReady:true];
+                atomic_store(&awaitingWriteReady, true);
+                return;
             }
+            continue;
         }
+
+        if (written.count) {
+            [self onChunksWritten:written awaitingWriteReady:false];
+            written = [NSMutableArray array];
+        }
+        atomic_store(&sendChunkOperationPending, false);
+        // A chunk may have been queued after the queue was found empty
+        if (self.sendChunkQueue.isEmpty || atomic_exchange(&sendChunkOperationPending, true))
+            return;
     }
 }
 
+// Called on the Bluetooth queue with the chunks written on one write readiness callback. If the writer waits for
+// the next callback, the last chunk send is reported by it, as the write callback of a write with response would.
+- (void) onChunksWritten:(NSArray<SendChunkOperation*>*)chunks awaitingWriteReady:(BOOL)awaiting {
+    dispatch_async(self.protocolQueue, ^{
+        SuotaProtocol* protocol = self.suotaProtocol;
+        if (!protocol.isRunning || chunks.firstObject.suotaProtocol != protocol)
+            return;
+        [protocol.statistics updateWriteBatch:(int)chunks.count];
+        for (SendChunkOperation* chunk in chunks) {
+            [protocol notifyForSendingChunk:chunk];
+            if (SuotaLibConfig.NOTIFY_CHUNK_SEND && !(awaiting && chunk == chunks.lastObject))
+                [protocol notifyChunkSend];
+        }
+    });
+}
+
+// The queue is replaced instead of drained, so that it is never accessed by two consumers
+- (void) clearSendChunkQueue {
+    self.sendChunkQueue = [[SuotaRingBuffer alloc] initWithCapacity:self.sendChunkQueue.capacity];
+    atomic_store(&awaitingWriteReady, false);
+    atomic_store(&sendChunkOperationPending, false);
+}
+
 - (void) executeOperation:(GattOperation*)gattOperation {
+    [self runOnProtocolQueue:^{
+        [self.gattScheduler enqueue:gattOperation];
+    }];
+}
+
+// Sends the operation to the peripheral. Chunks are sent directly by the chunk writer, everything else by the scheduler.
+- (BOOL) sendOperation:(GattOperation*)gattOperation {
     if (!self.peripheral || self.state != DEVICE_CONNECTED) {
         [self notifyFailure:NOT_CONNECTED];
-        return;
+        return false;
     }
 
     if (gattOperation.type == REBOOT_COMMAND) {
         self.rebootSent = true;
-        [self.suotaManagerDelegate onRebootSent];
+        [self invalidateCachedRevision];
+        [self.delegateDispatcher onRebootSent];
     }
     [gattOperation execute:self.peripheral];
+    return true;
 }
 
 - (void) executeOperationArray:(NSArray<GattOperation*>*)gattOperationArray {
@@ -470,11 +745,37 @@ static NSArray<CBUUID*>* deviceInfoUuids;
         [self executeOperation:operation];
 }
 
+#pragma mark - SuotaGattSchedulerDelegate
+
+- (BOOL) executeScheduledOperation:(GattOperation*)operation {
+    return [self sendOperation:operation];
+}
+
+- (void) onScheduledOperationTimeout:(GattOperation*)operation {
+    // The device may reboot before it responds to the reboot command
+    if (self.rebootSent)
+        return;
+    SuotaLog(TAG, @"GATT operation timeout: %@", self.gattScheduler);
+    // Stop the protocol, so that a late response doesn't continue the update after the failure
+    if (self.suotaProtocol.isRunning) {
+        [self.suotaProtocol onError:GATT_OPERATION_TIMEOUT];
+        return;
+    }
+    [self notifyFailure:GATT_OPERATION_TIMEOUT];
+    [self destroy];
+}
+
+#pragma mark -
+
 - (void) onSuotaProtocolSuccess {
     double elapsedTime = self.suotaProtocol ? self.suotaProtocol.elapsedTime / 1000.0 : -1;
     double uploadElapsedTime = self.suotaProtocol ? self.suotaProtocol.uploadElapsedTime / 1000.0 : -1;
-    [self.suotaManagerDelegate onSuccess:elapsedTime imageUploadElapsedSeconds:uploadElapsedTime];
+    [self.notificationCoalescer flush];
+    [self invalidateCachedRevision];
+    SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"GATT operations: %@", self.gattScheduler);
+    [self.delegateDispatcher onSuccess:elapsedTime imageUploadElapsedSeconds:uploadElapsedTime];
     
+    [self closeL2capChannel];
     if (SuotaLibConfig.AUTO_REBOOT) {
         [self sendRebootCommand];
     } else if (SuotaLibConfig.ALLOW_DIALOG_DISPLAY) {
@@ -486,7 +787,7 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 }
 
 - (void) onServicesDiscovered:(NSArray<CBService*>*)services {
-    [self.suotaManagerDelegate onServicesDiscovered];
+    [self.delegateDispatcher onServicesDiscovered];
     NSUInteger index = [services indexOfObjectPassingTest:^BOOL (CBService* service, NSUInteger index, BOOL* stop){
         return *stop = [service.UUID isEqual:SuotaProfile.SUOTA_SERVICE_UUID];
     }];
@@ -498,10 +799,10 @@ static NSArray<CBUUID*>* deviceInfoUuids;
         for (CBService* service in services) {
             if ([service.UUID isEqual:SuotaProfile.SUOTA_SERVICE_UUID]) {
                 self.suotaService = service;
-                [self.peripheral discoverCharacteristics:nil forService:service];
+                [self.peripheral discoverCharacteristics:SuotaLibConfig.TARGETED_DISCOVERY ? suotaCharacteristicUuids : nil forService:service];
             } else if ([service.UUID isEqual:SuotaProfile.SERVICE_DEVICE_INFORMATION]) {
                 self.deviceInfoService = service;
-                [self.peripheral discoverCharacteristics:nil forService:service];
+                [self.peripheral discoverCharacteristics:SuotaLibConfig.TARGETED_DISCOVERY ? deviceInfoUuids : nil forService:service];
             }
         }
     }
@@ -529,6 +830,8 @@ static NSArray<CBUUID*>* deviceInfoUuids;
         SuotaLog(TAG, @"The device does not support Service Status Characteristic Configuration Client Descriptor");
         [self notifyFailure:SUOTA_NOT_SUPPORTED];
     } else {
+        self.discoveryTime = NSProcessInfo.processInfo.systemUptime - self.discoveryStartTime;
+        SuotaLog(TAG, @"Discovery completed in %.3f seconds", self.discoveryTime);
         [self queueReadInfoOperations];
     }
 }
@@ -538,8 +841,10 @@ static NSArray<CBUUID*>* deviceInfoUuids;
         [self onSuotaInfoRead:characteristic];
     } else if ([deviceInfoUuids containsObject:characteristic.UUID]) {
         [self onDeviceInfoRead:characteristic];
+    } else if ([characteristic.UUID isEqual:SuotaProfile.SUOTA_MEM_INFO_UUID] && self.suotaProtocol.isRunning) {
+        [self.suotaProtocol onMemoryInfoRead:characteristic.value];
     } else {
-        [self.suotaManagerDelegate onCharacteristicRead:OTHER characteristic:characteristic];
+        [self.delegateDispatcher onCharacteristicRead:OTHER characteristic:characteristic];
     }
 }
 
@@ -631,12 +936,10 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 }
 
 - (void) reset {
-    self.sendChunkOperationPending = false;
-    [self.sendChunkOperationArray removeAllObjects];
+    [self clearSendChunkQueue];
+    [self.gattScheduler reset];
     self.suotaInfoMap = [NSMutableDictionary dictionary];
-    self.totalSuotaInfo = 0;
     self.deviceInfoMap = [NSMutableDictionary dictionary];
-    self.totalDeviceInfo = 0;
     
     self.suotaService = nil;
     self.memDevCharacteristic = nil;
@@ -665,12 +968,14 @@ static NSArray<CBUUID*>* deviceInfoUuids;
     self.suotaVersion = -1;
     self.mtu = SuotaProfile.DEFAULT_MTU;
     self.patchDataSize = SuotaLibConfig.DEFAULT_CHUNK_SIZE;
-    self.chunkSize = SuotaLibConfig.DEFAULT_CHUNK_SIZE;
+    if (!chunkSizeSet)
+        _chunkSize = SuotaLibConfig.DEFAULT_CHUNK_SIZE;
     self.l2capPsm = -1;
     self.suotaVersionRead = false;
     self.patchDataSizeRead = false;
     self.mtuRead = false;
     self.l2capPsmRead = false;
+    revisionsRead = false;
     
     self.manufacturerName = nil;
     self.modelNumber = nil;
@@ -683,8 +988,7 @@ static NSArray<CBUUID*>* deviceInfoUuids;
     self.pnpId = nil;
     
     self.rebootSent = false;
-    self.isDeviceInfoReadGroupPending = false;
-    self.isSuotaInfoReadGroupPending = false;
+    l2capChannelFailed = false;
 }
 
 - (BOOL) handleSuotaRunningOnNewConnectRequest {
@@ -699,86 +1003,70 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 }
 
 - (void) notifyFailure:(int)value {
-    dispatch_async(dispatch_get_main_queue(), ^{
-        [self.suotaManagerDelegate onFailure:value];
+    dispatch_async(self.protocolQueue, ^{
+        [self.notificationCoalescer flush];
+        [self.delegateDispatcher onFailure:value];
     });
 }
 
 - (void) onDeviceInfoRead:(CBCharacteristic*)characteristic {
     if (SuotaLibConfig.NOTIFY_DEVICE_INFO_READ)
-        [self.suotaManagerDelegate onCharacteristicRead:DEVICE_INFO characteristic:characteristic];
-    
-    [self assignDeviceInfo:characteristic];
-    
-    if (!self.isDeviceInfoReadGroupPending)
-        return;
+        [self.delegateDispatcher onCharacteristicRead:DEVICE_INFO characteristic:characteristic];
     
+    [self assignDeviceInfo:characteristic.UUID value:characteristic.value];
+    [self cacheValue:characteristic];
     self.deviceInfoMap[characteristic.UUID] = characteristic;
-    
-    if (self.totalDeviceInfo == self.deviceInfoMap.count) {
-        self.isDeviceInfoReadGroupPending = false;
-        if (SuotaLibConfig.NOTIFY_DEVICE_INFO_READ_COMPLETED)
-            [self.suotaManagerDelegate onDeviceInfoReadCompleted:SUCCESS];
-    }
 }
 
-- (void) assignDeviceInfo:(CBCharacteristic*)characteristic {
-    CBUUID* uuid = characteristic.UUID;
+- (void) assignDeviceInfo:(CBUUID*)uuid value:(NSData*)value {
     if ([uuid isEqual:SuotaProfile.CHARACTERISTIC_MANUFACTURER_NAME_STRING]) {
-        self.manufacturerName = [[NSString alloc] initWithData:characteristic.value encoding:NSUTF8StringEncoding];
+        self.manufacturerName = [[NSString alloc] initWithData:value encoding:NSUTF8StringEncoding];
     } else if ([uuid isEqual:SuotaProfile.CHARACTERISTIC_MODEL_NUMBER_STRING]) {
-        self.modelNumber = [[NSString alloc] initWithData:characteristic.value encoding:NSUTF8StringEncoding];
+        self.modelNumber = [[NSString alloc] initWithData:value encoding:NSUTF8StringEncoding];
     } else if ([uuid isEqual:SuotaProfile.CHARACTERISTIC_SERIAL_NUMBER_STRING]) {
-        self.serialNumber = [[NSString alloc] initWithData:characteristic.value encoding:NSUTF8StringEncoding];
+        self.serialNumber = [[NSString alloc] initWithData:value encoding:NSUTF8StringEncoding];
     } else if ([uuid isEqual:SuotaProfile.CHARACTERISTIC_HARDWARE_REVISION_STRING]) {
-        self.hardwareRevision = [[NSString alloc] initWithData:characteristic.value encoding:NSUTF8StringEncoding];
+        self.hardwareRevision = [[NSString alloc] initWithData:value encoding:NSUTF8StringEncoding];
     } else if ([uuid isEqual:SuotaProfile.CHARACTERISTIC_FIRMWARE_REVISION_STRING]) {
-        self.firmwareRevision = [[NSString alloc] initWithData:characteristic.value encoding:NSUTF8StringEncoding];
+        self.firmwareRevision = [[NSString alloc] initWithData:value encoding:NSUTF8StringEncoding];
     } else if ([uuid isEqual:SuotaProfile.CHARACTERISTIC_SOFTWARE_REVISION_STRING]) {
-        self.softwareRevision = [[NSString alloc] initWithData:characteristic.value encoding:NSUTF8StringEncoding];
+        self.softwareRevision = [[NSString alloc] initWithData:value encoding:NSUTF8StringEncoding];
     } else if ([uuid isEqual:SuotaProfile.CHARACTERISTIC_SYSTEM_ID]) {
-        self.systemId = characteristic.value;
+        self.systemId = value;
     } else if ([uuid isEqual:SuotaProfile.CHARACTERISTIC_IEEE_11073]) {
-        self.ieee11073 = characteristic.value;
+        self.ieee11073 = value;
     } else if ([uuid isEqual:SuotaProfile.CHARACTERISTIC_PNP_ID]) {
-        self.pnpId = characteristic.value;
+        self.pnpId = value;
     }
 }
 
 - (void) onSuotaInfoRead:(CBCharacteristic*)characteristic {
-    [self.suotaManagerDelegate onCharacteristicRead:SUOTA_INFO characteristic:characteristic];
-    [self onSuotaReadUpdate:characteristic];
-
-    if (!self.isSuotaInfoReadGroupPending)
-        return;
-    
+    [self.delegateDispatcher onCharacteristicRead:SUOTA_INFO characteristic:characteristic];
+    [self onSuotaReadUpdate:characteristic.UUID value:characteristic.value];
+    [self cacheValue:characteristic];
     self.suotaInfoMap[characteristic.UUID] = characteristic;
-    if (self.totalSuotaInfo == self.suotaInfoMap.count) {
-        self.isSuotaInfoReadGroupPending = false;
-        [self.suotaManagerDelegate onDeviceReady];
-    }
 }
 
-- (void) onSuotaReadUpdate:(CBCharacteristic*)characteristic {
-    const uint8_t* value = characteristic.value.bytes;
+- (void) onSuotaReadUpdate:(CBUUID*)uuid value:(NSData*)data {
+    const uint8_t* value = data.bytes;
     if (!value)
         return;
     
-    if ([characteristic.UUID isEqual:SuotaProfile.SUOTA_VERSION_UUID]) {
+    if ([uuid isEqual:SuotaProfile.SUOTA_VERSION_UUID]) {
         self.suotaVersionRead = true;
         self.suotaVersion = *(uint32_t*)value;
         SuotaLog(TAG, @"SUOTA version: %d", self.suotaVersion);
-    } else if ([characteristic.UUID isEqual:SuotaProfile.SUOTA_PATCH_DATA_CHAR_SIZE_UUID]) {
+    } else if ([uuid isEqual:SuotaProfile.SUOTA_PATCH_DATA_CHAR_SIZE_UUID]) {
         self.patchDataSizeRead = true;
         self.patchDataSize = *(uint32_t*)value;
         SuotaLog(TAG, @"Patch data size: %d", self.patchDataSize);
         [self updateChunkSize];
-    } else if ([characteristic.UUID isEqual:SuotaProfile.SUOTA_MTU_UUID]) {
+    } else if ([uuid isEqual:SuotaProfile.SUOTA_MTU_UUID]) {
         self.mtuRead = true;
         self.mtu = *(uint32_t*)value;
         SuotaLog(TAG, @"MTU: %d", self.mtu);
         [self updateChunkSize];
-    } else if ([characteristic.UUID isEqual:SuotaProfile.SUOTA_L2CAP_PSM_UUID]) {
+    } else if ([uuid isEqual:SuotaProfile.SUOTA_L2CAP_PSM_UUID]) {
         self.l2capPsmRead = true;
         self.l2capPsm = *(uint32_t*)value;
         SuotaLog(TAG, @"L2CAP PSM: %d", self.l2capPsm);
@@ -786,6 +1074,12 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 }
 
 - (void) showRebootPromptDialog {
+    if (!NSThread.isMainThread) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            [self showRebootPromptDialog];
+        });
+        return;
+    }
     if (!self.suotaViewController)
         return;
 
@@ -793,7 +1087,9 @@ static NSArray<CBUUID*>* deviceInfoUuids;
                                                                               message:@"Reboot device?"
                                                                        preferredStyle:UIAlertControllerStyleAlert];
     [rebootController addAction:[UIAlertAction actionWithTitle:@"OK" style:UIAlertActionStyleDefault handler:^(UIAlertAction* action) {
-        [self sendRebootCommand];
+        [self runOnProtocolQueue:^{
+            [self sendRebootCommand];
+        }];
     }]];
     [rebootController addAction:[UIAlertAction actionWithTitle:@"Cancel" style:UIAlertActionStyleDefault handler:^(UIAlertAction* action) {
         if (SuotaLibConfig.AUTO_DISCONNECT_IF_REBOOT_DENIED)
@@ -811,11 +1107,41 @@ static NSArray<CBUUID*>* deviceInfoUuids;
             && self.serviceStatusCharacteristic);
 }
 
+- (void) setChunkSize:(int)chunkSize {
+    _chunkSize = chunkSize;
+    chunkSizeSet = true;
+}
+
 - (void) updateChunkSize {
-    self.chunkSize = MIN(self.patchDataSize, self.mtu - 3);
+    if (chunkSizeSet) {
+        SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Chunk size %d set by the caller", self.chunkSize);
+        return;
+    }
+    int chunkSize = MIN(self.patchDataSize, self.mtu - 3);
+    // The MTU characteristic reports the device side value. Use the limit negotiated by iOS, if it is lower.
+    if (SuotaLibConfig.AUTO_CHUNK_SIZE && self.peripheral && self.peripheral.state == CBPeripheralStateConnected)
+        chunkSize = MIN(chunkSize, (int)[self.peripheral maximumWriteValueLengthForType:CBCharacteristicWriteWithoutResponse]);
+    _chunkSize = MAX(chunkSize, 1);
     SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Chunk size set to %d", self.chunkSize);
 }
 
+// The block size is used as the device limit. If the automatic chunk size is enabled, and the caller didn't set
+// the chunk size, the block size is rounded down to a multiple of the chunk size, so that every block is sent
+// with full size chunks.
+- (void) initBlocks {
+    int blockSize = self.blockSize;
+    int chunkSize = self.chunkSize;
+    if (SuotaLibConfig.AUTO_CHUNK_SIZE && !chunkSizeSet) {
+        [self updateChunkSize];
+        chunkSize = MIN(self.chunkSize, blockSize);
+        blockSize = blockSize / chunkSize * chunkSize;
+    }
+    [self.suotaFile initBlocks:blockSize chunkSize:chunkSize];
+    [self clearSendChunkQueue];
+    self.sendChunkQueue = [[SuotaRingBuffer alloc] initWithCapacity:MAX(self.suotaFile.chunksPerBlock, (blockSize + chunkSize - 1) / chunkSize)];
+    SuotaLog(TAG, @"Upload geometry: MTU %d, patch data size %d, chunk %d bytes, block %d bytes (%d chunks), %d blocks, %d chunks", self.mtu, self.patchDataSize, chunkSize, blockSize, self.suotaFile.chunksPerBlock, self.suotaFile.totalBlocks, self.suotaFile.totalChunks);
+}
+
 - (void) queueReadInfoOperations {
     if (SuotaLibConfig.AUTO_READ_DEVICE_INFO && SuotaLibConfig.READ_DEVICE_INFO_FIRST)
         [self queueReadDeviceInfo];
@@ -862,13 +1188,12 @@ static NSArray<CBUUID*>* deviceInfoUuids;
         [self notifyFailure:NOT_CONNECTED];
         return;
     }
-    if (self.isDeviceInfoReadGroupPending) {
+    if ([self.gattScheduler isGroupPending:DEVICE_INFO_READ_GROUP]) {
         SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Another device info read operation is pending");
         return;
     }
-    self.isDeviceInfoReadGroupPending = true;
     if (!self.deviceInfoService) {
-        [self.suotaManagerDelegate onDeviceInfoReadCompleted:NO_DEVICE_INFO];
+        [self.delegateDispatcher onDeviceInfoReadCompleted:NO_DEVICE_INFO];
         return;
     }
 
@@ -876,11 +1201,21 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 
     // If no device info available to read, trigger the onInfoReadCallback now
     if (!operationsToQueue.count) {
-        [self.suotaManagerDelegate onDeviceInfoReadCompleted:NO_DEVICE_INFO];
+        [self.delegateDispatcher onDeviceInfoReadCompleted:NO_DEVICE_INFO];
+        return;
+    }
+    operationsToQueue = [self applyCachedValues:operationsToQueue];
+    if (!operationsToQueue.count) {
+        SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Device info read from cache");
+        if (SuotaLibConfig.NOTIFY_DEVICE_INFO_READ_COMPLETED)
+            [self.delegateDispatcher onDeviceInfoReadCompleted:SUCCESS];
         return;
     }
-    self.totalDeviceInfo += (int)operationsToQueue.count;
-    [self executeOperationArray:operationsToQueue];
+    __weak SuotaManager* weakSelf = self;
+    [self.gattScheduler enqueueGroup:operationsToQueue name:DEVICE_INFO_READ_GROUP completion:^{
+        if (SuotaLibConfig.NOTIFY_DEVICE_INFO_READ_COMPLETED)
+            [weakSelf.delegateDispatcher onDeviceInfoReadCompleted:SUCCESS];
+    }];
 }
 
 - (NSArray<GattOperation*>*) suotaInfoReadOperations {
@@ -902,14 +1237,53 @@ static NSArray<CBUUID*>* deviceInfoUuids;
         return;
     }
 
-    self.isSuotaInfoReadGroupPending = true;
-    NSArray<GattOperation*>* operationsToQueue = self.suotaInfoReadOperations;
-    if (!operationsToQueue.count) {
-        [self.suotaManagerDelegate onDeviceReady];
+    if ([self.gattScheduler isGroupPending:SUOTA_INFO_READ_GROUP]) {
+        SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Another SUOTA info read operation is pending");
         return;
     }
-    self.totalSuotaInfo += (int)operationsToQueue.count;
-    [self executeOperationArray:operationsToQueue];
+    NSArray<GattOperation*>* operationsToQueue = [self applyCachedValues:self.suotaInfoReadOperations];
+    // An empty group completes immediately
+    __weak SuotaManager* weakSelf = self;
+    [self.gattScheduler enqueueGroup:operationsToQueue name:SUOTA_INFO_READ_GROUP completion:^{
+        [weakSelf.delegateDispatcher onDeviceReady];
+    }];
+}
+
+// Assigns the cached values of the read operations. Returns the operations of the values that are not cached.
+- (NSArray<GattOperation*>*) applyCachedValues:(NSArray<GattOperation*>*)operations {
+    if (!SuotaLibConfig.DEVICE_INFO_CACHE || !self.peripheral)
+        return operations;
+    NSDictionary<CBUUID*, NSData*>* cachedValues = [SuotaDeviceInfoCache.defaultCache valuesForPeripheral:self.peripheral.identifier];
+    if (!cachedValues.count)
+        return operations;
+
+    NSMutableArray<GattOperation*>* uncached = [NSMutableArray arrayWithCapacity:operations.count];
+    for (GattOperation* operation in operations) {
+        CBUUID* uuid = operation.characteristic.UUID;
+        NSData* value = uuid ? cachedValues[uuid] : nil;
+        if (!value) {
+            [uncached addObject:operation];
+        } else if ([suotaInfoUuids containsObject:uuid]) {
+            [self onSuotaReadUpdate:uuid value:value];
+        } else {
+            [self assignDeviceInfo:uuid value:value];
+        }
+    }
+    SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Cached values: %d, reads: %d", (int)(operations.count - uncached.count), (int)uncached.count);
+    return uncached;
+}
+
+- (void) cacheValue:(CBCharacteristic*)characteristic {
+    // The revision was invalidated when the reboot command was sent
+    if (!SuotaLibConfig.DEVICE_INFO_CACHE || !self.peripheral || self.rebootSent)
+        return;
+    [SuotaDeviceInfoCache.defaultCache storeValue:characteristic.value characteristic:characteristic.UUID peripheral:self.peripheral.identifier];
+}
+
+- (void) invalidateCachedRevision {
+    if (!SuotaLibConfig.DEVICE_INFO_CACHE || !self.peripheral)
+        return;
+    [SuotaDeviceInfoCache.defaultCache invalidateRevisionForPeripheral:self.peripheral.identifier];
 }
 
 - (void) sendRebootCommand {
@@ -926,38 +1300,85 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 
 - (void) onBluetoothUpdatedState:(NSNotification*)notification {
     NSNumber* state = notification.userInfo[@"state"];
-    if (state.intValue == CBCentralManagerStatePoweredOn && pendingConnection) {
-        pendingConnection = false;
-        [self connect];
-    }
+    [self runOnProtocolQueue:^{
+        if (state.intValue == CBCentralManagerStatePoweredOn && self->pendingConnection) {
+            self->pendingConnection = false;
+            [self connect];
+        }
+    }];
 }
 
 - (void) onDeviceConnected:(NSNotification*)notification {
     CBPeripheral* peripheral = notification.userInfo[@"peripheral"];
-    if (peripheral != self.peripheral)
-        return;
-    
-    peripheral.delegate = self;
-    [self.suotaManagerDelegate onConnectionStateChange:CONNECTED];
-    self.state = DEVICE_CONNECTED;
-    SuotaLog(TAG, @"Discover services");
-    [peripheral discoverServices:nil];
+    [self runOnProtocolQueue:^{
+        if (peripheral != self.peripheral)
+            return;
+
+        peripheral.delegate = self;
+        [self.delegateDispatcher onConnectionStateChange:CONNECTED];
+        self.state = DEVICE_CONNECTED;
+        SuotaLog(TAG, @"Discover services");
+        self.discoveryStartTime = NSProcessInfo.processInfo.systemUptime;
+        self.discoveryTime = 0;
+        [peripheral discoverServices:SuotaLibConfig.TARGETED_DISCOVERY ? discoveryServiceUuids : nil];
+    }];
 }
 
 - (void) onDeviceDisconnection:(NSNotification*)notification {
     CBPeripheral* peripheral = notification.userInfo[@"peripheral"];
-    if (peripheral != self.peripheral)
+    [self runOnProtocolQueue:^{
+        if (peripheral != self.peripheral)
+            return;
+
+        self.state = DEVICE_DISCONNECTED;
+        [self close];
+        [self.notificationCoalescer flush];
+        [self.delegateDispatcher onConnectionStateChange:DISCONNECTED];
+    }];
+}
+
+#pragma mark - SuotaL2capChannelDelegate
+
+- (void) onL2capChannelOpen:(SuotaL2capChannel*)channel {
+    if (!pendingStart)
         return;
-    
-    self.state = DEVICE_DISCONNECTED;
-    [self close];
-    [self.suotaManagerDelegate onConnectionStateChange:DISCONNECTED];
+    pendingStart = false;
+    SuotaLog(TAG, @"Image data transport: L2CAP");
+    [self.suotaProtocol start];
+}
+
+- (void) onL2capChannelFailure:(SuotaL2capChannel*)channel pendingChunks:(NSArray<SendChunkOperation*>*)pendingChunks {
+    SuotaLog(TAG, @"L2CAP channel failed, fallback to GATT");
+    l2capChannelFailed = true;
+    self.l2capChannel = nil;
+    if (pendingStart) {
+        pendingStart = false;
+        SuotaLog(TAG, @"Image data transport: GATT");
+        [self.suotaProtocol start];
+        return;
+    }
+    if (!self.suotaProtocol.isRunning)
+        return;
+    // Data buffered in the channel is lost, so the block is sent again over GATT, unless none of it was queued yet
+    SuotaProtocol* protocol = self.suotaProtocol;
+    if (pendingChunks.count || (protocol.lastChunk && protocol.lastChunk.block == protocol.currentBlock))
+        [protocol restartBlock];
+}
+
+- (void) onL2capChannel:(SuotaL2capChannel*)channel chunkSent:(SendChunkOperation*)chunk {
+    [self onCharacteristicWrite:self.patchDataCharacteristic];
 }
 
 #pragma mark - PeripheralDelegate
 
+- (void) peripheral:(CBPeripheral*)peripheral didOpenL2CAPChannel:(CBL2CAPChannel*)channel error:(NSError*)error {
+    dispatch_async(self.protocolQueue, ^{
+        [self.l2capChannel onChannelOpened:channel error:error];
+    });
+}
+
 - (void) peripheral:(CBPeripheral*)peripheral didDiscoverServices:(NSError*)error {
-    dispatch_async(dispatch_get_main_queue(), ^{
+    dispatch_async(self.protocolQueue, ^{
         if (error) {
             SuotaLog(TAG, @"Service discovery error: %@", error);
             [self notifyFailure:SERVICE_DISCOVERY_ERROR];
@@ -969,7 +1390,7 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 }
 
 - (void) peripheral:(CBPeripheral*)peripheral didDiscoverCharacteristicsForService:(CBService*)service error:(NSError*)error {
-    dispatch_async(dispatch_get_main_queue(), ^{
+    dispatch_async(self.protocolQueue, ^{
         if (error) {
             SuotaLog(TAG, @"Failed to read service: %@ characteristics, error: %@", service.UUID.UUIDString, error);
             [self notifyFailure:SERVICE_DISCOVERY_ERROR];
@@ -981,7 +1402,7 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 }
 
 - (void) peripheral:(CBPeripheral*)peripheral didDiscoverDescriptorsForCharacteristic:(CBCharacteristic*)characteristic error:(NSError*)error {
-    dispatch_async(dispatch_get_main_queue(), ^{
+    dispatch_async(self.protocolQueue, ^{
         if (error) {
             SuotaLog(TAG, @"Failed to read characteristic: %@ descriptors, error: %@", characteristic.UUID.UUIDString, error);
             [self notifyFailure:SERVICE_DISCOVERY_ERROR];
@@ -993,7 +1414,7 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 }
 
 - (void) peripheral:(CBPeripheral*)peripheral didUpdateValueForCharacteristic:(CBCharacteristic*)characteristic error:(NSError*)error {
-    dispatch_async(dispatch_get_main_queue(), ^{
+    dispatch_async(self.protocolQueue, ^{
         // Considering that SUOTA_SERV_STATUS characteristic is used only for notification reception and not value reading
         if ([characteristic.UUID isEqual:SuotaProfile.SUOTA_SERV_STATUS_UUID]) {
             [self onCharacteristicChanged:characteristic];
@@ -1005,6 +1426,7 @@ static NSArray<CBUUID*>* deviceInfoUuids;
                 SuotaLogOpt(SuotaLibLog.GATT_OPERATION, TAG, @"didUpdateValueForCharacteristic: %@ %@", characteristic.UUID, [SuotaUtils hexArray:characteristic.value]);
                 [self onCharacteristicRead:characteristic];
             }
+            [self.gattScheduler completeOperation:READ characteristic:characteristic error:error];
         }
     });
 }
@@ -1012,13 +1434,17 @@ static NSArray<CBUUID*>* deviceInfoUuids;
 - (void) peripheralIsReadyToSendWriteWithoutResponse:(CBPeripheral*)peripheral {
     SuotaLogOpt(SuotaLibLog.GATT_OPERATION, TAG, @"peripheralIsReadyToSendWriteWithoutResponse");
     // Assuming that only the patchDataCharacteristic is used for writing without response.
-    [self onCharacteristicWrite:self.patchDataCharacteristic];
+    if (!atomic_exchange(&awaitingWriteReady, false))
+        return;
+    dispatch_async(self.protocolQueue, ^{
+        [self onCharacteristicWrite:self.patchDataCharacteristic];
+    });
     [self dequeueSendChunkOperation];
 }
 
 - (void) peripheral:(CBPeripheral*)peripheral didWriteValueForCharacteristic:(CBCharacteristic*)characteristic error:(NSError*)error {
-    dispatch_async(dispatch_get_main_queue(), ^{
-        if (UIDevice.currentDevice.systemVersion.floatValue < 11.0 && [characteristic.UUID isEqual:SuotaProfile.SUOTA_PATCH_DATA_UUID])
+    dispatch_async(self.protocolQueue, ^{
+        if (!writeWithoutResponseFlowControl && [characteristic.UUID isEqual:SuotaProfile.SUOTA_PATCH_DATA_UUID])
             return;
 
         if (error) {
@@ -1029,11 +1455,12 @@ static NSArray<CBUUID*>* deviceInfoUuids;
             SuotaLogOpt(SuotaLibLog.GATT_OPERATION, TAG, @"didWriteValueForCharacteristic: %@", characteristic.UUID);
             [self onCharacteristicWrite:characteristic];
         }
+        [self.gattScheduler completeOperation:WRITE characteristic:characteristic error:error];
     });
 }
 
 - (void) peripheral:(CBPeripheral*)peripheral didUpdateNotificationStateForCharacteristic:(CBCharacteristic*)characteristic error:(NSError*)error {
-    dispatch_async(dispatch_get_main_queue(), ^{
+    dispatch_async(self.protocolQueue, ^{
         if (error) {
             SuotaLog(TAG, @"Failed to update notification state for characteristic: %@, error: %@", characteristic.UUID, error);
             [self notifyFailure:GATT_OPERATION_ERROR];
@@ -1041,6 +1468,19 @@ static NSArray<CBUUID*>* deviceInfoUuids;
             SuotaLogOpt(SuotaLibLog.GATT_OPERATION, TAG, @"didUpdateNotificationStateForCharacteristic: %@", characteristic.UUID);
             [self onDescriptorWrite:characteristic];
         }
+        [self.gattScheduler completeOperation:SET_NOTIFICATION_STATUS characteristic:characteristic error:error];
+    });
+}
+
+- (void) peripheral:(CBPeripheral*)peripheral didWriteValueForDescriptor:(CBDescriptor*)descriptor error:(NSError*)error {
+    dispatch_async(self.protocolQueue, ^{
+        if (error) {
+            SuotaLog(TAG, @"Failed to write descriptor: %@ value, error: %@", descriptor.UUID, error);
+            [self notifyFailure:GATT_OPERATION_ERROR];
+        } else {
+            SuotaLogOpt(SuotaLibLog.GATT_OPERATION, TAG, @"didWriteValueForDescriptor: %@", descriptor.UUID);
+        }
+        [self.gattScheduler completeOperation:WRITE_DESCRIPTOR characteristic:descriptor.characteristic error:error];
     });
 }
 
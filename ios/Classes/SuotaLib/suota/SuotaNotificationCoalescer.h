@@ -0,0 +1,83 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+/*!
+ @header SuotaNotificationCoalescer.h
+ @brief Header file for the SuotaNotificationCoalescer class.
+
+ This header file contains method and property declaration for the SuotaNotificationCoalescer class.
+
+ @copyright 2019 Dialog Semiconductor
+ */
+
+#import <Foundation/Foundation.h>
+
+@protocol SuotaManagerDelegate;
+
+/*!
+ * @class SuotaNotificationCoalescer
+ *
+ * @discussion Collapses the chunk, block and progress notifications of an upload into a snapshot of their latest values, which is delivered to the delegate at a limited rate.
+ *
+ * Updates can be reported from any thread. The snapshot is delivered on the coalescer queue, or on the thread that calls {@link flush}. A progress of 100% is delivered immediately.
+ *
+ */
+@interface SuotaNotificationCoalescer : NSObject
+
+/*!
+ * @property interval
+ *
+ * @discussion Minimum time in seconds between deliveries.
+ */
+@property (readonly) double interval;
+/*!
+ * @property updates
+ *
+ * @discussion Number of notifications reported to the coalescer.
+ */
+@property (readonly) int updates;
+/*!
+ * @property deliveries
+ *
+ * @discussion Number of snapshots delivered to the delegate.
+ */
+@property (readonly) int deliveries;
+
+/*!
+ * @method initWithDelegate:queue:rate:
+ *
+ * @param delegate The delegate that receives the notifications. It is not retained.
+ * @param queue The queue on which scheduled deliveries run.
+ * @param rate Maximum number of deliveries per second.
+ *
+ * @discussion Creates a new {@link SuotaNotificationCoalescer} instance.
+ *
+ */
+- (instancetype) initWithDelegate:(id<SuotaManagerDelegate>)delegate queue:(dispatch_queue_t)queue rate:(double)rate;
+
+- (void) onChunkSend:(int)chunkCount totalChunks:(int)totalChunks chunk:(int)chunk block:(int)block blockChunks:(int)blockChunks totalBlocks:(int)totalBlocks;
+- (void) onBlockSent:(int)block totalBlocks:(int)totalBlocks;
+- (void) onUploadProgress:(float)percent;
+
+/*!
+ * @method flush
+ *
+ * @discussion Delivers the pending notifications immediately. Must be called before a terminal notification, so that it is not overtaken by an older snapshot.
+ */
+- (void) flush;
+
+/*!
+ * @method reset
+ *
+ * @discussion Drops the pending notifications.
+ */
+- (void) reset;
+
+@end
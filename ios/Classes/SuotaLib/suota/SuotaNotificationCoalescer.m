@@ -0,0 +1,144 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+#import "SuotaNotificationCoalescer.h"
+#import "SuotaManager.h"
+#import "SuotaTimer.h"
+
+enum {
+    PENDING_CHUNK = 1 << 0,
+    PENDING_BLOCK = 1 << 1,
+    PENDING_PROGRESS = 1 << 2,
+};
+
+@interface SuotaNotificationCoalescer ()
+
+@property (weak) id<SuotaManagerDelegate> delegate;
+@property dispatch_queue_t queue;
+@property double interval;
+@property int updates;
+@property int deliveries;
+@property SuotaTimer* flushTimer;
+
+@end
+
+@implementation SuotaNotificationCoalescer {
+    int pending;
+    NSTimeInterval lastDelivery;
+    // Latest values, guarded by the lock
+    int chunkCount;
+    int totalChunks;
+    int chunk;
+    int chunkBlock;
+    int blockChunks;
+    int totalBlocks;
+    int block;
+    float percent;
+}
+
+- (instancetype) initWithDelegate:(id<SuotaManagerDelegate>)delegate queue:(dispatch_queue_t)queue rate:(double)rate {
+    self = [super init];
+    if (!self)
+        return nil;
+    self.delegate = delegate;
+    self.queue = queue;
+    self.interval = rate > 0 ? 1. / rate : 0;
+    return self;
+}
+
+- (void) onChunkSend:(int)chunkCount totalChunks:(int)totalChunks chunk:(int)chunk block:(int)block blockChunks:(int)blockChunks totalBlocks:(int)totalBlocks {
+    @synchronized (self) {
+        self->chunkCount = chunkCount;
+        self->totalChunks = totalChunks;
+        self->chunk = chunk;
+        self->chunkBlock = block;
+        self->blockChunks = blockChunks;
+        self->totalBlocks = totalBlocks;
+        pending |= PENDING_CHUNK;
+        self.updates++;
+        [self scheduleFlush];
+    }
+}
+
+- (void) onBlockSent:(int)block totalBlocks:(int)totalBlocks {
+    @synchronized (self) {
+        self->block = block;
+        self->totalBlocks = totalBlocks;
+        pending |= PENDING_BLOCK;
+        self.updates++;
+        [self scheduleFlush];
+    }
+}
+
+- (void) onUploadProgress:(float)percent {
+    @synchronized (self) {
+        self->percent = percent;
+        pending |= PENDING_PROGRESS;
+        self.updates++;
+        if (percent < 100) {
+            [self scheduleFlush];
+            return;
+        }
+    }
+    [self flush];
+}
+
+// Called with the lock held
+- (void) scheduleFlush {
+    if (self.flushTimer)
+        return;
+    double delay = MAX(lastDelivery + self.interval - NSProcessInfo.processInfo.systemUptime, 0);
+    __weak SuotaNotificationCoalescer* weakSelf = self;
+    self.flushTimer = [SuotaTimer scheduledTimerWithInterval:delay queue:self.queue repeats:false block:^(SuotaTimer* timer) {
+        [weakSelf flush];
+    }];
+}
+
+- (void) flush {
+    int pending;
+    int chunkCount, totalChunks, chunk, chunkBlock, blockChunks, totalBlocks, block;
+    float percent;
+    @synchronized (self) {
+        [self.flushTimer invalidate];
+        self.flushTimer = nil;
+        pending = self->pending;
+        if (!pending)
+            return;
+        self->pending = 0;
+        chunkCount = self->chunkCount;
+        totalChunks = self->totalChunks;
+        chunk = self->chunk;
+        chunkBlock = self->chunkBlock;
+        blockChunks = self->blockChunks;
+        totalBlocks = self->totalBlocks;
+        block = self->block;
+        percent = self->percent;
+        lastDelivery = NSProcessInfo.processInfo.systemUptime;
+        self.deliveries++;
+    }
+
+    id<SuotaManagerDelegate> delegate = self.delegate;
+    if (pending & PENDING_CHUNK)
+        [delegate onChunkSend:chunkCount totalChunks:totalChunks chunk:chunk block:chunkBlock blockChunks:blockChunks totalBlocks:totalBlocks];
+    if (pending & PENDING_BLOCK)
+        [delegate onBlockSent:block totalBlocks:totalBlocks];
+    if (pending & PENDING_PROGRESS)
+        [delegate onUploadProgress:percent];
+}
+
+- (void) reset {
+    @synchronized (self) {
+        [self.flushTimer invalidate];
+        self.flushTimer = nil;
+        pending = 0;
+    }
+}
+
+@end
@@ -22,7 +22,11 @@
 #import "SuotaManager.h"
 #import "SuotaProfile.h"
 
+@class GattOperation;
 @class SendChunkOperation;
+@class SuotaHistogram;
+@class SuotaTimer;
+@class SuotaUploadCheckpoint;
 
 /*!
  * @class SpeedStatistics
@@ -35,13 +39,65 @@
 @property uint64_t uploadStartTime;
 @property int bytesSent;
 @property double uploadAvg;
-@property NSMutableArray<NSNumber*>* speeds;
+/*!
+ * @property throughputHistogram
+ *
+ * @discussion Distribution of the block upload speeds, in bytes per second.
+ */
+@property (readonly) SuotaHistogram* throughputHistogram;
+/*!
+ * @property chunkLatencyHistogram
+ *
+ * @discussion Distribution of the chunk write latencies, in micro seconds. The latency of a chunk is the time from the write of the previous chunk of its block, which includes any wait for the write flow control.
+ */
+@property (readonly) SuotaHistogram* chunkLatencyHistogram;
+/*!
+ * @property idleGapHistogram
+ *
+ * @discussion Distribution of the block idle gaps, in milli seconds. The idle gap of a block is the time from the last chunk of the previous block to its first chunk.
+ */
+@property (readonly) SuotaHistogram* idleGapHistogram;
 @property double sum;
 @property double max;
 @property double min;
+@property int writeCallbacks;
+@property int batchedChunks;
+@property int maxChunksPerCallback;
 
+- (void) reset;
 - (void) update:(int)size speed:(double)speed;
 - (double) avg;
+/*!
+ * @method updateChunkWrite:time:
+ *
+ * @param chunk The index of the chunk in its block.
+ * @param time The system uptime when the chunk was written.
+ *
+ * @discussion Updates the chunk write latency statistics. Called on the protocol queue.
+ */
+- (void) updateChunkWrite:(int)chunk time:(NSTimeInterval)time;
+/*!
+ * @method updateWriteBatch:
+ *
+ * @param chunks Number of chunks written on a single write readiness callback.
+ *
+ * @discussion Updates the chunks per callback statistic.
+ */
+- (void) updateWriteBatch:(int)chunks;
+/*!
+ * @method chunksPerCallback
+ *
+ * @discussion Returns the average number of chunks written on each write readiness callback.
+ */
+- (double) chunksPerCallback;
+/*!
+ * @method updateIdleGap:
+ *
+ * @param gap Time in milli seconds between the last chunk of a block and the first chunk of the next block.
+ *
+ * @discussion Updates the block idle gap statistics.
+ */
+- (void) updateIdleGap:(uint64_t)gap;
 
 @end
 
@@ -58,23 +114,40 @@
 @property (weak) id<SuotaManagerDelegate> suotaManagerDelegate;
 @property SuotaFile* suotaFile;
 @property enum SuotaProtocolState state;
-@property NSTimer* timeoutTimer;
+@property SuotaTimer* timeoutTimer;
 
 @property uint64_t startTime;
 @property uint64_t elapsedTime;
 @property uint64_t uploadStartTime;
 @property uint64_t uploadElapsedTime;
 @property uint64_t currentBlockStartTime;
+@property uint64_t completedBlockStartTime;
+@property uint64_t lastChunkSentTime;
 
 @property BOOL suotaRunning;
 @property BOOL memoryDeviceSent;
 @property BOOL endSignalSent;
 
 @property int currentBlock;
+/*!
+ * @property firstBlock
+ *
+ * @discussion The block the upload starts from. It is greater than 0 if an interrupted upload is resumed.
+ */
+@property int firstBlock;
+/*!
+ * @property resumeBlock
+ *
+ * @discussion The block an interrupted upload can resume from, according to the journal, or 0 if there is no checkpoint. The upload is resumed only if the device confirms it.
+ */
+@property int resumeBlock;
+@property SuotaUploadCheckpoint* checkpoint;
 @property SendChunkOperation* lastChunk;
+@property NSArray<SendChunkOperation*>* preparedChunks;
+@property GattOperation* preparedPatchLength;
 
 @property SpeedStatistics* statistics;
-@property NSTimer* currentSpeedTimer;
+@property SuotaTimer* currentSpeedTimer;
 
 @property int bytesSent;
 
@@ -90,9 +163,39 @@
 - (double) avg;
 - (double) max;
 - (double) min;
+- (double) chunksPerCallback;
+/*!
+ * @method idleGapHistogram
+ *
+ * @discussion Returns the distribution of the time in milli seconds between the last chunk of each block and the first chunk of the next one, or <code>nil</code> if statistics are disabled.
+ */
+- (SuotaHistogram*) idleGapHistogram;
 - (void) onCharacteristicChanged:(int)value;
 - (void) onCharacteristicWrite:(CBCharacteristic*)characteristic;
 - (void) onDescriptorWrite:(CBCharacteristic*)characteristic;
+/*!
+ * @method onMemoryInfoRead:
+ *
+ * @param value The memory info characteristic value.
+ *
+ * @discussion Called when the memory info is read before resuming an upload. The value is the number of image bytes received by the device.
+ */
+- (void) onMemoryInfoRead:(NSData*)value;
+/*!
+ * @method restartBlock
+ *
+ * @discussion Sends the current block again, starting with its patch length, after the chunk transport failed in the middle of the block.
+ */
+- (void) restartBlock;
 - (void) notifyChunkSend;
+/*!
+ * @method onError:
+ *
+ * @param error The error code reported by the device, or an {@link ApplicationErrors} value.
+ *
+ * @discussion Stops the update, reports the failure and destroys the manager.
+ */
+- (void) onError:(int)error;
+- (void) suotaProtocolError;
 
 @end
@@ -12,11 +12,26 @@
 #import "MemoryDeviceOperation.h"
 #import "SendChunkOperation.h"
 #import "SendEndSignalOperation.h"
+#import "SuotaChecksum.h"
 #import "SuotaFile.h"
+#import "SuotaHistogram.h"
 #import "SuotaLibConfig.h"
 #import "SuotaLibLog.h"
 #import "SuotaManager.h"
+#import "SuotaNotificationCoalescer.h"
 #import "SuotaProfile.h"
+#import "SuotaTimer.h"
+#import "SuotaUploadJournal.h"
+
+@interface SpeedStatistics ()
+
+@property SuotaHistogram* throughputHistogram;
+@property SuotaHistogram* chunkLatencyHistogram;
+@property SuotaHistogram* idleGapHistogram;
+// Only accessed from the protocol queue
+@property NSTimeInterval lastChunkWriteTime;
+
+@end
 
 @implementation SpeedStatistics
 
@@ -24,23 +39,30 @@
     self = [super init];
     if (!self)
         return nil;
-    self.speeds = [NSMutableArray array];
+    self.throughputHistogram = [[SuotaHistogram alloc] init];
+    self.chunkLatencyHistogram = [[SuotaHistogram alloc] init];
+    self.idleGapHistogram = [[SuotaHistogram alloc] init];
     [self reset];
     return self;
 }
 
 - (void) reset {
     self.bytesSent = 0;
-    [self.speeds removeAllObjects];
+    [self.throughputHistogram reset];
+    [self.chunkLatencyHistogram reset];
+    [self.idleGapHistogram reset];
     self.sum = 0;
-    self.max = DBL_MIN;
+    self.max = -DBL_MAX;
     self.min = DBL_MAX;
+    self.writeCallbacks = 0;
+    self.batchedChunks = 0;
+    self.maxChunksPerCallback = 0;
 }
 
 - (void) update:(int)size speed:(double)speed {
     self.bytesSent += size;
     self.uploadAvg = self.bytesSent / (([[NSDate date] timeIntervalSince1970] * 1000 - self.uploadStartTime) / 1000.);
-    [self.speeds addObject:@(speed)];
+    [self.throughputHistogram recordValue:speed > 0 ? (uint64_t) MIN(speed, (double) SuotaHistogram.maxValue) : 0];
     self.sum += speed;
     if (self.max < speed)
         self.max = speed;
@@ -49,7 +71,28 @@
 }
 
 - (double) avg {
-    return self.sum / self.speeds.count;
+    return self.sum / self.throughputHistogram.count;
+}
+
+- (void) updateChunkWrite:(int)chunk time:(NSTimeInterval)time {
+    if (chunk)
+        [self.chunkLatencyHistogram recordValue:(uint64_t) MAX((time - self.lastChunkWriteTime) * 1000000, 0)];
+    self.lastChunkWriteTime = time;
+}
+
+- (void) updateWriteBatch:(int)chunks {
+    self.writeCallbacks++;
+    self.batchedChunks += chunks;
+    if (self.maxChunksPerCallback < chunks)
+        self.maxChunksPerCallback = chunks;
+}
+
+- (double) chunksPerCallback {
+    return self.writeCallbacks ? (double)self.batchedChunks / self.writeCallbacks : 0;
+}
+
+- (void) updateIdleGap:(uint64_t)gap {
+    [self.idleGapHistogram recordValue:gap];
 }
 
 @end
@@ -65,7 +108,7 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
     if (!self)
         return nil;
     self.suotaManager = suotaManager;
-    self.suotaManagerDelegate = suotaManager.suotaManagerDelegate;
+    self.suotaManagerDelegate = suotaManager.delegateDispatcher;
     if (SuotaLibConfig.CALCULATE_STATISTICS)
         self.statistics = [[SpeedStatistics alloc] init];
     [self reset];
@@ -74,6 +117,8 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
 
 - (void) start {
     [self reset];
+    [self.suotaManager.notificationCoalescer reset];
+    [self initCheckpoint];
     self.suotaRunning = true;
     if (SuotaLibLog.PROTOCOL || SuotaLibConfig.NOTIFY_SUOTA_LOG) {
         NSString* uploadSize = [NSString stringWithFormat:@"Upload size: %d bytes", self.suotaFile.uploadSize];
@@ -99,6 +144,46 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
     [self execute];
 }
 
+// Checks the journal for an interrupted upload of the same image to the same peripheral.
+// The upload always starts from the first block, unless the device confirms the checkpoint after the memory device is set.
+- (void) initCheckpoint {
+    self.checkpoint = nil;
+    self.firstBlock = 0;
+    self.resumeBlock = 0;
+    if (!SuotaLibConfig.RESUME_UPLOADS || !self.suotaManager.peripheral)
+        return;
+
+    SuotaUploadCheckpoint* checkpoint = [self createCheckpoint];
+    SuotaUploadCheckpoint* stored = [SuotaUploadJournal.defaultJournal checkpointForPeripheral:checkpoint.peripheral];
+    if (stored && [stored isSameUpload:checkpoint] && stored.lastBlock >= 0 && stored.lastBlock < self.suotaFile.totalBlocks - 1 && self.suotaManager.memoryInfoCharacteristic) {
+        self.resumeBlock = stored.lastBlock + 1;
+        SuotaLogOpt(SuotaLibLog.PROTOCOL, TAG, @"Upload checkpoint at block %d of %d", self.resumeBlock + 1, self.suotaFile.totalBlocks);
+    } else if (stored) {
+        SuotaLogOpt(SuotaLibLog.PROTOCOL, TAG, @"Discard upload checkpoint: %@", stored);
+        [SuotaUploadJournal.defaultJournal removeCheckpointForPeripheral:stored.peripheral];
+    }
+    self.checkpoint = checkpoint;
+}
+
+- (SuotaUploadCheckpoint*) createCheckpoint {
+    SuotaManager* manager = self.suotaManager;
+    return [[SuotaUploadCheckpoint alloc] initWithPeripheral:manager.peripheral.identifier imageHash:[SuotaChecksum sha256:self.suotaFile.data] size:self.suotaFile.uploadSize blockSize:self.suotaFile.blockSize memoryDevice:manager.memoryDevice gpioMap:manager.gpioMap firmwareRevision:manager.firmwareRevision];
+}
+
+- (void) updateCheckpoint {
+    if (!self.checkpoint)
+        return;
+    self.checkpoint.lastBlock = self.currentBlock;
+    [SuotaUploadJournal.defaultJournal updateCheckpoint:self.checkpoint];
+}
+
+- (void) removeCheckpoint {
+    if (!self.checkpoint)
+        return;
+    [SuotaUploadJournal.defaultJournal removeCheckpointForPeripheral:self.checkpoint.peripheral];
+    self.checkpoint = nil;
+}
+
 - (BOOL) isRunning {
     return self.suotaRunning;
 }
@@ -109,7 +194,7 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
     // Block notification timeout
     if (SuotaLibConfig.UPLOAD_TIMEOUT > 0) {
         if (sendChunk.isLastChunk)
-            self.timeoutTimer = [NSTimer scheduledTimerWithTimeInterval:((double)SuotaLibConfig.UPLOAD_TIMEOUT / 1000.0) target:self selector:@selector(timeout:) userInfo:nil repeats:false];
+            self.timeoutTimer = [self scheduleTimeout];
     }
     
     int block = sendChunk.block;
@@ -119,14 +204,20 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
         NSString* msg = [NSString stringWithFormat:@"Send block %d, chunk %d of %d (%d of %d), size %lu", block + 1, chunk + 1, [self.suotaFile getBlockChunks:block], sendChunk.chunkCount, self.suotaFile.totalChunks, (unsigned long)sendChunk.value.length];
         SuotaLogOpt(SuotaLibLog.CHUNK, TAG, @"%@", msg);
         if (SuotaLibConfig.NOTIFY_SUOTA_LOG_CHUNK && SuotaLibConfig.NOTIFY_SUOTA_LOG)
-            dispatch_async(dispatch_get_main_queue(), ^{
-                [self.suotaManagerDelegate onSuotaLog:self.state type:CHUNK log:msg];
-            });
+            [self.suotaManagerDelegate onSuotaLog:self.state type:CHUNK log:msg];
     }
 
-    if (SuotaLibConfig.CALCULATE_STATISTICS)
-        if (!chunk)
-            self.currentBlockStartTime = [[NSDate date] timeIntervalSince1970] * 1000;
+    if (SuotaLibConfig.CALCULATE_STATISTICS) {
+        uint64_t now = [[NSDate date] timeIntervalSince1970] * 1000;
+        if (!chunk) {
+            self.currentBlockStartTime = now;
+            if (block != self.firstBlock)
+                [self.statistics updateIdleGap:now - self.lastChunkSentTime];
+        }
+        if (sendChunk.isLastChunk)
+            self.lastChunkSentTime = now;
+        [self.statistics updateChunkWrite:chunk time:sendChunk.writeTime ? sendChunk.writeTime : NSProcessInfo.processInfo.systemUptime];
+    }
 }
 
 - (void) notifyForSendingMemoryDevice {
@@ -140,6 +231,8 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
 - (void) destroy {
     SuotaLog(TAG, @"Destroy");
     self.suotaRunning = false;
+    self.preparedChunks = nil;
+    self.preparedPatchLength = nil;
     if (self.currentSpeedTimer && self.currentSpeedTimer.isValid)
         [self.currentSpeedTimer invalidate];
     if (SuotaLibConfig.UPLOAD_TIMEOUT > 0 && self.timeoutTimer && self.timeoutTimer.isValid)
@@ -155,11 +248,19 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
 }
 
 - (double) max {
-    return self.statistics ? self.statistics.max : -1;
+    return self.statistics.throughputHistogram.count ? self.statistics.max : -1;
 }
 
 - (double) min {
-    return self.statistics ? self.statistics.min : -1;
+    return self.statistics.throughputHistogram.count ? self.statistics.min : -1;
+}
+
+- (double) chunksPerCallback {
+    return self.statistics ? self.statistics.chunksPerCallback : -1;
+}
+
+- (SuotaHistogram*) idleGapHistogram {
+    return self.statistics ? self.statistics.idleGapHistogram : nil;
 }
 
 - (void) onCharacteristicChanged:(int)value {
@@ -190,9 +291,9 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
             || ((self.state == SET_GPIO_MAP) ^ [uuid isEqual:SuotaProfile.SUOTA_GPIO_MAP_UUID] && (self.state != SET_GPIO_MAP || ![uuid isEqual:SuotaProfile.SUOTA_MEM_DEV_UUID]))
             || (self.state == SEND_BLOCK) ^ ([uuid isEqual:SuotaProfile.SUOTA_PATCH_LEN_UUID] || [uuid isEqual:SuotaProfile.SUOTA_PATCH_DATA_UUID])) {
             SuotaLog(TAG, @"Unexpected characteristic write on state %@: %@", SuotaProfile.suotaStateDescriptionList[@(self.state)] ? SuotaProfile.suotaStateDescriptionList[@(self.state)] : @(self.state), uuid);
-            dispatch_async(dispatch_get_main_queue(), ^{
+            [self.suotaManager runOnProtocolQueue:^{
                 [self suotaProtocolError];
-            });
+            }];
             return;
         }
     }
@@ -210,6 +311,10 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
 
     if ([uuid isEqual:SuotaProfile.SUOTA_GPIO_MAP_UUID]) {
         SuotaLogOpt(SuotaLibLog.PROTOCOL, TAG, @"GPIO map set");
+        if (self.resumeBlock) {
+            [self readMemoryInfo];
+            return;
+        }
         [self moveToNextState];
         [self execute];
     } else if ([uuid isEqual:SuotaProfile.SUOTA_PATCH_LEN_UUID]) {
@@ -221,6 +326,31 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
     }
 }
 
+// Stock SUOTA firmware resets the image write offset when the memory device is set, so the upload can't continue from the checkpoint.
+// Resume only if the device reports that it still holds exactly the bytes of the acknowledged blocks.
+- (void) onMemoryInfoRead:(NSData*)value {
+    if (!self.suotaRunning || self.state != SET_GPIO_MAP || !self.resumeBlock)
+        return;
+
+    uint32_t received = value.length >= 4 ? *(const uint32_t*)value.bytes : 0;
+    uint32_t expected = (uint32_t) self.resumeBlock * self.suotaFile.blockSize;
+    if (received == expected) {
+        self.firstBlock = self.resumeBlock;
+        self.currentBlock = self.firstBlock - 1;
+        self.checkpoint.lastBlock = self.currentBlock;
+        SuotaLogOpt(SuotaLibLog.PROTOCOL, TAG, @"Device reports %u bytes received, resume upload from block %d of %d", received, self.firstBlock + 1, self.suotaFile.totalBlocks);
+    } else {
+        NSString* msg = [NSString stringWithFormat:@"Device reports %u bytes received, expected %u, upload from the first block", received, expected];
+        SuotaLogOpt(SuotaLibLog.PROTOCOL, TAG, @"%@", msg);
+        if (SuotaLibConfig.NOTIFY_SUOTA_LOG)
+            [self.suotaManagerDelegate onSuotaLog:self.state type:INFO log:msg];
+        [SuotaUploadJournal.defaultJournal removeCheckpointForPeripheral:self.checkpoint.peripheral];
+    }
+    self.resumeBlock = 0;
+    [self moveToNextState];
+    [self execute];
+}
+
 - (void) onDescriptorWrite:(CBCharacteristic*)characteristic {
     if (!self.suotaRunning)
         return;
@@ -292,6 +422,8 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
     self.endSignalSent = false;
     self.currentBlock = -1;
     self.lastChunk = nil;
+    self.preparedChunks = nil;
+    self.preparedPatchLength = nil;
     if (SuotaLibConfig.CALCULATE_STATISTICS)
         [self.statistics reset];
     self.state = ENABLE_NOTIFICATIONS;
@@ -321,15 +453,25 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
             return;
         }
         self.lastChunk = nil; // detect future faulty notification
+        self.completedBlockStartTime = self.currentBlockStartTime;
+        [self updateCheckpoint];
 
+        // Send the prepared block before processing the completed one
+        BOOL pipelined = [self sendPreparedBlock];
         [self moveToNextState];
-        [self execute];
+        if (!pipelined) {
+            [self execute];
+            return;
+        }
+        self.currentBlock++;
+        [self prepareNextBlock];
     } else if (self.state == END_SIGNAL && self.endSignalSent) {
         if (SuotaLibConfig.UPLOAD_TIMEOUT > 0)
             [self.timeoutTimer invalidate];
         SuotaLogOpt(SuotaLibLog.PROTOCOL, TAG, @"End Signal Notification");
         self.endSignalSent = false; // detect future faulty notification
         [self onPostExecute];
+        [self removeCheckpoint];
         self.elapsedTime = [[NSDate date] timeIntervalSince1970] * 1000 - self.startTime;
         if (SuotaLibLog.PROTOCOL || SuotaLibConfig.NOTIFY_SUOTA_LOG) {
             NSString* msg = [NSString stringWithFormat: @"Update completed in %.3f seconds", self.elapsedTime / 1000.];
@@ -350,20 +492,67 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
         [self.timeoutTimer invalidate];
     NSString* msg = [NSString stringWithFormat:@"Error: %d, %@", error, SuotaProfile.suotaErrorCodeList[@(error)]];
     SuotaLog(TAG, @"%@", msg);
+
+    // Errors reported by the device mean that its state doesn't match the checkpoint. Library errors, like a timeout, keep it for the next attempt.
+    if (error <= 0xff) {
+        BOOL resumed = self.firstBlock > 0;
+        [self removeCheckpoint];
+        if (resumed && self.suotaRunning) {
+            [self restartUpload];
+            return;
+        }
+    }
     self.suotaRunning = false;
     self.state = ERROR;
+    [self.suotaManager.notificationCoalescer flush];
     [self.suotaManagerDelegate onFailure:error];
     if (SuotaLibConfig.NOTIFY_SUOTA_LOG)
         [self.suotaManagerDelegate onSuotaLog:ERROR type:INFO log:msg];
     [self.suotaManager destroy];
 }
 
+// Restarts the update from the first block, on the same connection
+- (void) restartUpload {
+    NSString* msg = @"Resumed upload rejected, restart from the first block";
+    SuotaLog(TAG, @"%@", msg);
+    if (SuotaLibConfig.NOTIFY_SUOTA_LOG)
+        [self.suotaManagerDelegate onSuotaLog:self.state type:INFO log:msg];
+    if (self.currentSpeedTimer && self.currentSpeedTimer.isValid)
+        [self.currentSpeedTimer invalidate];
+    [self.suotaManager clearSendChunkQueue];
+    [self reset];
+    self.suotaRunning = true;
+    self.firstBlock = 0;
+    self.resumeBlock = 0;
+    if (SuotaLibConfig.RESUME_UPLOADS)
+        self.checkpoint = [self createCheckpoint];
+    [self execute];
+}
+
+// The patch length write resets the block buffer of the device, so the partially received block is discarded
+- (void) restartBlock {
+    if (!self.suotaRunning || self.state != SEND_BLOCK)
+        return;
+    if (SuotaLibConfig.UPLOAD_TIMEOUT > 0 && self.timeoutTimer && self.timeoutTimer.isValid)
+        [self.timeoutTimer invalidate];
+    NSString* msg = [NSString stringWithFormat:@"Restart block %d", self.currentBlock + 1];
+    SuotaLog(TAG, @"%@", msg);
+    if (SuotaLibConfig.NOTIFY_SUOTA_LOG)
+        [self.suotaManagerDelegate onSuotaLog:self.state type:INFO log:msg];
+    [self.suotaManager clearSendChunkQueue];
+    self.lastChunk = nil;
+    // Not the prepared patch length, which belongs to the next block
+    int blockSize = [self.suotaFile getBlockSize:self.currentBlock];
+    [self.suotaManager executeOperation:[[GattOperation alloc] initWithCharacteristic:self.suotaManager.patchLengthCharacteristic value:(uint16_t)blockSize]];
+}
+
 - (void) suotaProtocolError {
     if (SuotaLibConfig.UPLOAD_TIMEOUT > 0 && self.timeoutTimer && self.timeoutTimer.isValid)
         [self.timeoutTimer invalidate];
     SuotaLog(TAG, @"SUOTA protocol error");
     self.suotaRunning = false;
     self.state = ERROR;
+    [self.suotaManager.notificationCoalescer flush];
     [self.suotaManagerDelegate onFailure:PROTOCOL_ERROR];
     if (SuotaLibConfig.NOTIFY_SUOTA_LOG)
         [self.suotaManagerDelegate onSuotaLog:ERROR type:INFO log:@"SUOTA protocol error"];
@@ -373,24 +562,44 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
 - (void) notifyChunkSend {
     SendChunkOperation* lastChunk = self.lastChunk;
     int block = lastChunk.block;
-    dispatch_async(dispatch_get_main_queue(), ^{
-        [self.suotaManagerDelegate onChunkSend:lastChunk.chunkCount totalChunks:self.suotaFile.totalChunks chunk:lastChunk.chunk + 1 block:block + 1 blockChunks:[self.suotaFile getBlockChunks:block] totalBlocks:self.suotaFile.totalBlocks];
-    });
+    int totalChunks = self.suotaFile.totalChunks;
+    int blockChunks = [self.suotaFile getBlockChunks:block];
+    int totalBlocks = self.suotaFile.totalBlocks;
+    SuotaNotificationCoalescer* coalescer = self.suotaManager.notificationCoalescer;
+    if (coalescer)
+        [coalescer onChunkSend:lastChunk.chunkCount totalChunks:totalChunks chunk:lastChunk.chunk + 1 block:block + 1 blockChunks:blockChunks totalBlocks:totalBlocks];
+    else
+        [self.suotaManagerDelegate onChunkSend:lastChunk.chunkCount totalChunks:totalChunks chunk:lastChunk.chunk + 1 block:block + 1 blockChunks:blockChunks totalBlocks:totalBlocks];
 }
 
 - (void) notifyBlockSent {
-    [self.suotaManagerDelegate onBlockSent:self.currentBlock + 1 totalBlocks:self.suotaFile.totalBlocks];
+    SuotaNotificationCoalescer* coalescer = self.suotaManager.notificationCoalescer;
+    if (coalescer)
+        [coalescer onBlockSent:self.currentBlock + 1 totalBlocks:self.suotaFile.totalBlocks];
+    else
+        [self.suotaManagerDelegate onBlockSent:self.currentBlock + 1 totalBlocks:self.suotaFile.totalBlocks];
 }
 
 - (void) notifyUploadProgress {
-    [self.suotaManagerDelegate onUploadProgress:((float)(self.currentBlock + 1)) / self.suotaFile.totalBlocks * 100];
+    float percent = ((float)(self.currentBlock + 1)) / self.suotaFile.totalBlocks * 100;
+    SuotaNotificationCoalescer* coalescer = self.suotaManager.notificationCoalescer;
+    if (coalescer)
+        [coalescer onUploadProgress:percent];
+    else
+        [self.suotaManagerDelegate onUploadProgress:percent];
 }
 
-- (void) timeout:(NSTimer*)timer {
-    dispatch_async(dispatch_get_main_queue(), ^{
-        SuotaLog(TAG, @"Upload timeout");
-        [self onError:UPLOAD_TIMEOUT];
-    });
+// Timers fire on the protocol queue. The block timeout is scheduled from the Bluetooth queue, when the last chunk is sent.
+- (SuotaTimer*) scheduleTimeout {
+    __weak SuotaProtocol* weakSelf = self;
+    return [SuotaTimer scheduledTimerWithInterval:(double)SuotaLibConfig.UPLOAD_TIMEOUT / 1000.0 queue:self.suotaManager.protocolQueue repeats:false block:^(SuotaTimer* timer) {
+        [weakSelf timeout];
+    }];
+}
+
+- (void) timeout {
+    SuotaLog(TAG, @"Upload timeout");
+    [self onError:UPLOAD_TIMEOUT];
 }
 
 - (void) enableNotifications {
@@ -413,10 +622,15 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
     
     // Image started notification timeout
     if (SuotaLibConfig.UPLOAD_TIMEOUT > 0)
-        self.timeoutTimer = [NSTimer scheduledTimerWithTimeInterval:((double)SuotaLibConfig.UPLOAD_TIMEOUT / 1000.0) target:self selector:@selector(timeout:) userInfo:nil repeats:false];
+        self.timeoutTimer = [self scheduleTimeout];
     [self.suotaManager executeOperation:[[MemoryDeviceOperation alloc] initWithProtocol:self characteristic:self.suotaManager.memDevCharacteristic value:memoryDevice]];
 }
 
+- (void) readMemoryInfo {
+    SuotaLogOpt(SuotaLibLog.PROTOCOL, TAG, @"Read memory info");
+    [self.suotaManager executeOperation:[[GattOperation alloc] initWithCharacteristic:self.suotaManager.memoryInfoCharacteristic]];
+}
+
 - (void) setGpioMap {
     int gpioMap = self.suotaManager.gpioMap;
     if (SuotaLibLog.PROTOCOL || SuotaLibConfig.NOTIFY_SUOTA_LOG) {
@@ -432,18 +646,25 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
     self.currentBlock++;
     self.lastChunk = nil;
     
-    if (!self.currentBlock) {
-        SuotaLogOpt(SuotaLibLog.PROTOCOL, TAG, @"Upload started");
+    if (self.currentBlock == self.firstBlock) {
+        NSString* msg = !self.firstBlock ? @"Upload started" : [NSString stringWithFormat:@"Upload resumed from block %d", self.firstBlock + 1];
+        SuotaLogOpt(SuotaLibLog.PROTOCOL, TAG, @"%@", msg);
         if (SuotaLibConfig.NOTIFY_SUOTA_LOG)
-            [self.suotaManagerDelegate onSuotaLog:self.state type:INFO log:@"Upload started"];
+            [self.suotaManagerDelegate onSuotaLog:self.state type:INFO log:msg];
         self.uploadStartTime = [[NSDate date] timeIntervalSince1970] * 1000;
         
         if (SuotaLibConfig.CALCULATE_STATISTICS) {
             self.statistics.uploadStartTime = self.uploadStartTime;
             self.bytesSent = 0;
-            self.currentSpeedTimer = [NSTimer scheduledTimerWithTimeInterval:((double) PROGRESS_UPDATE_MILLIS / 1000.0) target:self selector:@selector(updateCurrentSpeed:) userInfo:nil repeats:true];
+            __weak SuotaProtocol* weakSelf = self;
+            self.currentSpeedTimer = [SuotaTimer scheduledTimerWithInterval:(double)PROGRESS_UPDATE_MILLIS / 1000.0 queue:self.suotaManager.protocolQueue repeats:true block:^(SuotaTimer* timer) {
+                [weakSelf updateCurrentSpeed];
+            }];
         }
-        [self sendPatchLength:self.suotaFile.blockSize];
+        if ([self.suotaFile isLastBlock:self.currentBlock] && self.suotaFile.isLastBlockShorter)
+            [self sendPatchLength:self.suotaFile.lastBlockSize];
+        else
+            [self sendPatchLength:self.suotaFile.blockSize];
     } else if ([self.suotaFile isLastBlock:self.currentBlock] && self.suotaFile.isLastBlockShorter) {
         [self sendPatchLength:self.suotaFile.lastBlockSize];
     } else {
@@ -458,21 +679,65 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
         if (SuotaLibConfig.NOTIFY_SUOTA_LOG)
             [self.suotaManagerDelegate onSuotaLog:self.state type:INFO log:msg];
     }
-    [self.suotaManager executeOperation:[[GattOperation alloc] initWithCharacteristic:self.suotaManager.patchLengthCharacteristic value:(uint16_t)blockSize]];
+    GattOperation* operation = self.preparedPatchLength;
+    self.preparedPatchLength = nil;
+    if (!operation)
+        operation = [[GattOperation alloc] initWithCharacteristic:self.suotaManager.patchLengthCharacteristic value:(uint16_t)blockSize];
+    [self.suotaManager executeOperation:operation];
 }
 
 - (void) sendBlock {
-    SuotaLogOpt(SuotaLibLog.BLOCK, TAG, @"Current block: %d of %d", self.currentBlock + 1, self.suotaFile.totalBlocks);
-    
-    NSArray<NSData*>* block = [self.suotaFile getBlock:self.currentBlock];
-    int chunk = 0;
-    int chunkCount = self.currentBlock * self.suotaFile.chunksPerBlock + 1;
-    for (NSData* chunkData in block) {
-        SuotaLogOpt(SuotaLibLog.CHUNK, TAG, @"Queue block %d, chunk %d", self.currentBlock + 1, chunk + 1);
-        [self.suotaManager enqueueSendChunkOperation:[[SendChunkOperation alloc] initWithSuotaProtocol:self characteristic:self.suotaManager.patchDataCharacteristic valueData:chunkData chunkCount:chunkCount chunk:chunk block:self.currentBlock isLastChunk:[self.suotaFile isLastChunk:self.currentBlock chunk:chunk]]];
-        chunk++;
-        chunkCount++;
+    [self sendBlockChunks:[self chunkOperationsForBlock:self.currentBlock]];
+    [self prepareNextBlock];
+}
+
+- (void) sendBlockChunks:(NSArray<SendChunkOperation*>*)chunks {
+    SuotaLogOpt(SuotaLibLog.BLOCK, TAG, @"Current block: %d of %d", chunks.firstObject.block + 1, self.suotaFile.totalBlocks);
+    for (SendChunkOperation* chunk in chunks) {
+        SuotaLogOpt(SuotaLibLog.CHUNK, TAG, @"Queue block %d, chunk %d", chunk.block + 1, chunk.chunk + 1);
+        [self.suotaManager enqueueSendChunkOperation:chunk];
+    }
+}
+
+- (NSArray<SendChunkOperation*>*) chunkOperationsForBlock:(int)block {
+    NSArray<NSData*>* blockData = [self.suotaFile getBlock:block];
+    int blockChunks = (int) blockData.count;
+    int chunkCount = block * self.suotaFile.chunksPerBlock + 1;
+    NSMutableArray<SendChunkOperation*>* chunks = [NSMutableArray arrayWithCapacity:blockChunks];
+    for (int chunk = 0; chunk < blockChunks; chunk++, chunkCount++) {
+        [chunks addObject:[[SendChunkOperation alloc] initWithSuotaProtocol:self characteristic:self.suotaManager.patchDataCharacteristic valueData:blockData[chunk] chunkCount:chunkCount chunk:chunk block:block isLastChunk:chunk == blockChunks - 1]];
+    }
+    return chunks;
+}
+
+// Prepares the block after the current one, while the current block status notification is pending
+- (void) prepareNextBlock {
+    self.preparedChunks = nil;
+    self.preparedPatchLength = nil;
+    int nextBlock = self.currentBlock + 1;
+    if (!SuotaLibConfig.PIPELINE_BLOCKS || nextBlock >= self.suotaFile.totalBlocks)
+        return;
+
+    if ([self.suotaFile isLastBlock:nextBlock] && self.suotaFile.isLastBlockShorter)
+        self.preparedPatchLength = [[GattOperation alloc] initWithCharacteristic:self.suotaManager.patchLengthCharacteristic value:(uint16_t)self.suotaFile.lastBlockSize];
+    else
+        self.preparedChunks = [self chunkOperationsForBlock:nextBlock];
+}
+
+// Sends the next block, if it was prepared, and moves to it. The block sent processing is done afterwards on the completed block.
+- (BOOL) sendPreparedBlock {
+    if (!self.preparedChunks && !self.preparedPatchLength)
+        return false;
+
+    NSArray<SendChunkOperation*>* chunks = self.preparedChunks;
+    self.preparedChunks = nil;
+    if (chunks) {
+        [self sendBlockChunks:chunks];
+    } else {
+        // Chunks are sent after the patch length write callback, so the current block must be the next one by then
+        [self sendPatchLength:self.suotaFile.lastBlockSize];
     }
+    return true;
 }
 
 - (void) onBlockSent {
@@ -481,7 +746,7 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
         self.uploadElapsedTime = [[NSDate date] timeIntervalSince1970] * 1000 - self.uploadStartTime;
 
     if (SuotaLibConfig.CALCULATE_STATISTICS) {
-        double elapsed = ([[NSDate date] timeIntervalSince1970] * 1000 - self.currentBlockStartTime) / 1000.;
+        double elapsed = ([[NSDate date] timeIntervalSince1970] * 1000 - self.completedBlockStartTime) / 1000.;
         int size = [self.suotaFile getBlockSize:self.currentBlock];
         double speed = size / elapsed;
         
@@ -494,7 +759,7 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
         
         self.bytesSent += size;
         [self.statistics update:size speed:speed];
-        [self.suotaManagerDelegate updateSpeedStatistics:speed max:self.statistics.max min:self.statistics.min avg:!lastBlock ? self.statistics.uploadAvg : self.suotaFile.uploadSize / (self.uploadElapsedTime / 1000.)];
+        [self.suotaManagerDelegate updateSpeedStatistics:speed max:self.statistics.max min:self.statistics.min avg:!lastBlock ? self.statistics.uploadAvg : (self.suotaFile.uploadSize - self.firstBlock * self.suotaFile.blockSize) / (self.uploadElapsedTime / 1000.)];
     } else if (SuotaLibLog.BLOCK || (SuotaLibConfig.NOTIFY_SUOTA_LOG_BLOCK && SuotaLibConfig.NOTIFY_SUOTA_LOG)) {
                NSString* msg = [NSString stringWithFormat:@"Block sent: %d", self.currentBlock + 1];
                SuotaLogOpt(SuotaLibLog.BLOCK, TAG, @"%@", msg);
@@ -509,6 +774,15 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
     if (SuotaLibLog.PROTOCOL || SuotaLibConfig.NOTIFY_SUOTA_LOG) {
         if (lastBlock) {
             NSString* msg = [NSString stringWithFormat:@"Upload completed in %.3f seconds", self.uploadElapsedTime / 1000.0];
+            if (self.statistics && self.statistics.writeCallbacks)
+                msg = [msg stringByAppendingFormat:@", %.2f chunks per write callback (max %d)", self.statistics.chunksPerCallback, self.statistics.maxChunksPerCallback];
+            if (self.statistics && self.statistics.idleGapHistogram.count)
+                msg = [msg stringByAppendingFormat:@", block idle gap %.1f ms (max %llu ms)", self.statistics.idleGapHistogram.mean, self.statistics.idleGapHistogram.max];
+            if (self.statistics) {
+                SuotaHistogram* throughput = self.statistics.throughputHistogram;
+                SuotaHistogram* latency = self.statistics.chunkLatencyHistogram;
+                msg = [msg stringByAppendingFormat:@", block speed p50/p90/p99 %llu/%llu/%llu B/s, chunk latency p50/p90/p99 %llu/%llu/%llu us", [throughput valueAtPercentile:50], [throughput valueAtPercentile:90], [throughput valueAtPercentile:99], [latency valueAtPercentile:50], [latency valueAtPercentile:90], [latency valueAtPercentile:99]];
+            }
             SuotaLogOpt(SuotaLibLog.PROTOCOL, TAG, @"%@", msg);
             if (SuotaLibConfig.NOTIFY_SUOTA_LOG)
                 [self.suotaManagerDelegate onSuotaLog:self.state type:INFO log:msg];
@@ -522,11 +796,11 @@ static int const PROGRESS_UPDATE_MILLIS = 1000;
         [self.suotaManagerDelegate onSuotaLog:self.state type:INFO log:@"Send end signal"];
     // End signal notification timeout
     if (SuotaLibConfig.UPLOAD_TIMEOUT > 0)
-        self.timeoutTimer = [NSTimer scheduledTimerWithTimeInterval:((double)SuotaLibConfig.UPLOAD_TIMEOUT / 1000.0) target:self selector:@selector(timeout:) userInfo:nil repeats:false];
+        self.timeoutTimer = [self scheduleTimeout];
     [self.suotaManager executeOperation:[[SendEndSignalOperation alloc] initWithSuotaProtocol:self characteristic:self.suotaManager.memDevCharacteristic]];
 }
 
-- (void) updateCurrentSpeed:(NSTimer*)timer {
+- (void) updateCurrentSpeed {
     [self.suotaManagerDelegate updateCurrentSpeed:self.bytesSent];
     self.bytesSent = 0;
 }
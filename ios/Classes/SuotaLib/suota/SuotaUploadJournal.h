@@ -0,0 +1,150 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+/*!
+ @header SuotaUploadJournal.h
+ @brief Header file for the SuotaUploadJournal class.
+
+ This header file contains method and property declaration for the SuotaUploadJournal class.
+
+ @copyright 2019 Dialog Semiconductor
+ */
+
+#import <Foundation/Foundation.h>
+
+/*!
+ * @class SuotaUploadCheckpoint
+ *
+ * @discussion The progress of an image upload to a peripheral.
+ *
+ */
+@interface SuotaUploadCheckpoint : NSObject
+
+@property (readonly) NSUUID* peripheral;
+/*!
+ * @property imageHash
+ *
+ * @discussion The SHA-256 digest of the SUOTA image.
+ */
+@property (readonly) NSData* imageHash;
+@property (readonly) int size;
+@property (readonly) int blockSize;
+@property (readonly) int memoryDevice;
+@property (readonly) int gpioMap;
+/*!
+ * @property firmwareRevision
+ *
+ * @discussion The firmware revision reported by the device when the upload started, or <code>nil</code> if it was not read.
+ */
+@property (readonly) NSString* firmwareRevision;
+/*!
+ * @property lastBlock
+ *
+ * @discussion The last block acknowledged by the device, or -1 if no block was acknowledged.
+ */
+@property int lastBlock;
+@property (readonly) NSDate* date;
+
+/*!
+ * @method initWithPeripheral:imageHash:size:blockSize:memoryDevice:gpioMap:firmwareRevision:
+ *
+ * @param peripheral The peripheral identifier.
+ * @param imageHash The SHA-256 digest of the image.
+ * @param size The image upload size.
+ * @param blockSize The block size used for the upload.
+ * @param memoryDevice The memory device value written to the device.
+ * @param gpioMap The GPIO map value written to the device.
+ * @param firmwareRevision The device firmware revision, or <code>nil</code> if not available.
+ *
+ * @discussion Creates a new {@link SuotaUploadCheckpoint} with no acknowledged blocks.
+ *
+ */
+- (instancetype) initWithPeripheral:(NSUUID*)peripheral imageHash:(NSData*)imageHash size:(int)size blockSize:(int)blockSize memoryDevice:(int)memoryDevice gpioMap:(int)gpioMap firmwareRevision:(NSString*)firmwareRevision;
+
+/*!
+ * @method isSameUpload:
+ *
+ * @param checkpoint The checkpoint to compare.
+ *
+ * @discussion Checks if both checkpoints refer to the same image, block size and memory settings on the same peripheral. The firmware revision is compared only if it is available on both.
+ */
+- (BOOL) isSameUpload:(SuotaUploadCheckpoint*)checkpoint;
+
+@end
+
+/*!
+ * @class SuotaUploadJournal
+ *
+ * @discussion Persistent record of the last acknowledged block of each interrupted upload, keyed by the peripheral identifier. It is used to resume an upload after the connection is lost.
+ *
+ * The journal is thread safe. Updates are written to disk asynchronously.
+ *
+ */
+@interface SuotaUploadJournal : NSObject
+
+/*!
+ * @property defaultJournal
+ *
+ * @discussion The journal stored at {@link UPLOAD_JOURNAL_PATH}.
+ */
+@property (class, readonly) SuotaUploadJournal* defaultJournal;
+
+/*!
+ * @property journalPath
+ *
+ * @discussion The journal file path.
+ */
+@property (readonly) NSString* journalPath;
+
+/*!
+ * @method initWithJournalPath:
+ *
+ * @param journalPath The journal file path.
+ *
+ * @discussion Creates a new {@link SuotaUploadJournal} instance and loads the stored checkpoints.
+ *
+ */
+- (instancetype) initWithJournalPath:(NSString*)journalPath;
+
+/*!
+ * @method checkpointForPeripheral:
+ *
+ * @param peripheral The peripheral identifier.
+ *
+ * @return The stored checkpoint, or <code>nil</code> if there isn't one.
+ */
+- (SuotaUploadCheckpoint*) checkpointForPeripheral:(NSUUID*)peripheral;
+
+/*!
+ * @method updateCheckpoint:
+ *
+ * @param checkpoint The checkpoint to store.
+ *
+ * @discussion Stores the current state of the checkpoint, replacing any previous checkpoint of the same peripheral.
+ */
+- (void) updateCheckpoint:(SuotaUploadCheckpoint*)checkpoint;
+
+/*!
+ * @method removeCheckpointForPeripheral:
+ *
+ * @param peripheral The peripheral identifier.
+ *
+ * @discussion Removes the stored checkpoint of the peripheral.
+ */
+- (void) removeCheckpointForPeripheral:(NSUUID*)peripheral;
+
+/*!
+ * @method save
+ *
+ * @discussion Writes the journal to disk, if it was modified.
+ */
+- (void) save;
+
+@end
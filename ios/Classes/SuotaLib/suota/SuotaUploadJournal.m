@@ -0,0 +1,207 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+#import "SuotaUploadJournal.h"
+#import "SuotaLibConfig.h"
+#import "SuotaLibLog.h"
+#import "SuotaPropertyListWriter.h"
+#import "SuotaUtils.h"
+
+static NSString* const TAG = @"SuotaUploadJournal";
+
+static int const JOURNAL_VERSION = 2;
+static NSString* const KEY_VERSION = @"version";
+static NSString* const KEY_CHECKPOINTS = @"checkpoints";
+static NSString* const KEY_IMAGE_HASH = @"imageHash";
+static NSString* const KEY_SIZE = @"size";
+static NSString* const KEY_BLOCK_SIZE = @"blockSize";
+static NSString* const KEY_MEMORY_DEVICE = @"memoryDevice";
+static NSString* const KEY_GPIO_MAP = @"gpioMap";
+static NSString* const KEY_FIRMWARE_REVISION = @"firmwareRevision";
+static NSString* const KEY_LAST_BLOCK = @"lastBlock";
+static NSString* const KEY_DATE = @"date";
+
+@interface SuotaUploadCheckpoint ()
+
+@property NSUUID* peripheral;
+@property NSData* imageHash;
+@property int size;
+@property int blockSize;
+@property int memoryDevice;
+@property int gpioMap;
+@property NSString* firmwareRevision;
+@property NSDate* date;
+
+- (instancetype) initWithPeripheral:(NSUUID*)peripheral dictionary:(NSDictionary*)dictionary;
+- (NSDictionary*) dictionary;
+
+@end
+
+@implementation SuotaUploadCheckpoint
+
+- (instancetype) initWithPeripheral:(NSUUID*)peripheral imageHash:(NSData*)imageHash size:(int)size blockSize:(int)blockSize memoryDevice:(int)memoryDevice gpioMap:(int)gpioMap firmwareRevision:(NSString*)firmwareRevision {
+    self = [super init];
+    if (!self)
+        return nil;
+    self.peripheral = peripheral;
+    self.imageHash = imageHash;
+    self.size = size;
+    self.blockSize = blockSize;
+    self.memoryDevice = memoryDevice;
+    self.gpioMap = gpioMap;
+    self.firmwareRevision = firmwareRevision;
+    self.lastBlock = -1;
+    self.date = [NSDate date];
+    return self;
+}
+
+- (instancetype) initWithPeripheral:(NSUUID*)peripheral dictionary:(NSDictionary*)dictionary {
+    self = [super init];
+    if (!self)
+        return nil;
+    for (NSString* key in @[ KEY_SIZE, KEY_BLOCK_SIZE, KEY_MEMORY_DEVICE, KEY_GPIO_MAP, KEY_LAST_BLOCK ]) {
+        if (![dictionary[key] isKindOfClass:NSNumber.class])
+            return nil;
+    }
+    NSData* imageHash = dictionary[KEY_IMAGE_HASH];
+    if (![imageHash isKindOfClass:NSData.class] || !imageHash.length)
+        return nil;
+    self.peripheral = peripheral;
+    self.imageHash = imageHash;
+    self.size = [dictionary[KEY_SIZE] intValue];
+    self.blockSize = [dictionary[KEY_BLOCK_SIZE] intValue];
+    self.memoryDevice = [dictionary[KEY_MEMORY_DEVICE] intValue];
+    self.gpioMap = [dictionary[KEY_GPIO_MAP] intValue];
+    self.lastBlock = [dictionary[KEY_LAST_BLOCK] intValue];
+    NSString* firmwareRevision = dictionary[KEY_FIRMWARE_REVISION];
+    if ([firmwareRevision isKindOfClass:NSString.class])
+        self.firmwareRevision = firmwareRevision;
+    NSDate* date = dictionary[KEY_DATE];
+    self.date = [date isKindOfClass:NSDate.class] ? date : [NSDate distantPast];
+    return self;
+}
+
+- (NSDictionary*) dictionary {
+    NSMutableDictionary* dictionary = [NSMutableDictionary dictionary];
+    dictionary[KEY_IMAGE_HASH] = self.imageHash;
+    dictionary[KEY_SIZE] = @(self.size);
+    dictionary[KEY_BLOCK_SIZE] = @(self.blockSize);
+    dictionary[KEY_MEMORY_DEVICE] = @(self.memoryDevice);
+    dictionary[KEY_GPIO_MAP] = @(self.gpioMap);
+    dictionary[KEY_LAST_BLOCK] = @(self.lastBlock);
+    dictionary[KEY_DATE] = self.date;
+    if (self.firmwareRevision)
+        dictionary[KEY_FIRMWARE_REVISION] = self.firmwareRevision;
+    return dictionary;
+}
+
+- (BOOL) isSameUpload:(SuotaUploadCheckpoint*)checkpoint {
+    return [self.peripheral isEqual:checkpoint.peripheral]
+        && self.imageHash.length && [self.imageHash isEqualToData:checkpoint.imageHash]
+        && self.size == checkpoint.size
+        && self.blockSize == checkpoint.blockSize
+        && self.memoryDevice == checkpoint.memoryDevice
+        && self.gpioMap == checkpoint.gpioMap
+        && (!self.firmwareRevision || !checkpoint.firmwareRevision || [self.firmwareRevision isEqualToString:checkpoint.firmwareRevision]);
+}
+
+- (NSString*) description {
+    return [NSString stringWithFormat:@"%@: image %@, size %d, block size %d, last block %d", self.peripheral.UUIDString, [SuotaUtils hexArray:self.imageHash], self.size, self.blockSize, self.lastBlock];
+}
+
+@end
+
+
+@interface SuotaUploadJournal ()
+
+@property NSString* journalPath;
+@property NSMutableDictionary<NSString*, NSDictionary*>* checkpoints;
+@property SuotaPropertyListWriter* writer;
+
+@end
+
+@implementation SuotaUploadJournal
+
++ (SuotaUploadJournal*) defaultJournal {
+    static SuotaUploadJournal* defaultJournal;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        defaultJournal = [[SuotaUploadJournal alloc] initWithJournalPath:SuotaLibConfig.UPLOAD_JOURNAL_PATH];
+    });
+    return defaultJournal;
+}
+
+- (instancetype) initWithJournalPath:(NSString*)journalPath {
+    self = [super init];
+    if (!self)
+        return nil;
+    self.journalPath = journalPath;
+    self.checkpoints = [NSMutableDictionary dictionary];
+    __weak SuotaUploadJournal* weakSelf = self;
+    self.writer = [[SuotaPropertyListWriter alloc] initWithPath:journalPath name:@"SuotaUploadJournal" snapshot:^NSDictionary* {
+        return [weakSelf propertyList];
+    }];
+    [self load];
+    return self;
+}
+
+- (void) load {
+    NSData* data = [NSData dataWithContentsOfFile:self.journalPath];
+    if (!data)
+        return;
+    NSError* error;
+    NSDictionary* journal = [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:nil error:&error];
+    if (![journal isKindOfClass:NSDictionary.class] || [journal[KEY_VERSION] intValue] != JOURNAL_VERSION) {
+        SuotaLogOpt(SuotaLibLog.PROTOCOL, TAG, @"Ignoring invalid journal: %@ %@", self.journalPath, error ? error.localizedDescription : @"");
+        return;
+    }
+    NSDictionary* checkpoints = journal[KEY_CHECKPOINTS];
+    if (![checkpoints isKindOfClass:NSDictionary.class])
+        return;
+    for (NSString* key in checkpoints) {
+        if ([checkpoints[key] isKindOfClass:NSDictionary.class])
+            self.checkpoints[key] = checkpoints[key];
+    }
+}
+
+- (SuotaUploadCheckpoint*) checkpointForPeripheral:(NSUUID*)peripheral {
+    @synchronized (self) {
+        NSDictionary* dictionary = self.checkpoints[peripheral.UUIDString];
+        return dictionary ? [[SuotaUploadCheckpoint alloc] initWithPeripheral:peripheral dictionary:dictionary] : nil;
+    }
+}
+
+- (void) updateCheckpoint:(SuotaUploadCheckpoint*)checkpoint {
+    @synchronized (self) {
+        self.checkpoints[checkpoint.peripheral.UUIDString] = checkpoint.dictionary;
+        [self.writer saveLater];
+    }
+}
+
+- (void) removeCheckpointForPeripheral:(NSUUID*)peripheral {
+    @synchronized (self) {
+        if (!self.checkpoints[peripheral.UUIDString])
+            return;
+        [self.checkpoints removeObjectForKey:peripheral.UUIDString];
+        [self.writer saveLater];
+    }
+}
+
+- (void) save {
+    [self.writer save];
+}
+
+- (NSDictionary*) propertyList {
+    @synchronized (self) {
+        return @{ KEY_VERSION : @(JOURNAL_VERSION), KEY_CHECKPOINTS : [self.checkpoints copy] };
+    }
+}
+
+@end
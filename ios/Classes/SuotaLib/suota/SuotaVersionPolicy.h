@@ -0,0 +1,135 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+/*!
+ @header SuotaVersionPolicy.h
+ @brief Header file for the SuotaVersionPolicy class.
+
+ This header file contains method and property declaration for the SuotaVersionPolicy class.
+
+ @copyright 2019 Dialog Semiconductor
+ */
+
+#import <Foundation/Foundation.h>
+
+@class HeaderInfo;
+
+/*!
+ * @protocol SuotaUpdatePolicy
+ *
+ * @discussion Decides before the upload whether the device already runs the firmware of the selected file.
+ */
+@protocol SuotaUpdatePolicy <NSObject>
+
+/*!
+ * @method isFirmwareCurrent:firmwareRevision:softwareRevision:
+ *
+ * @param headerInfo The header info of the selected firmware file.
+ * @param firmwareRevision The firmware revision read from the device, or <code>nil</code> if it was not read.
+ * @param softwareRevision The software revision read from the device, or <code>nil</code> if it was not read.
+ *
+ * @return <code>true</code> if the update should be skipped.
+ */
+- (BOOL) isFirmwareCurrent:(HeaderInfo*)headerInfo firmwareRevision:(NSString*)firmwareRevision softwareRevision:(NSString*)softwareRevision;
+
+@end
+
+enum SuotaVersionComparison {
+    // The image version string equals the device revision
+    VERSION_EXACT,
+    // The timestamp found in the device revision equals the image timestamp
+    VERSION_TIMESTAMP,
+    // The version number found in the device revision equals the image version number
+    VERSION_SEMANTIC,
+};
+
+enum SuotaRevisionField {
+    // Device Information Service firmware revision. On many devices this is the SDK version.
+    REVISION_FIRMWARE,
+    // Device Information Service software revision
+    REVISION_SOFTWARE,
+};
+
+/*!
+ * @class SuotaVersionPolicy
+ *
+ * @discussion Built-in {@link SuotaUpdatePolicy} that compares the image header version or timestamp with one revision of the device. The device is current if the revision matches the image.
+ *
+ * The timestamp and semantic comparisons can also skip images older than the running firmware, if {@link allowNewer} is set.
+ *
+ */
+@interface SuotaVersionPolicy : NSObject <SuotaUpdatePolicy>
+
+@property (readonly) enum SuotaVersionComparison comparison;
+/*!
+ * @property field
+ *
+ * @discussion The device revision compared with the image.
+ */
+@property (readonly) enum SuotaRevisionField field;
+/*!
+ * @property allowNewer
+ *
+ * @discussion If <code>true</code>, a device running a newer timestamp or version than the image is also current. Ignored by the exact comparison.
+ */
+@property (readonly) BOOL allowNewer;
+
+/*!
+ * @method initWithComparison:field:allowNewer:
+ *
+ * @param comparison The comparison to use.
+ * @param field The device revision to compare.
+ * @param allowNewer Indicates if a newer device revision is current.
+ *
+ * @discussion Creates a new {@link SuotaVersionPolicy} instance.
+ *
+ */
+- (instancetype) initWithComparison:(enum SuotaVersionComparison)comparison field:(enum SuotaRevisionField)field allowNewer:(BOOL)allowNewer;
+
+/*!
+ * @method initWithComparison:
+ *
+ * @param comparison The comparison to use.
+ *
+ * @discussion Creates a new {@link SuotaVersionPolicy} instance, which compares the software revision and requires a match.
+ *
+ */
+- (instancetype) initWithComparison:(enum SuotaVersionComparison)comparison;
+
++ (SuotaVersionPolicy*) exactVersionPolicy;
++ (SuotaVersionPolicy*) timestampPolicy;
++ (SuotaVersionPolicy*) semanticVersionPolicy;
+
+/*!
+ * @method parseSemanticVersion:
+ *
+ * @param version The version string, for example <code>v_6.0.14.1114</code>.
+ *
+ * @return The numeric components of the first dot separated number in the string, or <code>nil</code> if there is none. Any prefix or suffix is ignored.
+ */
++ (NSArray<NSNumber*>*) parseSemanticVersion:(NSString*)version;
+
+/*!
+ * @method compareSemanticVersion:to:
+ *
+ * @discussion Compares two versions component by component. Missing components count as 0.
+ */
++ (NSComparisonResult) compareSemanticVersion:(NSArray<NSNumber*>*)version to:(NSArray<NSNumber*>*)other;
+
+/*!
+ * @method parseTimestamp:
+ *
+ * @param revision The revision string.
+ *
+ * @return The first 9 or 10 digit number in the string, as seconds since 1970, or 0 if there is none.
+ */
++ (uint64_t) parseTimestamp:(NSString*)revision;
+
+@end
@@ -0,0 +1,127 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+#import "SuotaVersionPolicy.h"
+#import "HeaderInfo.h"
+#import "SuotaLibLog.h"
+
+static NSString* const TAG = @"SuotaVersionPolicy";
+
+static NSRegularExpression* semanticVersionPattern;
+static NSRegularExpression* timestampPattern;
+
+@interface SuotaVersionPolicy ()
+
+@property enum SuotaVersionComparison comparison;
+@property enum SuotaRevisionField field;
+@property BOOL allowNewer;
+
+@end
+
+@implementation SuotaVersionPolicy
+
++ (void) initialize {
+    if (self != SuotaVersionPolicy.class)
+        return;
+
+    semanticVersionPattern = [NSRegularExpression regularExpressionWithPattern:@"\\d+(?:\\.\\d+)+" options:0 error:nil];
+    timestampPattern = [NSRegularExpression regularExpressionWithPattern:@"(?<!\\d)\\d{9,10}(?!\\d)" options:0 error:nil];
+}
+
+- (instancetype) initWithComparison:(enum SuotaVersionComparison)comparison field:(enum SuotaRevisionField)field allowNewer:(BOOL)allowNewer {
+    self = [super init];
+    if (!self)
+        return nil;
+    self.comparison = comparison;
+    self.field = field;
+    self.allowNewer = allowNewer;
+    return self;
+}
+
+- (instancetype) initWithComparison:(enum SuotaVersionComparison)comparison {
+    return [self initWithComparison:comparison field:REVISION_SOFTWARE allowNewer:false];
+}
+
++ (SuotaVersionPolicy*) exactVersionPolicy {
+    return [[SuotaVersionPolicy alloc] initWithComparison:VERSION_EXACT];
+}
+
++ (SuotaVersionPolicy*) timestampPolicy {
+    return [[SuotaVersionPolicy alloc] initWithComparison:VERSION_TIMESTAMP];
+}
+
++ (SuotaVersionPolicy*) semanticVersionPolicy {
+    return [[SuotaVersionPolicy alloc] initWithComparison:VERSION_SEMANTIC];
+}
+
+- (BOOL) isFirmwareCurrent:(HeaderInfo*)headerInfo firmwareRevision:(NSString*)firmwareRevision softwareRevision:(NSString*)softwareRevision {
+    NSString* revision = self.field == REVISION_FIRMWARE ? firmwareRevision : softwareRevision;
+    if (!headerInfo || !revision.length || ![self isRevision:revision current:headerInfo])
+        return false;
+    SuotaLogOpt(SuotaLibLog.MANAGER, TAG, @"Device revision %@ matches image %@ (%llu)", revision, headerInfo.version, headerInfo.timestamp);
+    return true;
+}
+
+- (BOOL) isRevision:(NSString*)revision current:(HeaderInfo*)headerInfo {
+    switch (self.comparison) {
+        case VERSION_EXACT: {
+            NSCharacterSet* trim = NSCharacterSet.whitespaceAndNewlineCharacterSet;
+            NSString* version = [headerInfo.version stringByTrimmingCharactersInSet:trim];
+            return version.length && [[revision stringByTrimmingCharactersInSet:trim] isEqualToString:version];
+        }
+
+        case VERSION_TIMESTAMP: {
+            uint64_t timestamp = [SuotaVersionPolicy parseTimestamp:revision];
+            return timestamp && headerInfo.timestamp && (timestamp == headerInfo.timestamp || (self.allowNewer && timestamp > headerInfo.timestamp));
+        }
+
+        case VERSION_SEMANTIC: {
+            NSArray<NSNumber*>* deviceVersion = [SuotaVersionPolicy parseSemanticVersion:revision];
+            NSArray<NSNumber*>* imageVersion = [SuotaVersionPolicy parseSemanticVersion:headerInfo.version];
+            if (!deviceVersion || !imageVersion)
+                return false;
+            NSComparisonResult result = [SuotaVersionPolicy compareSemanticVersion:deviceVersion to:imageVersion];
+            return result == NSOrderedSame || (self.allowNewer && result == NSOrderedDescending);
+        }
+    }
+    return false;
+}
+
++ (NSArray<NSNumber*>*) parseSemanticVersion:(NSString*)version {
+    if (!version)
+        return nil;
+    NSTextCheckingResult* match = [semanticVersionPattern firstMatchInString:version options:0 range:NSMakeRange(0, version.length)];
+    if (!match)
+        return nil;
+    NSMutableArray<NSNumber*>* components = [NSMutableArray array];
+    for (NSString* component in [[version substringWithRange:match.range] componentsSeparatedByString:@"."])
+        [components addObject:@(component.longLongValue)];
+    return components;
+}
+
++ (NSComparisonResult) compareSemanticVersion:(NSArray<NSNumber*>*)version to:(NSArray<NSNumber*>*)other {
+    NSUInteger count = MAX(version.count, other.count);
+    for (NSUInteger i = 0; i < count; i++) {
+        long long a = i < version.count ? version[i].longLongValue : 0;
+        long long b = i < other.count ? other[i].longLongValue : 0;
+        if (a != b)
+            return a < b ? NSOrderedAscending : NSOrderedDescending;
+    }
+    return NSOrderedSame;
+}
+
++ (uint64_t) parseTimestamp:(NSString*)revision {
+    if (!revision)
+        return 0;
+    NSTextCheckingResult* match = [timestampPattern firstMatchInString:revision options:0 range:NSMakeRange(0, revision.length)];
+    return match ? (uint64_t)[revision substringWithRange:match.range].longLongValue : 0;
+}
+
+@end
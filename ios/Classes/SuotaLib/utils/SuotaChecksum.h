@@ -0,0 +1,94 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+/*!
+ @header SuotaChecksum.h
+ @brief Header file for the SuotaChecksum class.
+
+ This header file contains method declarations for the firmware checksum kernels.
+
+ @copyright 2019 Dialog Semiconductor
+ */
+
+#import <Foundation/Foundation.h>
+
+/*!
+ * @class SuotaChecksum
+ *
+ * @discussion Checksum kernels used for firmware image validation. The fastest implementation available on the running CPU is selected once, at class initialization. NEON is used on ARM, SSE2/AVX2 on x86. CRC32 uses the ARMv8 CRC32 instructions if the CPU supports them, otherwise zlib.
+ *
+ */
+@interface SuotaChecksum : NSObject
+
+/*!
+ * @property xorKernelName
+ *
+ * @discussion Name of the selected XOR checksum implementation.
+ */
+@property (class, readonly) NSString* xorKernelName;
+
+/*!
+ * @property crc32KernelName
+ *
+ * @discussion Name of the selected CRC32 implementation.
+ */
+@property (class, readonly) NSString* crc32KernelName;
+
+/*!
+ * @method xorChecksum:length:
+ *
+ * @param bytes The buffer.
+ * @param length The buffer length.
+ *
+ * @discussion Calculates the XOR of all the bytes in the buffer. This is the SUOTA firmware CRC.
+ *
+ * @return The XOR checksum.
+ */
++ (uint8_t) xorChecksum:(const uint8_t*)bytes length:(NSUInteger)length;
+
+/*!
+ * @method crc32:bytes:length:
+ *
+ * @param crc The current CRC value. Use <code>0</code> for the first call.
+ * @param bytes The buffer.
+ * @param length The buffer length.
+ *
+ * @discussion Updates a CRC32 value with the bytes of the buffer. The result is identical to the zlib <code>crc32</code> function.
+ *
+ * @return The updated CRC32 value.
+ */
++ (uint32_t) crc32:(uint32_t)crc bytes:(const uint8_t*)bytes length:(NSUInteger)length;
+
+/*!
+ * @method sha256:
+ *
+ * @param data The data.
+ *
+ * @discussion Calculates the SHA-256 digest of the data. Used to identify firmware images, where the SUOTA CRC is too weak.
+ *
+ * @return The 32 byte digest.
+ */
++ (NSData*) sha256:(NSData*)data;
+
+/*!
+ * @method xorChecksumReference:length:
+ *
+ * @discussion Byte at a time XOR checksum. Used as reference for validation and benchmarks.
+ */
++ (uint8_t) xorChecksumReference:(const uint8_t*)bytes length:(NSUInteger)length;
+
+/*!
+ * @method crc32Reference:bytes:length:
+ *
+ * @discussion zlib CRC32. Used as reference for validation and benchmarks.
+ */
++ (uint32_t) crc32Reference:(uint32_t)crc bytes:(const uint8_t*)bytes length:(NSUInteger)length;
+
+@end
@@ -0,0 +1,220 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+#import "SuotaChecksum.h"
+#import <zlib.h>
+#import <CommonCrypto/CommonDigest.h>
+#import <sys/sysctl.h>
+#import "SuotaLibLog.h"
+
+#if defined(__ARM_NEON)
+#import <arm_neon.h>
+#endif
+#if defined(__aarch64__)
+#import <arm_acle.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#import <immintrin.h>
+#endif
+
+typedef uint8_t (*SuotaXorKernel)(const uint8_t* bytes, size_t length);
+typedef uint32_t (*SuotaCrc32Kernel)(uint32_t crc, const uint8_t* bytes, size_t length);
+
+static SuotaXorKernel xorKernel;
+static SuotaCrc32Kernel crc32Kernel;
+static NSString* xorKernelName;
+static NSString* crc32KernelName;
+
+static inline uint8_t fold64(uint64_t v) {
+    v ^= v >> 32;
+    v ^= v >> 16;
+    v ^= v >> 8;
+    return (uint8_t) v;
+}
+
+static uint8_t xorScalar(const uint8_t* bytes, size_t length) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < length; i++)
+        crc ^= bytes[i];
+    return crc;
+}
+
+static uint8_t xorWord(const uint8_t* bytes, size_t length) {
+    uint64_t acc = 0;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        acc ^= word;
+    }
+    return fold64(acc) ^ xorScalar(bytes + i, length - i);
+}
+
+#if defined(__ARM_NEON)
+static uint8_t xorNeon(const uint8_t* bytes, size_t length) {
+    uint8x16_t acc0 = vdupq_n_u8(0), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64) {
+        acc0 = veorq_u8(acc0, vld1q_u8(bytes + i));
+        acc1 = veorq_u8(acc1, vld1q_u8(bytes + i + 16));
+        acc2 = veorq_u8(acc2, vld1q_u8(bytes + i + 32));
+        acc3 = veorq_u8(acc3, vld1q_u8(bytes + i + 48));
+    }
+    for (; i + 16 <= length; i += 16)
+        acc0 = veorq_u8(acc0, vld1q_u8(bytes + i));
+    uint64x2_t acc = vreinterpretq_u64_u8(veorq_u8(veorq_u8(acc0, acc1), veorq_u8(acc2, acc3)));
+    return fold64(vgetq_lane_u64(acc, 0) ^ vgetq_lane_u64(acc, 1)) ^ xorScalar(bytes + i, length - i);
+}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+static uint8_t xorSse2(const uint8_t* bytes, size_t length) {
+    __m128i acc0 = _mm_setzero_si128(), acc1 = acc0;
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        acc0 = _mm_xor_si128(acc0, _mm_loadu_si128((const __m128i*)(bytes + i)));
+        acc1 = _mm_xor_si128(acc1, _mm_loadu_si128((const __m128i*)(bytes + i + 16)));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, _mm_xor_si128(acc0, acc1));
+    return fold64(lanes[0] ^ lanes[1]) ^ xorWord(bytes + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static uint8_t xorAvx2(const uint8_t* bytes, size_t length) {
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = acc0;
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64) {
+        acc0 = _mm256_xor_si256(acc0, _mm256_loadu_si256((const __m256i*)(bytes + i)));
+        acc1 = _mm256_xor_si256(acc1, _mm256_loadu_si256((const __m256i*)(bytes + i + 32)));
+    }
+    __m256i acc = _mm256_xor_si256(acc0, acc1);
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i*)lanes, _mm_xor_si128(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1)));
+    return fold64(lanes[0] ^ lanes[1]) ^ xorWord(bytes + i, length - i);
+}
+#endif
+
+static uint32_t crc32Zlib(uint32_t crc, const uint8_t* bytes, size_t length) {
+    uLong value = crc;
+    while (length) {
+        uInt size = (uInt) MIN(length, (size_t) UINT32_MAX);
+        value = crc32(value, bytes, size);
+        bytes += size;
+        length -= size;
+    }
+    return (uint32_t) value;
+}
+
+#if defined(__aarch64__)
+// The ARMv8 CRC32 instructions use the same polynomial as zlib (0x04C11DB7, reflected).
+__attribute__((target("crc")))
+static uint32_t crc32Armv8(uint32_t crc, const uint8_t* bytes, size_t length) {
+    crc = ~crc;
+    while (length && ((uintptr_t)bytes & 7)) {
+        crc = __crc32b(crc, *bytes++);
+        length--;
+    }
+    uint64_t word;
+    for (; length >= 32; length -= 32, bytes += 32) {
+        memcpy(&word, bytes, 8);
+        crc = __crc32d(crc, word);
+        memcpy(&word, bytes + 8, 8);
+        crc = __crc32d(crc, word);
+        memcpy(&word, bytes + 16, 8);
+        crc = __crc32d(crc, word);
+        memcpy(&word, bytes + 24, 8);
+        crc = __crc32d(crc, word);
+    }
+    for (; length >= 8; length -= 8, bytes += 8) {
+        memcpy(&word, bytes, 8);
+        crc = __crc32d(crc, word);
+    }
+    while (length--)
+        crc = __crc32b(crc, *bytes++);
+    return ~crc;
+}
+
+static BOOL hasArmv8Crc32(void) {
+    int value = 0;
+    size_t size = sizeof(value);
+    return sysctlbyname("hw.optional.armv8_crc32", &value, &size, NULL, 0) == 0 && value;
+}
+#endif
+
+@implementation SuotaChecksum
+
+static NSString* const TAG = @"SuotaChecksum";
+
++ (void) initialize {
+    if (self != SuotaChecksum.class)
+        return;
+
+    xorKernel = xorWord;
+    xorKernelName = @"word";
+#if defined(__ARM_NEON)
+    xorKernel = xorNeon;
+    xorKernelName = @"neon";
+#elif defined(__x86_64__) || defined(__i386__)
+    xorKernel = xorSse2;
+    xorKernelName = @"sse2";
+    if (__builtin_cpu_supports("avx2")) {
+        xorKernel = xorAvx2;
+        xorKernelName = @"avx2";
+    }
+#endif
+
+    crc32Kernel = crc32Zlib;
+    crc32KernelName = @"zlib";
+#if defined(__aarch64__)
+    if (hasArmv8Crc32()) {
+        crc32Kernel = crc32Armv8;
+        crc32KernelName = @"armv8-crc32";
+    }
+#endif
+    SuotaLogOpt(SuotaLibLog.SUOTA_FILE, TAG, @"Checksum kernels: xor=%@ crc32=%@", xorKernelName, crc32KernelName);
+}
+
++ (NSString*) xorKernelName {
+    return xorKernelName;
+}
+
++ (NSString*) crc32KernelName {
+    return crc32KernelName;
+}
+
++ (uint8_t) xorChecksum:(const uint8_t*)bytes length:(NSUInteger)length {
+    return xorKernel(bytes, length);
+}
+
++ (uint32_t) crc32:(uint32_t)crc bytes:(const uint8_t*)bytes length:(NSUInteger)length {
+    return crc32Kernel(crc, bytes, length);
+}
+
++ (NSData*) sha256:(NSData*)data {
+    NSMutableData* digest = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_CTX context;
+    CC_SHA256_Init(&context);
+    // CC_LONG is 32 bit
+    for (NSUInteger offset = 0; offset < data.length; offset += UINT32_MAX)
+        CC_SHA256_Update(&context, (const uint8_t*) data.bytes + offset, (CC_LONG) MIN(data.length - offset, UINT32_MAX));
+    CC_SHA256_Final(digest.mutableBytes, &context);
+    return digest;
+}
+
++ (uint8_t) xorChecksumReference:(const uint8_t*)bytes length:(NSUInteger)length {
+    return xorScalar(bytes, length);
+}
+
++ (uint32_t) crc32Reference:(uint32_t)crc bytes:(const uint8_t*)bytes length:(NSUInteger)length {
+    return crc32Zlib(crc, bytes, length);
+}
+
+@end
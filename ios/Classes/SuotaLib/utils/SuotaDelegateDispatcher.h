@@ -0,0 +1,57 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+/*!
+ @header SuotaDelegateDispatcher.h
+ @brief Header file for the SuotaDelegateDispatcher class.
+
+ This header file contains method and property declaration for the SuotaDelegateDispatcher class.
+
+ @copyright 2019 Dialog Semiconductor
+ */
+
+#import <Foundation/Foundation.h>
+
+/*!
+ * @class SuotaDelegateDispatcher
+ *
+ * @discussion Proxy that forwards the methods of a delegate protocol to the target on the delegate queue.
+ *
+ * Calls made on the main thread, while the delegate queue is the main queue, are forwarded immediately. Otherwise, the call is dispatched asynchronously, so the methods must not return a value. Calls made from the same queue are delivered in order. Methods are not forwarded if the target has been released.
+ *
+ */
+@interface SuotaDelegateDispatcher : NSProxy
+
+/*!
+ * @property target
+ *
+ * @discussion The delegate. It is not retained.
+ */
+@property (weak) id target;
+/*!
+ * @property queue
+ *
+ * @discussion The queue on which the delegate methods are called.
+ */
+@property dispatch_queue_t queue;
+
+/*!
+ * @method initWithProtocol:target:queue:
+ *
+ * @param protocol The delegate protocol.
+ * @param target The delegate.
+ * @param queue The queue on which the delegate methods are called.
+ *
+ * @discussion Creates a new {@link SuotaDelegateDispatcher} instance.
+ *
+ */
+- (instancetype) initWithProtocol:(Protocol*)protocol target:(id)target queue:(dispatch_queue_t)queue;
+
+@end
@@ -0,0 +1,55 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+#import "SuotaDelegateDispatcher.h"
+#import <objc/runtime.h>
+
+@implementation SuotaDelegateDispatcher {
+    Protocol* protocol;
+}
+
+- (instancetype) initWithProtocol:(Protocol*)delegateProtocol target:(id)target queue:(dispatch_queue_t)queue {
+    protocol = delegateProtocol;
+    self.target = target;
+    self.queue = queue;
+    return self;
+}
+
+- (BOOL) respondsToSelector:(SEL)selector {
+    return [self.target respondsToSelector:selector];
+}
+
+- (NSMethodSignature*) methodSignatureForSelector:(SEL)selector {
+    // The signature is taken from the protocol, so that calls are accepted even if the target is released
+    struct objc_method_description description = protocol_getMethodDescription(protocol, selector, true, true);
+    if (!description.types)
+        description = protocol_getMethodDescription(protocol, selector, false, true);
+    return description.types ? [NSMethodSignature signatureWithObjCTypes:description.types] : nil;
+}
+
+- (void) forwardInvocation:(NSInvocation*)invocation {
+    dispatch_queue_t queue = self.queue;
+    if (queue == dispatch_get_main_queue() && NSThread.isMainThread) {
+        [self invoke:invocation];
+        return;
+    }
+    [invocation retainArguments];
+    dispatch_async(queue, ^{
+        [self invoke:invocation];
+    });
+}
+
+- (void) invoke:(NSInvocation*)invocation {
+    id target = self.target;
+    if ([target respondsToSelector:invocation.selector])
+        [invocation invokeWithTarget:target];
+}
+
+@end
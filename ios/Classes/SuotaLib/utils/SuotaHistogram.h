@@ -0,0 +1,97 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+/*!
+ @header SuotaHistogram.h
+ @brief Header file for the SuotaHistogram class.
+
+ This header file contains method and property declaration for the SuotaHistogram class.
+
+ @copyright 2019 Dialog Semiconductor
+ */
+
+#import <Foundation/Foundation.h>
+
+/*!
+ * @class SuotaHistogram
+ *
+ * @discussion Fixed size streaming histogram of integer values, with log bucketed ranges like an HDR histogram. Each power of two range is split in 32 linear buckets, so values are reported with a relative error of at most 1 / 32, and values below 64 are exact. Memory use does not depend on the number of recorded values.
+ *
+ * Histograms can be merged, and encoded with {@link data} to be aggregated elsewhere, for example across the devices of a fleet update.
+ *
+ * The histogram is thread safe.
+ *
+ */
+@interface SuotaHistogram : NSObject <NSCopying>
+
+/*!
+ * @property maxValue
+ *
+ * @discussion The highest value that can be recorded. Higher values are recorded as this value.
+ */
+@property (class, readonly) uint64_t maxValue;
+
+@property (readonly) uint64_t count;
+@property (readonly) uint64_t min;
+@property (readonly) uint64_t max;
+/*!
+ * @property mean
+ *
+ * @discussion The exact mean of the recorded values, or 0 if the histogram is empty.
+ */
+@property (readonly) double mean;
+
+/*!
+ * @method histogramWithData:
+ *
+ * @param data A histogram encoded by {@link data}.
+ *
+ * @return The decoded histogram, or <code>nil</code> if the data is invalid.
+ */
++ (SuotaHistogram*) histogramWithData:(NSData*)data;
+
+/*!
+ * @method recordValue:
+ *
+ * @param value The value to record.
+ */
+- (void) recordValue:(uint64_t)value;
+
+/*!
+ * @method valueAtPercentile:
+ *
+ * @param percentile The percentile, from 0 to 100.
+ *
+ * @return The highest value of the bucket that contains the percentile, limited to the recorded range, or 0 if the histogram is empty.
+ */
+- (uint64_t) valueAtPercentile:(double)percentile;
+
+/*!
+ * @method merge:
+ *
+ * @param other The histogram to add to this one.
+ */
+- (void) merge:(SuotaHistogram*)other;
+
+/*!
+ * @method data
+ *
+ * @discussion Encodes the histogram in a compact, platform independent format, which contains only the buckets that are not empty.
+ */
+- (NSData*) data;
+
+/*!
+ * @method reset
+ *
+ * @discussion Removes all the recorded values.
+ */
+- (void) reset;
+
+@end
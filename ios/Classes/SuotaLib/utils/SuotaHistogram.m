@@ -0,0 +1,205 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+#import "SuotaHistogram.h"
+#import <libkern/OSByteOrder.h>
+
+// Each power of two range above 2^SUB_BUCKET_BITS has SUB_BUCKET_COUNT buckets
+static int const SUB_BUCKET_BITS = 5;
+static int const SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+static int const MAX_VALUE_BITS = 40;
+static int const BUCKET_COUNT = (MAX_VALUE_BITS + 1 - SUB_BUCKET_BITS) * SUB_BUCKET_COUNT;
+
+static uint8_t const DATA_VERSION = 1;
+// Version, sub bucket bits, max value bits, reserved, count, min, max, sum, number of buckets
+static NSUInteger const DATA_HEADER_SIZE = 4 + 4 * 8 + 2;
+// Index, count
+static NSUInteger const DATA_BUCKET_SIZE = 2 + 8;
+
+static int bucketIndex(uint64_t value) {
+    if (value < 2 * SUB_BUCKET_COUNT)
+        return (int) value;
+    int shift = 63 - __builtin_clzll(value) - SUB_BUCKET_BITS;
+    return (shift + 1) * SUB_BUCKET_COUNT + (int)((value >> shift) - SUB_BUCKET_COUNT);
+}
+
+static uint64_t bucketHighestValue(int index) {
+    if (index < 2 * SUB_BUCKET_COUNT)
+        return index;
+    int shift = index / SUB_BUCKET_COUNT - 1;
+    uint64_t base = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+    return ((base + 1) << shift) - 1;
+}
+
+@implementation SuotaHistogram {
+    uint64_t buckets[BUCKET_COUNT];
+    uint64_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+}
+
++ (uint64_t) maxValue {
+    return (1ULL << MAX_VALUE_BITS) - 1;
+}
+
++ (SuotaHistogram*) histogramWithData:(NSData*)data {
+    const uint8_t* bytes = data.bytes;
+    if (data.length < DATA_HEADER_SIZE || bytes[0] != DATA_VERSION || bytes[1] != SUB_BUCKET_BITS || bytes[2] != MAX_VALUE_BITS)
+        return nil;
+    uint16_t entries = OSReadLittleInt16(bytes, 36);
+    if (data.length != DATA_HEADER_SIZE + entries * DATA_BUCKET_SIZE)
+        return nil;
+
+    SuotaHistogram* histogram = [[SuotaHistogram alloc] init];
+    uint64_t total = 0;
+    for (int i = 0; i < entries; i++) {
+        const uint8_t* entry = bytes + DATA_HEADER_SIZE + i * DATA_BUCKET_SIZE;
+        uint16_t index = OSReadLittleInt16(entry, 0);
+        uint64_t bucketCount = OSReadLittleInt64(entry, 2);
+        if (index >= BUCKET_COUNT)
+            return nil;
+        histogram->buckets[index] += bucketCount;
+        total += bucketCount;
+    }
+    if (total != OSReadLittleInt64(bytes, 4))
+        return nil;
+    histogram->count = total;
+    histogram->min = OSReadLittleInt64(bytes, 12);
+    histogram->max = OSReadLittleInt64(bytes, 20);
+    histogram->sum = OSReadLittleInt64(bytes, 28);
+    return histogram;
+}
+
+- (id) copyWithZone:(NSZone*)zone {
+    SuotaHistogram* copy = [[SuotaHistogram alloc] init];
+    [copy merge:self];
+    return copy;
+}
+
+- (void) recordValue:(uint64_t)value {
+    value = MIN(value, SuotaHistogram.maxValue);
+    @synchronized (self) {
+        buckets[bucketIndex(value)]++;
+        min = count ? MIN(min, value) : value;
+        max = count ? MAX(max, value) : value;
+        count++;
+        sum += value;
+    }
+}
+
+- (uint64_t) count {
+    @synchronized (self) {
+        return count;
+    }
+}
+
+- (uint64_t) min {
+    @synchronized (self) {
+        return min;
+    }
+}
+
+- (uint64_t) max {
+    @synchronized (self) {
+        return max;
+    }
+}
+
+- (double) mean {
+    @synchronized (self) {
+        return count ? (double) sum / count : 0;
+    }
+}
+
+- (uint64_t) valueAtPercentile:(double)percentile {
+    @synchronized (self) {
+        if (!count)
+            return 0;
+        uint64_t rank = MAX((uint64_t) ceil(MIN(MAX(percentile, 0), 100) / 100 * count), 1);
+        uint64_t total = 0;
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            total += buckets[i];
+            if (total >= rank)
+                return MAX(MIN(bucketHighestValue(i), max), min);
+        }
+        return max;
+    }
+}
+
+- (void) merge:(SuotaHistogram*)other {
+    if (!other || other == self)
+        return;
+    // Copied first, so that the two locks are never held together
+    uint64_t otherBuckets[BUCKET_COUNT];
+    uint64_t otherCount, otherMin, otherMax, otherSum;
+    @synchronized (other) {
+        memcpy(otherBuckets, other->buckets, sizeof(otherBuckets));
+        otherCount = other->count;
+        otherMin = other->min;
+        otherMax = other->max;
+        otherSum = other->sum;
+    }
+    if (!otherCount)
+        return;
+    @synchronized (self) {
+        for (int i = 0; i < BUCKET_COUNT; i++)
+            buckets[i] += otherBuckets[i];
+        min = count ? MIN(min, otherMin) : otherMin;
+        max = count ? MAX(max, otherMax) : otherMax;
+        count += otherCount;
+        sum += otherSum;
+    }
+}
+
+- (NSData*) data {
+    @synchronized (self) {
+        uint16_t entries = 0;
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            if (buckets[i])
+                entries++;
+        }
+        NSMutableData* data = [NSMutableData dataWithLength:DATA_HEADER_SIZE + entries * DATA_BUCKET_SIZE];
+        uint8_t* bytes = data.mutableBytes;
+        bytes[0] = DATA_VERSION;
+        bytes[1] = SUB_BUCKET_BITS;
+        bytes[2] = MAX_VALUE_BITS;
+        OSWriteLittleInt64(bytes, 4, count);
+        OSWriteLittleInt64(bytes, 12, min);
+        OSWriteLittleInt64(bytes, 20, max);
+        OSWriteLittleInt64(bytes, 28, sum);
+        OSWriteLittleInt16(bytes, 36, entries);
+        uint8_t* entry = bytes + DATA_HEADER_SIZE;
+        for (int i = 0; i < BUCKET_COUNT; i++) {
+            if (!buckets[i])
+                continue;
+            OSWriteLittleInt16(entry, 0, (uint16_t) i);
+            OSWriteLittleInt64(entry, 2, buckets[i]);
+            entry += DATA_BUCKET_SIZE;
+        }
+        return data;
+    }
+}
+
+- (void) reset {
+    @synchronized (self) {
+        memset(buckets, 0, sizeof(buckets));
+        count = 0;
+        min = 0;
+        max = 0;
+        sum = 0;
+    }
+}
+
+- (NSString*) description {
+    return [NSString stringWithFormat:@"count %llu, min %llu, p50 %llu, p90 %llu, p99 %llu, max %llu", self.count, self.min, [self valueAtPercentile:50], [self valueAtPercentile:90], [self valueAtPercentile:99], self.max];
+}
+
+@end
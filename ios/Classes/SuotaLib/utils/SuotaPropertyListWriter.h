@@ -0,0 +1,67 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+/*!
+ @header SuotaPropertyListWriter.h
+ @brief Header file for the SuotaPropertyListWriter class.
+
+ This header file contains method and property declaration for the SuotaPropertyListWriter class.
+
+ @copyright 2019 Dialog Semiconductor
+ */
+
+#import <Foundation/Foundation.h>
+
+typedef NSDictionary* (^SuotaPropertyListSnapshot)(void);
+
+/*!
+ * @class SuotaPropertyListWriter
+ *
+ * @discussion Writes a property list file on a serial queue, for the persistent stores of the library. Updates marked with {@link saveLater} before the pending write runs are written together. Files are written atomically, in binary format.
+ *
+ * The writer is thread safe.
+ *
+ */
+@interface SuotaPropertyListWriter : NSObject
+
+/*!
+ * @property path
+ *
+ * @discussion The property list file path.
+ */
+@property (readonly) NSString* path;
+
+/*!
+ * @method initWithPath:name:snapshot:
+ *
+ * @param path The property list file path. Its directory is created on the first write.
+ * @param name Name of the store, used for the queue label and the log.
+ * @param snapshot Returns the property list to write, or <code>nil</code> to skip the write. Called on the writer queue, without any lock of the writer held.
+ *
+ * @discussion Creates a new {@link SuotaPropertyListWriter} instance.
+ *
+ */
+- (instancetype) initWithPath:(NSString*)path name:(NSString*)name snapshot:(SuotaPropertyListSnapshot)snapshot;
+
+/*!
+ * @method saveLater
+ *
+ * @discussion Marks the store as modified and schedules a write, unless one is already pending.
+ */
+- (void) saveLater;
+
+/*!
+ * @method save
+ *
+ * @discussion Writes the store now, if it was modified, after any pending write.
+ */
+- (void) save;
+
+@end
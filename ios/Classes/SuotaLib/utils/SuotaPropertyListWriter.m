@@ -0,0 +1,84 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+#import "SuotaPropertyListWriter.h"
+#import "SuotaLibLog.h"
+
+static NSString* const TAG = @"SuotaPropertyListWriter";
+
+@interface SuotaPropertyListWriter ()
+
+@property NSString* path;
+@property NSString* name;
+@property (copy) SuotaPropertyListSnapshot snapshot;
+@property BOOL modified;
+@property BOOL writePending;
+@property dispatch_queue_t queue;
+
+@end
+
+@implementation SuotaPropertyListWriter
+
+- (instancetype) initWithPath:(NSString*)path name:(NSString*)name snapshot:(SuotaPropertyListSnapshot)snapshot {
+    self = [super init];
+    if (!self)
+        return nil;
+    self.path = path;
+    self.name = name;
+    self.snapshot = snapshot;
+    self.queue = dispatch_queue_create(name.UTF8String, DISPATCH_QUEUE_SERIAL);
+    return self;
+}
+
+- (void) saveLater {
+    @synchronized (self) {
+        self.modified = true;
+        if (self.writePending)
+            return;
+        self.writePending = true;
+    }
+    dispatch_async(self.queue, ^{
+        @synchronized (self) {
+            self.writePending = false;
+        }
+        [self write];
+    });
+}
+
+- (void) save {
+    dispatch_sync(self.queue, ^{
+        [self write];
+    });
+}
+
+// Called on the writer queue, so that writes are never reordered. The modified flag is cleared before the
+// snapshot is taken, so that an update made after the snapshot schedules another write.
+- (void) write {
+    @synchronized (self) {
+        if (!self.modified)
+            return;
+        self.modified = false;
+    }
+    NSDictionary* propertyList = self.snapshot();
+    if (!propertyList)
+        return;
+
+    NSError* error;
+    NSData* data = [NSPropertyListSerialization dataWithPropertyList:propertyList format:NSPropertyListBinaryFormat_v1_0 options:0 error:&error];
+    if (!data) {
+        SuotaLog(TAG, @"Failed to serialize %@: %@", self.name, error.localizedDescription);
+        return;
+    }
+    [NSFileManager.defaultManager createDirectoryAtPath:self.path.stringByDeletingLastPathComponent withIntermediateDirectories:true attributes:nil error:nil];
+    if (![data writeToFile:self.path options:NSDataWritingAtomic error:&error])
+        SuotaLog(TAG, @"Failed to save %@: %@ %@", self.name, self.path, error.localizedDescription);
+}
+
+@end
@@ -0,0 +1,79 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+/*!
+ @header SuotaRingBuffer.h
+ @brief Header file for the SuotaRingBuffer class.
+
+ This header file contains method and property declaration for the SuotaRingBuffer class.
+
+ @copyright 2019 Dialog Semiconductor
+ */
+
+#import <Foundation/Foundation.h>
+
+/*!
+ * @class SuotaRingBuffer
+ *
+ * @discussion Fixed capacity, lock free, single producer single consumer queue of objects.
+ *
+ * {@link push:} must only be called by one thread at a time, and {@link pop} and {@link removeAllObjects} by one other thread at a time. No locks are used.
+ *
+ */
+@interface SuotaRingBuffer<ObjectType> : NSObject
+
+/*!
+ * @property capacity
+ *
+ * @discussion The queue capacity. This is the requested capacity rounded up to a power of two.
+ */
+@property (readonly) NSUInteger capacity;
+
+/*!
+ * @method initWithCapacity:
+ *
+ * @param capacity The minimum number of objects the queue can hold.
+ *
+ * @discussion Creates a new {@link SuotaRingBuffer} instance.
+ *
+ */
+- (instancetype) initWithCapacity:(NSUInteger)capacity;
+
+/*!
+ * @method push:
+ *
+ * @param object The object to add. Must not be nil.
+ *
+ * @discussion Adds the object at the end of the queue. Producer only.
+ *
+ * @return <code>false</code> if the queue is full.
+ */
+- (BOOL) push:(ObjectType)object;
+
+/*!
+ * @method pop
+ *
+ * @discussion Removes the first object of the queue. Consumer only.
+ *
+ * @return The first object, or nil if the queue is empty.
+ */
+- (ObjectType) pop;
+
+/*!
+ * @method removeAllObjects
+ *
+ * @discussion Removes all the objects of the queue. Consumer only.
+ */
+- (void) removeAllObjects;
+
+- (NSUInteger) count;
+- (BOOL) isEmpty;
+
+@end
@@ -0,0 +1,73 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+#import "SuotaRingBuffer.h"
+#import <stdatomic.h>
+
+@implementation SuotaRingBuffer {
+    void** slots;
+    NSUInteger mask;
+    // Free running indexes. head is written only by the producer, tail only by the consumer.
+    _Atomic(NSUInteger) head;
+    _Atomic(NSUInteger) tail;
+}
+
+- (instancetype) initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (!self)
+        return nil;
+    NSUInteger size = 1;
+    while (size < capacity)
+        size <<= 1;
+    _capacity = size;
+    mask = size - 1;
+    slots = calloc(size, sizeof(void*));
+    atomic_init(&head, 0);
+    atomic_init(&tail, 0);
+    return self;
+}
+
+- (void) dealloc {
+    [self removeAllObjects];
+    free(slots);
+}
+
+- (BOOL) push:(id)object {
+    NSUInteger h = atomic_load_explicit(&head, memory_order_relaxed);
+    if (h - atomic_load_explicit(&tail, memory_order_acquire) == _capacity)
+        return false;
+    slots[h & mask] = (__bridge_retained void*) object;
+    atomic_store_explicit(&head, h + 1, memory_order_release);
+    return true;
+}
+
+- (id) pop {
+    NSUInteger t = atomic_load_explicit(&tail, memory_order_relaxed);
+    if (t == atomic_load_explicit(&head, memory_order_acquire))
+        return nil;
+    void* object = slots[t & mask];
+    slots[t & mask] = NULL;
+    atomic_store_explicit(&tail, t + 1, memory_order_release);
+    return (__bridge_transfer id) object;
+}
+
+- (void) removeAllObjects {
+    while ([self pop]);
+}
+
+- (NSUInteger) count {
+    return atomic_load_explicit(&head, memory_order_acquire) - atomic_load_explicit(&tail, memory_order_acquire);
+}
+
+- (BOOL) isEmpty {
+    return self.count == 0;
+}
+
+@end
@@ -0,0 +1,130 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+/*!
+ @header SuotaTimer.h
+ @brief Header file for the SuotaTimer and SuotaTimerWheel classes.
+
+ This header file contains method and property declaration for the SuotaTimer and SuotaTimerWheel classes.
+
+ @copyright 2019 Dialog Semiconductor
+ */
+
+#import <Foundation/Foundation.h>
+
+@class SuotaTimer;
+@class SuotaTimerWheel;
+
+typedef void (^SuotaTimerBlock)(SuotaTimer* timer);
+
+/*!
+ * @class SuotaTimer
+ *
+ * @discussion Timer that fires on a dispatch queue. Unlike <code>NSTimer</code>, it does not need a run loop, so it can be scheduled from any thread.
+ *
+ * Timers are armed on a {@link SuotaTimerWheel}, so they fire up to one wheel tick late. If a repeating timer fires while the previous call of its block is still pending on the queue, that firing is skipped.
+ *
+ */
+@interface SuotaTimer : NSObject
+
+/*!
+ * @property wheel
+ *
+ * @discussion The wheel the timer is armed on.
+ */
+@property (readonly) SuotaTimerWheel* wheel;
+
+/*!
+ * @method scheduledTimerWithInterval:queue:repeats:block:
+ *
+ * @param interval The timer interval in seconds.
+ * @param queue The queue on which the block is called.
+ * @param repeats If <code>true</code>, the timer fires every interval until it is invalidated.
+ * @param block The block to call when the timer fires.
+ *
+ * @discussion Creates a new {@link SuotaTimer} and arms it on the {@link sharedWheel}.
+ *
+ */
++ (SuotaTimer*) scheduledTimerWithInterval:(double)interval queue:(dispatch_queue_t)queue repeats:(BOOL)repeats block:(SuotaTimerBlock)block;
+
+/*!
+ * @method invalidate
+ *
+ * @discussion Stops the timer. The block is not called afterwards, if the timer is invalidated on the timer queue.
+ */
+- (void) invalidate;
+
+- (BOOL) isValid;
+
+@end
+
+/*!
+ * @class SuotaTimerWheel
+ *
+ * @discussion Hashed timing wheel. All the timers of a wheel are driven by a single dispatch source, which is programmed for the next occupied slot, so the wheel wakes up only when a timer is due. Arming and invalidating a timer take constant time, regardless of the number of armed timers.
+ *
+ * The wheel is thread safe. Timer blocks are called on the queue given when each timer is scheduled.
+ *
+ */
+@interface SuotaTimerWheel : NSObject
+
+/*!
+ * @property sharedWheel
+ *
+ * @discussion The wheel used by the library, with a tick of {@link TIMER_WHEEL_TICK} milli seconds.
+ */
+@property (class, readonly) SuotaTimerWheel* sharedWheel;
+
+/*!
+ * @property tickInterval
+ *
+ * @discussion The wheel resolution in seconds.
+ */
+@property (readonly) double tickInterval;
+
+/*!
+ * @property slots
+ *
+ * @discussion Number of wheel slots. Timers longer than one wheel revolution wait for more revolutions in their slot.
+ */
+@property (readonly) NSUInteger slots;
+
+/*!
+ * @method initWithTickInterval:slots:
+ *
+ * @param tickInterval The wheel resolution in seconds.
+ * @param slots The number of wheel slots.
+ *
+ * @discussion Creates a new {@link SuotaTimerWheel} instance.
+ *
+ */
+- (instancetype) initWithTickInterval:(double)tickInterval slots:(NSUInteger)slots;
+
+/*!
+ * @method scheduleTimerWithInterval:queue:repeats:block:
+ *
+ * @param interval The timer interval in seconds. It is rounded up to whole ticks.
+ * @param queue The queue on which the block is called.
+ * @param repeats If <code>true</code>, the timer fires every interval until it is invalidated.
+ * @param block The block to call when the timer fires.
+ *
+ * @discussion Creates a new {@link SuotaTimer} and arms it on the wheel.
+ *
+ */
+- (SuotaTimer*) scheduleTimerWithInterval:(double)interval queue:(dispatch_queue_t)queue repeats:(BOOL)repeats block:(SuotaTimerBlock)block;
+
+/*!
+ * @method count
+ *
+ * @return The number of armed timers.
+ */
+- (NSUInteger) count;
+
+@end
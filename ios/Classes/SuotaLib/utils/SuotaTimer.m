@@ -0,0 +1,266 @@
+/*
+ *******************************************************************************
+ *
+ * Copyright (C) 2019-2020 Dialog Semiconductor.
+ * This computer program includes Confidential, Proprietary Information
+ * of Dialog Semiconductor. All Rights Reserved.
+ *
+ *******************************************************************************
+ */
+
+#import "SuotaTimer.h"
+#import "SuotaLibConfig.h"
+
+static NSUInteger const SHARED_WHEEL_SLOTS = 512;
+
+@interface SuotaTimer () {
+    @public
+    // Wheel state, guarded by the wheel lock. Each slot is a circular list, with a sentinel timer as its head.
+    SuotaTimer* next;
+    __unsafe_unretained SuotaTimer* prev;
+    uint64_t ticks;
+    // Absolute wheel tick at which the timer fires
+    uint64_t deadline;
+    BOOL armed;
+    BOOL cancelled;
+    BOOL firePending;
+}
+
+@property SuotaTimerWheel* wheel;
+@property dispatch_queue_t queue;
+@property BOOL repeats;
+@property (copy) SuotaTimerBlock block;
+
+@end
+
+@interface SuotaTimerWheel ()
+
+- (void) fire:(SuotaTimer*)timer;
+- (void) invalidate:(SuotaTimer*)timer;
+- (BOOL) isValid:(SuotaTimer*)timer;
+
+@end
+
+@implementation SuotaTimer
+
++ (SuotaTimer*) scheduledTimerWithInterval:(double)interval queue:(dispatch_queue_t)queue repeats:(BOOL)repeats block:(SuotaTimerBlock)block {
+    return [SuotaTimerWheel.sharedWheel scheduleTimerWithInterval:interval queue:queue repeats:repeats block:block];
+}
+
+- (void) invalidate {
+    [self.wheel invalidate:self];
+}
+
+- (BOOL) isValid {
+    return [self.wheel isValid:self];
+}
+
+@end
+
+
+@implementation SuotaTimerWheel {
+    dispatch_queue_t queue;
+    dispatch_source_t source;
+    NSArray<SuotaTimer*>* slotHeads;
+    NSUInteger count;
+    NSTimeInterval origin;
+    // Last tick whose slot was processed
+    uint64_t processedTick;
+    // Tick the source is programmed for, or UINT64_MAX if it is idle
+    uint64_t scheduledTick;
+}
+
++ (SuotaTimerWheel*) sharedWheel {
+    static SuotaTimerWheel* sharedWheel;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedWheel = [[SuotaTimerWheel alloc] initWithTickInterval:(double)SuotaLibConfig.TIMER_WHEEL_TICK / 1000.0 slots:SHARED_WHEEL_SLOTS];
+    });
+    return sharedWheel;
+}
+
+- (instancetype) initWithTickInterval:(double)tickInterval slots:(NSUInteger)slots {
+    self = [super init];
+    if (!self)
+        return nil;
+    _tickInterval = tickInterval;
+    _slots = MAX(slots, 1);
+
+    NSMutableArray<SuotaTimer*>* slotHeads = [NSMutableArray arrayWithCapacity:_slots];
+    for (NSUInteger i = 0; i < _slots; i++) {
+        SuotaTimer* head = [[SuotaTimer alloc] init];
+        head->next = head;
+        head->prev = head;
+        [slotHeads addObject:head];
+    }
+    self->slotHeads = slotHeads;
+    origin = NSProcessInfo.processInfo.systemUptime;
+    scheduledTick = UINT64_MAX;
+
+    // The source is one shot, programmed for the next deadline, so the wheel does not wake up between timers
+    queue = dispatch_queue_create("SuotaTimerWheel", DISPATCH_QUEUE_SERIAL);
+    source = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
+    __weak SuotaTimerWheel* weakSelf = self;
+    dispatch_source_set_event_handler(source, ^{
+        [weakSelf onTimer];
+    });
+    dispatch_source_set_timer(source, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+    dispatch_resume(source);
+    return self;
+}
+
+- (void) dealloc {
+    dispatch_source_cancel(source);
+}
+
+- (SuotaTimer*) scheduleTimerWithInterval:(double)interval queue:(dispatch_queue_t)timerQueue repeats:(BOOL)repeats block:(SuotaTimerBlock)block {
+    SuotaTimer* timer = [[SuotaTimer alloc] init];
+    timer.wheel = self;
+    timer.queue = timerQueue;
+    timer.repeats = repeats;
+    timer.block = block;
+    timer->ticks = MAX((uint64_t)ceil(interval / self.tickInterval), 1);
+    @synchronized (self) {
+        // Rounded up to the next tick, so that the timer never fires early
+        NSTimeInterval elapsed = NSProcessInfo.processInfo.systemUptime - origin;
+        uint64_t deadline = (uint64_t)ceil((elapsed + interval) / self.tickInterval);
+        [self arm:timer deadline:MAX(deadline, [self tickAt:elapsed] + 1)];
+    }
+    return timer;
+}
+
+- (NSUInteger) count {
+    @synchronized (self) {
+        return count;
+    }
+}
+
+- (uint64_t) tickAt:(NSTimeInterval)elapsed {
+    return elapsed > 0 ? (uint64_t)(elapsed / self.tickInterval) : 0;
+}
+
+// Called with the lock held
+- (void) arm:(SuotaTimer*)timer deadline:(uint64_t)deadline {
+    SuotaTimer* head = slotHeads[deadline % self.slots];
+    timer->deadline = deadline;
+    timer->next = head->next;
+    timer->prev = head;
+    head->next->prev = timer;
+    head->next = timer;
+    timer->armed = true;
+    count++;
+
+    if (deadline < scheduledTick)
+        [self scheduleAt:deadline];
+}
+
+// Called with the lock held
+- (void) unlink:(SuotaTimer*)timer {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = nil;
+    timer->prev = nil;
+    timer->armed = false;
+    count--;
+}
+
+// Called with the lock held
+- (void) scheduleAt:(uint64_t)tick {
+    scheduledTick = tick;
+    if (tick == UINT64_MAX) {
+        dispatch_source_set_timer(source, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+        return;
+    }
+    NSTimeInterval delay = MAX(origin + tick * self.tickInterval - NSProcessInfo.processInfo.systemUptime, 0);
+    dispatch_source_set_timer(source, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), DISPATCH_TIME_FOREVER, (uint64_t)(self.tickInterval * NSEC_PER_SEC) / 10);
+}
+
+// Called with the lock held. Returns the earliest deadline. The slots are scanned in deadline order for up to one
+// revolution, so the scan stops at the first timer that is due in the current revolution.
+- (uint64_t) nextDeadline {
+    uint64_t next = UINT64_MAX;
+    if (!count)
+        return next;
+    for (NSUInteger i = 1; i <= self.slots; i++) {
+        uint64_t tick = processedTick + i;
+        SuotaTimer* head = slotHeads[tick % self.slots];
+        for (SuotaTimer* timer = head->next; timer != head; timer = timer->next) {
+            if (timer->deadline == tick)
+                return tick;
+            next = MIN(next, timer->deadline);
+        }
+    }
+    return next;
+}
+
+- (void) onTimer {
+    NSMutableArray<SuotaTimer*>* fired;
+    @synchronized (self) {
+        uint64_t now = [self tickAt:NSProcessInfo.processInfo.systemUptime - origin];
+        // Each slot is visited once, even if more than a revolution has elapsed since the last visit
+        uint64_t elapsedTicks = now > processedTick ? MIN(now - processedTick, (uint64_t)self.slots) : 0;
+        for (uint64_t i = 1; i <= elapsedTicks && count; i++) {
+            SuotaTimer* head = slotHeads[(processedTick + i) % self.slots];
+            SuotaTimer* timer = head->next;
+            while (timer != head) {
+                SuotaTimer* next = timer->next;
+                if (timer->deadline <= now) {
+                    [self unlink:timer];
+                    // Armed after the current tick, so that it is not visited again in this pass
+                    if (timer.repeats)
+                        [self arm:timer deadline:MAX(timer->deadline + timer->ticks, now + 1)];
+                    if (!timer->firePending) {
+                        timer->firePending = true;
+                        if (!fired)
+                            fired = [NSMutableArray array];
+                        [fired addObject:timer];
+                    }
+                }
+                timer = next;
+            }
+        }
+        processedTick = MAX(processedTick, now);
+        [self scheduleAt:[self nextDeadline]];
+    }
+
+    for (SuotaTimer* timer in fired) {
+        dispatch_async(timer.queue, ^{
+            [self fire:timer];
+        });
+    }
+}
+- (void) fire:(SuotaTimer*)timer {
+    SuotaTimerBlock block;
+    @synchronized (self) {
+        timer->firePending = false;
+        if (timer->cancelled)
+            return;
+        block = timer.block;
+        // A fired timer releases its block, which may retain the timer owner
+        if (!timer.repeats)
+            timer.block = nil;
+    }
+    if (block)
+        block(timer);
+}
+
+- (void) invalidate:(SuotaTimer*)timer {
+    @synchronized (self) {
+        timer->cancelled = true;
+        timer.block = nil;
+        if (timer->armed) {
+            [self unlink:timer];
+            if (!count)
+                [self scheduleAt:UINT64_MAX];
+        }
+    }
+}
+
+- (BOOL) isValid:(SuotaTimer*)timer {
+    @synchronized (self) {
+        // A timer that fired stays valid until its block is called
+        return !timer->cancelled && (timer->armed || timer->firePending);
+    }
+}
+
+@end
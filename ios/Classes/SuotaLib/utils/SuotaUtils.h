@@ -60,3 +60,20 @@ enum {
 - (BOOL) hasRemaining;
 
 @end
+
+/*!
+ * @class SuotaDataSlice
+ *
+ * @discussion Read-only view of a byte range inside another {@link NSData} object. The slice keeps a reference to the source buffer and does not copy its bytes.
+ *
+ */
+@interface SuotaDataSlice : NSData
+
+@property (readonly) NSData* source;
+@property (readonly) NSRange range;
+
+- (instancetype) initWithData:(NSData*)data range:(NSRange)range;
+
++ (instancetype) sliceWithData:(NSData*)data range:(NSRange)range;
+
+@end
@@ -184,3 +184,34 @@
 }
 
 @end
+
+@implementation SuotaDataSlice
+
+- (instancetype) initWithData:(NSData*)data range:(NSRange)range {
+    self = [super init];
+    if (!self)
+        return nil;
+    if (NSMaxRange(range) > data.length)
+        @throw [NSException exceptionWithName:NSRangeException reason:@"SuotaDataSlice range error" userInfo:nil];
+    _source = data;
+    _range = range;
+    return self;
+}
+
++ (instancetype) sliceWithData:(NSData*)data range:(NSRange)range {
+    return [[self alloc] initWithData:data range:range];
+}
+
+- (const void*) bytes {
+    return (const uint8_t*)self.source.bytes + self.range.location;
+}
+
+- (NSUInteger) length {
+    return self.range.length;
+}
+
+- (id) copyWithZone:(NSZone*)zone {
+    return self;
+}
+
+@end
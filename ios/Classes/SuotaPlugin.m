@@ -3,16 +3,15 @@
 
 @implementation SuotaPlugin
 
+static uint32_t lastSessionId;
+static int lastFirmwareHandle;
+
 - (instancetype)init {
     self = [super init];
     if (self) {
         _centralManager = [[CBCentralManager alloc] initWithDelegate:self queue:nil];
-        _discoveredPeripherals = [NSMutableDictionary dictionary];
-        
-        _targetPeripheral = nil;
-        _flutterResult = nil;
-        _targetRemoteId = nil;
-        
+        _sessions = [NSMutableDictionary dictionary];
+        _firmwareImages = [NSMutableDictionary dictionary];
     }
     return self;
 }
@@ -34,150 +33,212 @@
 - (void)centralManagerDidUpdateState:(CBCentralManager *)central {
     if (central.state == CBManagerStatePoweredOn) {
         // If Bluetooth was off but now is on, start scanning again
-        if (self.targetRemoteId != nil) {
-            [self.centralManager scanForPeripheralsWithServices:nil options:nil];
-        }
+        [self scanForWaitingSessions];
     } else {
-        // Handle other states
-        if (self.flutterResult != nil) {
-            self.flutterResult([FlutterError errorWithCode:@"BLUETOOTH_OFF"
-                                                   message:@"Bluetooth is powered off"
-                                                   details:nil]);
-            self.flutterResult = nil;
+        // Sessions that haven't found their device yet fail. Connected sessions are failed by their SUOTA manager.
+        for (SuotaPluginSession *session in self.sessions.allValues) {
+            if (session.suotaManager == nil) {
+                [session fail:NOT_CONNECTED];
+            }
         }
     }
 }
 
 - (void)centralManager:(CBCentralManager *)central didDiscoverPeripheral:(CBPeripheral *)peripheral advertisementData:(NSDictionary<NSString *, id> *)advertisementData RSSI:(NSNumber *)RSSI {
-    
-    NSLog(@"SUOTA Found some peripheral with remoteId: %@", peripheral.identifier.UUIDString);
-    if ([peripheral.identifier.UUIDString isEqualToString:self.targetRemoteId]) {
-        NSLog(@"SUOTA Found peripheral 1 with remoteId: %@", self.targetRemoteId);
-        self.targetPeripheral = peripheral;
-//        [self.centralManager stopScan];
-        
-        NSLog(@"SUOTA Found peripheral with remoteId: %@", self.targetRemoteId);
-        
-        [self.suotaManager initWithPeripheral:self.targetPeripheral suotaManagerDelegate:self];
+    SuotaPluginSession *session = self.sessions[peripheral.identifier.UUIDString];
+    if (session != nil && session.suotaManager == nil) {
+        NSLog(@"SUOTA Found peripheral with remoteId: %@", session.remoteId);
+        [session connect:peripheral source:@"scan"];
+        [self scanForWaitingSessions];
+    }
+}
+
+- (void)scanForWaitingSessions {
+    BOOL waiting = false;
+    for (SuotaPluginSession *session in self.sessions.allValues) {
+        if (session.suotaManager == nil) {
+            waiting = true;
+            break;
+        }
+    }
+    if (waiting && self.centralManager.state == CBManagerStatePoweredOn) {
+        if (!self.centralManager.isScanning) {
+            NSLog(@"SUOTA Started scanForPeripheralsWithServices");
+            [self.centralManager scanForPeripheralsWithServices:@[SuotaProfile.SUOTA_SERVICE_UUID] options:nil];
+        }
+    } else if (self.centralManager.isScanning) {
         [self.centralManager stopScan];
-        [self.suotaManager connect];
-        //    if (self.flutterResult != nil) {
-        //      self.flutterResult([NSString stringWithFormat:@"Found device: %@", peripheral.name]);
-        //      self.flutterResult = nil;
-        //    }
     }
 }
 
-#pragma mark - CBPeripheralDelegate
+#pragma mark - Method calls
 
 - (void)installUpdate:(FlutterMethodCall*)call result:(FlutterResult)result {
-    NSString *path = call.arguments[@"path"];
-    NSString *fileName = call.arguments[@"fileName"];
-    NSString *remoteId = call.arguments[@"remoteId"];
-    
-    self.flutterResult = result;
-    self.filePath = path;
-    self.fileName = fileName;
-    
-    NSLog(@"SUOTA Received getBluetoothDeviceById call with remoteId: %@", remoteId);
-    if (self.centralManager.state == CBManagerStatePoweredOn) {
-        NSLog(@"SUOTA Started scanForPeripheralsWithServices");
-        self.targetRemoteId = remoteId;
-        [self.centralManager scanForPeripheralsWithServices:nil options:nil];
-        self.suotaManager = [SuotaManager alloc];
-        self.suotaManager.bluetoothManager.bluetoothManager = self.centralManager;
+    SuotaPluginSession *session = [self createSession:call.arguments[@"remoteId"] result:result];
+    session.filePath = call.arguments[@"path"];
+    session.fileName = call.arguments[@"fileName"];
+    session.updatePolicy = [self updatePolicy:call.arguments];
+    [self startSession:session result:result];
+}
+
+- (void)installUpdateFromBytes:(FlutterMethodCall*)call result:(FlutterResult)result {
+    SuotaFile *suotaFile = [self firmwareFromBytes:call.arguments[@"firmware"] result:result];
+    if (suotaFile != nil) {
+        SuotaPluginSession *session = [self createSession:call.arguments[@"remoteId"] result:result];
+        session.suotaFile = suotaFile;
+        session.updatePolicy = [self updatePolicy:call.arguments];
+        [self startSession:session result:result];
+    }
+}
+
+- (void)installUpdateFromHandle:(FlutterMethodCall*)call result:(FlutterResult)result {
+    SuotaFile *firmware = self.firmwareImages[call.arguments[@"handle"]];
+    if (firmware == nil) {
+        result([FlutterError errorWithCode:@"INVALID_FIRMWARE_HANDLE"
+                                   message:@"Firmware image not loaded"
+                                   details:nil]);
+        return;
+    }
+    // The copy shares the image data, so each update gets its own block state without copying the image
+    SuotaPluginSession *session = [self createSession:call.arguments[@"remoteId"] result:result];
+    session.suotaFile = [firmware copy];
+    session.updatePolicy = [self updatePolicy:call.arguments];
+    [self startSession:session result:result];
+}
+
+- (void)loadFirmware:(FlutterMethodCall*)call result:(FlutterResult)result {
+    SuotaFile *suotaFile = [self firmwareFromBytes:call.arguments[@"firmware"] result:result];
+    if (suotaFile != nil) {
+        NSNumber *handle = @(++lastFirmwareHandle);
+        self.firmwareImages[handle] = suotaFile;
+        result(handle);
+    }
+}
+
+- (void)releaseFirmware:(FlutterMethodCall*)call result:(FlutterResult)result {
+    [self.firmwareImages removeObjectForKey:call.arguments[@"handle"]];
+    result(nil);
+}
+
+- (SuotaFile*)firmwareFromBytes:(FlutterStandardTypedData*)firmware result:(FlutterResult)result {
+    if (![firmware isKindOfClass:FlutterStandardTypedData.class] || firmware.data.length == 0) {
+        result([FlutterError errorWithCode:@"INVALID_FIRMWARE"
+                                   message:@"Firmware image is empty"
+                                   details:nil]);
+        return nil;
+    }
+    // The decoded data is immutable, so the SUOTA file keeps it without copying
+    return [[SuotaFile alloc] initWithFirmwareBuffer:firmware.data];
+}
+
+- (id<SuotaUpdatePolicy>)updatePolicy:(NSDictionary*)arguments {
+    NSString *versionCheck = arguments[@"versionCheck"];
+    enum SuotaVersionComparison comparison;
+    if ([@"exact" isEqual:versionCheck]) {
+        comparison = VERSION_EXACT;
+    } else if ([@"timestamp" isEqual:versionCheck]) {
+        comparison = VERSION_TIMESTAMP;
+    } else if ([@"semantic" isEqual:versionCheck]) {
+        comparison = VERSION_SEMANTIC;
     } else {
+        return nil;
+    }
+    enum SuotaRevisionField field = [@"firmware" isEqual:arguments[@"versionField"]] ? REVISION_FIRMWARE : REVISION_SOFTWARE;
+    BOOL allowNewer = [arguments[@"allowNewer"] isKindOfClass:NSNumber.class] && [arguments[@"allowNewer"] boolValue];
+    return [[SuotaVersionPolicy alloc] initWithComparison:comparison field:field allowNewer:allowNewer];
+}
+
+- (SuotaPluginSession*)createSession:(NSString*)remoteId result:(FlutterResult)result {
+    NSLog(@"SUOTA Received install call with remoteId: %@", remoteId);
+    if (![remoteId isKindOfClass:NSString.class] || [[NSUUID alloc] initWithUUIDString:remoteId] == nil) {
         result([FlutterError errorWithCode:@"DEVICE_NOT_FOUND"
                                    message:@"Device not found"
                                    details:nil]);
+        return nil;
     }
-    
+    // Sessions are keyed by the identifier string, which CoreBluetooth reports in upper case
+    remoteId = remoteId.uppercaseString;
+    SuotaPluginSession *active = self.sessions[remoteId];
+    if (active != nil) {
+        result([FlutterError errorWithCode:@"SESSION_ACTIVE"
+                                   message:@"The device is already being updated"
+                                   details:@(active.sessionId)]);
+        return nil;
+    }
+    return [[SuotaPluginSession alloc] initWithSessionId:++lastSessionId remoteId:remoteId delegate:self];
+}
+
+- (void)startSession:(SuotaPluginSession*)session result:(FlutterResult)result {
+    if (session == nil) {
+        return;
+    }
+    if (self.centralManager.state != CBManagerStatePoweredOn) {
+        result([FlutterError errorWithCode:@"DEVICE_NOT_FOUND"
+                                   message:@"Device not found"
+                                   details:nil]);
+        return;
+    }
+    self.sessions[session.remoteId] = session;
+    // The session id reaches Dart before any event of the session
+    result(@(session.sessionId));
+    [session start:SuotaLibConfig.DEFAULT_SCAN_TIMEOUT / 1000.0];
+    [self findPeripheral:session];
+}
+
+- (void)findPeripheral:(SuotaPluginSession*)session {
+    NSUUID *identifier = [[NSUUID alloc] initWithUUIDString:session.remoteId];
+    // A device connected to the system is in range, even if it doesn't advertise
+    for (CBPeripheral *peripheral in [self.centralManager retrieveConnectedPeripheralsWithServices:@[SuotaProfile.SUOTA_SERVICE_UUID]]) {
+        if ([peripheral.identifier isEqual:identifier]) {
+            [session connect:peripheral source:@"connected"];
+            return;
+        }
+    }
+    CBPeripheral *known = [self.centralManager retrievePeripheralsWithIdentifiers:@[identifier]].firstObject;
+    if (known != nil) {
+        [session connect:known source:@"known"];
+        return;
+    }
+    // Unknown devices are found by a scan filtered on the SUOTA service, until the session times out
+    [self scanForWaitingSessions];
 }
 
 - (void)handleMethodCall:(FlutterMethodCall*)call result:(FlutterResult)result {
     NSLog(@"SUOTA handleMethodCall call with method: %@", call.method);
     if ([@"getPlatformVersion" isEqualToString:call.method]) {
         result([@"iOS " stringByAppendingString:[[UIDevice currentDevice] systemVersion]]);
-    } if ([@"installUpdate" isEqualToString:call.method]) {
+    } else if ([@"installUpdate" isEqualToString:call.method]) {
         [self installUpdate:call result:result];
+    } else if ([@"installUpdateFromBytes" isEqualToString:call.method]) {
+        [self installUpdateFromBytes:call result:result];
+    } else if ([@"installUpdateFromHandle" isEqualToString:call.method]) {
+        [self installUpdateFromHandle:call result:result];
+    } else if ([@"loadFirmware" isEqualToString:call.method]) {
+        [self loadFirmware:call result:result];
+    } else if ([@"releaseFirmware" isEqualToString:call.method]) {
+        [self releaseFirmware:call result:result];
     } else {
         result(FlutterMethodNotImplemented);
     }
 }
 
 
-#pragma mark - SuotaManagerDelegate
-
-- (void) onFailure:(int)errorCode {
-    NSString *errorMessage = SuotaProfile.suotaErrorCodeList[@(errorCode)];
-    self.flutterResult([FlutterError errorWithCode:@"Error updating the device"
-                               message:errorMessage
-                               details:nil]);
-}
-
-- (void) onConnectionStateChange:(enum SuotaManagerStatus)newStatus {
-}
-
-- (void) onServicesDiscovered {
-}
-
-- (void) onCharacteristicRead:(enum CharacteristicGroup)characteristicGroup characteristic:(CBCharacteristic*)characteristic {
-}
-
-- (void) onDeviceInfoReadCompleted:(enum DeviceInfoReadStatus)status {
-}
-
-- (void) onDeviceReady {
-    NSLog(@"SUOTA Device is ready");
-    [self.centralManager stopScan];
-    
-    NSFileManager* fileManager = [NSFileManager defaultManager];
-    NSString* fullFilePath = [NSString pathWithComponents:@[self.filePath, self.fileName]];
-    if (![fileManager fileExistsAtPath:fullFilePath]) {
-        NSLog(@"SUOTA File is not OK");
-            self.flutterResult([FlutterError errorWithCode:@"DEVICE_NOT_FOUND"
-                                       message:@"Device not found"
-                                       details:nil]);
-    }
-
-    NSLog(@"SUOTA File is OK");
-    SuotaFile* suotaFile = [[SuotaFile alloc] initWithAbsoluteFilePath:fullFilePath];
-    self.suotaManager.suotaFile = suotaFile;
-    NSLog(@"SUOTA File is set");
-    [self.suotaManager initializeSuota];
-    NSLog(@"SUOTA Suota initiated");
-    
-//    self.flutterResult(@(YES));
-    [self.suotaManager startUpdate];
-}
-
-- (void) onSuotaLog:(enum SuotaProtocolState)state type:(enum SuotaLogType)type log:(NSString*)log {
-}
-
-- (void) onChunkSend:(int)chunkCount totalChunks:(int)totalChunks chunk:(int)chunk block:(int)block blockChunks:(int)blockChunks totalBlocks:(int)totalBlocks {
-}
-
-- (void) updateSpeedStatistics:(double)current max:(double)max min:(double)min avg:(double)avg {}
-
-- (void) onBlockSent:(int)block totalBlocks:(int)totalBlocks {
-}
-
-- (void) updateCurrentSpeed:(double)currentSpeed {
-}
-
-- (void) onUploadProgress:(float)percent {
-    NSDictionary *progressUpdate = @{@"progress": @(percent)};
-    self.flutterEventSink(progressUpdate);
-}
+#pragma mark - SuotaPluginSessionDelegate
 
-- (void) onSuccess:(double)totalElapsedSeconds imageUploadElapsedSeconds:(double)imageUploadElapsedSeconds {
-    self.flutterResult(@(YES));
+- (void)sendEvent:(id)event {
+    if (self.flutterEventSink != nil) {
+        self.flutterEventSink(event);
+    }
 }
 
-- (void) onRebootSent {
+- (void)onSessionFinished:(SuotaPluginSession *)session {
+    if (self.sessions[session.remoteId] == session) {
+        [self.sessions removeObjectForKey:session.remoteId];
+    }
+    [self scanForWaitingSessions];
 }
 
-#pragma mark - SuotaManagerDelegate
+#pragma mark - FlutterStreamHandler
 
 - (FlutterError * _Nullable)onCancelWithArguments:(id _Nullable)arguments {
     self.flutterEventSink = nil;
@@ -0,0 +1,96 @@
+#import <Flutter/Flutter.h>
+#import <CoreBluetooth/CoreBluetooth.h>
+#import "SuotaLib.h"
+#import "SuotaTelemetry.h"
+
+@class SuotaPluginSession;
+
+/*!
+ * @protocol SuotaPluginSessionDelegate
+ *
+ * @discussion Receives the events of a {@link SuotaPluginSession}. All methods are called on the main thread.
+ */
+@protocol SuotaPluginSessionDelegate <NSObject>
+
+/*!
+ * @method sendEvent:
+ *
+ * @param event A telemetry record or a session result, tagged with the session id.
+ */
+- (void) sendEvent:(id)event;
+
+/*!
+ * @method onSessionFinished:
+ *
+ * @param session The session that succeeded or failed. No events are sent afterwards.
+ */
+- (void) onSessionFinished:(SuotaPluginSession*)session;
+
+@end
+
+/*!
+ * @class SuotaPluginSession
+ *
+ * @discussion The update of a single device, started by an install method call. Each session has its own {@link SuotaManager} and telemetry, so several devices can be updated in parallel.
+ */
+@interface SuotaPluginSession : NSObject <SuotaManagerDelegate>
+
+@property (readonly) uint32_t sessionId;
+@property (readonly) NSString *remoteId;
+@property (weak) id<SuotaPluginSessionDelegate> delegate;
+@property (strong, nonatomic) SuotaFile *suotaFile;
+@property (strong, nonatomic) NSString *filePath;
+@property (strong, nonatomic) NSString *fileName;
+/*!
+ * @property updatePolicy
+ *
+ * @discussion Set as the {@link SuotaManager} update policy. If the device firmware is current, the session finishes with a <code>current</code> event instead of uploading the image.
+ */
+@property (strong, nonatomic) id<SuotaUpdatePolicy> updatePolicy;
+@property (readonly) SuotaManager *suotaManager;
+@property (readonly) SuotaTelemetry *telemetry;
+@property (readonly) BOOL finished;
+/*!
+ * @property peripheralSource
+ *
+ * @discussion How the device was found: <code>connected</code> if it was already connected to the system, <code>known</code> if the system retrieved it by its identifier, or <code>scan</code>.
+ */
+@property (readonly) NSString *peripheralSource;
+/*!
+ * @property connectLatency
+ *
+ * @discussion Time in seconds from the install call until the device was ready, or 0 before that.
+ */
+@property (readonly) NSTimeInterval connectLatency;
+
+- (instancetype) initWithSessionId:(uint32_t)sessionId remoteId:(NSString*)remoteId delegate:(id<SuotaPluginSessionDelegate>)delegate;
+
+/*!
+ * @method start:
+ *
+ * @param timeout Time in seconds to find the device and connect to it.
+ *
+ * @discussion Starts the session timeout. The session fails if the device isn't ready when it expires.
+ */
+- (void) start:(NSTimeInterval)timeout;
+
+/*!
+ * @method connect:source:
+ *
+ * @param peripheral The device to update.
+ * @param source How the device was found, see {@link peripheralSource}.
+ *
+ * @discussion Connects to the device. The update starts when the device is ready.
+ */
+- (void) connect:(CBPeripheral*)peripheral source:(NSString*)source;
+
+/*!
+ * @method fail:
+ *
+ * @param errorCode The error code. Error codes can be found at {@link SuotaErrors} and {@link ApplicationErrors}.
+ *
+ * @discussion Reports a failure that happened before the device connected, and finishes the session.
+ */
+- (void) fail:(int)errorCode;
+
+@end
@@ -0,0 +1,199 @@
+#import "SuotaPluginSession.h"
+#import "SuotaTimer.h"
+
+@interface SuotaPluginSession ()
+
+@property (readwrite) SuotaManager *suotaManager;
+@property (readwrite) BOOL finished;
+@property (readwrite) NSString *peripheralSource;
+@property (readwrite) NSTimeInterval connectLatency;
+@property NSTimeInterval startTime;
+@property SuotaTimer *timeoutTimer;
+
+@end
+
+@implementation SuotaPluginSession
+
+- (instancetype) initWithSessionId:(uint32_t)sessionId remoteId:(NSString*)remoteId delegate:(id<SuotaPluginSessionDelegate>)delegate {
+    self = [super init];
+    if (self) {
+        _sessionId = sessionId;
+        _remoteId = remoteId;
+        _delegate = delegate;
+        _telemetry = [[SuotaTelemetry alloc] initWithSessionId:sessionId];
+        _startTime = NSProcessInfo.processInfo.systemUptime;
+    }
+    return self;
+}
+
+- (void) start:(NSTimeInterval)timeout {
+    __weak SuotaPluginSession *weakSelf = self;
+    self.timeoutTimer = [SuotaTimer scheduledTimerWithInterval:timeout queue:dispatch_get_main_queue() repeats:false block:^(SuotaTimer *timer) {
+        [weakSelf onTimeout];
+    }];
+}
+
+- (void) onTimeout {
+    NSLog(@"SUOTA Session %u timeout: %@", self.sessionId, self.suotaManager ? @"device not ready" : @"device not found");
+    // A pending connection to a device out of range never completes on its own
+    [self.suotaManager destroy];
+    [self fail:NOT_CONNECTED];
+}
+
+- (void) connect:(CBPeripheral*)peripheral source:(NSString*)source {
+    NSLog(@"SUOTA Session %u connecting to %@ (%@)", self.sessionId, self.remoteId, source);
+    self.peripheralSource = source;
+    self.suotaManager = [[SuotaManager alloc] initWithPeripheral:peripheral suotaManagerDelegate:self];
+    self.suotaManager.updatePolicy = self.updatePolicy;
+    [self.suotaManager connect];
+}
+
+- (void) fail:(int)errorCode {
+    if (self.finished)
+        return;
+    NSString *errorMessage = SuotaProfile.suotaErrorCodeList[@(errorCode)];
+    [self finish:@{
+        @"sessionId": @(self.sessionId),
+        @"event": @"failure",
+        @"errorCode": @(errorCode),
+        @"message": errorMessage ? errorMessage : NSNull.null,
+    }];
+}
+
+- (void) finish:(NSDictionary*)result {
+    self.finished = true;
+    [self.timeoutTimer invalidate];
+    [self.delegate sendEvent:result];
+    [self.delegate onSessionFinished:self];
+}
+
+- (void) sendTelemetry:(enum SuotaTelemetryEvent)event {
+    if (self.finished)
+        return;
+    [self.delegate sendEvent:[FlutterStandardTypedData typedDataWithBytes:[self.telemetry encode:event]]];
+}
+
+#pragma mark - SuotaManagerDelegate
+
+- (void) onFailure:(int)errorCode {
+    [self fail:errorCode];
+}
+
+- (void) onConnectionStateChange:(enum SuotaManagerStatus)newStatus {
+}
+
+- (void) onServicesDiscovered {
+}
+
+- (void) onCharacteristicRead:(enum CharacteristicGroup)characteristicGroup characteristic:(CBCharacteristic*)characteristic {
+}
+
+- (void) onDeviceInfoReadCompleted:(enum DeviceInfoReadStatus)status {
+}
+
+- (void) onDeviceReady {
+    if (self.finished)
+        return;
+    [self.timeoutTimer invalidate];
+    self.connectLatency = NSProcessInfo.processInfo.systemUptime - self.startTime;
+    NSLog(@"SUOTA Device is ready after %.3f seconds, discovery %.3f seconds", self.connectLatency, self.suotaManager.discoveryTime);
+    [self.delegate sendEvent:@{
+        @"sessionId": @(self.sessionId),
+        @"event": @"metrics",
+        @"connectLatency": @(self.connectLatency),
+        @"discoveryTime": @(self.suotaManager.discoveryTime),
+        @"peripheralSource": self.peripheralSource,
+    }];
+
+    SuotaFile* suotaFile = self.suotaFile;
+    if (suotaFile == nil) {
+        NSFileManager* fileManager = [NSFileManager defaultManager];
+        NSString* fullFilePath = [NSString pathWithComponents:@[self.filePath, self.fileName]];
+        if (![fileManager fileExistsAtPath:fullFilePath]) {
+            NSLog(@"SUOTA File is not OK");
+            [self fail:FIRMWARE_LOAD_FAILED];
+            [self.suotaManager disconnect];
+            return;
+        }
+
+        NSLog(@"SUOTA File is OK");
+        suotaFile = [[SuotaFile alloc] initWithAbsoluteFilePath:fullFilePath];
+    }
+    self.suotaManager.suotaFile = suotaFile;
+    NSLog(@"SUOTA File is set");
+    [self.suotaManager initializeSuota];
+    NSLog(@"SUOTA Suota initiated");
+
+    [self.suotaManager startUpdate];
+}
+
+- (void) onSuotaLog:(enum SuotaProtocolState)state type:(enum SuotaLogType)type log:(NSString*)log {
+    if (self.telemetry.state == state)
+        return;
+    self.telemetry.state = state;
+    [self sendTelemetry:TELEMETRY_STATE];
+}
+
+- (void) onChunkSend:(int)chunkCount totalChunks:(int)totalChunks chunk:(int)chunk block:(int)block blockChunks:(int)blockChunks totalBlocks:(int)totalBlocks {
+    SuotaFile* suotaFile = self.suotaManager.suotaFile;
+    self.telemetry.block = block;
+    self.telemetry.totalBlocks = totalBlocks;
+    self.telemetry.chunkCount = chunkCount;
+    self.telemetry.totalChunks = totalChunks;
+    int blockBytes = MIN(chunk * suotaFile.chunkSize, suotaFile.blockSize);
+    self.telemetry.bytesSent = MIN((block - 1) * suotaFile.blockSize + blockBytes, suotaFile.uploadSize);
+    [self sendTelemetry:TELEMETRY_CHUNK];
+}
+
+- (void) updateSpeedStatistics:(double)current max:(double)max min:(double)min avg:(double)avg {
+    self.telemetry.currentSpeed = current;
+    self.telemetry.avgSpeed = avg;
+    [self sendTelemetry:TELEMETRY_SPEED];
+}
+
+- (void) onBlockSent:(int)block totalBlocks:(int)totalBlocks {
+    SuotaFile* suotaFile = self.suotaManager.suotaFile;
+    self.telemetry.block = block;
+    self.telemetry.totalBlocks = totalBlocks;
+    self.telemetry.bytesSent = MIN(block * suotaFile.blockSize, suotaFile.uploadSize);
+    [self sendTelemetry:TELEMETRY_BLOCK];
+}
+
+- (void) updateCurrentSpeed:(double)currentSpeed {
+    self.telemetry.currentSpeed = currentSpeed;
+    [self sendTelemetry:TELEMETRY_SPEED];
+}
+
+- (void) onUploadProgress:(float)percent {
+    self.telemetry.percent = percent;
+    [self sendTelemetry:TELEMETRY_PROGRESS];
+}
+
+- (void) onSuccess:(double)totalElapsedSeconds imageUploadElapsedSeconds:(double)imageUploadElapsedSeconds {
+    if (self.finished)
+        return;
+    [self finish:@{
+        @"sessionId": @(self.sessionId),
+        @"event": @"success",
+        @"totalElapsedSeconds": @(totalElapsedSeconds),
+        @"imageUploadElapsedSeconds": @(imageUploadElapsedSeconds),
+    }];
+}
+
+- (void) onRebootSent {
+}
+
+- (void) onFirmwareCurrent:(SuotaFile*)suotaFile {
+    if (self.finished)
+        return;
+    NSString *version = suotaFile.headerInfo.version;
+    NSLog(@"SUOTA Device already runs %@ (firmware %@, software %@)", version, self.suotaManager.firmwareRevision, self.suotaManager.softwareRevision);
+    [self finish:@{
+        @"sessionId": @(self.sessionId),
+        @"event": @"current",
+        @"version": version ? version : NSNull.null,
+    }];
+    [self.suotaManager disconnect];
+}
+
+@end
@@ -0,0 +1,84 @@
+#import <Foundation/Foundation.h>
+
+/*!
+ * @enum SuotaTelemetryEvent
+ *
+ * @abstract The notification that produced a telemetry record.
+ */
+enum SuotaTelemetryEvent {
+    TELEMETRY_STATE = 1,
+    TELEMETRY_CHUNK,
+    TELEMETRY_BLOCK,
+    TELEMETRY_PROGRESS,
+    TELEMETRY_SPEED,
+};
+
+/*!
+ * @defined SUOTA_TELEMETRY_VERSION
+ *
+ * @abstract Version of the telemetry record layout. Must match the Dart decoder.
+ */
+#define SUOTA_TELEMETRY_VERSION 1
+
+/*!
+ * @defined SUOTA_TELEMETRY_NO_STATE
+ *
+ * @abstract Protocol state value sent before the SUOTA protocol starts.
+ */
+#define SUOTA_TELEMETRY_NO_STATE 0xFF
+
+/*!
+ * @defined SUOTA_TELEMETRY_RECORD_SIZE
+ *
+ * @abstract Size in bytes of an encoded telemetry record.
+ */
+#define SUOTA_TELEMETRY_RECORD_SIZE 56
+
+/*!
+ * @class SuotaTelemetry
+ *
+ * @discussion Keeps the latest upload state of a session, and encodes it as a fixed size little endian record, which is sent on the event channel.
+ *
+ * Record layout:
+ * <pre>
+ *  0 uint32  session id
+ *  4 uint8   event, see {@link SuotaTelemetryEvent}
+ *  5 uint8   SUOTA protocol state, or {@link SUOTA_TELEMETRY_NO_STATE}
+ *  6 uint8   record version
+ *  7 uint8   reserved
+ *  8 uint32  block
+ * 12 uint32  total blocks
+ * 16 uint32  chunk count
+ * 20 uint32  total chunks
+ * 24 uint32  bytes sent
+ * 28 float32 upload progress percent
+ * 32 float64 current speed in Bps
+ * 40 float64 average speed in Bps
+ * 48 float64 seconds since the session started
+ * </pre>
+ */
+@interface SuotaTelemetry : NSObject
+
+@property (readonly) uint32_t sessionId;
+@property uint8_t state;
+@property uint32_t block;
+@property uint32_t totalBlocks;
+@property uint32_t chunkCount;
+@property uint32_t totalChunks;
+@property uint32_t bytesSent;
+@property float percent;
+@property double currentSpeed;
+@property double avgSpeed;
+
+- (instancetype) initWithSessionId:(uint32_t)sessionId;
+
+/*!
+ * @method encode:
+ *
+ * @param event The notification that produced the record.
+ *
+ * @return The encoded record, timestamped with the current time.
+ */
+- (NSData*) encode:(enum SuotaTelemetryEvent)event;
+
+@end
@@ -0,0 +1,56 @@
+#import "SuotaTelemetry.h"
+
+struct __attribute__((packed)) SuotaTelemetryRecord {
+    uint32_t sessionId;
+    uint8_t event;
+    uint8_t state;
+    uint8_t version;
+    uint8_t reserved;
+    uint32_t block;
+    uint32_t totalBlocks;
+    uint32_t chunkCount;
+    uint32_t totalChunks;
+    uint32_t bytesSent;
+    float percent;
+    double currentSpeed;
+    double avgSpeed;
+    double timestamp;
+};
+
+_Static_assert(sizeof(struct SuotaTelemetryRecord) == SUOTA_TELEMETRY_RECORD_SIZE, "Telemetry record layout changed");
+
+@implementation SuotaTelemetry {
+    NSTimeInterval startTime;
+}
+
+- (instancetype) initWithSessionId:(uint32_t)sessionId {
+    self = [super init];
+    if (!self)
+        return nil;
+    _sessionId = sessionId;
+    _state = SUOTA_TELEMETRY_NO_STATE;
+    startTime = NSProcessInfo.processInfo.systemUptime;
+    return self;
+}
+
+- (NSData*) encode:(enum SuotaTelemetryEvent)event {
+    // iOS devices are little endian, so the record is sent as laid out in memory
+    struct SuotaTelemetryRecord record = {
+        .sessionId = self.sessionId,
+        .event = event,
+        .state = self.state,
+        .version = SUOTA_TELEMETRY_VERSION,
+        .block = self.block,
+        .totalBlocks = self.totalBlocks,
+        .chunkCount = self.chunkCount,
+        .totalChunks = self.totalChunks,
+        .bytesSent = self.bytesSent,
+        .percent = self.percent,
+        .currentSpeed = self.currentSpeed,
+        .avgSpeed = self.avgSpeed,
+        .timestamp = NSProcessInfo.processInfo.systemUptime - startTime,
+    };
+    return [NSData dataWithBytes:&record length:sizeof(record)];
+}
+
+@end
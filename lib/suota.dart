@@ -1,19 +1,30 @@
 
+import 'dart:typed_data';
+
 import 'suota_platform_interface.dart';
+import 'suota_version_check.dart';
+
+export 'suota_session_metrics.dart';
+export 'suota_telemetry.dart';
+export 'suota_version_check.dart';
 
 
 class Suota {
   Future<String?> getPlatformVersion() {
     return SuotaPlatform.instance.getPlatformVersion();
   }
-  Future<bool> installUpdate(
+  Future<int> installUpdate(
       String path,
       String fileName,
       String remoteId,
       SuotaProgressCallback? progressCallback,
       SuotaSuccessCallback? successCallback,
-      SuotaFailureCallback? failureCallback,
-      ) async {
+      SuotaFailureCallback? failureCallback, {
+      SuotaTelemetryCallback? telemetryCallback,
+      SuotaMetricsCallback? metricsCallback,
+      SuotaVersionCheck? versionCheck,
+      SuotaCurrentCallback? currentCallback,
+      }) async {
     return await SuotaPlatform.instance.installUpdate(
       path,
       fileName,
@@ -21,6 +32,63 @@ class Suota {
       progressCallback,
       successCallback,
       failureCallback,
+      telemetryCallback: telemetryCallback,
+      metricsCallback: metricsCallback,
+      versionCheck: versionCheck,
+      currentCallback: currentCallback,
+    );
+  }
+
+  Future<int> installUpdateFromBytes(
+      Uint8List firmware,
+      String remoteId,
+      SuotaProgressCallback? progressCallback,
+      SuotaSuccessCallback? successCallback,
+      SuotaFailureCallback? failureCallback, {
+      SuotaTelemetryCallback? telemetryCallback,
+      SuotaMetricsCallback? metricsCallback,
+      SuotaVersionCheck? versionCheck,
+      SuotaCurrentCallback? currentCallback,
+      }) async {
+    return await SuotaPlatform.instance.installUpdateFromBytes(
+      firmware,
+      remoteId,
+      progressCallback,
+      successCallback,
+      failureCallback,
+      telemetryCallback: telemetryCallback,
+      metricsCallback: metricsCallback,
+      versionCheck: versionCheck,
+      currentCallback: currentCallback,
     );
   }
+  Future<int> installUpdateFromHandle(
+      int handle,
+      String remoteId,
+      SuotaProgressCallback? progressCallback,
+      SuotaSuccessCallback? successCallback,
+      SuotaFailureCallback? failureCallback, {
+      SuotaTelemetryCallback? telemetryCallback,
+      SuotaMetricsCallback? metricsCallback,
+      SuotaVersionCheck? versionCheck,
+      SuotaCurrentCallback? currentCallback,
+      }) async {
+    return await SuotaPlatform.instance.installUpdateFromHandle(
+      handle,
+      remoteId,
+      progressCallback,
+      successCallback,
+      failureCallback,
+      telemetryCallback: telemetryCallback,
+      metricsCallback: metricsCallback,
+      versionCheck: versionCheck,
+      currentCallback: currentCallback,
+    );
+  }
+  Future<int> loadFirmware(Uint8List firmware) {
+    return SuotaPlatform.instance.loadFirmware(firmware);
+  }
+  Future<void> releaseFirmware(int handle) {
+    return SuotaPlatform.instance.releaseFirmware(handle);
+  }
 }
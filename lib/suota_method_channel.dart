@@ -1,7 +1,12 @@
+import 'dart:async';
+
 import 'package:flutter/foundation.dart';
 import 'package:flutter/services.dart';
 
 import 'suota_platform_interface.dart';
+import 'suota_session_metrics.dart';
+import 'suota_telemetry.dart';
+import 'suota_version_check.dart';
 
 /// An implementation of [SuotaPlatform] that uses method channels.
 class MethodChannelSuota extends SuotaPlatform {
@@ -18,28 +23,144 @@ class MethodChannelSuota extends SuotaPlatform {
   }
 
 
+  /// Callbacks of the running sessions, keyed by session id.
+  final _sessions = <int, _SuotaSessionCallbacks>{};
+
+  /// The single subscription to the event channel, shared by all sessions.
+  StreamSubscription<dynamic>? _events;
+
   @override
-  Future<bool> installUpdate(String path,
+  Future<int> installUpdate(String path,
       String fileName,
       String remoteId,
       SuotaProgressCallback? progressCallback,
       SuotaSuccessCallback? successCallback,
-      SuotaFailureCallback? failureCallback) async {
-    _eventChannel.receiveBroadcastStream().listen((event) {
-      if (event is Map<dynamic, dynamic>) {
-        print('event: $event');
-        final progress = event['progress'];
-        if (progress != null) {
-          progressCallback?.call(progress);
-        }
-      }
-    }, onError: (error) {
-      print(error);
-    });
-    return await methodChannel.invokeMethod('installUpdate', {
+      SuotaFailureCallback? failureCallback,
+      {SuotaTelemetryCallback? telemetryCallback,
+      SuotaMetricsCallback? metricsCallback,
+      SuotaVersionCheck? versionCheck,
+      SuotaCurrentCallback? currentCallback}) {
+    return _startSession('installUpdate', {
       'path': path,
       'fileName': fileName,
       'remoteId': remoteId,
+      ...?versionCheck?.toArguments(),
+    }, _SuotaSessionCallbacks(progressCallback, successCallback,
+        failureCallback, telemetryCallback, metricsCallback, currentCallback));
+  }
+
+  @override
+  Future<int> installUpdateFromBytes(Uint8List firmware,
+      String remoteId,
+      SuotaProgressCallback? progressCallback,
+      SuotaSuccessCallback? successCallback,
+      SuotaFailureCallback? failureCallback,
+      {SuotaTelemetryCallback? telemetryCallback,
+      SuotaMetricsCallback? metricsCallback,
+      SuotaVersionCheck? versionCheck,
+      SuotaCurrentCallback? currentCallback}) {
+    return _startSession('installUpdateFromBytes', {
+      'firmware': firmware,
+      'remoteId': remoteId,
+      ...?versionCheck?.toArguments(),
+    }, _SuotaSessionCallbacks(progressCallback, successCallback,
+        failureCallback, telemetryCallback, metricsCallback, currentCallback));
+  }
+
+  @override
+  Future<int> installUpdateFromHandle(int handle,
+      String remoteId,
+      SuotaProgressCallback? progressCallback,
+      SuotaSuccessCallback? successCallback,
+      SuotaFailureCallback? failureCallback,
+      {SuotaTelemetryCallback? telemetryCallback,
+      SuotaMetricsCallback? metricsCallback,
+      SuotaVersionCheck? versionCheck,
+      SuotaCurrentCallback? currentCallback}) {
+    return _startSession('installUpdateFromHandle', {
+      'handle': handle,
+      'remoteId': remoteId,
+      ...?versionCheck?.toArguments(),
+    }, _SuotaSessionCallbacks(progressCallback, successCallback,
+        failureCallback, telemetryCallback, metricsCallback, currentCallback));
+  }
+
+  @override
+  Future<int> loadFirmware(Uint8List firmware) async {
+    final handle = await methodChannel.invokeMethod<int>('loadFirmware', {
+      'firmware': firmware,
+    });
+    return handle!;
+  }
+
+  @override
+  Future<void> releaseFirmware(int handle) async {
+    await methodChannel.invokeMethod('releaseFirmware', {
+      'handle': handle,
     });
   }
+
+  Future<int> _startSession(String method, Map<String, dynamic> arguments,
+      _SuotaSessionCallbacks callbacks) async {
+    _events ??= _eventChannel
+        .receiveBroadcastStream()
+        .listen(_onEvent, onError: (error) {
+      print(error);
+    });
+    final sessionId = (await methodChannel.invokeMethod<int>(method, arguments))!;
+    // The native side sends the session id before any event of the session,
+    // and this runs before the next event is handled.
+    _sessions[sessionId] = callbacks;
+    return sessionId;
+  }
+
+  @visibleForTesting
+  void handleEvent(dynamic event) => _onEvent(event);
+
+  void _onEvent(dynamic event) {
+    if (event is Uint8List) {
+      final telemetry = SuotaTelemetry.decode(ByteData.sublistView(event));
+      if (telemetry == null) {
+        return;
+      }
+      final callbacks = _sessions[telemetry.sessionId];
+      callbacks?.telemetryCallback?.call(telemetry);
+      if (telemetry.event == SuotaTelemetryEvent.progress) {
+        callbacks?.progressCallback?.call(telemetry.percent);
+      }
+    } else if (event is Map) {
+      if (event['event'] == 'metrics') {
+        _sessions[event['sessionId']]
+            ?.metricsCallback
+            ?.call(SuotaSessionMetrics.fromMap(event));
+        return;
+      }
+      final callbacks = _sessions.remove(event['sessionId']);
+      if (callbacks == null) {
+        return;
+      }
+      switch (event['event']) {
+        case 'success':
+          callbacks.successCallback?.call(
+              event['totalElapsedSeconds'], event['imageUploadElapsedSeconds']);
+        case 'failure':
+          callbacks.failureCallback?.call(event['errorCode']);
+        case 'current':
+          callbacks.currentCallback?.call(event['version']);
+      }
+    }
+  }
+}
+
+class _SuotaSessionCallbacks {
+  final SuotaProgressCallback? progressCallback;
+  final SuotaSuccessCallback? successCallback;
+  final SuotaFailureCallback? failureCallback;
+  final SuotaTelemetryCallback? telemetryCallback;
+  final SuotaMetricsCallback? metricsCallback;
+  final SuotaCurrentCallback? currentCallback;
+
+  _SuotaSessionCallbacks(this.progressCallback, this.successCallback,
+      this.failureCallback, this.telemetryCallback, this.metricsCallback,
+      this.currentCallback);
 }
@@ -1,11 +1,19 @@
+import 'dart:typed_data';
+
 import 'package:plugin_platform_interface/plugin_platform_interface.dart';
 
 import 'suota_method_channel.dart';
+import 'suota_session_metrics.dart';
+import 'suota_telemetry.dart';
+import 'suota_version_check.dart';
 
 typedef SuotaProgressCallback = void Function(double percent);
 typedef SuotaSuccessCallback = void Function(
     double totalElapsedSeconds, double imageUploadElapsedSeconds);
 typedef SuotaFailureCallback = void Function(int errorCode);
+typedef SuotaTelemetryCallback = void Function(SuotaTelemetry telemetry);
+typedef SuotaMetricsCallback = void Function(SuotaSessionMetrics metrics);
+typedef SuotaCurrentCallback = void Function(String? version);
 
 abstract class SuotaPlatform extends PlatformInterface {
   /// Constructs a SuotaPlatform.
@@ -32,14 +40,75 @@ abstract class SuotaPlatform extends PlatformInterface {
     return _instance.getPlatformVersion();
   }
 
-  Future<bool> installUpdate(
+  /// Updates the device with a firmware file. Returns the session id once the
+  /// update has started. Several devices can be updated in parallel; the
+  /// callbacks of each session receive only its own events, and success or
+  /// failure is reported through [successCallback] and [failureCallback].
+  ///
+  /// With a [versionCheck], the image isn't uploaded if the device already
+  /// runs it, and [currentCallback] is called with the image version instead
+  /// of [successCallback]. Version checks are supported on iOS only.
+  Future<int> installUpdate(
       String path,
       String fileName,
       String remoteId,
       SuotaProgressCallback? progressCallback,
       SuotaSuccessCallback? successCallback,
-      SuotaFailureCallback? failureCallback) {
+      SuotaFailureCallback? failureCallback,
+      {SuotaTelemetryCallback? telemetryCallback,
+      SuotaMetricsCallback? metricsCallback,
+      SuotaVersionCheck? versionCheck,
+      SuotaCurrentCallback? currentCallback}) {
     return _instance.installUpdate(
-        path, fileName, remoteId, progressCallback, successCallback, failureCallback);
+        path, fileName, remoteId, progressCallback, successCallback, failureCallback,
+        telemetryCallback: telemetryCallback, metricsCallback: metricsCallback,
+        versionCheck: versionCheck, currentCallback: currentCallback);
+  }
+
+  /// Updates the device with a firmware image passed from memory, without
+  /// writing it to a file first. Returns the session id, like [installUpdate].
+  Future<int> installUpdateFromBytes(
+      Uint8List firmware,
+      String remoteId,
+      SuotaProgressCallback? progressCallback,
+      SuotaSuccessCallback? successCallback,
+      SuotaFailureCallback? failureCallback,
+      {SuotaTelemetryCallback? telemetryCallback,
+      SuotaMetricsCallback? metricsCallback,
+      SuotaVersionCheck? versionCheck,
+      SuotaCurrentCallback? currentCallback}) {
+    return _instance.installUpdateFromBytes(
+        firmware, remoteId, progressCallback, successCallback, failureCallback,
+        telemetryCallback: telemetryCallback, metricsCallback: metricsCallback,
+        versionCheck: versionCheck, currentCallback: currentCallback);
+  }
+
+  /// Updates the device with a firmware image loaded by [loadFirmware].
+  /// Returns the session id, like [installUpdate].
+  Future<int> installUpdateFromHandle(
+      int handle,
+      String remoteId,
+      SuotaProgressCallback? progressCallback,
+      SuotaSuccessCallback? successCallback,
+      SuotaFailureCallback? failureCallback,
+      {SuotaTelemetryCallback? telemetryCallback,
+      SuotaMetricsCallback? metricsCallback,
+      SuotaVersionCheck? versionCheck,
+      SuotaCurrentCallback? currentCallback}) {
+    return _instance.installUpdateFromHandle(
+        handle, remoteId, progressCallback, successCallback, failureCallback,
+        telemetryCallback: telemetryCallback, metricsCallback: metricsCallback,
+        versionCheck: versionCheck, currentCallback: currentCallback);
+  }
+
+  /// Keeps a firmware image in native memory, so that it can be used for
+  /// several updates without sending it again. Returns the image handle.
+  Future<int> loadFirmware(Uint8List firmware) {
+    return _instance.loadFirmware(firmware);
+  }
+
+  /// Frees a firmware image loaded by [loadFirmware].
+  Future<void> releaseFirmware(int handle) {
+    return _instance.releaseFirmware(handle);
   }
 }
@@ -0,0 +1,38 @@
+/// Timing of an update session, reported once the device is ready.
+class SuotaSessionMetrics {
+  final int sessionId;
+
+  /// Seconds from the install call until the device was ready for the update.
+  final double connectLatency;
+
+  /// Seconds spent discovering the SUOTA and device information services and
+  /// characteristics, included in [connectLatency]. Null if the platform
+  /// doesn't report it.
+  final double? discoveryTime;
+
+  /// How the device was found. On iOS, `connected` if it was already
+  /// connected to the system, `known` if the system retrieved it by its
+  /// identifier, or `scan`. On Android, `address`.
+  final String peripheralSource;
+
+  const SuotaSessionMetrics({
+    required this.sessionId,
+    required this.connectLatency,
+    this.discoveryTime,
+    required this.peripheralSource,
+  });
+
+  factory SuotaSessionMetrics.fromMap(Map<dynamic, dynamic> map) {
+    return SuotaSessionMetrics(
+      sessionId: map['sessionId'],
+      connectLatency: (map['connectLatency'] as num).toDouble(),
+      discoveryTime: (map['discoveryTime'] as num?)?.toDouble(),
+      peripheralSource: map['peripheralSource'] ?? '',
+    );
+  }
+
+  @override
+  String toString() =>
+      'SuotaSessionMetrics(session: $sessionId, connectLatency: $connectLatency, '
+      'discoveryTime: $discoveryTime, peripheralSource: $peripheralSource)';
+}
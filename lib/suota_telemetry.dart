@@ -0,0 +1,98 @@
+import 'dart:typed_data';
+
+/// The notification that produced a [SuotaTelemetry] record.
+enum SuotaTelemetryEvent {
+  unknown,
+  state,
+  chunk,
+  block,
+  progress,
+  speed,
+}
+
+/// A snapshot of an update session, sent by the native side as a fixed size
+/// little endian record on the event channel.
+///
+/// The layout must match `SuotaTelemetry` on iOS and Android:
+///
+/// ```
+///  0 uint32  session id
+///  4 uint8   event
+///  5 uint8   SUOTA protocol state, or [noState]
+///  6 uint8   record version
+///  7 uint8   reserved
+///  8 uint32  block
+/// 12 uint32  total blocks
+/// 16 uint32  chunk count
+/// 20 uint32  total chunks
+/// 24 uint32  bytes sent
+/// 28 float32 upload progress percent
+/// 32 float64 current speed in Bps
+/// 40 float64 average speed in Bps
+/// 48 float64 seconds since the session started
+/// ```
+class SuotaTelemetry {
+  static const int version = 1;
+  static const int recordSize = 56;
+  static const int noState = 0xFF;
+
+  final int sessionId;
+  final SuotaTelemetryEvent event;
+  final int state;
+  final int block;
+  final int totalBlocks;
+  final int chunkCount;
+  final int totalChunks;
+  final int bytesSent;
+  final double percent;
+  final double currentSpeed;
+  final double avgSpeed;
+  final double elapsedSeconds;
+
+  const SuotaTelemetry({
+    required this.sessionId,
+    required this.event,
+    required this.state,
+    required this.block,
+    required this.totalBlocks,
+    required this.chunkCount,
+    required this.totalChunks,
+    required this.bytesSent,
+    required this.percent,
+    required this.currentSpeed,
+    required this.avgSpeed,
+    required this.elapsedSeconds,
+  });
+
+  /// Decodes a record. Returns null if the record has an unknown version or
+  /// is too short.
+  static SuotaTelemetry? decode(ByteData data) {
+    if (data.lengthInBytes < recordSize || data.getUint8(6) != version) {
+      return null;
+    }
+    final event = data.getUint8(4);
+    return SuotaTelemetry(
+      sessionId: data.getUint32(0, Endian.little),
+      event: event < SuotaTelemetryEvent.values.length
+          ? SuotaTelemetryEvent.values[event]
+          : SuotaTelemetryEvent.unknown,
+      state: data.getUint8(5),
+      block: data.getUint32(8, Endian.little),
+      totalBlocks: data.getUint32(12, Endian.little),
+      chunkCount: data.getUint32(16, Endian.little),
+      totalChunks: data.getUint32(20, Endian.little),
+      bytesSent: data.getUint32(24, Endian.little),
+      percent: data.getFloat32(28, Endian.little),
+      currentSpeed: data.getFloat64(32, Endian.little),
+      avgSpeed: data.getFloat64(40, Endian.little),
+      elapsedSeconds: data.getFloat64(48, Endian.little),
+    );
+  }
+
+  @override
+  String toString() =>
+      'SuotaTelemetry(session: $sessionId, event: ${event.name}, state: $state, '
+      'block: $block/$totalBlocks, chunk: $chunkCount/$totalChunks, '
+      'bytes: $bytesSent, progress: $percent, speed: $currentSpeed, '
+      'avg: $avgSpeed, elapsed: $elapsedSeconds)';
+}
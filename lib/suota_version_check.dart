@@ -0,0 +1,57 @@
+/// How the image version is compared with a device revision.
+enum SuotaVersionComparison {
+  /// The image version equals the device revision.
+  exact,
+
+  /// The timestamp in the device revision equals the image timestamp.
+  timestamp,
+
+  /// The version number in the device revision, like `6.0.14.1114`, equals
+  /// the image version number.
+  semantic,
+}
+
+/// The Device Information Service revision compared with the image.
+enum SuotaRevisionField {
+  /// The firmware revision. On many devices this is the SDK version, not the
+  /// application version.
+  firmware,
+
+  /// The software revision.
+  software,
+}
+
+/// How the firmware image is compared with the firmware running on the
+/// device before the upload. If the device is current, the image isn't
+/// uploaded and the session ends with the current callback instead.
+///
+/// The image version and timestamp are read from its header, and compared
+/// with the [field] revision string of the device.
+class SuotaVersionCheck {
+  final SuotaVersionComparison comparison;
+
+  /// The device revision compared with the image.
+  final SuotaRevisionField field;
+
+  /// Whether a device running a newer timestamp or version than the image is
+  /// also current, so that older images are never installed. Ignored by the
+  /// exact comparison.
+  final bool allowNewer;
+
+  const SuotaVersionCheck(this.comparison,
+      {this.field = SuotaRevisionField.software, this.allowNewer = false});
+
+  static const exact = SuotaVersionCheck(SuotaVersionComparison.exact);
+  static const timestamp = SuotaVersionCheck(SuotaVersionComparison.timestamp);
+  static const semantic = SuotaVersionCheck(SuotaVersionComparison.semantic);
+
+  Map<String, Object> toArguments() => {
+        'versionCheck': comparison.name,
+        'versionField': field.name,
+        'allowNewer': allowNewer,
+      };
+
+  @override
+  String toString() =>
+      'SuotaVersionCheck(${comparison.name}, field: ${field.name}, allowNewer: $allowNewer)';
+}
@@ -1,6 +1,11 @@
+import 'dart:typed_data';
+
 import 'package:flutter/services.dart';
 import 'package:flutter_test/flutter_test.dart';
-import 'package:suota/suota_method_channel.dart';
+import 'package:renesas_suota/suota_method_channel.dart';
+import 'package:renesas_suota/suota_session_metrics.dart';
+import 'package:renesas_suota/suota_telemetry.dart';
+import 'package:renesas_suota/suota_version_check.dart';
 
 void main() {
   TestWidgetsFlutterBinding.ensureInitialized();
@@ -24,4 +29,104 @@ void main() {
   test('getPlatformVersion', () async {
     expect(await platform.getPlatformVersion(), '42');
   });
+
+  test('loadFirmware passes the image bytes', () async {
+    final firmware = Uint8List.fromList(List.generate(1024, (i) => i & 0xFF));
+    final messenger = TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger;
+    messenger.setMockMethodCallHandler(platform.methodChannel, (MethodCall methodCall) async {
+      expect(methodCall.method, 'loadFirmware');
+      expect(methodCall.arguments['firmware'], firmware);
+      return 1;
+    });
+    addTearDown(() => messenger.setMockMethodCallHandler(platform.methodChannel, null));
+
+    expect(await platform.loadFirmware(firmware), 1);
+  });
+
+  test('events are demultiplexed by session id', () async {
+    final messenger = TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger;
+    var nextSessionId = 1;
+    messenger.setMockMethodCallHandler(platform.methodChannel, (MethodCall methodCall) async {
+      return nextSessionId++;
+    });
+    messenger.setMockStreamHandler(
+        const EventChannel('renesas_suota/events'), MockStreamHandler.inline(onListen: (_, __) {}));
+    addTearDown(() => messenger.setMockMethodCallHandler(platform.methodChannel, null));
+
+    final progress = <int, List<double>>{1: [], 2: []};
+    final finished = <int, String>{};
+    final latency = <int, double>{};
+    for (final remoteId in ['A', 'B']) {
+      late int sessionId;
+      sessionId = await platform.installUpdate('path', 'file.img', remoteId,
+          (percent) => progress[sessionId]!.add(percent),
+          (total, upload) => finished[sessionId] = 'success',
+          (error) => finished[sessionId] = 'failure $error',
+          metricsCallback: (metrics) => latency[sessionId] = metrics.connectLatency);
+    }
+
+    Uint8List record(int sessionId, double percent) {
+      final data = ByteData(SuotaTelemetry.recordSize);
+      data.setUint32(0, sessionId, Endian.little);
+      data.setUint8(4, SuotaTelemetryEvent.progress.index);
+      data.setUint8(6, SuotaTelemetry.version);
+      data.setFloat32(28, percent, Endian.little);
+      return data.buffer.asUint8List();
+    }
+
+    platform.handleEvent(
+        {'sessionId': 1, 'event': 'metrics', 'connectLatency': 0.25, 'peripheralSource': 'known'});
+    platform.handleEvent(record(1, 50));
+    platform.handleEvent(record(2, 25));
+    platform.handleEvent({'sessionId': 2, 'event': 'failure', 'errorCode': 0xfff7});
+    platform.handleEvent(record(2, 75));
+    platform.handleEvent({
+      'sessionId': 1,
+      'event': 'success',
+      'totalElapsedSeconds': 10.0,
+      'imageUploadElapsedSeconds': 8.0,
+    });
+
+    expect(progress[1], [50]);
+    expect(progress[2], [25]);
+    expect(finished, {1: 'success', 2: 'failure ${0xfff7}'});
+    expect(latency, {1: 0.25});
+  });
+
+  test('a current device ends the session with the current callback', () async {
+    final messenger = TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger;
+    messenger.setMockMethodCallHandler(platform.methodChannel, (MethodCall methodCall) async {
+      expect(methodCall.arguments['versionCheck'], 'semantic');
+      expect(methodCall.arguments['versionField'], 'firmware');
+      expect(methodCall.arguments['allowNewer'], false);
+      return 7;
+    });
+    messenger.setMockStreamHandler(
+        const EventChannel('renesas_suota/events'), MockStreamHandler.inline(onListen: (_, __) {}));
+    addTearDown(() => messenger.setMockMethodCallHandler(platform.methodChannel, null));
+
+    final finished = <String>[];
+    await platform.installUpdateFromHandle(1, 'A', null,
+        (total, upload) => finished.add('success'), (error) => finished.add('failure'),
+        versionCheck: const SuotaVersionCheck(SuotaVersionComparison.semantic,
+            field: SuotaRevisionField.firmware),
+        currentCallback: (version) => finished.add('current $version'));
+
+    platform.handleEvent({'sessionId': 7, 'event': 'current', 'version': '6.0.14.1114'});
+    platform.handleEvent({'sessionId': 7, 'event': 'failure', 'errorCode': 1});
+    expect(finished, ['current 6.0.14.1114']);
+  });
+
+  test('session metrics discovery time is optional', () {
+    final ios = SuotaSessionMetrics.fromMap({
+      'sessionId': 1,
+      'connectLatency': 0.5,
+      'discoveryTime': 0.125,
+      'peripheralSource': 'connected',
+    });
+    expect(ios.discoveryTime, 0.125);
+    final android = SuotaSessionMetrics.fromMap(
+        {'sessionId': 2, 'connectLatency': 0.5, 'peripheralSource': 'address'});
+    expect(android.discoveryTime, isNull);
+  });
 }
@@ -0,0 +1,45 @@
+import 'dart:typed_data';
+
+import 'package:flutter_test/flutter_test.dart';
+import 'package:renesas_suota/suota_telemetry.dart';
+
+void main() {
+  ByteData record({int version = SuotaTelemetry.version}) {
+    final data = ByteData(SuotaTelemetry.recordSize);
+    data.setUint32(0, 7, Endian.little);
+    data.setUint8(4, SuotaTelemetryEvent.chunk.index);
+    data.setUint8(5, 3);
+    data.setUint8(6, version);
+    data.setUint32(8, 12, Endian.little);
+    data.setUint32(12, 300, Endian.little);
+    data.setUint32(16, 190, Endian.little);
+    data.setUint32(20, 4800, Endian.little);
+    data.setUint32(24, 45600, Endian.little);
+    data.setFloat32(28, 4.0, Endian.little);
+    data.setFloat64(32, 21500.5, Endian.little);
+    data.setFloat64(40, 19875.25, Endian.little);
+    data.setFloat64(48, 2.5, Endian.little);
+    return data;
+  }
+
+  test('decode', () {
+    final telemetry = SuotaTelemetry.decode(record())!;
+    expect(telemetry.sessionId, 7);
+    expect(telemetry.event, SuotaTelemetryEvent.chunk);
+    expect(telemetry.state, 3);
+    expect(telemetry.block, 12);
+    expect(telemetry.totalBlocks, 300);
+    expect(telemetry.chunkCount, 190);
+    expect(telemetry.totalChunks, 4800);
+    expect(telemetry.bytesSent, 45600);
+    expect(telemetry.percent, 4.0);
+    expect(telemetry.currentSpeed, 21500.5);
+    expect(telemetry.avgSpeed, 19875.25);
+    expect(telemetry.elapsedSeconds, 2.5);
+  });
+
+  test('decode rejects unknown versions and short records', () {
+    expect(SuotaTelemetry.decode(record(version: 2)), isNull);
+    expect(SuotaTelemetry.decode(ByteData(SuotaTelemetry.recordSize - 1)), isNull);
+  });
+}